@@ -343,6 +343,7 @@ enum audio_mode {
 enum rtp_receive_mode {
 	RECEIVE_MODE_MAIN = 0,  /**< RTP RX is processed in main thread      */
 	RECEIVE_MODE_THREAD,    /**< RTP RX is processed in separate thread  */
+	RECEIVE_MODE_POOL,      /**< RTP RX is processed in worker pool      */
 };
 
 enum rtp_receive_mode resolve_receive_mode(const struct pl *fmt);
@@ -369,6 +370,8 @@ struct config_call {
 	uint32_t local_timeout; /**< Incoming call timeout [sec] 0=off    */
 	uint32_t max_calls;     /**< Maximum number of calls, 0=unlimited */
 	bool hold_other_calls;  /**< Hold other calls */
+	uint32_t arena_size;    /**< Per-call arena chunk [bytes], 0=off */
+	uint32_t arena_pool;    /**< Recycled arena chunks, 0=off        */
 };
 
 /** Audio */
@@ -394,6 +397,10 @@ struct config_audio {
 	bool adaptive;          /**< Enable adaptive audio buffer   */
 	double silence;         /**< Silence volume in [dB]         */
 	uint32_t telev_pt;      /**< Payload type for tel.-event    */
+	uint32_t red;           /**< Redundant frames per packet    */
+	bool stretch;           /**< Time-stretch the audio buffer  */
+	char moh_mod[16];       /**< Music-on-hold source module    */
+	char moh_dev[128];      /**< Music-on-hold source device    */
 };
 
 /** Video */
@@ -409,6 +416,10 @@ struct config_video {
 	double fps;             /**< Video framerate                */
 	bool fullscreen;        /**< Enable fullscreen display      */
 	int enc_fmt;            /**< Encoder pixelfmt (enum vidfmt) */
+	unsigned conv_threads;  /**< Pixel format converter threads */
+	uint32_t simulcast;     /**< Number of simulcast layers     */
+	bool cc;                /**< Congestion control             */
+	bool fec;               /**< Forward error correction       */
 };
 
 /** Audio/Video Transport */
@@ -421,15 +432,18 @@ struct config_avt {
 	struct {
 		enum jbuf_type jbtype;  /**< Jitter buffer type     */
 		struct range jbuf_del;  /**< Delay, number of frames*/
+		uint32_t jbuf_pct;      /**< Target delay percentile*/
 	} audio;
 	struct {
 		enum jbuf_type jbtype;  /**< Jitter buffer type     */
 		struct range jbuf_del;  /**< Delay, number of frames*/
+		uint32_t jbuf_pct;      /**< Target delay percentile*/
 	} video;
 	bool rtp_stats;         /**< Enable RTP statistics          */
 	uint32_t rtp_timeout;   /**< RTP Timeout in seconds (0=off) */
 	bool bundle;            /**< Media Multiplexing (BUNDLE)    */
 	enum rtp_receive_mode rxmode;   /**< RTP RX processing mode */
+	uint32_t rxworkers;     /**< Number of RTP RX pool workers  */
 };
 
 /** Network Configuration */
@@ -445,6 +459,24 @@ struct config_net {
 	bool use_getaddrinfo;   /**< Use getaddrinfo for A/AAAA records */
 };
 
+/** Media thread classes */
+enum media_thread {
+	MEDIA_THREAD_AUDIO_TX = 0,   /**< Audio TX thread                 */
+	MEDIA_THREAD_AUDIO_RX,       /**< RTP RX threads and workers      */
+	MEDIA_THREAD_AUDIO_DRV,      /**< Audio driver threads            */
+	MEDIA_THREAD_VIDEO,          /**< Video TX and encoder threads    */
+
+	MEDIA_THREAD_MAX
+};
+
+/** Media thread placement */
+struct config_sched {
+	char cpus[MEDIA_THREAD_MAX][64]; /**< CPU set per class, e.g. 2-3,6 */
+	uint32_t rt_prio;       /**< SCHED_FIFO priority of audio, 0=off */
+	bool numa_local;        /**< Allocate from the local NUMA node   */
+	uint32_t thread_pool;   /**< Parked media workers per class      */
+};
+
 
 /** Core configuration */
 struct config {
@@ -459,6 +491,8 @@ struct config {
 	struct config_avt avt;
 
 	struct config_net net;
+
+	struct config_sched sched;
 };
 
 int config_parse_conf(struct config *cfg, const struct conf *conf);
@@ -643,11 +677,21 @@ struct aufilt;
 struct aufilt_enc_st {
 	const struct aufilt *af;
 	struct le le;
+	int ifmt;             /**< Negotiated input format, or -1 */
 };
 
 struct aufilt_dec_st {
 	const struct aufilt *af;
 	struct le le;
+	int ifmt;             /**< Negotiated input format, or -1 */
+};
+
+/** Audio Filter capabilities */
+enum aufilt_flags {
+	AUFILT_INPLACE = 1 << 0,  /**< Works in-place on any format     */
+	AUFILT_S16     = 1 << 1,  /**< Works in-place on S16LE          */
+	AUFILT_CONV    = 1 << 2,  /**< Format converter, done by core   */
+	AUFILT_FLOAT   = 1 << 3,  /**< Works in-place on FLOAT          */
 };
 
 /** Audio Filter Parameters */
@@ -676,10 +720,52 @@ struct aufilt {
 	aufilt_encode_h *ench;
 	aufilt_decupd_h *decupdh;
 	aufilt_decode_h *dech;
+	uint32_t flags;       /**< Capabilities (enum aufilt_flags) */
 };
 
 void aufilt_register(struct list *aufiltl, struct aufilt *af);
 void aufilt_unregister(struct aufilt *af);
+int  aufilt_negotiate(const struct aufilt *af, struct aufilt_prm *prm);
+
+struct aufilt_arena;
+
+int  aufilt_arena_alloc(struct aufilt_arena **arenap, size_t sz);
+int  aufilt_arena_conv(struct aufilt_arena *arena, struct auframe *af,
+		       enum aufmt fmt);
+uint64_t aufilt_arena_convc(struct aufilt_arena *arena);
+int  aufilt_chain_encode(struct list *filtl, struct aufilt_arena *arena,
+			 struct auframe *af, enum aufmt fmt);
+int  aufilt_chain_decode(struct list *filtl, struct aufilt_arena *arena,
+			 struct auframe *af, enum aufmt fmt);
+
+
+/*
+ * Polyphase audio resampler
+ */
+
+struct aupoly;
+
+int    aupoly_alloc(struct aupoly **rsp, uint32_t irate, uint8_t ich,
+		    uint32_t orate, uint8_t och);
+bool   aupoly_match(const struct aupoly *rs, uint32_t irate, uint8_t ich,
+		    uint32_t orate, uint8_t och);
+size_t aupoly_maxoutc(const struct aupoly *rs, size_t inc);
+void   aupoly_reset(struct aupoly *rs);
+int    aupoly_process(struct aupoly *rs, int16_t *outv, size_t *outc,
+		      const int16_t *inv, size_t inc);
+int    aupoly_debug(struct re_printf *pf, const struct aupoly *rs);
+
+
+/*
+ * Audio time-stretching
+ */
+
+struct austretch;
+
+int austretch_alloc(struct austretch **stp);
+int austretch_process(struct austretch *st, struct auframe *af,
+		      bool compress);
+int austretch_debug(struct re_printf *pf, const struct austretch *st);
 
 
 /*
@@ -765,6 +851,16 @@ const struct menc *menc_find(const struct list *mencl, const char *id);
 const char *menc_event_name(enum menc_event event);
 
 
+/*
+ * Media thread placement
+ */
+
+int  media_thread_place(enum media_thread cls);
+const char *media_thread_name(enum media_thread cls);
+int  media_thread_debug(struct re_printf *pf, void *unused);
+void media_worker_stats(uint64_t *n_created, uint64_t *n_reused);
+
+
 /*
  * Net - Networking
  */
@@ -816,6 +912,8 @@ int  play_tone(struct play **playp, struct player *player,
 void play_set_finish_handler(struct play *play, play_finish_h *fh, void *arg);
 int  play_init(struct player **playerp);
 void play_set_path(struct player *player, const char *path);
+int  play_cache_preload(struct player *player, const char *dir);
+int  play_debug(struct re_printf *pf, const struct player *player);
 
 
 /*
@@ -859,6 +957,7 @@ enum ua_event {
 	UA_EVENT_CALL_REMOTE_SDP,     /**< param: offer or answer */
 	UA_EVENT_CALL_HOLD,           /**< Call put on-hold by peer          */
 	UA_EVENT_CALL_RESUME,         /**< Call resumed by peer              */
+	UA_EVENT_CALL_BITRATE,        /**< param: media,bitrate,state        */
 	UA_EVENT_REFER,
 	UA_EVENT_MODULE,
 	UA_EVENT_END_OF_FILE,
@@ -1183,6 +1282,8 @@ typedef int (auenc_update_h)(struct auenc_state **aesp,
 typedef int (auenc_encode_h)(struct auenc_state *aes,
 			     bool *marker, uint8_t *buf, size_t *len,
 			     int fmt, const void *sampv, size_t sampc);
+/* Packet loss reported by the peer in [%], called while encoding */
+typedef void (auenc_loss_h)(struct auenc_state *aes, int loss);
 
 typedef int (audec_update_h)(struct audec_state **adsp,
 			     const struct aucodec *ac, const char *fmtp);
@@ -1210,6 +1311,7 @@ struct aucodec {
 	audec_plc_h    *plch;
 	sdp_fmtp_enc_h *fmtp_ench;
 	sdp_fmtp_cmp_h *fmtp_cmph;
+	auenc_loss_h   *lossh;      /* Packet loss update (optional) */
 };
 
 void aucodec_register(struct list *aucodecl, struct aucodec *ac);
@@ -1259,6 +1361,9 @@ typedef int (videnc_encode_h)(struct videnc_state *ves, bool update,
 typedef int (videnc_packetize_h)(struct videnc_state *ves,
 				 const struct vidpacket *packet);
 
+/* Change the target bitrate without restarting the encoder */
+typedef int (videnc_bitrate_h)(struct videnc_state *ves, uint32_t bitrate);
+
 typedef int(viddec_update_h)(struct viddec_state **vdsp,
 			     const struct vidcodec *vc, const char *fmtp,
 			     const struct video *vid);
@@ -1279,6 +1384,7 @@ struct vidcodec {
 	sdp_fmtp_enc_h *fmtp_ench;
 	sdp_fmtp_cmp_h *fmtp_cmph;
 	videnc_packetize_h *packetizeh;
+	videnc_bitrate_h *bitrateh;
 };
 
 void vidcodec_register(struct list *vidcodecl, struct vidcodec *vc);
@@ -1308,6 +1414,11 @@ struct vidfilt_dec_st {
 	struct le le;
 };
 
+/** Video Filter capabilities */
+enum vidfilt_flags {
+	VIDFILT_RDONLY = 1 << 0,  /**< Does not modify the frame         */
+};
+
 /** Video Filter Parameters */
 struct vidfilt_prm {
 	unsigned width;   /**< Picture width              */
@@ -1337,6 +1448,7 @@ struct vidfilt {
 	vidfilt_encode_h *ench;
 	vidfilt_decupd_h *decupdh;
 	vidfilt_decode_h *dech;
+	uint32_t flags;       /**< Capabilities (enum vidfilt_flags) */
 };
 
 void vidfilt_register(struct list *vidfiltl, struct vidfilt *vf);
@@ -1349,6 +1461,114 @@ int vidfilt_dec_append(struct list *filtl, void **ctx,
 		       const struct video *vid);
 
 
+/*
+ * Video frame pool
+ */
+
+struct vidpool;
+
+int vidpool_alloc(struct vidpool **poolp, unsigned maxc);
+int vidpool_get(struct vidpool *pool, struct vidframe **framep,
+		enum vidfmt fmt, const struct vidsz *sz);
+int vidpool_debug(struct re_printf *pf, const struct vidpool *pool);
+
+
+/*
+ * Parallel video converter
+ */
+
+int  vidconv_mt(struct vidframe *dst, const struct vidframe *src);
+bool vidconv_mt_supported(enum vidfmt src_fmt, enum vidfmt dst_fmt);
+int  vidconv_mt_debug(struct re_printf *pf, void *unused);
+
+
+/*
+ * Video congestion control
+ */
+
+/** Rate controller state */
+enum vidcc_state {
+	VIDCC_PROBE = 0,  /**< Fast increase, no recent congestion */
+	VIDCC_INCREASE,   /**< Slow increase                       */
+	VIDCC_HOLD,       /**< Queues are draining                 */
+	VIDCC_DECREASE,   /**< Backoff after congestion            */
+};
+
+struct vidcc;
+struct twcc;
+
+int  vidcc_alloc(struct vidcc **ccp, uint32_t max);
+void vidcc_set_max(struct vidcc *cc, uint32_t max);
+void vidcc_sent(struct vidcc *cc, uint16_t seq, size_t size, uint64_t now);
+void vidcc_arrival(struct vidcc *cc, uint16_t seq, int64_t arrival_us);
+void vidcc_feedback(struct vidcc *cc, uint64_t now);
+int  vidcc_twcc(struct vidcc *cc, const struct twcc *twcc, uint64_t now);
+void vidcc_loss(struct vidcc *cc, uint8_t fraction, uint32_t rtt,
+		uint64_t now);
+uint32_t vidcc_bitrate(const struct vidcc *cc);
+uint32_t vidcc_max(const struct vidcc *cc);
+enum vidcc_state vidcc_state(const struct vidcc *cc);
+const char *vidcc_state_name(enum vidcc_state state);
+bool vidcc_changed(struct vidcc *cc);
+int  vidcc_print(struct re_printf *pf, const struct vidcc *cc);
+int  vidcc_debug(struct re_printf *pf, const struct vidcc *cc);
+
+
+/*
+ * Forward error correction
+ */
+
+/** FEC group size, media packets per repair packet */
+enum {
+	FEC_GROUP_MIN = 2,
+	FEC_GROUP_MAX = 15,
+};
+
+struct fec_enc;
+struct fec_dec;
+
+typedef void (fec_recover_h)(const struct rtp_header *hdr, struct mbuf *mb,
+			     void *arg);
+
+unsigned fec_group_size(double loss);
+int  fec_enc_alloc(struct fec_enc **encp);
+void fec_enc_set_group(struct fec_enc *enc, unsigned k);
+unsigned fec_enc_group(const struct fec_enc *enc);
+int  fec_enc_packet(struct fec_enc *enc, struct mbuf **mbp,
+		    const struct rtp_header *hdr, const uint8_t *p,
+		    size_t len);
+int  fec_enc_debug(struct re_printf *pf, const struct fec_enc *enc);
+int  fec_dec_alloc(struct fec_dec **decp);
+void fec_dec_media(struct fec_dec *dec, const struct rtp_header *hdr,
+		   const struct mbuf *mb);
+int  fec_dec_repair(struct fec_dec *dec, const struct rtp_header *hdr,
+		    const struct mbuf *mb, fec_recover_h *rech, void *arg);
+int  fec_dec_debug(struct re_printf *pf, const struct fec_dec *dec);
+
+
+/*
+ * Redundant audio data (RFC 2198)
+ */
+
+/** Max. number of previous frames in a RED packet */
+enum { RED_LEVEL_MAX = 2 };
+
+struct red_enc;
+struct red_dec;
+
+typedef void (red_frame_h)(const struct rtp_header *hdr, struct mbuf *mb,
+			   bool recovered, void *arg);
+
+int  red_enc_alloc(struct red_enc **encp, unsigned level);
+int  red_enc_encode(struct red_enc *enc, struct mbuf *mb, uint8_t pt,
+		    uint32_t ts);
+int  red_dec_alloc(struct red_dec **decp);
+void red_dec_media(struct red_dec *dec, const struct rtp_header *hdr);
+int  red_dec_decode(struct red_dec *dec, const struct rtp_header *hdr,
+		    struct mbuf *mb, red_frame_h *frameh, void *arg);
+int  red_dec_debug(struct re_printf *pf, const struct red_dec *dec);
+
+
 /*
  * Audio stream
  */
@@ -1436,6 +1656,7 @@ struct stream *video_strm(const struct video *v);
 const struct vidcodec *video_codec(const struct video *vid, bool tx);
 void video_sdp_attr_decode(struct video *v);
 void video_req_keyframe(struct video *vid);
+unsigned video_simulcast_layers(const struct video *v);
 
 double video_calc_seconds(uint64_t rtp_ts);
 double video_timestamp_to_seconds(uint64_t timestamp);
@@ -1443,6 +1664,20 @@ uint64_t video_calc_rtp_timestamp_fix(uint64_t timestamp);
 uint64_t video_calc_timebase_timestamp(uint64_t rtp_ts);
 
 
+/*
+ * Call memory arena
+ */
+
+struct call_arena;
+
+int    call_arena_alloc(struct call_arena **arenap, size_t chunksz);
+void  *call_arena_zalloc(struct call_arena *arena, size_t size);
+size_t call_arena_used(const struct call_arena *arena);
+int    call_arena_debug(struct re_printf *pf,
+			const struct call_arena *arena);
+void   call_arena_stats(uint64_t *n_chunk, uint64_t *n_reused);
+
+
 /*
  * Generic stream
  */
@@ -1454,9 +1689,11 @@ struct stream_param {
 	int af;             /**< Wanted address family */
 	const char *cname;  /**< Canonical name        */
 	const char *peer;   /**< Peer uri/name or identifier  */
+	struct call_arena *arena; /**< Per-call memory arena (optional) */
 };
 
 struct jbuf_stat;
+struct jbuf_hist;
 
 typedef void (stream_mnatconn_h)(struct stream *strm, void *arg);
 typedef void (stream_rtpestab_h)(struct stream *strm, void *arg);
@@ -1467,6 +1704,7 @@ typedef void (stream_error_h)(struct stream *strm, int err, void *arg);
 int stream_update(struct stream *s);
 const struct rtcp_stats *stream_rtcp_stats(const struct stream *strm);
 int stream_jbuf_stats(const struct stream *strm, struct jbuf_stat *s);
+int stream_jbuf_hist(const struct stream *strm, struct jbuf_hist *h);
 struct sdp_media *stream_sdpmedia(const struct stream *s);
 uint32_t stream_metric_get_tx_n_packets(const struct stream *strm);
 uint32_t stream_metric_get_tx_n_bytes(const struct stream *strm);
@@ -1521,14 +1759,33 @@ struct jbuf_stat {
 	uint32_t n_flush;      /**< Number of times jitter buffer flushed   */
 };
 
+enum {
+	JBUF_HIST_SIZE = 50,   /**< Number of delay histogram buckets       */
+	JBUF_HIST_MS   = 10,   /**< Width of a histogram bucket [ms]        */
+};
+
+/** Jitter buffer relative arrival delay histogram */
+struct jbuf_hist {
+	uint32_t probv[JBUF_HIST_SIZE]; /**< Probability per bucket [ppm]   */
+	uint32_t n;            /**< Number of delay samples                 */
+	uint32_t pct;          /**< Target delay percentile [%]             */
+	uint32_t target;       /**< Target delay [ms]                       */
+	uint32_t wish;         /**< Wish size [frames]                      */
+};
+
 
 int  jbuf_alloc(struct jbuf **jbp, uint32_t min, uint32_t max);
+int  jbuf_alloc_arena(struct jbuf **jbp, uint32_t min, uint32_t max,
+		      struct call_arena *arena);
 int  jbuf_set_type(struct jbuf *jb, enum jbuf_type jbtype);
+int  jbuf_set_srate(struct jbuf *jb, uint32_t srate);
+int  jbuf_set_percentile(struct jbuf *jb, uint32_t pct);
 int  jbuf_put(struct jbuf *jb, const struct rtp_header *hdr, void *mem);
 int  jbuf_get(struct jbuf *jb, struct rtp_header *hdr, void **mem);
 int  jbuf_drain(struct jbuf *jb, struct rtp_header *hdr, void **mem);
 void jbuf_flush(struct jbuf *jb);
 int  jbuf_stats(const struct jbuf *jb, struct jbuf_stat *jstat);
+int  jbuf_hist(const struct jbuf *jb, struct jbuf_hist *hist);
 int  jbuf_debug(struct re_printf *pf, const struct jbuf *jb);
 uint32_t jbuf_frames(const struct jbuf *jb);
 uint32_t jbuf_packets(const struct jbuf *jb);
@@ -56,6 +56,8 @@ static int write_thread(void *arg)
 	snd_pcm_sframes_t n;
 	int num_frames;
 
+	media_thread_place(MEDIA_THREAD_AUDIO_DRV);
+
 	num_frames = st->prm.srate * st->prm.ptime / 1000;
 
 	auframe_init(&af, st->prm.fmt, st->sampv, st->sampc, st->prm.srate,
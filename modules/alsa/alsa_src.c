@@ -56,6 +56,8 @@ static int read_thread(void *arg)
 	int num_frames;
 	int err;
 
+	media_thread_place(MEDIA_THREAD_AUDIO_DRV);
+
 	num_frames = st->prm.srate * st->prm.ptime / 1000;
 
 	/* Start */
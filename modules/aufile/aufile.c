@@ -28,6 +28,11 @@ static struct auplay *auplay;
 static int module_init(void)
 {
 	int err;
+
+	err = aufile_buf_init();
+	if (err)
+		return err;
+
 	err = ausrc_register(&ausrc, baresip_ausrcl(), "aufile",
 			     aufile_src_alloc);
 	err |= auplay_register(&auplay, baresip_auplayl(), "aufile",
@@ -41,6 +46,8 @@ static int module_close(void)
 	ausrc = mem_deref(ausrc);
 	auplay = mem_deref(auplay);
 
+	aufile_buf_close();
+
 	return 0;
 }
 
@@ -10,3 +10,15 @@ int aufile_play_alloc(struct auplay_st **stp, const struct auplay *ap,
 int aufile_src_alloc(struct ausrc_st **stp, const struct ausrc *as,
 		     struct ausrc_prm *prm, const char *dev,
 		     ausrc_read_h *rh, ausrc_error_h *errh, void *arg);
+
+
+/* Shared WAV file buffers */
+struct aufile_buf;
+
+int  aufile_buf_init(void);
+void aufile_buf_close(void);
+int  aufile_buf_get(struct aufile_buf **bufp, const char *path);
+void *aufile_buf_release(struct aufile_buf *buf);
+const struct aufile_prm *aufile_buf_prm(const struct aufile_buf *buf);
+size_t aufile_buf_read(const struct aufile_buf *buf, size_t *posp,
+		       int16_t *sampv, size_t sampc);
@@ -0,0 +1,334 @@
+/**
+ * @file aufile_buf.c Shared read-once WAV file buffers
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "aufile.h"
+
+
+/*
+ * A WAV file is read once into memory and shared by all audio sources
+ * playing it, each source reads through its own cursor. The memory use
+ * does not grow with the number of listeners. The file is copied instead
+ * of mapped, so truncating or rewriting it cannot fault a listener. A
+ * modified file gets a new buffer, the old one stays valid until the last
+ * listener is gone. Listeners drop their reference with
+ * aufile_buf_release().
+ */
+
+
+struct aufile_buf {
+	struct le le;
+	char *path;
+	uint8_t *addr;           /**< File contents                   */
+	size_t len;              /**< Length of the file contents     */
+	const uint8_t *data;     /**< WAV data chunk                  */
+	size_t datalen;          /**< Length of the data chunk        */
+	struct aufile_prm prm;   /**< Format of the audio samples     */
+	ino_t ino;
+	time_t mtime;
+	off_t fsize;
+};
+
+
+static struct list bufl;
+static mtx_t *buf_mtx;
+
+
+/* called with buf_mtx held, see aufile_buf_release() */
+static void destructor(void *arg)
+{
+	struct aufile_buf *buf = arg;
+
+	list_unlink(&buf->le);
+
+	mem_deref(buf->addr);
+	mem_deref(buf->path);
+}
+
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 |
+		(uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+
+/* Find the data chunk of a RIFF/WAVE file */
+static int find_data(struct aufile_buf *buf)
+{
+	size_t pos = 12;
+
+	if (buf->len < pos || memcmp(buf->addr, "RIFF", 4) ||
+	    memcmp(buf->addr + 8, "WAVE", 4))
+		return EBADMSG;
+
+	while (pos + 8 <= buf->len) {
+
+		const uint8_t *hdr = buf->addr + pos;
+		size_t size = get_le32(hdr + 4);
+
+		pos += 8;
+
+		if (0 == memcmp(hdr, "data", 4)) {
+			buf->data    = buf->addr + pos;
+			buf->datalen = min(size, buf->len - pos);
+			return 0;
+		}
+
+		if (size >= buf->len - pos)
+			break;
+
+		/* chunks are padded to an even length */
+		pos += size + (size & 1);
+	}
+
+	return ENOENT;
+}
+
+
+static int file_read(struct aufile_buf *buf, const char *path)
+{
+	FILE *f;
+	int err = 0;
+
+	f = fopen(path, "rb");
+	if (!f)
+		return errno;
+
+	buf->addr = mem_alloc((size_t)buf->fsize, NULL);
+	if (!buf->addr) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	/* a file truncated in the meantime is used up to its new end */
+	buf->len = fread(buf->addr, 1, (size_t)buf->fsize, f);
+	if (!buf->len)
+		err = EIO;
+
+ out:
+	(void)fclose(f);
+
+	return err;
+}
+
+
+static bool buf_valid(const struct aufile_buf *buf, const struct stat *st)
+{
+	return buf->ino == st->st_ino && buf->mtime == st->st_mtime &&
+		buf->fsize == st->st_size;
+}
+
+
+/**
+ * Initialize the shared WAV file buffers
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int aufile_buf_init(void)
+{
+	return mutex_alloc(&buf_mtx);
+}
+
+
+/**
+ * Close the shared WAV file buffers
+ */
+void aufile_buf_close(void)
+{
+	buf_mtx = mem_deref(buf_mtx);
+}
+
+
+/**
+ * Get a shared buffer of a WAV file
+ *
+ * @param bufp Pointer to WAV file buffer, the caller holds a reference
+ * @param path Path to the WAV file
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int aufile_buf_get(struct aufile_buf **bufp, const char *path)
+{
+	struct aufile_buf *buf;
+	struct aufile *af = NULL;
+	struct stat st;
+	struct le *le;
+	int err;
+
+	if (!bufp || !path)
+		return EINVAL;
+
+	if (stat(path, &st))
+		return errno;
+
+	if (st.st_size == 0)
+		return EBADMSG;
+
+	mtx_lock(buf_mtx);
+	for (le = list_head(&bufl); le; le = le->next) {
+
+		buf = le->data;
+
+		/* the last reference is only dropped with buf_mtx held */
+		if (0 == str_cmp(buf->path, path) && buf_valid(buf, &st)) {
+			*bufp = mem_ref(buf);
+			mtx_unlock(buf_mtx);
+			return 0;
+		}
+	}
+	mtx_unlock(buf_mtx);
+
+	buf = mem_zalloc(sizeof(*buf), destructor);
+	if (!buf)
+		return ENOMEM;
+
+	buf->ino   = st.st_ino;
+	buf->mtime = st.st_mtime;
+	buf->fsize = st.st_size;
+
+	/* the header is parsed by the WAV reader */
+	err = aufile_open(&af, &buf->prm, path, AUFILE_READ);
+	if (err)
+		goto out;
+
+	switch (buf->prm.fmt) {
+
+	case AUFMT_S16LE:
+	case AUFMT_PCMA:
+	case AUFMT_PCMU:
+		break;
+
+	default:
+		err = ENOTSUP;
+		goto out;
+	}
+
+	err  = str_dup(&buf->path, path);
+	err |= file_read(buf, path);
+	if (err)
+		goto out;
+
+	/* the data chunk is located in the copy that is played */
+	err = find_data(buf);
+	if (err)
+		goto out;
+
+	mtx_lock(buf_mtx);
+	list_append(&bufl, &buf->le, buf);
+	mtx_unlock(buf_mtx);
+
+	info("aufile: loaded %s (%zu bytes)\n", path, buf->datalen);
+
+ out:
+	mem_deref(af);
+
+	if (err)
+		mem_deref(buf);
+	else
+		*bufp = buf;
+
+	return err;
+}
+
+
+/**
+ * Release a shared WAV file buffer
+ *
+ * The reference is dropped with the list locked, so a concurrent lookup
+ * cannot take a reference to a buffer that is being destroyed.
+ *
+ * @param buf WAV file buffer
+ *
+ * @return Always NULL
+ */
+void *aufile_buf_release(struct aufile_buf *buf)
+{
+	if (!buf)
+		return NULL;
+
+	mtx_lock(buf_mtx);
+	mem_deref(buf);
+	mtx_unlock(buf_mtx);
+
+	return NULL;
+}
+
+
+/**
+ * Get the format of a shared WAV file buffer
+ *
+ * @param buf WAV file buffer
+ *
+ * @return Format of the audio samples
+ */
+const struct aufile_prm *aufile_buf_prm(const struct aufile_buf *buf)
+{
+	return buf ? &buf->prm : NULL;
+}
+
+
+/**
+ * Read audio samples from a shared WAV file buffer
+ *
+ * The samples are converted to native-endian S16 while they are read.
+ *
+ * @param buf   WAV file buffer
+ * @param posp  Read cursor in bytes, updated
+ * @param sampv Buffer for S16 samples
+ * @param sampc Number of samples to read
+ *
+ * @return Number of samples read, less than sampc at the end of the file
+ */
+size_t aufile_buf_read(const struct aufile_buf *buf, size_t *posp,
+		       int16_t *sampv, size_t sampc)
+{
+	const uint8_t *p;
+	size_t i, n;
+
+	if (!buf || !posp || !sampv || *posp >= buf->datalen)
+		return 0;
+
+	p = buf->data + *posp;
+	n = buf->datalen - *posp;
+
+	switch (buf->prm.fmt) {
+
+	case AUFMT_S16LE:
+		n = min(n / 2, sampc);
+		for (i = 0; i < n; i++)
+			sampv[i] = (int16_t)(p[2*i] | p[2*i + 1] << 8);
+
+		*posp += n * 2;
+		break;
+
+	case AUFMT_PCMA:
+		n = min(n, sampc);
+		for (i = 0; i < n; i++)
+			sampv[i] = g711_alaw2pcm(p[i]);
+
+		*posp += n;
+		break;
+
+	case AUFMT_PCMU:
+		n = min(n, sampc);
+		for (i = 0; i < n; i++)
+			sampv[i] = g711_ulaw2pcm(p[i]);
+
+		*posp += n;
+		break;
+
+	default:
+		n = 0;
+		break;
+	}
+
+	return n;
+}
@@ -5,6 +5,7 @@
  */
 #define _DEFAULT_SOURCE 1
 #define _BSD_SOURCE 1
+#include <string.h>
 #include <re_atomic.h>
 #include <re.h>
 #include <rem.h>
@@ -27,9 +28,8 @@
 
 struct ausrc_st {
 	struct tmr tmr;
-	struct aufile *aufile;
-	struct aubuf *aubuf;
-	enum aufmt fmt;                 /**< Wav file sample format          */
+	struct aufile_buf *buf;         /**< Shared buffer of the Wav file   */
+	size_t pos;                     /**< Read cursor in the Wav data     */
 	struct ausrc_prm prm;           /**< Audio src parameter             */
 	uint32_t ptime;
 	size_t sampc;
@@ -53,8 +53,7 @@ static void destructor(void *arg)
 
 	tmr_cancel(&st->tmr);
 
-	mem_deref(st->aufile);
-	mem_deref(st->aubuf);
+	aufile_buf_release(st->buf);
 }
 
 
@@ -71,22 +70,28 @@ static int src_thread(void *arg)
 
 	while (re_atomic_rlx(&st->run)) {
 		struct auframe af;
+		size_t n;
 
 		sys_msleep(ms);
 		now = tmr_jiffies();
 		if (ts > now)
 			continue;
 
+		/* convert one frame from the shared file buffer */
+		n = aufile_buf_read(st->buf, &st->pos, sampv, st->sampc);
+		if (n < st->sampc) {
+			memset(&sampv[n], 0,
+			       (st->sampc - n) * sizeof(int16_t));
+		}
+
 		auframe_init(&af, AUFMT_S16LE, sampv, st->sampc,
 		             st->prm.srate, st->prm.ch);
 
-		aubuf_read_auframe(st->aubuf, &af);
-
 		st->rh(&af, st->arg);
 
 		ts += st->ptime;
 
-		if (aubuf_cur_size(st->aubuf) == 0)
+		if (n < st->sampc)
 			break;
 	}
 
@@ -115,86 +120,12 @@ static void timeout(void *arg)
 }
 
 
-static int read_file(struct ausrc_st *st)
-{
-	struct mbuf *mb = NULL;
-	int err;
-	size_t n;
-	struct mbuf *mb2 = NULL;
-	struct auframe af;
-
-	auframe_init(&af, st->fmt, NULL, 0, st->prm.srate, st->prm.ch);
-
-	for (;;) {
-		uint16_t *sampv;
-		uint8_t *p;
-		size_t i;
-
-		mem_deref(mb);
-		mb = mbuf_alloc(4096);
-		if (!mb)
-			return ENOMEM;
-
-		mb->end = mb->size;
-
-		err = aufile_read(st->aufile, mb->buf, &mb->end);
-		if (err)
-			break;
-
-		if (mb->end == 0) {
-			info("aufile: read end of file\n");
-			break;
-		}
-
-		/* convert from Little-Endian to Native-Endian */
-		n = mb->end;
-		sampv = (void *)mb->buf;
-		p     = (void *)mb->buf;
-
-		switch (st->fmt) {
-		case AUFMT_S16LE:
-			/* convert from Little-Endian to Native-Endian */
-			for (i = 0; i < n/2; i++)
-				sampv[i] = sys_ltohs(sampv[i]);
-
-			aubuf_append_auframe(st->aubuf, mb, &af);
-			break;
-		case AUFMT_PCMA:
-		case AUFMT_PCMU:
-			mb2 = mbuf_alloc(2 * n);
-			for (i = 0; i < n; i++) {
-				err |= mbuf_write_u16(mb2,
-					   st->fmt == AUFMT_PCMA ?
-					   (uint16_t) g711_alaw2pcm(p[i]) :
-					   (uint16_t) g711_ulaw2pcm(p[i]) );
-			}
-
-			mbuf_set_pos(mb2, 0);
-			aubuf_append_auframe(st->aubuf, mb2, &af);
-			mem_deref(mb2);
-			break;
-
-		default:
-			err = ENOSYS;
-			break;
-		}
-
-		if (err)
-			break;
-	}
-
-	info("aufile: loaded %zu bytes\n", aubuf_cur_size(st->aubuf));
-	mem_deref(mb);
-	return err;
-}
-
-
 int aufile_src_alloc(struct ausrc_st **stp, const struct ausrc *as,
 		     struct ausrc_prm *prm, const char *dev,
 		     ausrc_read_h *rh, ausrc_error_h *errh, void *arg)
 {
 	struct ausrc_st *st;
-	struct aufile_prm fprm;
+	const struct aufile_prm *fprm;
 	uint32_t   ptime;
 	bool join = false;
 	int err;
@@ -225,34 +156,26 @@ int aufile_src_alloc(struct ausrc_st **stp, const struct ausrc *as,
 	if (!ptime)
 		ptime = 40;
 
-	err = aufile_open(&st->aufile, &fprm, dev, AUFILE_READ);
+	err = aufile_buf_get(&st->buf, dev);
 	if (err) {
 		warning("aufile: failed to open file '%s' (%m)\n", dev, err);
 		goto out;
 	}
 
+	fprm = aufile_buf_prm(st->buf);
+
 	info("aufile: %s: %u Hz, %d channels, %s\n",
-	     dev, fprm.srate, fprm.channels, aufmt_name(fprm.fmt));
+	     dev, fprm->srate, fprm->channels, aufmt_name(fprm->fmt));
 
 	/* return wav format to caller */
-	prm->srate = fprm.srate;
-	prm->ch    = fprm.channels;
+	prm->srate = fprm->srate;
+	prm->ch    = fprm->channels;
 	st->prm   = *prm;
 
-	st->fmt    = fprm.fmt;
 	st->sampc  = prm->srate * prm->ch * ptime / 1000;
 
 	info("aufile: audio ptime=%u sampc=%zu\n", st->ptime, st->sampc);
 
-	/* 1 - inf seconds of audio */
-	err = aubuf_alloc(&st->aubuf, 0, 0);
-	if (err)
-		goto out;
-
-	err = read_file(st);
-	if (err)
-		goto out;
-
 	tmr_start(&st->tmr, ptime, timeout, st);
 
 	re_atomic_rlx_set(&st->run, true);
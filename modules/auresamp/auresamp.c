@@ -33,10 +33,11 @@ struct auresamp_st {
 		struct aufilt_dec_st daf;
 	} u;                     /* inheritance                              */
 
-	int16_t *sampv;          /* s16le audio data buffer                  */
+	int16_t *sampv;          /* format conversion buffer                 */
+	size_t sampsz;           /* size of sampv buffer                     */
 	int16_t *rsampv;         /* resampled data                           */
 	size_t rsampsz;          /* size of rsampv buffer                    */
-	struct auresamp resamp;  /* resampler                                */
+	struct aupoly *resamp;   /* polyphase resampler                      */
 	struct aufilt_prm oprm;  /* filter output parameters                 */
 	const char *dbg;         /* debugging "encoder"/"decoder"            */
 };
@@ -46,6 +47,7 @@ static void common_destructor(void *arg)
 {
 	struct auresamp_st *st = arg;
 
+	mem_deref(st->resamp);
 	mem_deref(st->rsampv);
 	mem_deref(st->sampv);
 }
@@ -69,41 +71,39 @@ static void dec_destructor(void *arg)
 }
 
 
-static int sampv_alloc(struct auresamp_st *st, struct auframe *af)
+static int buf_check_size(struct auresamp_st *st, struct auframe *af)
 {
-	size_t psize;
+	size_t outc, psize;
 
-	psize = af->sampc * af->ch * 2;
-	st->sampv = mem_zalloc(psize, NULL);
+	outc = aupoly_maxoutc(st->resamp, af->sampc);
 
-	if (!st->sampv)
-		return ENOMEM;
-
-	return 0;
-}
-
-
-static int rsampv_check_size(struct auresamp_st *st, struct auframe *af)
-{
-	uint64_t ptime;
-	size_t psize;
-
-	ptime = af->sampc * 1000 / af->srate;
-	psize = ptime * st->oprm.srate * st->oprm.ch *
-		aufmt_sample_size(af->fmt) / 1000;
-
-	/* auresamp minimum output size is the input size */
-	psize = max(psize, auframe_size(af));
+	psize = outc * sizeof(int16_t);
 	if (st->rsampsz < psize) {
 		st->rsampsz = 0;
 		st->rsampv = mem_deref(st->rsampv);
 		st->rsampv = mem_zalloc(psize, NULL);
+		if (!st->rsampv)
+			return ENOMEM;
+
+		st->rsampsz = psize;
 	}
 
-	if (!st->rsampv)
-		return ENOMEM;
+	if (af->fmt == AUFMT_S16LE && st->oprm.fmt == AUFMT_S16LE)
+		return 0;
+
+	/* used for input and output conversion */
+	psize = max(af->sampc * sizeof(int16_t),
+		    outc * aufmt_sample_size(st->oprm.fmt));
+	if (st->sampsz < psize) {
+		st->sampsz = 0;
+		st->sampv = mem_deref(st->sampv);
+		st->sampv = mem_zalloc(psize, NULL);
+		if (!st->sampv)
+			return ENOMEM;
+
+		st->sampsz = psize;
+	}
 
-	st->rsampsz = psize;
 	return 0;
 }
 
@@ -112,14 +112,17 @@ static int resamp_setup(struct auresamp_st *st, struct auframe *af)
 {
 	int err = 0;
 
-	err = auresamp_setup(&st->resamp, af->srate, af->ch,
-			     st->oprm.srate, st->oprm.ch);
+	st->resamp = mem_deref(st->resamp);
+	err = aupoly_alloc(&st->resamp, af->srate, af->ch,
+			   st->oprm.srate, st->oprm.ch);
 	if (err) {
-		warning("resample: auresamp_setup error (%m)\n", err);
+		warning("resample: aupoly_alloc error (%m)\n", err);
 		return err;
 	}
 
-	return rsampv_check_size(st, af);
+	debug("auresamp: %H\n", aupoly_debug, st->resamp);
+
+	return buf_check_size(st, af);
 }
 
 
@@ -141,7 +144,6 @@ static int common_update(struct auresamp_st **stp, struct aufilt_prm *oprm,
 		return ENOMEM;
 
 	st->oprm = *oprm;
-	auresamp_init(&st->resamp);
 
 	*stp = st;
 	return 0;
@@ -165,35 +167,33 @@ static int common_resample(struct auresamp_st *st, struct auframe *af)
 
 	if (st->oprm.srate == af->srate && st->oprm.ch == af->ch) {
 		st->rsampsz = 0;
+		st->sampsz  = 0;
+		st->resamp = mem_deref(st->resamp);
 		st->rsampv = mem_deref(st->rsampv);
 		st->sampv  = mem_deref(st->sampv);
 		return 0;
 	}
 
-	sampv  = af->sampv;
-	if (af->fmt != AUFMT_S16LE) {
-		if (!st->sampv)
-			err = sampv_alloc(st, af);
-
-		if (err)
-			return err;
-
-		auconv_to_s16(st->sampv, af->fmt, af->sampv, af->sampc);
-		sampv = st->sampv;
-	}
-
-	if (st->resamp.irate != af->srate || st->resamp.ich != af->ch)
+	if (!aupoly_match(st->resamp, af->srate, af->ch,
+			  st->oprm.srate, st->oprm.ch))
 		err = resamp_setup(st, af);
 	else
-		err = rsampv_check_size(st, af);
+		err = buf_check_size(st, af);
 
 	if (err)
 		return err;
 
-	rsampc = st->rsampsz / 2;
-	err = auresamp(&st->resamp, st->rsampv, &rsampc, sampv, af->sampc);
+	sampv  = af->sampv;
+	if (af->fmt != AUFMT_S16LE) {
+		auconv_to_s16(st->sampv, af->fmt, af->sampv, af->sampc);
+		sampv = st->sampv;
+	}
+
+	rsampc = st->rsampsz / sizeof(int16_t);
+	err = aupoly_process(st->resamp, st->rsampv, &rsampc,
+			     sampv, af->sampc);
 	if (err) {
-		warning("resample: auresamp error (%m)\n", err);
+		warning("resample: aupoly_process error (%m)\n", err);
 		return err;
 	}
 
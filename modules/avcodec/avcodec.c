@@ -73,6 +73,7 @@ static struct vidcodec h264 = {
 	.fmtp_ench = avcodec_h264_fmtp_enc,
 	.fmtp_cmph = avcodec_h264_fmtp_cmp,
 	.packetizeh= avcodec_packetize,
+	.bitrateh  = avcodec_encode_bitrate,
 };
 
 static struct vidcodec h264_1 = {
@@ -85,6 +86,7 @@ static struct vidcodec h264_1 = {
 	.fmtp_ench = avcodec_h264_fmtp_enc,
 	.fmtp_cmph = avcodec_h264_fmtp_cmp,
 	.packetizeh= avcodec_packetize,
+	.bitrateh  = avcodec_encode_bitrate,
 };
 
 static struct vidcodec h265 = {
@@ -95,6 +97,7 @@ static struct vidcodec h265 = {
 	.decupdh   = avcodec_decode_update,
 	.dech      = avcodec_decode_h265,
 	.packetizeh= avcodec_packetize,
+	.bitrateh  = avcodec_encode_bitrate,
 };
 
 
@@ -29,6 +29,7 @@ int avcodec_encode_update(struct videnc_state **vesp,
 int avcodec_encode(struct videnc_state *st, bool update,
 		   const struct vidframe *frame, uint64_t timestamp);
 int avcodec_packetize(struct videnc_state *st, const struct vidpacket *packet);
+int avcodec_encode_bitrate(struct videnc_state *st, uint32_t bitrate);
 
 
 /*
@@ -530,6 +530,27 @@ int avcodec_encode(struct videnc_state *st, bool update,
 }
 
 
+/*
+ * libx264 reconfigures its rate control on the next frame, other encoders
+ * use the new bitrate when they are opened again.
+ */
+int avcodec_encode_bitrate(struct videnc_state *st, uint32_t bitrate)
+{
+	if (!st)
+		return EINVAL;
+
+	st->encprm.bitrate = bitrate;
+
+	if (st->ctx) {
+		st->ctx->bit_rate       = bitrate;
+		st->ctx->rc_max_rate    = bitrate;
+		st->ctx->rc_buffer_size = bitrate / 2;
+	}
+
+	return 0;
+}
+
+
 int avcodec_packetize(struct videnc_state *st, const struct vidpacket *packet)
 {
 	int err = 0;
@@ -167,6 +167,14 @@ static int cmd_play_file(struct re_printf *pf, void *arg)
 }
 
 
+static int cmd_play_debug(struct re_printf *pf, void *unused)
+{
+	(void)unused;
+
+	return play_debug(pf, baresip_player());
+}
+
+
 struct fileinfo_st {
 	struct ausrc_st *ausrc;
 	struct ausrc_prm prm;
@@ -380,6 +388,8 @@ static const struct cmd debugcmdv[] = {
 {"modules",     0,       0, "Module debug",           mod_debug           },
 {"netstat",    'n',      0, "Network debug",          cmd_net_debug       },
 {"play",        0, CMD_PRM, "Play audio file",        cmd_play_file       },
+{"playstat",    0,       0, "Audio file player debug", cmd_play_debug     },
+{"sched",       0,       0, "Media thread placement", media_thread_debug },
 {"sipstat",    'i',      0, "SIP debug",              cmd_sip_debug       },
 {"sysinfo",    's',      0, "System info",            print_system_info   },
 {"timers",      0,       0, "Timer debug",            tmr_status          },
@@ -506,6 +506,39 @@ static struct menc dtls_srtp = {
 };
 
 
+/*
+ * Session resumption with session IDs and/or session tickets, for the
+ * server side of the handshake. A peer offering a cached session can skip
+ * the full handshake. The DTLS client of libre does not offer a cached
+ * session, so calls between two baresip instances are not resumed.
+ */
+static void resumption_set(void)
+{
+	enum tls_resume_mode mode;
+	struct pl pl;
+
+	if (conf_get(conf_cur(), "dtls_srtp_resumption", &pl))
+		return;
+
+	if (0 == pl_strcasecmp(&pl, "none"))
+		mode = TLS_RESUMPTION_NONE;
+	else if (0 == pl_strcasecmp(&pl, "ids"))
+		mode = TLS_RESUMPTION_IDS;
+	else if (0 == pl_strcasecmp(&pl, "tickets"))
+		mode = TLS_RESUMPTION_TICKETS;
+	else if (0 == pl_strcasecmp(&pl, "all"))
+		mode = TLS_RESUMPTION_ALL;
+	else {
+		warning("dtls_srtp: unknown resumption mode '%r'\n", &pl);
+		return;
+	}
+
+	tls_set_resumption(tls, mode);
+
+	info("dtls_srtp: session resumption: %r\n", &pl);
+}
+
+
 static int module_init(void)
 {
 	struct list *mencl = baresip_mencl();
@@ -533,6 +566,8 @@ static int module_init(void)
 
 	tls_set_verify_client_trust_all(tls);
 
+	resumption_set();
+
 	err = tls_set_srtp(tls, srtp_profiles);
 	if (err) {
 		warning("dtls_srtp: failed to enable SRTP profile (%m)\n",
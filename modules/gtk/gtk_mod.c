@@ -1231,7 +1231,8 @@ static struct aufilt vumeter = {
 	.encupdh = vu_encode_update,
 	.ench    = vu_encode,
 	.decupdh = vu_decode_update,
-	.dech    = vu_decode
+	.dech    = vu_decode,
+	.flags   = AUFILT_INPLACE,
 };
 
 
@@ -23,6 +23,9 @@
  *
  * The switching is done by applying a fade in/out function to the original
  * stream. The audio source is not faded.
+ *
+ * The stream is processed in-place as S16LE or FLOAT. The audio source is
+ * always read as S16LE and mixed into the stream in its sample format.
  */
 
 #define DEFAULT_FADE_TIME 160  /*default fading time in ms*/
@@ -84,7 +87,7 @@ struct mixstatus {
 	float minvol;                   /**< Minimum audio stream volume     */
 	float ausvol;                   /**< Volume for mixed audio source   */
 	size_t sampc;                   /**< Stream sample count for frame   */
-	size_t nbytes;                  /**< Stream bytes per frame          */
+	size_t nbytes;                  /**< Audio source bytes per frame    */
 	uint16_t i_fade;                /**< Fade-in/-out counter            */
 	uint16_t n_fade;                /**< Fade-in/-out steps              */
 	float delta_fade;               /**< linear delta accumulation       */
@@ -220,7 +223,7 @@ static void ausrc_prm_aufilt(struct ausrc_prm *ausprm,
 {
 	ausprm->srate = filprm->srate;
 	ausprm->ch    = filprm->ch;
-	ausprm->fmt   = filprm->fmt;
+	ausprm->fmt   = AUFMT_S16LE;
 }
 
 
@@ -239,6 +242,14 @@ static void ausrc_read_handler(struct auframe *afsrc, void *arg)
 	if (!st->sampc || !st->nbytes)
 		return;
 
+	/* the audio source is read as S16LE, see mix_float() */
+	if (afsrc->fmt != AUFMT_S16LE) {
+		warning("mixausrc: ausrc sample format %s not supported\n",
+			aufmt_name(afsrc->fmt));
+		st->nextmode = FM_FADEIN;
+		return;
+	}
+
 	if (st->ausrc_prm.srate != st->prm.srate ||
 			st->ausrc_prm.ch != st->prm.ch)
 		err = process_resamp(st, afsrc);
@@ -351,7 +362,7 @@ static void mixstatus_init(struct mixstatus *st, struct aufilt_prm *prm)
 	/* initialize with configured values */
 	st->prm = *prm;
 	st->ausrc_prm.ch = prm->ch;
-	st->ausrc_prm.fmt = prm->fmt;
+	st->ausrc_prm.fmt = AUFMT_S16LE;
 	st->ausrc_prm.srate = prm->srate;
 }
 
@@ -508,10 +519,10 @@ static void mix_int16(struct mixstatus *st, int16_t *data, size_t n)
 
 static void mix_float(struct mixstatus *st, float *data, size_t n)
 {
+	const float scale = st->ausvol / 32768.0f;
 	size_t i;
 	for (i = 0; i < n; i++)
-		data[i] = data[i] * st->minvol +
-			(st->ausvol * st->rbuf[i]);
+		data[i] = data[i] * st->minvol + scale * st->rbuf[i];
 }
 
 
@@ -541,7 +552,7 @@ static int process(struct mixstatus *st, struct auframe *af)
 	size_t n = af->sampc;
 	int err = 0;
 
-	st->nbytes = auframe_size(af);
+	st->nbytes = n * sizeof(int16_t);
 	if (!st->sampc) {
 		st->sampc = n;
 		st->ausrc_prm.ptime = (uint32_t) n * 1000 /
@@ -859,7 +870,8 @@ static int dec_mix_stop(struct re_printf *pf, void *unused)
 
 
 static struct aufilt mixausrc = {
-	LE_INIT, "mixausrc", encode_update, encode, decode_update, decode
+	LE_INIT, "mixausrc", encode_update, encode, decode_update, decode,
+	AUFILT_S16 | AUFILT_FLOAT
 };
 
 
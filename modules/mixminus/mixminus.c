@@ -21,6 +21,7 @@ enum {
 struct mix {
 	struct aubuf *ab;
 	const struct audio *au;
+	struct aupoly *resamp;
 	struct aufilt_prm prm;
 	bool ready;
 	struct le le_priv;
@@ -33,8 +34,6 @@ struct mixminus_enc {
 	struct list mixers;
 	int16_t *sampv;
 	int16_t *rsampv;
-	int16_t *fsampv;
-	struct auresamp resamp;
 	struct aufilt_prm prm;
 	struct le le_priv;
 };
@@ -43,7 +42,7 @@ struct mixminus_dec {
 	struct aufilt_dec_st af;  /* inheritance */
 
 	const struct audio *au;
-	int16_t *fsampv;
+	int16_t *sampv;
 	struct aufilt_prm prm;
 };
 
@@ -60,7 +59,6 @@ static void enc_destructor(void *arg)
 	list_flush(&st->mixers);
 	mem_deref(st->sampv);
 	mem_deref(st->rsampv);
-	mem_deref(st->fsampv);
 	list_unlink(&st->le_priv);
 
 	for (le = list_head(&encs); le; le = le->next) {
@@ -87,12 +85,13 @@ static void enc_destructor(void *arg)
 static void dec_destructor(void *arg)
 {
 	struct mixminus_dec *st = arg;
-	mem_deref(st->fsampv);
+	mem_deref(st->sampv);
 }
 
 static void mix_destructor(void *arg)
 {
 	struct mix *mix = arg;
+	mem_deref(mix->resamp);
 	mem_deref(mix->ab);
 }
 
@@ -128,13 +127,8 @@ static int encode_update(struct aufilt_enc_st **stp, void **ctx,
 	if (!st->rsampv)
 		return ENOMEM;
 
-	st->fsampv = mem_zalloc(psize, NULL);
-	if (!st->fsampv)
-		return ENOMEM;
-
 	st->prm = *prm;
 	st->au = au;
-	auresamp_init(&st->resamp);
 
 	list_append(&encs, &st->le_priv, st);
 
@@ -194,9 +188,7 @@ static int decode_update(struct aufilt_dec_st **stp, void **ctx,
 			 const struct audio *au)
 {
 	struct mixminus_dec *st;
-	size_t psize;
 	(void)af;
-	(void)prm;
 
 	if (!stp || !ctx)
 		return EINVAL;
@@ -208,11 +200,14 @@ static int decode_update(struct aufilt_dec_st **stp, void **ctx,
 	if (!st)
 		return ENOMEM;
 
-	psize = AUDIO_SAMPSZ * sizeof(int16_t);
-
-	st->fsampv = mem_zalloc(psize, NULL);
-	if (!st->fsampv)
-		return ENOMEM;
+	/* the mix buffers are always S16LE */
+	if (prm->fmt == AUFMT_FLOAT) {
+		st->sampv = mem_zalloc(AUDIO_SAMPSZ * sizeof(int16_t), NULL);
+		if (!st->sampv) {
+			mem_deref(st);
+			return ENOMEM;
+		}
+	}
 
 	st->au = au;
 	st->prm = *prm;
@@ -242,24 +237,70 @@ static void read_samp(struct aubuf *ab, int16_t *sampv, size_t sampc,
 }
 
 
+static int mix_resamp_setup(struct mix *mix, const struct aufilt_prm *prm)
+{
+	int err;
+
+	if (aupoly_match(mix->resamp, mix->prm.srate, mix->prm.ch,
+			 prm->srate, prm->ch))
+		return 0;
+
+	/* filter banks are shared, only the stream state is allocated */
+	mix->resamp = mem_deref(mix->resamp);
+	err = aupoly_alloc(&mix->resamp, mix->prm.srate, mix->prm.ch,
+			   prm->srate, prm->ch);
+	if (err)
+		warning("mixminus/aupoly_alloc error (%m)\n", err);
+
+	return err;
+}
+
+
+static void mix_s16(int16_t *sampv, const int16_t *sampv_mix, size_t sampc)
+{
+	int32_t sample;
+
+	for (size_t i = 0; i < sampc; i++) {
+		sample = sampv[i] + sampv_mix[i];
+
+		/* soft clipping */
+		if (sample >= 32767)
+			sample = 32767;
+		if (sample <= -32767)
+			sample = -32767;
+		sampv[i] = sample;
+	}
+}
+
+
+static void mix_float(float *sampv, const int16_t *sampv_mix, size_t sampc)
+{
+	float sample;
+
+	for (size_t i = 0; i < sampc; i++) {
+		sample = sampv[i] + sampv_mix[i] * (1.0f / 32768.0f);
+
+		if (sample > 1.0f)
+			sample = 1.0f;
+		if (sample < -1.0f)
+			sample = -1.0f;
+		sampv[i] = sample;
+	}
+}
+
+
 static int encode(struct aufilt_enc_st *aufilt_enc_st, struct auframe *af)
 {
 	struct mixminus_enc *enc = (struct mixminus_enc *)aufilt_enc_st;
-	size_t i, inc, outc, stime;
+	size_t inc, outc, stime;
 	struct le *lem;
 	struct mix *mix;
-	int16_t *sampv = af->sampv;
 	int16_t *sampv_mix = enc->sampv;
-	int32_t sample;
 	int err = 0;
 
+	/* the stream is mixed in-place, the other parties are S16LE */
 	stime = 1000 * af->sampc / (enc->prm.srate * enc->prm.ch);
 
-	if (enc->prm.fmt != AUFMT_S16LE) {
-		auconv_to_s16(enc->fsampv, enc->prm.fmt, af->sampv, af->sampc);
-		sampv = enc->fsampv;
-	}
-
 	for (lem = list_head(&enc->mixers); lem; lem = lem->next) {
 		mix = lem->data;
 		if (!mix)
@@ -276,42 +317,30 @@ static int encode(struct aufilt_enc_st *aufilt_enc_st, struct auframe *af)
 		if (!mix->prm.srate || !mix->prm.ch)
 			continue;
 
-		err = auresamp_setup(&enc->resamp, mix->prm.srate, mix->prm.ch,
-				     enc->prm.srate, enc->prm.ch);
-		if (err) {
-			warning("mixminus/auresamp_setup error (%m)\n", err);
-			return err;
-		}
+		if (mix->prm.srate != enc->prm.srate ||
+		    mix->prm.ch != enc->prm.ch) {
+
+			err = mix_resamp_setup(mix, &enc->prm);
+			if (err)
+				return err;
 
-		if (enc->resamp.resample) {
 			outc = AUDIO_SAMPSZ;
 			sampv_mix = enc->rsampv;
 
-			if (enc->prm.srate > mix->prm.srate) {
-				inc = af->sampc / enc->resamp.ratio;
-			}
-			else {
-				inc = af->sampc * enc->resamp.ratio;
-			}
-
-			if (enc->prm.ch == 2 && mix->prm.ch == 1) {
-				inc = inc / 2;
-			}
-
-			if (enc->prm.ch == 1 && mix->prm.ch == 2) {
-				inc = inc * 2;
-			}
+			inc = af->sampc / enc->prm.ch;
+			inc = inc * mix->prm.srate / enc->prm.srate;
+			inc = inc * mix->prm.ch;
 
 			read_samp(mix->ab, enc->sampv, inc, stime);
 
-			err = auresamp(&enc->resamp, sampv_mix, &outc,
-				       enc->sampv, inc);
+			err = aupoly_process(mix->resamp, sampv_mix, &outc,
+					     enc->sampv, inc);
 			if (err) {
-				warning("mixminus/auresamp error (%m)\n", err);
+				warning("mixminus/aupoly error (%m)\n", err);
 				return err;
 			}
 			if (outc != af->sampc) {
-				warning("mixminus/auresamp sample count "
+				warning("mixminus/aupoly sample count "
 					"error\n");
 				return EINVAL;
 			}
@@ -320,21 +349,10 @@ static int encode(struct aufilt_enc_st *aufilt_enc_st, struct auframe *af)
 			read_samp(mix->ab, sampv_mix, af->sampc, stime);
 		}
 
-		for (i = 0; i < af->sampc; i++) {
-			sample = sampv[i] + sampv_mix[i];
-
-			/* soft clipping */
-			if (sample >= 32767)
-				sample = 32767;
-			if (sample <= -32767)
-				sample = -32767;
-			sampv[i] = sample;
-		}
-	}
-
-	if (enc->prm.fmt != AUFMT_S16LE) {
-		auconv_from_s16(enc->prm.fmt, af->sampv, sampv,
-				af->sampc);
+		if (af->fmt == AUFMT_FLOAT)
+			mix_float(af->sampv, sampv_mix, af->sampc);
+		else
+			mix_s16(af->sampv, sampv_mix, af->sampc);
 	}
 
 	return err;
@@ -348,7 +366,15 @@ static int decode(struct aufilt_dec_st *aufilt_dec_st, struct auframe *af)
 	struct le *le;
 	struct le *lem;
 	struct mix *mix;
-	int16_t *sampv;
+	const int16_t *sampv = af->sampv;
+
+	if (af->fmt == AUFMT_FLOAT) {
+		if (!dec->sampv)
+			return ENOTSUP;
+
+		auconv_to_s16(dec->sampv, AUFMT_FLOAT, af->sampv, af->sampc);
+		sampv = dec->sampv;
+	}
 
 	for (le = list_head(&encs); le; le = le->next) {
 		enc = le->data;
@@ -367,14 +393,6 @@ static int decode(struct aufilt_dec_st *aufilt_dec_st, struct auframe *af)
 			mix->prm.ch = dec->prm.ch;
 			mix->prm.srate = dec->prm.srate;
 
-			sampv = af->sampv;
-
-			if (dec->prm.fmt != AUFMT_S16LE) {
-				sampv = dec->fsampv;
-				auconv_to_s16(sampv, dec->prm.fmt,
-					      (void *)af->sampv, af->sampc);
-			}
-
 			aubuf_write_samp(mix->ab, sampv, af->sampc);
 		}
 	}
@@ -442,7 +460,8 @@ static int debug_conference(struct re_printf *pf, void *arg)
 
 
 static struct aufilt mixminus = {
-	LE_INIT, "mixminus", encode_update, encode, decode_update, decode
+	LE_INIT, "mixminus", encode_update, encode, decode_update, decode,
+	AUFILT_S16 | AUFILT_FLOAT
 };
 
 
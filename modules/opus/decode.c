@@ -119,11 +119,13 @@ int opus_decode_pkloss(struct audec_state *ads,
 
 	/*
 	 * FEC=0 -> use PLC
-	 * FEC=1 -> use inband FEC
+	 * FEC=1 -> use inband FEC of the next packet (buf)
 	 */
-	fec = opus_packet_loss > 0;
+	fec = buf && len;
 
 	opus_decoder_ctl(ads->dec, OPUS_GET_LAST_PACKET_DURATION(&frame_size));
+	if (frame_size <= 0)
+		frame_size = (opus_int32)(*sampc / ads->ch);
 
 	switch (fmt) {
 
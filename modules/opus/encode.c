@@ -4,6 +4,7 @@
  * Copyright (C) 2010 Alfred E. Heggestad
  */
 
+#include <re_atomic.h>
 #include <re.h>
 #include <rem.h>
 #include <baresip.h>
@@ -14,6 +15,10 @@
 struct auenc_state {
 	OpusEncoder *enc;
 	unsigned ch;
+	RE_ATOMIC int loss;  /* Packet loss reported by the peer [%] */
+	int loss_cur;        /* Packet loss applied to the encoder [%] */
+	bool dtx;            /* DTX enabled */
+	bool in_dtx;         /* Frames are currently not transmitted */
 };
 
 
@@ -41,6 +46,15 @@ static opus_int32 srate2bw(opus_int32 srate)
 }
 
 
+static void encode_adapt(struct auenc_state *aes, int loss)
+{
+	(void)opus_encoder_ctl(aes->enc, OPUS_SET_PACKET_LOSS_PERC(loss));
+	(void)opus_encoder_ctl(aes->enc, OPUS_SET_INBAND_FEC(loss > 0));
+
+	aes->loss_cur = loss;
+}
+
+
 #if 0
 static const char *bwname(opus_int32 bw)
 {
@@ -98,6 +112,8 @@ int opus_encode_update(struct auenc_state **aesp, const struct aucodec *ac,
 			return ENOMEM;
 
 		aes->ch = ac->ch;
+		aes->loss_cur = -1;
+		re_atomic_rlx_set(&aes->loss, opus_packet_loss);
 
 		aes->enc = opus_encoder_create(ac->srate, ac->ch,
 					       opus_application,
@@ -146,11 +162,17 @@ int opus_encode_update(struct auenc_state **aesp, const struct aucodec *ac,
 	(void)opus_encoder_ctl(aes->enc, OPUS_SET_INBAND_FEC(prm.inband_fec));
 	(void)opus_encoder_ctl(aes->enc, OPUS_SET_DTX(prm.dtx));
 
-	if (opus_packet_loss) {
+	if (opus_adaptive) {
+		(void)opus_encoder_ctl(aes->enc, OPUS_SET_DTX(1));
+		encode_adapt(aes, re_atomic_rlx(&aes->loss));
+	}
+	else if (opus_packet_loss) {
 		opus_encoder_ctl(aes->enc,
 				 OPUS_SET_PACKET_LOSS_PERC(opus_packet_loss));
 	}
 
+	aes->dtx = opus_adaptive || prm.dtx;
+
 #if 0
 	{
 	opus_int32 bw, complex;
@@ -174,16 +196,32 @@ int opus_encode_update(struct auenc_state **aesp, const struct aucodec *ac,
 }
 
 
+/* Loss report from RTCP, applied by the encoder thread */
+void opus_encode_loss(struct auenc_state *aes, int loss)
+{
+	if (!aes)
+		return;
+
+	re_atomic_rlx_set(&aes->loss, loss);
+}
+
+
 int opus_encode_frm(struct auenc_state *aes,
 		    bool *marker, uint8_t *buf, size_t *len,
 		    int fmt, const void *sampv, size_t sampc)
 {
 	opus_int32 n;
-	(void)marker;
 
 	if (!aes || !buf || !len || !sampv)
 		return EINVAL;
 
+	if (opus_adaptive) {
+		int loss = re_atomic_rlx(&aes->loss);
+
+		if (loss != aes->loss_cur)
+			encode_adapt(aes, loss);
+	}
+
 	switch (fmt) {
 
 	case AUFMT_S16LE:
@@ -210,6 +248,17 @@ int opus_encode_frm(struct auenc_state *aes,
 		return ENOTSUP;
 	}
 
+	/* DTX: a packet of 1-2 bytes does not need to be transmitted */
+	if (aes->dtx && n <= 2) {
+		aes->in_dtx = true;
+		*len = 0;
+		return 0;
+	}
+
+	if (aes->in_dtx && marker)
+		*marker = true;
+
+	aes->in_dtx = false;
 	*len = n;
 
 	return 0;
@@ -29,6 +29,7 @@
   opus_complexity {0-10}     # Encoder's computational complexity (10 max)
   opus_application {audio, voip} # Encoder's intended application
   opus_packet_loss {0-100}   # Expected packet loss for FEC
+  opus_adaptive   {yes,no}   # Adapt FEC to RTCP loss, enable DTX
  \endverbatim
  *
  * References:
@@ -47,6 +48,7 @@ static char fmtp_mirror[256];
 uint32_t opus_complexity = 10;
 opus_int32 opus_application = OPUS_APPLICATION_AUDIO;
 opus_int32 opus_packet_loss = 0;
+bool opus_adaptive = false;
 
 
 static int opus_fmtp_enc(struct mbuf *mb, const struct sdp_format *fmt,
@@ -79,6 +81,7 @@ static struct aucodec opus = {
 	.decupdh   = opus_decode_update,
 	.dech      = opus_decode_frm,
 	.plch      = opus_decode_pkloss,
+	.lossh     = opus_encode_loss,
 };
 
 
@@ -198,6 +201,8 @@ static int module_init(void)
 			opus_packet_loss = value;
 	}
 
+	(void)conf_get_bool(conf, "opus_adaptive", &opus_adaptive);
+
 	debug("opus: fmtp=\"%s\"\n", fmtp);
 
 	aucodec_register(baresip_aucodecl(), &opus);
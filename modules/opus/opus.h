@@ -21,10 +21,12 @@ int opus_encode_update(struct auenc_state **aesp, const struct aucodec *ac,
 int opus_encode_frm(struct auenc_state *aes,
 		    bool *marker, uint8_t *buf, size_t *len,
 		    int fmt, const void *sampv, size_t sampc);
+void opus_encode_loss(struct auenc_state *aes, int loss);
 
 extern uint32_t opus_complexity;
 extern opus_int32 opus_application;
 extern opus_int32 opus_packet_loss;
+extern bool opus_adaptive;
 
 /* Decode */
 int opus_decode_update(struct audec_state **adsp, const struct aucodec *ac,
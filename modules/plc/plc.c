@@ -19,6 +19,9 @@
  *
  * Packet Loss Concealment (PLC) audio-filter using spandsp
  *
+ * spandsp works on S16LE samples. FLOAT frames are processed in-place,
+ * spandsp gets a S16LE shadow copy of the history and the concealed
+ * samples are written back as FLOAT.
  */
 
 
@@ -26,6 +29,8 @@ struct plc_st {
 	struct aufilt_dec_st af; /* base class */
 	plc_state_t plc;
 	size_t sampc;
+	int16_t *sampv;          /* S16LE shadow buffer for FLOAT */
+	size_t sampvc;
 };
 
 
@@ -34,6 +39,7 @@ static void destructor(void *arg)
 	struct plc_st *st = arg;
 
 	list_unlink(&st->af.le);
+	mem_deref(st->sampv);
 }
 
 
@@ -58,7 +64,7 @@ static int update(struct aufilt_dec_st **stp, void **ctx,
 		return ENOSYS;
 	}
 
-	if (prm->fmt != AUFMT_S16LE) {
+	if (prm->fmt != AUFMT_S16LE && prm->fmt != AUFMT_FLOAT) {
 		warning("plc: unsupported sample format (%s)\n",
 			aufmt_name(prm->fmt));
 		return ENOTSUP;
@@ -83,6 +89,46 @@ static int update(struct aufilt_dec_st **stp, void **ctx,
 }
 
 
+static int decode_float(struct plc_st *plc, struct auframe *af)
+{
+	size_t sampc = af->sampc ? af->sampc : plc->sampc;
+	bool smooth;
+
+	if (!sampc)
+		return 0;
+
+	if (sampc > plc->sampvc) {
+		int16_t *sampv = mem_reallocarray(plc->sampv, sampc,
+						  sizeof(int16_t), NULL);
+		if (!sampv)
+			return ENOMEM;
+
+		plc->sampv  = sampv;
+		plc->sampvc = sampc;
+	}
+
+	if (af->sampc) {
+		/* spandsp only modifies the frame after a loss */
+		smooth = plc->plc.missing_samples != 0;
+
+		auconv_to_s16(plc->sampv, AUFMT_FLOAT, af->sampv, sampc);
+		plc_rx(&plc->plc, plc->sampv, (int)sampc);
+		plc->sampc = sampc;
+
+		if (smooth)
+			auconv_from_s16(AUFMT_FLOAT, af->sampv, plc->sampv,
+					sampc);
+	}
+	else {
+		af->sampc = plc_fillin(&plc->plc, plc->sampv, (int)sampc);
+		auconv_from_s16(AUFMT_FLOAT, af->sampv, plc->sampv,
+				af->sampc);
+	}
+
+	return 0;
+}
+
+
 /*
  * PLC is only valid for Decoding (RX)
  *
@@ -95,6 +141,9 @@ static int decode(struct aufilt_dec_st *st, struct auframe *af)
 	if (!st || !af)
 		return EINVAL;
 
+	if (af->fmt == AUFMT_FLOAT)
+		return decode_float(plc, af);
+
 	if (af->fmt != AUFMT_S16LE)
 		return ENOTSUP;
 
@@ -112,7 +161,8 @@ static int decode(struct aufilt_dec_st *st, struct auframe *af)
 static struct aufilt plc = {
 	.name    = "plc",
 	.decupdh = update,
-	.dech    = decode
+	.dech    = decode,
+	.flags   = AUFILT_S16 | AUFILT_FLOAT,
 };
 
 
@@ -123,9 +123,10 @@ static int do_snapshot_send(struct re_printf *pf, void *arg)
 }
 
 static struct vidfilt snapshot = {
-	.name = "snapshot",
-	.ench = encode,
-	.dech = decode,
+	.name  = "snapshot",
+	.ench  = encode,
+	.dech  = decode,
+	.flags = VIDFILT_RDONLY,
 };
 
 
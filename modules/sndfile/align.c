@@ -0,0 +1,281 @@
+/**
+ * @file align.c  Timestamp aligner for mixed stereo recordings
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re_atomic.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "record.h"
+
+
+/*
+ * Each channel is positioned on a common output timeline. The first frame
+ * of a channel is anchored at its queue time, following frames are placed
+ * by their timestamp relative to the anchor. Gaps are left as silence, and
+ * a channel is re-anchored if its timestamps jump or drift too far from
+ * the queue time (SSRC change, hold, clock skew).
+ *
+ * The output is delayed by at most HOLD_MS to wait for the other channel.
+ */
+
+
+enum {
+	WINDOW_MS = 2000,  /* Mixing window in [ms]                     */
+	HOLD_MS   = 500,   /* Max wait for a lagging channel in [ms]    */
+	RESYNC_MS = 300,   /* Max timestamp deviation before re-anchor  */
+	CHANNELS  = 2,
+};
+
+
+struct align_chan {
+	bool active;      /**< Channel is anchored                    */
+	uint64_t ts0;     /**< Timestamp of the anchor frame [us]     */
+	uint64_t pos0;    /**< Output position of the anchor frame    */
+	uint64_t end;     /**< Output position after the last frame   */
+};
+
+
+struct rec_align {
+	float *winv;                   /**< Interleaved stereo window      */
+	size_t winc;                   /**< Window size in sample frames   */
+	uint64_t base;                 /**< Output position of winv[0]     */
+	uint64_t t0;                   /**< Start time in [us]             */
+	uint32_t srate;                /**< Output sample rate             */
+	struct align_chan chv[CHANNELS];
+	align_write_h *wh;
+	void *arg;
+
+	struct {
+		RE_ATOMIC uint64_t n_written;  /**< Sample frames written  */
+		RE_ATOMIC uint64_t n_silence;  /**< Silence in gaps        */
+		RE_ATOMIC uint64_t n_late;     /**< Late samples dropped   */
+		RE_ATOMIC uint64_t n_resync;   /**< Channel re-anchored    */
+	} stats;
+};
+
+
+static void destructor(void *arg)
+{
+	struct rec_align *al = arg;
+
+	mem_deref(al->winv);
+}
+
+
+static uint64_t usec_to_pos(const struct rec_align *al, uint64_t usec)
+{
+	return usec * al->srate / AUDIO_TIMEBASE;
+}
+
+
+/* Write the window up to position pos, gaps beyond it are silence */
+static void emit(struct rec_align *al, uint64_t pos)
+{
+	size_t n;
+
+	while (pos > al->base) {
+
+		n = (size_t)min(pos - al->base, (uint64_t)al->winc);
+
+		al->wh(al->winv, n, al->arg);
+
+		memmove(al->winv, &al->winv[n * CHANNELS],
+			(al->winc - n) * CHANNELS * sizeof(float));
+		memset(&al->winv[(al->winc - n) * CHANNELS], 0,
+		       n * CHANNELS * sizeof(float));
+
+		al->base += n;
+		re_atomic_rlx_add(&al->stats.n_written, n);
+	}
+}
+
+
+/**
+ * Allocate a timestamp aligner
+ *
+ * @param alp   Pointer to allocated aligner
+ * @param srate Output sample rate
+ * @param t0    Start of the output timeline in [us]
+ * @param wh    Write handler for the interleaved stereo output
+ * @param arg   Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int align_alloc(struct rec_align **alp, uint32_t srate, uint64_t t0,
+		align_write_h *wh, void *arg)
+{
+	struct rec_align *al;
+
+	if (!alp || !srate || !wh)
+		return EINVAL;
+
+	al = mem_zalloc(sizeof(*al), destructor);
+	if (!al)
+		return ENOMEM;
+
+	al->srate = srate;
+	al->t0    = t0;
+	al->winc  = srate * WINDOW_MS / 1000;
+	al->wh    = wh;
+	al->arg   = arg;
+
+	al->winv = mem_zalloc(al->winc * CHANNELS * sizeof(float), NULL);
+	if (!al->winv) {
+		mem_deref(al);
+		return ENOMEM;
+	}
+
+	*alp = al;
+
+	return 0;
+}
+
+
+/**
+ * Place mono samples on one channel of the output timeline
+ *
+ * @param al   Timestamp aligner
+ * @param chan Channel number (0 = left, 1 = right)
+ * @param ts   Frame timestamp in AUDIO_TIMEBASE units
+ * @param qt   Queue time of the frame in [us]
+ * @param sampv Mono samples
+ * @param sampc Number of samples
+ */
+void align_push(struct rec_align *al, unsigned chan, uint64_t ts,
+		uint64_t qt, const float *sampv, size_t sampc)
+{
+	struct align_chan *ch;
+	uint64_t pos, qpos;
+	size_t off;
+
+	if (!al || chan >= CHANNELS || !sampv || !sampc)
+		return;
+
+	ch    = &al->chv[chan];
+	sampc = min(sampc, al->winc);
+	qpos  = usec_to_pos(al, qt > al->t0 ? qt - al->t0 : 0);
+
+	if (ch->active && ts >= ch->ts0) {
+		pos = ch->pos0 + usec_to_pos(al, ts - ch->ts0);
+
+		if (pos + al->srate * RESYNC_MS / 1000 < qpos ||
+		    pos > qpos + al->srate * RESYNC_MS / 1000) {
+			re_atomic_rlx_add(&al->stats.n_resync, 1);
+			ch->active = false;
+		}
+	}
+	else if (ch->active) {
+		/* timestamps went backwards */
+		re_atomic_rlx_add(&al->stats.n_resync, 1);
+		ch->active = false;
+	}
+
+	if (!ch->active) {
+		ch->active = true;
+		ch->ts0    = ts;
+		ch->pos0   = max(qpos, ch->end);
+	}
+
+	pos = ch->pos0 + usec_to_pos(al, ts - ch->ts0);
+
+	if (pos > ch->end && ch->end)
+		re_atomic_rlx_add(&al->stats.n_silence, pos - ch->end);
+
+	/* the output has already been written */
+	if (pos < al->base) {
+		size_t late = (size_t)min(al->base - pos, (uint64_t)sampc);
+
+		re_atomic_rlx_add(&al->stats.n_late, late);
+		sampv += late;
+		sampc -= late;
+		pos   += late;
+	}
+
+	ch->end = max(ch->end, pos + sampc);
+
+	if (!sampc)
+		return;
+
+	/* make room, the other channel gets silence */
+	if (pos + sampc > al->base + al->winc)
+		emit(al, pos + sampc - al->winc);
+
+	off = (size_t)(pos - al->base);
+
+	for (size_t i = 0; i < sampc; i++)
+		al->winv[(off + i) * CHANNELS + chan] = sampv[i];
+}
+
+
+/**
+ * Write the aligned output
+ *
+ * Output is written up to the channel that lags behind, but never later
+ * than HOLD_MS after the channel that is ahead.
+ *
+ * @param al  Timestamp aligner
+ * @param all True to write everything, e.g. at the end of the recording
+ */
+void align_flush(struct rec_align *al, bool all)
+{
+	uint64_t ready = UINT64_MAX, end = 0;
+	uint64_t hold;
+	unsigned activec = 0;
+
+	if (!al)
+		return;
+
+	for (unsigned i = 0; i < CHANNELS; i++) {
+		const struct align_chan *ch = &al->chv[i];
+
+		if (!ch->active)
+			continue;
+
+		ready = min(ready, ch->end);
+		end   = max(end, ch->end);
+		++activec;
+	}
+
+	hold = al->srate * HOLD_MS / 1000;
+
+	/* a channel that has not started yet is lagging behind */
+	if (all)
+		ready = end;
+	else if (activec < CHANNELS)
+		ready = end > hold ? end - hold : 0;
+	else if (end > ready + hold)
+		ready = end - hold;
+
+	emit(al, ready);
+}
+
+
+static uint64_t pos_to_msec(const struct rec_align *al, uint64_t pos)
+{
+	return pos * 1000 / al->srate;
+}
+
+
+/**
+ * Print the aligner statistics
+ *
+ * @param pf Print function
+ * @param al Timestamp aligner
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int align_debug(struct re_printf *pf, const struct rec_align *al)
+{
+	if (!al)
+		return 0;
+
+	return re_hprintf(pf, "    aligned: %llu ms written,"
+			  " %llu ms silence, %llu ms late, %llu resyncs\n",
+			  pos_to_msec(al, re_atomic_rlx(&al->stats.n_written)),
+			  pos_to_msec(al, re_atomic_rlx(&al->stats.n_silence)),
+			  pos_to_msec(al, re_atomic_rlx(&al->stats.n_late)),
+			  re_atomic_rlx(&al->stats.n_resync));
+}
@@ -0,0 +1,933 @@
+/**
+ * @file record.c  Recording engine with asynchronous disk writers
+ *
+ * Copyright (C) 2010 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <sndfile.h>
+#include <re_atomic.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "record.h"
+
+
+/*
+ * The audio threads copy each frame into a lock-free single-producer,
+ * single-consumer ring buffer per recorded stream. A small pool of writer
+ * threads drains the rings and writes to disk in large sequential chunks,
+ * so file I/O never blocks the real-time audio path.
+ *
+ * A mixed recording has one ring per call direction. The rings carry
+ * frames with their timestamp and queue time, and the writer aligns both
+ * directions into one interleaved stereo file. A direction with another
+ * sample rate than the file is resampled by the writer.
+ */
+
+
+enum {
+	TICK_MS = 20,     /* Writer thread poll interval in [ms] */
+};
+
+
+/* Frame header in the ring of a mixed recording */
+struct rec_hdr {
+	uint64_t ts;                  /**< Timestamp in AUDIO_TIMEBASE     */
+	uint64_t qt;                  /**< Queue time in [us]              */
+	uint32_t srate;               /**< Sample rate                     */
+	uint32_t sampc;               /**< Number of samples               */
+	uint8_t ch;                   /**< Number of channels              */
+	uint8_t fmt;                  /**< Sample format (enum aufmt)      */
+};
+
+
+struct ring {
+	uint8_t *buf;                 /**< Ring buffer                     */
+	size_t sz;                    /**< Ring size, power of two         */
+	RE_ATOMIC size_t wr;          /**< Write position (producer)       */
+	RE_ATOMIC size_t rd;          /**< Read position (consumer)        */
+
+	struct {
+		RE_ATOMIC size_t hwm;         /**< Ring high-water mark    */
+		RE_ATOMIC uint64_t n_frames;  /**< Frames queued           */
+		RE_ATOMIC uint64_t n_drop;    /**< Frames dropped          */
+	} stats;
+};
+
+
+struct rec_stream {
+	struct le le;                 /**< Member of writer stream list    */
+	char *filename;               /**< Output filename                 */
+	enum snd_format format;       /**< Output file format              */
+	SNDFILE *sf;                  /**< Output file, opened by writer   */
+	bool failed;                  /**< Output file could not be opened */
+
+	struct ring ringv[2];         /**< One ring per input              */
+	unsigned ringc;               /**< Number of inputs                */
+	struct rec_align *align;      /**< Aligner, mixed recordings only  */
+	float *mixv;                  /**< Mono conversion buffer (writer) */
+	size_t mixc;                  /**< Size of the conversion buffer   */
+	struct aupoly *resampv[2];    /**< Resampler per input (writer)    */
+	int16_t *rsampv;              /**< Resampler buffer (writer)       */
+	size_t rsampc;                /**< Size of the resampler buffer    */
+
+	/* frame parameters, published by the first write */
+	uint32_t srate;
+	uint8_t ch;
+	enum aufmt fmt;
+
+	struct {
+		RE_ATOMIC uint64_t n_bytes;   /**< Bytes written to file   */
+		RE_ATOMIC uint64_t n_writes;  /**< Number of file writes   */
+	} stats;
+};
+
+
+struct writer {
+	thrd_t thrd;
+	mtx_t *mtx;
+	struct list streaml;
+	bool started;
+};
+
+
+static struct {
+	struct writer *writerv;
+	uint32_t writerc;
+	uint32_t next;
+	uint32_t flush_ms;
+	RE_ATOMIC bool run;
+	RE_ATOMIC uint64_t n_drop;    /* Dropped frames of closed streams */
+} rec;
+
+
+static void stream_destructor(void *arg)
+{
+	struct rec_stream *rs = arg;
+
+	if (rs->sf)
+		sf_close(rs->sf);
+
+	for (unsigned i = 0; i < rs->ringc; i++)
+		mem_deref(rs->ringv[i].buf);
+
+	mem_deref(rs->align);
+	mem_deref(rs->mixv);
+	mem_deref(rs->resampv[0]);
+	mem_deref(rs->resampv[1]);
+	mem_deref(rs->rsampv);
+	mem_deref(rs->filename);
+}
+
+
+static size_t ring_fill(const struct ring *r)
+{
+	return re_atomic_acq(&r->wr) - re_atomic_rlx(&r->rd);
+}
+
+
+static size_t stream_fill(const struct rec_stream *rs)
+{
+	size_t fill = 0;
+
+	for (unsigned i = 0; i < rs->ringc; i++)
+		fill = max(fill, ring_fill(&rs->ringv[i]));
+
+	return fill;
+}
+
+
+static uint64_t stream_drops(const struct rec_stream *rs)
+{
+	uint64_t n = 0;
+
+	for (unsigned i = 0; i < rs->ringc; i++)
+		n += re_atomic_rlx(&rs->ringv[i].stats.n_drop);
+
+	return n;
+}
+
+
+static size_t stream_hwm(const struct rec_stream *rs)
+{
+	size_t hwm = 0;
+
+	for (unsigned i = 0; i < rs->ringc; i++)
+		hwm = max(hwm, re_atomic_rlx(&rs->ringv[i].stats.hwm));
+
+	return hwm;
+}
+
+
+static int ring_alloc(struct ring *r, size_t bufsz)
+{
+	r->sz = 4096;
+
+	while (r->sz < bufsz)
+		r->sz <<= 1;
+
+	r->buf = mem_alloc(r->sz, NULL);
+
+	return r->buf ? 0 : ENOMEM;
+}
+
+
+/* Copy in or out of the ring at position pos, wrapping at the end */
+static void ring_put(struct ring *r, size_t pos, const void *p, size_t n)
+{
+	size_t off = pos & (r->sz - 1);
+	size_t len = min(n, r->sz - off);
+
+	memcpy(&r->buf[off], p, len);
+	memcpy(r->buf, (const uint8_t *)p + len, n - len);
+}
+
+
+static void ring_get(const struct ring *r, size_t pos, void *p, size_t n)
+{
+	size_t off = pos & (r->sz - 1);
+	size_t len = min(n, r->sz - off);
+
+	memcpy(p, &r->buf[off], len);
+	memcpy((uint8_t *)p + len, r->buf, n - len);
+}
+
+
+static void ring_hwm(struct ring *r, size_t wr)
+{
+	size_t n = wr - re_atomic_rlx(&r->rd);
+
+	if (n > re_atomic_rlx(&r->stats.hwm))
+		re_atomic_rlx_set(&r->stats.hwm, n);
+}
+
+
+static int sf_format(enum snd_format format, enum aufmt fmt)
+{
+	switch (format) {
+
+	case SND_WAV:
+		return SF_FORMAT_WAV |
+			(fmt == AUFMT_FLOAT ? SF_FORMAT_FLOAT :
+			 SF_FORMAT_PCM_16);
+
+	case SND_FLAC:
+		return SF_FORMAT_FLAC | SF_FORMAT_PCM_16;
+
+	case SND_OPUS:
+		return SF_FORMAT_OGG | SF_FORMAT_OPUS;
+
+	default:
+		return 0;
+	}
+}
+
+
+static int stream_open(struct rec_stream *rs)
+{
+	SF_INFO sfinfo;
+
+	memset(&sfinfo, 0, sizeof(sfinfo));
+	sfinfo.samplerate = rs->srate;
+	sfinfo.channels   = rs->ch;
+	sfinfo.format     = sf_format(rs->format,
+				      rs->align ? AUFMT_S16LE : rs->fmt);
+
+	if (!sf_format_check(&sfinfo)) {
+		warning("sndfile: %s: format not supported"
+			" (%u Hz, %u ch, %s)\n", rs->filename,
+			rs->srate, rs->ch, aufmt_name(rs->fmt));
+		return ENOTSUP;
+	}
+
+	rs->sf = sf_open(rs->filename, SFM_WRITE, &sfinfo);
+	if (!rs->sf) {
+		warning("sndfile: could not open: %s (%s)\n",
+			rs->filename, sf_strerror(NULL));
+		return EIO;
+	}
+
+	return 0;
+}
+
+
+static void stream_write(struct rec_stream *rs, const uint8_t *p, size_t n)
+{
+	sf_count_t c;
+
+	if (rs->fmt == AUFMT_FLOAT)
+		c = sf_write_float(rs->sf, (const float *)(const void *)p,
+				   n / sizeof(float)) * sizeof(float);
+	else
+		c = sf_write_short(rs->sf, (const short *)(const void *)p,
+				   n / sizeof(short)) * sizeof(short);
+
+	re_atomic_rlx_add(&rs->stats.n_bytes, (uint64_t)c);
+	re_atomic_rlx_add(&rs->stats.n_writes, 1);
+}
+
+
+/* Consumer: write all queued samples, in at most two chunks */
+static void stream_drain(struct rec_stream *rs)
+{
+	struct ring *r = &rs->ringv[0];
+	size_t rd = re_atomic_rlx(&r->rd);
+	size_t n  = re_atomic_acq(&r->wr) - rd;
+
+	if (!n)
+		return;
+
+	if (!rs->sf && !rs->failed)
+		rs->failed = stream_open(rs) != 0;
+
+	while (n) {
+		size_t off = rd & (r->sz - 1);
+		size_t len = min(n, r->sz - off);
+
+		if (rs->sf)
+			stream_write(rs, &r->buf[off], len);
+
+		rd += len;
+		n  -= len;
+	}
+
+	re_atomic_rls_set(&r->rd, rd);
+}
+
+
+static void mix_write_handler(const float *sampv, size_t framec, void *arg)
+{
+	struct rec_stream *rs = arg;
+	sf_count_t c;
+
+	if (!rs->sf && !rs->failed)
+		rs->failed = stream_open(rs) != 0;
+
+	if (!rs->sf)
+		return;
+
+	c = sf_writef_float(rs->sf, sampv, framec);
+
+	re_atomic_rlx_add(&rs->stats.n_bytes,
+			  (uint64_t)c * rs->ch * sizeof(float));
+	re_atomic_rlx_add(&rs->stats.n_writes, 1);
+}
+
+
+static int mix_check_size(struct rec_stream *rs, size_t sampc)
+{
+	float *v;
+
+	if (rs->mixc >= sampc)
+		return 0;
+
+	v = mem_realloc(rs->mixv, sampc * sizeof(float));
+	if (!v)
+		return ENOMEM;
+
+	rs->mixv = v;
+	rs->mixc = sampc;
+
+	return 0;
+}
+
+
+/* Down-mix one queued frame to mono float */
+static const float *mix_frame(struct rec_stream *rs, const struct ring *r,
+			      size_t pos, const struct rec_hdr *hdr)
+{
+	const size_t framec = hdr->sampc / hdr->ch;
+	const size_t ssz    = aufmt_sample_size(hdr->fmt);
+	uint8_t *p;
+
+	if (mix_check_size(rs, hdr->sampc))
+		return NULL;
+
+	/* the samples are copied to the end, the result is packed in front */
+	p = (uint8_t *)(void *)rs->mixv +
+		hdr->sampc * (sizeof(float) - ssz);
+	ring_get(r, pos, p, hdr->sampc * ssz);
+
+	for (size_t i = 0; i < framec; i++) {
+		float v = 0;
+
+		for (uint8_t c = 0; c < hdr->ch; c++) {
+			size_t j = i * hdr->ch + c;
+
+			if (hdr->fmt == AUFMT_FLOAT)
+				v += ((const float *)(const void *)p)[j];
+			else
+				v += ((const int16_t *)(const void *)p)[j] /
+					32768.0f;
+		}
+
+		rs->mixv[i] = v / hdr->ch;
+	}
+
+	return rs->mixv;
+}
+
+
+/* Resample a mono frame of one input to the sample rate of the file */
+static const float *mix_resample(struct rec_stream *rs, unsigned chan,
+				 uint32_t srate, size_t *framec)
+{
+	struct aupoly **resamp = &rs->resampv[chan];
+	size_t outc, sz;
+	int err;
+
+	if (!aupoly_match(*resamp, srate, 1, rs->srate, 1)) {
+
+		*resamp = mem_deref(*resamp);
+
+		err = aupoly_alloc(resamp, srate, 1, rs->srate, 1);
+		if (err) {
+			warning("sndfile: resampler %u -> %u Hz (%m)\n",
+				srate, rs->srate, err);
+			return NULL;
+		}
+	}
+
+	outc = aupoly_maxoutc(*resamp, *framec);
+
+	/* input in front, output behind */
+	sz = *framec + outc;
+	if (rs->rsampc < sz) {
+		int16_t *v = mem_realloc(rs->rsampv, sz * sizeof(int16_t));
+		if (!v)
+			return NULL;
+
+		rs->rsampv = v;
+		rs->rsampc = sz;
+	}
+
+	auconv_to_s16(rs->rsampv, AUFMT_FLOAT, rs->mixv, *framec);
+
+	err = aupoly_process(*resamp, rs->rsampv + *framec, &outc,
+			     rs->rsampv, *framec);
+	if (err || mix_check_size(rs, outc))
+		return NULL;
+
+	auconv_from_s16(AUFMT_FLOAT, rs->mixv, rs->rsampv + *framec, outc);
+
+	*framec = outc;
+
+	return rs->mixv;
+}
+
+
+/* Consumer: align all queued frames of both directions */
+static void stream_drain_mix(struct rec_stream *rs, bool all)
+{
+	for (unsigned i = 0; i < rs->ringc; i++) {
+		struct ring *r = &rs->ringv[i];
+		size_t rd = re_atomic_rlx(&r->rd);
+		size_t wr = re_atomic_acq(&r->wr);
+
+		while (rd != wr) {
+			struct rec_hdr hdr;
+			const float *v;
+			size_t framec;
+
+			ring_get(r, rd, &hdr, sizeof(hdr));
+			rd += sizeof(hdr);
+
+			framec = hdr.sampc / hdr.ch;
+
+			v = mix_frame(rs, r, rd, &hdr);
+			if (v && hdr.srate != rs->srate)
+				v = mix_resample(rs, i, hdr.srate, &framec);
+			if (v)
+				align_push(rs->align, i, hdr.ts, hdr.qt,
+					   v, framec);
+
+			rd += hdr.sampc * aufmt_sample_size(hdr.fmt);
+		}
+
+		re_atomic_rls_set(&r->rd, rd);
+	}
+
+	align_flush(rs->align, all);
+}
+
+
+static void stream_finish(struct rec_stream *rs)
+{
+	if (rs->sf) {
+		sf_close(rs->sf);
+		rs->sf = NULL;
+	}
+
+	re_atomic_rlx_add(&rec.n_drop, stream_drops(rs));
+
+	info("sndfile: closed %s (%llu bytes, high-water %zu/%zu bytes,"
+	     " %llu frames dropped)\n", rs->filename,
+	     re_atomic_rlx(&rs->stats.n_bytes),
+	     stream_hwm(rs), rs->ringv[0].sz, stream_drops(rs));
+}
+
+
+static void stream_flush(struct rec_stream *rs, bool all)
+{
+	if (rs->align)
+		stream_drain_mix(rs, all);
+	else
+		stream_drain(rs);
+}
+
+
+/*
+ * Drain the streams of one writer. Only the writer thread unlinks
+ * streams, other threads only append, so the list element stays valid
+ * while the lock is released for the file I/O.
+ *
+ * A stream is finished when the writer holds the last reference.
+ */
+static void writer_flush(struct writer *w, bool all)
+{
+	struct le *le;
+
+	mtx_lock(w->mtx);
+	le = list_head(&w->streaml);
+	mtx_unlock(w->mtx);
+
+	while (le) {
+		struct rec_stream *rs = le->data;
+		bool closing = mem_nrefs(rs) == 1;
+		bool done;
+
+		if (all || closing || stream_fill(rs) >= rs->ringv[0].sz / 2)
+			stream_flush(rs, closing);
+
+		done = closing && !stream_fill(rs);
+
+		mtx_lock(w->mtx);
+		le = le->next;
+		if (done)
+			list_unlink(&rs->le);
+		mtx_unlock(w->mtx);
+
+		if (done) {
+			stream_finish(rs);
+			mem_deref(rs);
+		}
+	}
+}
+
+
+static int writer_thread(void *arg)
+{
+	struct writer *w = arg;
+	uint64_t last = tmr_jiffies();
+
+	while (re_atomic_rlx(&rec.run)) {
+		uint64_t now;
+
+		sys_msleep(TICK_MS);
+
+		now = tmr_jiffies();
+		if (now - last >= rec.flush_ms) {
+			writer_flush(w, true);
+			last = now;
+		}
+		else {
+			/* only streams above half fill */
+			writer_flush(w, false);
+		}
+	}
+
+	writer_flush(w, true);
+
+	return 0;
+}
+
+
+static void writer_close(struct writer *w)
+{
+	struct le *le;
+
+	if (w->started)
+		thrd_join(w->thrd, NULL);
+
+	for (le = list_head(&w->streaml); le; le = le->next) {
+		struct rec_stream *rs = le->data;
+
+		stream_flush(rs, true);
+		stream_finish(rs);
+	}
+
+	list_flush(&w->streaml);
+	mem_deref(w->mtx);
+}
+
+
+static void writers_destructor(void *arg)
+{
+	(void)arg;
+
+	re_atomic_rlx_set(&rec.run, false);
+
+	for (uint32_t i = 0; i < rec.writerc; i++)
+		writer_close(&rec.writerv[i]);
+}
+
+
+/**
+ * Start the recording engine
+ *
+ * @param threads  Number of writer threads
+ * @param flush_ms Flush interval in [ms]
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rec_init(uint32_t threads, uint32_t flush_ms)
+{
+	int err = 0;
+
+	if (!threads)
+		return EINVAL;
+
+	rec.writerv = mem_zalloc(threads * sizeof(*rec.writerv),
+				 writers_destructor);
+	if (!rec.writerv)
+		return ENOMEM;
+
+	rec.writerc  = threads;
+	rec.flush_ms = max(flush_ms, (uint32_t)TICK_MS);
+	re_atomic_rlx_set(&rec.run, true);
+
+	for (uint32_t i = 0; i < threads; i++) {
+		struct writer *w = &rec.writerv[i];
+
+		err = mutex_alloc(&w->mtx);
+		if (err)
+			goto out;
+
+		err = thread_create_name(&w->thrd, "sndfile", writer_thread,
+					 w);
+		if (err)
+			goto out;
+
+		w->started = true;
+	}
+
+ out:
+	if (err)
+		rec_close();
+
+	return err;
+}
+
+
+/**
+ * Stop the recording engine, all queued samples are written
+ */
+void rec_close(void)
+{
+	rec.writerv = mem_deref(rec.writerv);
+	rec.writerc = 0;
+}
+
+
+static int stream_alloc(struct rec_stream **rsp, const char *filename,
+			enum snd_format format, unsigned ringc, size_t bufsz)
+{
+	struct rec_stream *rs;
+	int err = 0;
+
+	if (!rsp || !str_isset(filename) || !rec.writerc)
+		return EINVAL;
+
+	rs = mem_zalloc(sizeof(*rs), stream_destructor);
+	if (!rs)
+		return ENOMEM;
+
+	rs->format = format;
+	rs->ringc  = ringc;
+
+	for (unsigned i = 0; i < ringc; i++) {
+		err = ring_alloc(&rs->ringv[i], bufsz);
+		if (err)
+			goto out;
+	}
+
+	err = str_dup(&rs->filename, filename);
+
+ out:
+	if (err)
+		mem_deref(rs);
+	else
+		*rsp = rs;
+
+	return err;
+}
+
+
+/* Streams are spread round-robin over the writers */
+static void stream_start(struct rec_stream *rs)
+{
+	struct writer *w = &rec.writerv[rec.next++ % rec.writerc];
+
+	mtx_lock(w->mtx);
+	list_append(&w->streaml, &rs->le, mem_ref(rs));
+	mtx_unlock(w->mtx);
+}
+
+
+/**
+ * Allocate a recording stream
+ *
+ * The file is finished asynchronously when the stream is dereferenced.
+ *
+ * @param rsp      Pointer to allocated recording stream
+ * @param filename Output filename
+ * @param format   Output file format
+ * @param bufsz    Minimum ring buffer size in [bytes]
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rec_stream_alloc(struct rec_stream **rsp, const char *filename,
+		     enum snd_format format, size_t bufsz)
+{
+	int err;
+
+	err = stream_alloc(rsp, filename, format, 1, bufsz);
+	if (err)
+		return err;
+
+	stream_start(*rsp);
+
+	return 0;
+}
+
+
+/**
+ * Allocate a mixed stereo recording stream
+ *
+ * The transmitted audio is recorded on the left channel and the received
+ * audio on the right channel. Both directions are aligned by the frame
+ * timestamps, gaps and lost frames are recorded as silence. Frames with
+ * another sample rate are resampled to the sample rate of the file.
+ *
+ * @param rsp      Pointer to allocated recording stream
+ * @param filename Output filename
+ * @param format   Output file format
+ * @param srate    Sample rate of the file
+ * @param bufsz    Minimum ring buffer size per direction in [bytes]
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rec_stream_alloc_mix(struct rec_stream **rsp, const char *filename,
+			 enum snd_format format, uint32_t srate,
+			 size_t bufsz)
+{
+	struct rec_stream *rs;
+	int err;
+
+	if (!srate)
+		return EINVAL;
+
+	err = stream_alloc(&rs, filename, format, 2, bufsz);
+	if (err)
+		return err;
+
+	rs->srate = srate;
+	rs->ch    = 2;
+	rs->fmt   = AUFMT_FLOAT;
+
+	err = align_alloc(&rs->align, srate, tmr_jiffies_usec(),
+			  mix_write_handler, rs);
+	if (err) {
+		mem_deref(rs);
+		return err;
+	}
+
+	stream_start(rs);
+
+	*rsp = rs;
+
+	return 0;
+}
+
+
+/* Producer: queue a frame with its header for the aligner */
+static int write_mix(struct rec_stream *rs, struct ring *r,
+		     const struct auframe *af)
+{
+	struct rec_hdr hdr;
+	size_t wr, n;
+
+	if (!af->srate || !af->ch ||
+	    (af->fmt != AUFMT_S16LE && af->fmt != AUFMT_FLOAT))
+		return EINVAL;
+
+	n  = auframe_size(af);
+	wr = re_atomic_rlx(&r->wr);
+
+	if (wr - re_atomic_acq(&r->rd) + sizeof(hdr) + n > r->sz)
+		return ENOSPC;
+
+	hdr.ts    = af->timestamp;
+	hdr.qt    = tmr_jiffies_usec();
+	hdr.srate = af->srate;
+	hdr.sampc = (uint32_t)af->sampc;
+	hdr.ch    = af->ch;
+	hdr.fmt   = (uint8_t)af->fmt;
+
+	ring_put(r, wr, &hdr, sizeof(hdr));
+	ring_put(r, wr + sizeof(hdr), af->sampv, n);
+
+	re_atomic_rls_set(&r->wr, wr + sizeof(hdr) + n);
+	ring_hwm(r, wr + sizeof(hdr) + n);
+
+	return 0;
+}
+
+
+/**
+ * Queue an audio frame for recording
+ *
+ * The frame is dropped if the ring buffer is full or the frame parameters
+ * of a single recording changed.
+ *
+ * @param rs   Recording stream
+ * @param chan Direction of a mixed recording, REC_TX otherwise
+ * @param af   Audio frame
+ *
+ * @return 0 if success, otherwise errorcode
+ *
+ * @note This function has REAL-TIME properties
+ */
+int rec_stream_write(struct rec_stream *rs, enum rec_chan chan,
+		     const struct auframe *af)
+{
+	struct ring *r;
+	size_t wr, n;
+	int err = 0;
+
+	if (!rs || !af || (unsigned)chan >= rs->ringc)
+		return EINVAL;
+
+	if (!af->sampc)
+		return 0;
+
+	r = &rs->ringv[chan];
+
+	if (rs->align) {
+		err = write_mix(rs, r, af);
+		if (err)
+			goto drop;
+
+		re_atomic_rlx_add(&r->stats.n_frames, 1);
+		return 0;
+	}
+
+	wr = re_atomic_rlx(&r->wr);
+
+	/* frame parameters are published with the first write */
+	if (!wr) {
+		if (af->fmt != AUFMT_S16LE && af->fmt != AUFMT_FLOAT)
+			goto drop;
+
+		rs->srate = af->srate;
+		rs->ch    = af->ch;
+		rs->fmt   = af->fmt;
+	}
+	else if (af->srate != rs->srate || af->ch != rs->ch ||
+		 af->fmt != rs->fmt) {
+		goto drop;
+	}
+
+	n = auframe_size(af);
+	if (wr - re_atomic_acq(&r->rd) + n > r->sz)
+		goto drop;
+
+	ring_put(r, wr, af->sampv, n);
+
+	re_atomic_rls_set(&r->wr, wr + n);
+	re_atomic_rlx_add(&r->stats.n_frames, 1);
+	ring_hwm(r, wr + n);
+
+	return 0;
+
+ drop:
+	re_atomic_rlx_add(&r->stats.n_drop, 1);
+	return err ? err : ENOSPC;
+}
+
+
+/**
+ * Get the file extension of a recording format
+ *
+ * @param format Recording file format
+ *
+ * @return File extension
+ */
+const char *rec_format_ext(enum snd_format format)
+{
+	switch (format) {
+
+	case SND_FLAC: return "flac";
+	case SND_OPUS: return "opus";
+	default:       return "wav";
+	}
+}
+
+
+static int recstream_debug(struct re_printf *pf, const struct rec_stream *rs)
+{
+	int err;
+
+	err = re_hprintf(pf, "  %s: written %llu bytes in %llu writes%s\n",
+			 rs->filename,
+			 re_atomic_rlx(&rs->stats.n_bytes),
+			 re_atomic_rlx(&rs->stats.n_writes),
+			 rs->failed ? " (failed)" : "");
+
+	for (unsigned i = 0; i < rs->ringc; i++) {
+		const struct ring *r = &rs->ringv[i];
+
+		err |= re_hprintf(pf, "    %s: fill %zu/%zu, high-water %zu,"
+				  " frames %llu, dropped %llu\n",
+				  rs->align ? (i ? "rx" : "tx") : "ring",
+				  ring_fill(r), r->sz,
+				  re_atomic_rlx(&r->stats.hwm),
+				  re_atomic_rlx(&r->stats.n_frames),
+				  re_atomic_rlx(&r->stats.n_drop));
+	}
+
+	err |= align_debug(pf, rs->align);
+
+	return err;
+}
+
+
+/**
+ * Print the recording engine statistics
+ *
+ * @param pf     Print function
+ * @param unused Unused parameter
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rec_debug(struct re_printf *pf, void *unused)
+{
+	int err;
+	(void)unused;
+
+	err = re_hprintf(pf, "sndfile: %u writer threads, flush %ums,"
+			 " %llu frames dropped in closed streams\n",
+			 rec.writerc, rec.flush_ms,
+			 re_atomic_rlx(&rec.n_drop));
+
+	for (uint32_t i = 0; i < rec.writerc; i++) {
+		struct writer *w = &rec.writerv[i];
+
+		mtx_lock(w->mtx);
+		for (struct le *le = w->streaml.head; le; le = le->next)
+			err |= recstream_debug(pf, le->data);
+		mtx_unlock(w->mtx);
+	}
+
+	return err;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file record.h  Recording engine interface
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+
+
+/** Recording file formats */
+enum snd_format {
+	SND_WAV = 0,
+	SND_FLAC,
+	SND_OPUS,
+};
+
+/** Inputs of a mixed stereo recording */
+enum rec_chan {
+	REC_TX = 0,   /**< Left channel, encoded audio  */
+	REC_RX = 1,   /**< Right channel, decoded audio */
+};
+
+
+struct rec_stream;
+
+
+/* Recording engine */
+int  rec_init(uint32_t threads, uint32_t flush_ms);
+void rec_close(void);
+int  rec_debug(struct re_printf *pf, void *unused);
+const char *rec_format_ext(enum snd_format format);
+
+/* Recording stream */
+int  rec_stream_alloc(struct rec_stream **rsp, const char *filename,
+		      enum snd_format format, size_t bufsz);
+int  rec_stream_alloc_mix(struct rec_stream **rsp, const char *filename,
+			  enum snd_format format, uint32_t srate,
+			  size_t bufsz);
+int  rec_stream_write(struct rec_stream *rs, enum rec_chan chan,
+		      const struct auframe *af);
+
+
+/* Timestamp aligner */
+struct rec_align;
+
+typedef void (align_write_h)(const float *sampv, size_t framec, void *arg);
+
+int  align_alloc(struct rec_align **alp, uint32_t srate, uint64_t t0,
+		 align_write_h *wh, void *arg);
+void align_push(struct rec_align *al, unsigned chan, uint64_t ts,
+		uint64_t qt, const float *sampv, size_t sampc);
+void align_flush(struct rec_align *al, bool all);
+int  align_debug(struct re_printf *pf, const struct rec_align *al);
@@ -3,40 +3,65 @@
  *
  * Copyright (C) 2010 Alfred E. Heggestad
  */
-#include <sndfile.h>
 #include <time.h>
 #include <re.h>
 #include <rem.h>
 #include <baresip.h>
+#include "record.h"
 
 
 /**
  * @defgroup sndfile sndfile
  *
- * Audio filter that writes audio samples to WAV-file
+ * Audio filter that writes audio samples to WAV, FLAC or Opus files
+ *
+ * The audio frames are queued in a lock-free ring buffer per stream and
+ * written to disk by a pool of writer threads.
+ *
+ * In split mode the encoded and decoded audio are written to separate
+ * files. In stereo mode both directions of a call are aligned by their
+ * timestamps and written to one file, with the transmitted audio on the
+ * left and the received audio on the right channel. The recording is
+ * shared by all filters of the call's audio object, so it survives a
+ * re-setup of the encode or decode filters.
  *
  * Example Configuration:
  \verbatim
   snd_path					/tmp/
+  snd_format					wav	# wav, flac, opus
+  snd_mode					split	# split, stereo
+  snd_threads					1
+  snd_buffer					2000	# ring size in [ms]
+  snd_flush					200	# write period in [ms]
  \endverbatim
  */
 
 
 struct sndfile_enc {
 	struct aufilt_enc_st af;  /* base class */
-	SNDFILE *encf;
-	int err;
-	const struct audio *audio;
+	struct rec_stream *rs;
+	struct mixrec *mix;
 };
 
 struct sndfile_dec {
 	struct aufilt_dec_st af;  /* base class */
-	SNDFILE *decf;
-	int err;
-	const struct audio *audio;
+	struct rec_stream *rs;
+	struct mixrec *mix;
+};
+
+/* Stereo recording of one audio object */
+struct mixrec {
+	struct le le;
+	const struct audio *au;
+	struct rec_stream *rs;
 };
 
 static char file_path[512] = ".";
+static enum snd_format file_format = SND_WAV;
+static uint32_t buffer_ms = 2000;
+static bool stereo;
+static struct list mixl;       /* Stereo recordings (struct mixrec) */
+static mtx_t *mix_mtx;
 
 
 static int timestamp_print(struct re_printf *pf, const struct tm *tm)
@@ -50,88 +75,132 @@ static int timestamp_print(struct re_printf *pf, const struct tm *tm)
 }
 
 
-static void enc_destructor(void *arg)
+static void mix_destructor(void *arg)
 {
-	struct sndfile_enc *st = arg;
+	struct mixrec *mix = arg;
 
-	if (st->encf)
-		sf_close(st->encf);
+	mtx_lock(mix_mtx);
+	list_unlink(&mix->le);
+	mtx_unlock(mix_mtx);
 
-	list_unlink(&st->af.le);
+	mem_deref(mix->rs);
 }
 
 
-static void dec_destructor(void *arg)
+/* Find the stereo recording of an audio object, with a new reference */
+static struct mixrec *mix_find(const struct audio *au)
 {
-	struct sndfile_dec *st = arg;
+	struct mixrec *found = NULL;
+	struct le *le;
+
+	mtx_lock(mix_mtx);
+	for (le = mixl.head; le; le = le->next) {
+		struct mixrec *mix = le->data;
+
+		/* skip a recording that is being destroyed */
+		if (mix->au == au && mem_nrefs(mix) > 0) {
+			found = mem_ref(mix);
+			break;
+		}
+	}
+	mtx_unlock(mix_mtx);
+
+	return found;
+}
 
-	if (st->decf)
-		sf_close(st->decf);
+
+static void enc_destructor(void *arg)
+{
+	struct sndfile_enc *st = arg;
+
+	mem_deref(st->rs);
+	mem_deref(st->mix);
 
 	list_unlink(&st->af.le);
 }
 
 
-static int get_format(enum aufmt fmt)
+static void dec_destructor(void *arg)
 {
-	switch (fmt) {
+	struct sndfile_dec *st = arg;
 
-	case AUFMT_S16LE:  return SF_FORMAT_PCM_16;
-	case AUFMT_FLOAT:  return SF_FORMAT_FLOAT;
-	default:           return 0;
-	}
+	mem_deref(st->rs);
+	mem_deref(st->mix);
+
+	list_unlink(&st->af.le);
 }
 
 
-static int openfile(SNDFILE **sfp,
-			 const struct aufilt_prm *prm,
-			 const struct stream *strm,
-			 bool enc)
+static int openstream(struct rec_stream **rsp, struct mixrec **mixp,
+		      const struct aufilt_prm *prm,
+		      const struct audio *au, bool enc)
 {
+	const struct stream *strm = audio_strm(au);
 	char filename[256];
-	SF_INFO sfinfo;
 	time_t tnow = time(0);
 	struct tm *tm = localtime(&tnow);
-	SNDFILE *sf;
-	int format;
+	struct mixrec *mix = NULL;
+	size_t bufsz;
+	int err;
 
 	const char *cname = stream_cname(strm);
 	const char *peer = stream_peer(strm);
 
+	/* both directions of a call share one stereo recording */
+	if (stereo) {
+		mix = mix_find(au);
+		if (mix) {
+			*rsp  = mem_ref(mix->rs);
+			*mixp = mix;
+			return 0;
+		}
+	}
+
 	(void)re_snprintf(filename, sizeof(filename),
-			  "%s/dump-%s=>%s-%H-%s.wav",
+			  "%s/dump-%s=>%s-%H-%s.%s",
 			  file_path,
 			  cname, peer,
-			  timestamp_print, tm, enc ? "enc" : "dec");
-
-	format = get_format(prm->fmt);
-	if (!format) {
-		warning("sndfile: sample format not supported (%s)\n",
-			aufmt_name(prm->fmt));
-		return EINVAL;
+			  timestamp_print, tm,
+			  stereo ? "mix" : enc ? "enc" : "dec",
+			  rec_format_ext(file_format));
+
+	/* room for the largest sample format */
+	bufsz = (size_t)prm->srate * prm->ch * sizeof(float) *
+		buffer_ms / 1000;
+
+	if (stereo)
+		err = rec_stream_alloc_mix(rsp, filename, file_format,
+					   prm->srate, bufsz);
+	else
+		err = rec_stream_alloc(rsp, filename, file_format, bufsz);
+	if (err) {
+		warning("sndfile: could not record %s (%m)\n",
+			filename, err);
+		return err;
 	}
 
-	sfinfo.samplerate = prm->srate;
-	sfinfo.channels   = prm->ch;
-	sfinfo.format     = SF_FORMAT_WAV | format;
+	if (stereo) {
+		mix = mem_zalloc(sizeof(*mix), mix_destructor);
+		if (!mix) {
+			*rsp = mem_deref(*rsp);
+			return ENOMEM;
+		}
+
+		mix->au = au;
+		mix->rs = mem_ref(*rsp);
+
+		mtx_lock(mix_mtx);
+		list_append(&mixl, &mix->le, mix);
+		mtx_unlock(mix_mtx);
 
-	sf = sf_open(filename, SFM_WRITE, &sfinfo);
-	if (!sf) {
-		warning("sndfile: could not open: %s\n", filename);
-		puts(sf_strerror(NULL));
-		return EIO;
+		*mixp = mix;
 	}
 
 	info("sndfile: dumping %s audio to %s\n",
-	     enc ? "encode" : "decode", filename);
+	     stereo ? "call" : enc ? "encode" : "decode", filename);
 
-	module_event("sndfile", "dump", NULL, NULL,
-		     "%s/dump-%s=>%s-%H-%s.wav",
-		     file_path,
-		     cname, peer,
-		     timestamp_print, tm, enc ? "enc" : "dec");
+	module_event("sndfile", "dump", NULL, NULL, "%s", filename);
 
-	*sfp = sf;
 	return 0;
 }
 
@@ -141,18 +210,22 @@ static int encode_update(struct aufilt_enc_st **stp, void **ctx,
 			 const struct audio *au)
 {
 	struct sndfile_enc *st;
-	(void)ctx;
+	int err;
 	(void)af;
-	(void)prm;
 
-	if (!stp || !au)
+	if (!stp || !ctx || !prm || !au)
 		return EINVAL;
 
 	st = mem_zalloc(sizeof(*st), enc_destructor);
 	if (!st)
 		return EINVAL;
 
-	st->audio = au;
+	err = openstream(&st->rs, &st->mix, prm, au, true);
+	if (err) {
+		mem_deref(st);
+		return err;
+	}
+
 	*stp = (struct aufilt_enc_st *)st;
 
 	return 0;
@@ -164,46 +237,37 @@ static int decode_update(struct aufilt_dec_st **stp, void **ctx,
 			 const struct audio *au)
 {
 	struct sndfile_dec *st;
-	(void)ctx;
+	int err;
 	(void)af;
-	(void)prm;
 
-	if (!stp || !au)
+	if (!stp || !ctx || !prm || !au)
 		return EINVAL;
 
 	st = mem_zalloc(sizeof(*st), dec_destructor);
 	if (!st)
 		return EINVAL;
 
-	st->audio = au;
+	err = openstream(&st->rs, &st->mix, prm, au, false);
+	if (err) {
+		mem_deref(st);
+		return err;
+	}
+
 	*stp = (struct aufilt_dec_st *)st;
 
 	return 0;
 }
 
 
+/* Dropped frames are counted by the recorder, the call goes on */
 static int encode(struct aufilt_enc_st *st, struct auframe *af)
 {
 	struct sndfile_enc *sf = (struct sndfile_enc *)st;
-	size_t num_bytes;
 
 	if (!st || !af)
 		return EINVAL;
 
-	if (sf->err)
-		return sf->err;
-
-	if (!sf->encf) {
-		struct aufilt_prm prm = {af->srate, af->ch, af->fmt};
-		sf->err = openfile(&sf->encf, &prm,
-				   audio_strm(sf->audio), true);
-		if (sf->err)
-			return sf->err;
-	}
-
-	num_bytes = auframe_size(af);
-
-	sf_write_raw(sf->encf, af->sampv, num_bytes);
+	(void)rec_stream_write(sf->rs, REC_TX, af);
 
 	return 0;
 }
@@ -212,25 +276,11 @@ static int encode(struct aufilt_enc_st *st, struct auframe *af)
 static int decode(struct aufilt_dec_st *st, struct auframe *af)
 {
 	struct sndfile_dec *sf = (struct sndfile_dec *)st;
-	size_t num_bytes;
 
 	if (!st || !af)
 		return EINVAL;
 
-	if (sf->err)
-		return sf->err;
-
-	if (!sf->decf) {
-		struct aufilt_prm prm = {af->srate, af->ch, af->fmt};
-		sf->err = openfile(&sf->decf, &prm,
-				   audio_strm(sf->audio), false);
-		if (sf->err)
-			return sf->err;
-	}
-
-	num_bytes = auframe_size(af);
-
-	sf_write_raw(sf->decf, af->sampv, num_bytes);
+	(void)rec_stream_write(sf->rs, stereo ? REC_RX : REC_TX, af);
 
 	return 0;
 }
@@ -241,17 +291,64 @@ static struct aufilt sndfile = {
 	.encupdh = encode_update,
 	.ench    = encode,
 	.decupdh = decode_update,
-	.dech    = decode
+	.dech    = decode,
+	.flags   = AUFILT_INPLACE,
+};
+
+
+static const struct cmd cmdv[] = {
+	{"sndfile_debug", 0, 0, "Recording statistics", rec_debug},
 };
 
 
 static int module_init(void)
 {
-	aufilt_register(baresip_aufiltl(), &sndfile);
+	struct pl pl;
+	uint32_t threads = 1, flush_ms = 200;
+	int err;
 
 	conf_get_str(conf_cur(), "snd_path", file_path, sizeof(file_path));
+	(void)conf_get_u32(conf_cur(), "snd_threads", &threads);
+	(void)conf_get_u32(conf_cur(), "snd_buffer", &buffer_ms);
+	(void)conf_get_u32(conf_cur(), "snd_flush", &flush_ms);
+
+	if (0 == conf_get(conf_cur(), "snd_format", &pl)) {
+
+		if (0 == pl_strcasecmp(&pl, "wav"))
+			file_format = SND_WAV;
+		else if (0 == pl_strcasecmp(&pl, "flac"))
+			file_format = SND_FLAC;
+		else if (0 == pl_strcasecmp(&pl, "opus"))
+			file_format = SND_OPUS;
+		else
+			warning("sndfile: unsupported format (%r)\n", &pl);
+	}
 
-	info("sndfile: saving files in %s\n", file_path);
+	if (0 == conf_get(conf_cur(), "snd_mode", &pl))
+		stereo = 0 == pl_strcasecmp(&pl, "stereo");
+
+	err = mutex_alloc(&mix_mtx);
+	if (err)
+		return err;
+
+	err = rec_init(threads, flush_ms);
+	if (err) {
+		mix_mtx = mem_deref(mix_mtx);
+		return err;
+	}
+
+	err = cmd_register(baresip_commands(), cmdv, RE_ARRAY_SIZE(cmdv));
+	if (err) {
+		rec_close();
+		mix_mtx = mem_deref(mix_mtx);
+		return err;
+	}
+
+	aufilt_register(baresip_aufiltl(), &sndfile);
+
+	info("sndfile: saving %s %s files in %s (%u writer threads)\n",
+	     stereo ? "stereo" : "split", rec_format_ext(file_format),
+	     file_path, threads);
 
 	return 0;
 }
@@ -260,6 +357,13 @@ static int module_init(void)
 static int module_close(void)
 {
 	aufilt_unregister(&sndfile);
+	cmd_unregister(baresip_commands(), cmdv);
+
+	/* writes all queued samples */
+	rec_close();
+
+	mix_mtx = mem_deref(mix_mtx);
+
 	return 0;
 }
 
@@ -71,6 +71,8 @@ static int read_thread(void *arg)
 {
 	struct ausrc_st *st = arg;
 
+	media_thread_place(MEDIA_THREAD_AUDIO_DRV);
+
 	if (!sio_start(st->hdl)) {
 		warning("sndio: could not start record\n");
 		goto out;
@@ -96,6 +98,8 @@ static int write_thread(void *arg)
 	struct auplay_st *st = arg;
 	struct auframe af;
 
+	media_thread_place(MEDIA_THREAD_AUDIO_DRV);
+
 	if (!sio_start(st->hdl)) {
 		warning("sndio: could not start playback\n");
 		goto out;
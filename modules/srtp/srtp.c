@@ -40,6 +40,8 @@ struct menc_st {
 	/* base64_decoding worst case encoded 32+12 key */
 	uint8_t key_rx[46];
 	struct srtp *srtp_tx, *srtp_rx;
+	enum srtp_suite suite_tx, suite_rx;
+
 	RE_ATOMIC bool use_srtp;
 	bool got_sdp;
 	char *crypto_suite;
@@ -166,6 +168,10 @@ static int start_srtp(struct menc_st *st, const char *suite_name)
 
 	len = get_master_keylen(suite);
 
+	/* our key does not change, only a new suite needs a new context */
+	if (st->srtp_tx && st->suite_tx != suite)
+		st->srtp_tx = mem_deref(st->srtp_tx);
+
 	/* allocate and initialize the SRTP session */
 	if (!st->srtp_tx) {
 		err = srtp_alloc(&st->srtp_tx, suite, st->key_tx, len, 0);
@@ -173,6 +179,8 @@ static int start_srtp(struct menc_st *st, const char *suite_name)
 			warning("srtp: srtp_alloc TX failed (%m)\n", err);
 			return err;
 		}
+
+		st->suite_tx = suite;
 	}
 
 	if (!st->srtp_rx) {
@@ -181,6 +189,8 @@ static int start_srtp(struct menc_st *st, const char *suite_name)
 			warning("srtp: srtp_alloc RX failed (%m)\n", err);
 			return err;
 		}
+
+		st->suite_rx = suite;
 	}
 
 	/* use SRTP for this stream/session */
@@ -271,6 +281,32 @@ static int sdp_enc(struct menc_st *st, struct sdp_media *m,
 }
 
 
+/*
+ * The receive context is kept while the key and suite are unchanged, e.g.
+ * across re-INVITEs. A new key always gets a new context, with a fresh
+ * rollover counter and replay window, even if the peer goes back to a key
+ * it used before.
+ */
+static void rx_context_update(struct menc_st *st, const uint8_t *key,
+			      size_t len, enum srtp_suite suite)
+{
+	if (st->srtp_rx && st->suite_rx == suite &&
+	    0 == mem_seccmp(st->key_rx, key, len))
+		return;
+
+	if (st->srtp_rx) {
+		info("srtp: %s: re-keying in progress\n",
+		     stream_name(st->strm));
+	}
+
+	/* a new context is derived from the key */
+	st->srtp_rx = mem_deref(st->srtp_rx);
+
+	mem_secclean(st->key_rx, sizeof(st->key_rx));
+	memcpy(st->key_rx, key, len);
+}
+
+
 static int start_crypto(struct menc_st *st, const struct pl *key_info)
 {
 	size_t olen = 0, len = 0;
@@ -306,15 +342,9 @@ static int start_crypto(struct menc_st *st, const struct pl *key_info)
 		return ERANGE;
 	}
 
-	/* receiving key-info changed -> reset srtp_rx */
-	if (st->srtp_rx && mem_seccmp(st->key_rx, new_key,
-		sizeof(st->key_rx) > olen ? olen : sizeof(st->key_rx))) {
-		info("srtp: %s: re-keying in progress\n",
-			stream_name(st->strm));
-		st->srtp_rx = mem_deref(st->srtp_rx);
-	}
+	rx_context_update(st, new_key, olen,
+			  resolve_suite(st->crypto_suite));
 
-	memcpy(st->key_rx, new_key, olen);
 	mem_secclean(new_key, olen);
 	new_key = mem_deref(new_key);
 
@@ -356,11 +386,10 @@ static bool sdp_attr_handler(const char *name, const char *value, void *arg)
 	if (!cryptosuite_issupported(&c.suite))
 		return false;
 
-	/* receiving crypto-suite changed -> reset srtp_rx */
+	/* the contexts of a new crypto-suite are set up by start_crypto */
 	if (st->srtp_rx && pl_strcmp(&c.suite, st->crypto_suite)) {
 		info ("srtp (%s-rx): cipher suite changed from %s to %r\n",
 			stream_name(st->strm), st->crypto_suite, &c.suite);
-		st->srtp_rx = mem_deref(st->srtp_rx);
 	}
 
 	st->crypto_suite = mem_deref(st->crypto_suite);
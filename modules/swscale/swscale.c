@@ -76,23 +76,13 @@ static int encode_update(struct vidfilt_enc_st **stp, void **ctx,
 }
 
 
-static int encode_process(struct vidfilt_enc_st *st, struct vidframe *frame,
-			  uint64_t *timestamp)
+static int sws_convert(struct swscale_enc *enc, const struct vidframe *frame)
 {
-	struct swscale_enc *enc = (struct swscale_enc *)st;
 	enum AVPixelFormat avpixfmt, avpixfmt_dst;
 	const uint8_t *srcSlice[4];
 	uint8_t *dst[4];
 	int srcStride[4], dstStride[4];
 	int width, height, i, h;
-	int err = 0;
-	(void)timestamp;
-
-	if (!st)
-		return EINVAL;
-
-	if (!frame)
-		return 0;
 
 	width = frame->size.w;
 	height = frame->size.h;
@@ -134,16 +124,6 @@ static int encode_process(struct vidfilt_enc_st *st, struct vidframe *frame,
 		     enc->dst_size.w, enc->dst_size.h);
 	}
 
-	if (!enc->frame) {
-
-		err = vidframe_alloc(&enc->frame, enc->swscale_format,
-				     &enc->dst_size);
-		if (err) {
-			warning("swscale: vidframe_alloc error (%m)\n", err);
-			return err;
-		}
-	}
-
 	for (i=0; i<4; i++) {
 		srcSlice[i]  = frame->data[i];
 		srcStride[i] = frame->linesize[i];
@@ -158,6 +138,43 @@ static int encode_process(struct vidfilt_enc_st *st, struct vidframe *frame,
 		return EPROTO;
 	}
 
+	return 0;
+}
+
+
+static int encode_process(struct vidfilt_enc_st *st, struct vidframe *frame,
+			  uint64_t *timestamp)
+{
+	struct swscale_enc *enc = (struct swscale_enc *)st;
+	int i;
+	int err = 0;
+	(void)timestamp;
+
+	if (!st)
+		return EINVAL;
+
+	if (!frame)
+		return 0;
+
+	if (!enc->frame) {
+
+		err = vidframe_alloc(&enc->frame, enc->swscale_format,
+				     &enc->dst_size);
+		if (err) {
+			warning("swscale: vidframe_alloc error (%m)\n", err);
+			return err;
+		}
+	}
+
+	/* Pixel conversion without scaling uses the parallel converter */
+	if (vidsz_cmp(&frame->size, &enc->dst_size) &&
+	    vidconv_mt_supported(frame->fmt, enc->swscale_format))
+		err = vidconv_mt(enc->frame, frame);
+	else
+		err = sws_convert(enc, frame);
+	if (err)
+		return err;
+
 	/* Copy the converted frame back to the input frame */
 	for (i=0; i<4; i++) {
 		frame->data[i]     = enc->frame->data[i];
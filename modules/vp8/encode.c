@@ -21,6 +21,7 @@ enum {
 
 struct videnc_state {
 	vpx_codec_ctx_t ctx;
+	vpx_codec_enc_cfg_t cfg;
 	struct vidsz size;
 	unsigned fps;
 	unsigned bitrate;
@@ -141,6 +142,7 @@ static int open_encoder(struct videnc_state *ves, const struct vidsz *size)
 	}
 
 	ves->ctxup = true;
+	ves->cfg   = cfg;
 
 	res = vpx_codec_control(&ves->ctx, VP8E_SET_CPUUSED, cpuused);
 	if (res) {
@@ -156,6 +158,30 @@ static int open_encoder(struct videnc_state *ves, const struct vidsz *size)
 }
 
 
+int vp8_encode_bitrate(struct videnc_state *ves, uint32_t bitrate)
+{
+	vpx_codec_err_t res;
+
+	if (!ves)
+		return EINVAL;
+
+	ves->bitrate = bitrate;
+
+	if (!ves->ctxup)
+		return 0;
+
+	ves->cfg.rc_target_bitrate = bitrate / 1000; /* kbps */
+
+	res = vpx_codec_enc_config_set(&ves->ctx, &ves->cfg);
+	if (res) {
+		warning("vp8: enc config: %s\n", vpx_codec_err_to_string(res));
+		return EPROTO;
+	}
+
+	return 0;
+}
+
+
 static inline void hdr_encode(uint8_t hdr[HDR_SIZE], bool noref, bool start,
 			      uint8_t partid, uint16_t picid)
 {
@@ -38,6 +38,7 @@ static struct vp9_vidcodec vp9 = {
 		.dech      = vp9_decode,
 		.fmtp_ench = vp9_fmtp_enc,
 		.packetizeh = vp9_encode_packetize,
+		.bitrateh  = vp9_encode_bitrate,
 	},
 	.max_fs = 3600
 };
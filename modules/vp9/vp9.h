@@ -15,6 +15,7 @@ int vp9_encode_update(struct videnc_state **vesp, const struct vidcodec *vc,
 		      videnc_packet_h *pkth, const struct video *vid);
 int vp9_encode(struct videnc_state *ves, bool update,
 	       const struct vidframe *frame, uint64_t timestamp);
+int vp9_encode_bitrate(struct videnc_state *ves, uint32_t bitrate);
 int vp9_encode_packetize(struct videnc_state *ves,
 			 const struct vidpacket *pkt);
 
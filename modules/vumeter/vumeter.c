@@ -211,7 +211,8 @@ static struct aufilt vumeter = {
 	.encupdh = encode_update,
 	.ench    = encode,
 	.decupdh = decode_update,
-	.dech    = decode
+	.dech    = decode,
+	.flags   = AUFILT_INPLACE,
 };
 
 
@@ -124,7 +124,8 @@ static struct aufilt webrtc_aec = {
 	.encupdh = webrtc_aec_encode_update,
 	.ench    = webrtc_aec_encode,
 	.decupdh = webrtc_aec_decode_update,
-	.dech    = webrtc_aec_decode
+	.dech    = webrtc_aec_decode,
+	.flags   = AUFILT_S16 | AUFILT_FLOAT,
 };
 
 
@@ -84,14 +84,17 @@ struct autx {
 	struct ausrc_prm ausrc_prm;   /**< Audio Source parameters         */
 	const struct aucodec *ac;     /**< Current audio encoder           */
 	struct auenc_state *enc;      /**< Audio encoder state (optional)  */
+	char *params;                 /**< Encoder format parameters       */
 	struct aubuf *aubuf;          /**< Packetize outgoing stream       */
 	size_t aubuf_maxsz;           /**< Maximum aubuf size in [bytes]   */
 	volatile bool aubuf_started;  /**< Aubuf was started flag          */
 	struct list filtl;            /**< Audio filters in encoding order */
+	struct aufilt_arena *arena;   /**< Filter format conversion arena  */
 	struct mbuf *mb;              /**< Buffer for outgoing RTP packets */
 	char *module;                 /**< Audio source module name        */
 	char *device;                 /**< Audio source device name        */
 	void *sampv;                  /**< Sample buffer                   */
+	struct call_arena *carena;    /**< Call arena of sampv (optional)  */
 	uint32_t ptime;               /**< Packet time for sending         */
 	uint64_t ts_ext;              /**< Ext. Timestamp for outgoing RTP */
 	uint32_t ts_base;             /**< First timestamp sent            */
@@ -102,14 +105,23 @@ struct autx {
 	int cur_key;                  /**< Currently transmitted event     */
 	enum aufmt src_fmt;           /**< Sample format for audio source  */
 	enum aufmt enc_fmt;           /**< Sample format for encoder       */
+	int loss;                     /**< Packet loss of the peer [%]     */
+	int pt;                       /**< Payload type of the encoder     */
+	struct red_enc *red;          /**< RED encoder (optional)          */
+	int red_pt;                   /**< RED payload type, or -1         */
+	struct moh_sub *moh;          /**< Shared music-on-hold (optional) */
+	struct mbuf *moh_mb;          /**< Buffer for music-on-hold RTP    */
+	RE_ATOMIC bool moh_on;        /**< Music-on-hold replaces ausrc    */
+	bool moh_marker;              /**< Marker bit for music-on-hold    */
 
 	struct {
 		uint64_t aubuf_overrun;
 		uint64_t aubuf_underrun;
+		uint64_t dtx;         /**< Frames not sent (DTX)           */
 	} stats;
 
 	struct {
-		thrd_t tid;           /**< Audio transmit thread           */
+		struct media_worker *tid; /**< Audio transmit thread       */
 		RE_ATOMIC bool run;   /**< Audio transmit thread running   */
 	} thr;
 
@@ -142,6 +154,7 @@ struct audio {
 
 /* RFC 6464 */
 static const char *uri_aulevel = "urn:ietf:params:rtp-hdrext:ssrc-audio-level";
+static const char *red_name = "red";
 
 
 /**
@@ -175,15 +188,25 @@ static double autx_calc_seconds(const struct autx *autx)
 }
 
 
+static void moh_stop(struct autx *tx)
+{
+	/* no more frames after the subscription is gone */
+	tx->moh = mem_deref(tx->moh);
+	re_atomic_rlx_set(&tx->moh_on, false);
+}
+
+
 static void stop_tx(struct autx *tx, struct audio *a)
 {
 	if (!tx || !a)
 		return;
 
+	moh_stop(tx);
+
 	if (a->cfg.txmode == AUDIO_MODE_THREAD &&
 	    re_atomic_rlx(&tx->thr.run)) {
 		re_atomic_rlx_set(&tx->thr.run, false);
-		thrd_join(tx->thr.tid, NULL);
+		media_worker_join(tx->thr.tid);
 	}
 
 	/* audio source must be stopped first */
@@ -205,9 +228,15 @@ static void audio_destructor(void *arg)
 	aurecv_stop(a->aur);
 
 	mem_deref(a->tx.enc);
+	mem_deref(a->tx.params);
+	mem_deref(a->tx.red);
 	mem_deref(a->tx.aubuf);
 	mem_deref(a->tx.mb);
-	mem_deref(a->tx.sampv);
+	mem_deref(a->tx.moh_mb);
+	if (!a->tx.carena)
+		mem_deref(a->tx.sampv);
+	mem_deref(a->tx.carena);
+	mem_deref(a->tx.arena);
 	mem_deref(a->tx.module);
 	mem_deref(a->tx.device);
 
@@ -282,6 +311,65 @@ static int append_rtpext(struct audio *au, struct mbuf *mb,
 }
 
 
+/* Write the RTP header extensions, if any, after the RTP header space */
+static int rtpext_write(struct audio *a, struct mbuf *mb,
+			const struct auframe *af, size_t *ext_len)
+{
+	struct bundle *bun = stream_bundle(a->strm);
+	bool bundled = bundle_state(bun) != BUNDLE_NONE;
+	int err;
+
+	mb->pos = mb->end = STREAM_PRESZ;
+	*ext_len = 0;
+
+	if (!a->level_enabled && !bundled)
+		return 0;
+
+	/* skip the extension header */
+	mb->pos += RTPEXT_HDR_SIZE;
+
+	if (a->level_enabled) {
+		err = append_rtpext(a, mb, af->fmt, af->sampv, af->sampc);
+		if (err)
+			return err;
+	}
+
+	if (bundled) {
+		const char *mid = stream_mid(a->strm);
+
+		rtpext_encode(mb, bundle_extmap_mid(bun),
+			      str_len(mid), (void *)mid);
+	}
+
+	*ext_len = mb->pos - STREAM_PRESZ;
+
+	/* write the Extension header at the beginning */
+	mb->pos = STREAM_PRESZ;
+
+	err = rtpext_hdr_encode(mb, *ext_len - RTPEXT_HDR_SIZE);
+	if (err)
+		return err;
+
+	mb->pos = STREAM_PRESZ + *ext_len;
+	mb->end = STREAM_PRESZ + *ext_len;
+
+	return 0;
+}
+
+
+/* RFC 2198 -- the encoded frame is sent together with the previous ones */
+static int red_encode(struct autx *tx, size_t ext_len, uint32_t rtp_ts)
+{
+	int err;
+
+	tx->mb->pos = STREAM_PRESZ + ext_len;
+	err = red_enc_encode(tx->red, tx->mb, (uint8_t)tx->pt, rtp_ts);
+	tx->mb->pos = STREAM_PRESZ;
+
+	return err;
+}
+
+
 /*
  * Encode audio and send via stream
  *
@@ -290,8 +378,6 @@ static int append_rtpext(struct audio *au, struct mbuf *mb,
 static void encode_rtp_send(struct audio *a, struct autx *tx,
 			    struct auframe *af)
 {
-	struct bundle *bun = stream_bundle(a->strm);
-	bool bundled = bundle_state(bun) != BUNDLE_NONE;
 	size_t frame_size;  /* number of samples per channel */
 	size_t sampc_rtp;
 	size_t len;
@@ -303,6 +389,10 @@ static void encode_rtp_send(struct audio *a, struct autx *tx,
 	if (!tx->ac || !tx->ac->ench)
 		return;
 
+	/* the shared music-on-hold is sent instead */
+	if (re_atomic_rlx(&tx->moh_on))
+		return;
+
 	if (tx->ac->srate != af->srate || tx->ac->ch != af->ch) {
 		warning("audio: srate/ch of frame %u/%u vs audio codec %u/%u. "
 			"Use module auresamp!\n",
@@ -310,39 +400,9 @@ static void encode_rtp_send(struct audio *a, struct autx *tx,
 		return;
 	}
 
-	tx->mb->pos = tx->mb->end = STREAM_PRESZ;
-
-	if (a->level_enabled || bundled) {
-
-		/* skip the extension header */
-		tx->mb->pos += RTPEXT_HDR_SIZE;
-
-		if (a->level_enabled) {
-			err = append_rtpext(a, tx->mb, af->fmt,
-					    af->sampv, af->sampc);
-			if (err)
-				return;
-		}
-
-		if (bundled) {
-			const char *mid = stream_mid(a->strm);
-
-			rtpext_encode(tx->mb, bundle_extmap_mid(bun),
-				      str_len(mid), (void *)mid);
-		}
-
-		ext_len = tx->mb->pos - STREAM_PRESZ;
-
-		/* write the Extension header at the beginning */
-		tx->mb->pos = STREAM_PRESZ;
-
-		err = rtpext_hdr_encode(tx->mb, ext_len - RTPEXT_HDR_SIZE);
-		if (err)
-			return;
-
-		tx->mb->pos = STREAM_PRESZ + ext_len;
-		tx->mb->end = STREAM_PRESZ + ext_len;
-	}
+	err = rtpext_write(a, tx->mb, af, &ext_len);
+	if (err)
+		return;
 
 	len = mbuf_get_space(tx->mb);
 
@@ -362,6 +422,10 @@ static void encode_rtp_send(struct audio *a, struct autx *tx,
 		goto out;
 	}
 
+	/* discontinuous transmission, the frame is not sent */
+	if (!len && !ts_delta)
+		++tx->stats.dtx;
+
 	tx->mb->pos = STREAM_PRESZ;
 	tx->mb->end = STREAM_PRESZ + ext_len + len;
 
@@ -370,8 +434,14 @@ static void encode_rtp_send(struct audio *a, struct autx *tx,
 		uint32_t rtp_ts = tx->ts_ext & 0xffffffff;
 
 		if (len) {
+			int pt = -1;
+
 			mtx_lock(a->tx.mtx);
-			err = stream_send(a->strm, ext_len!=0, marker, -1,
+			if (tx->red_pt >= 0 && !ts_delta &&
+			    !red_encode(tx, ext_len, rtp_ts))
+				pt = tx->red_pt;
+
+			err = stream_send(a->strm, ext_len!=0, marker, pt,
 					  rtp_ts, tx->mb);
 			mtx_unlock(a->tx.mtx);
 			if (err)
@@ -405,6 +475,80 @@ static void encode_rtp_send(struct audio *a, struct autx *tx,
 }
 
 
+/*
+ * Send a frame of the shared music-on-hold stream, only the RTP header
+ * is specific to this stream
+ *
+ * @note This function has REAL-TIME properties
+ */
+static void moh_frame_handler(const struct auframe *af, bool marker,
+			      const uint8_t *buf, size_t len, void *arg)
+{
+	struct audio *a = arg;
+	struct autx *tx = &a->tx;
+	struct mbuf *mb = tx->moh_mb;
+	size_t ext_len;
+	int err;
+
+	if (len) {
+		err  = rtpext_write(a, mb, af, &ext_len);
+		err |= mbuf_write_mem(mb, buf, len);
+		if (err)
+			return;
+
+		mb->pos = STREAM_PRESZ;
+
+		mtx_lock(tx->mtx);
+		err = stream_send(a->strm, ext_len != 0,
+				  marker || tx->moh_marker, -1,
+				  tx->ts_ext & 0xffffffff, mb);
+		mtx_unlock(tx->mtx);
+		if (err)
+			return;
+
+		tx->moh_marker = false;
+	}
+
+	mtx_lock(tx->mtx);
+	tx->ts_ext += af->sampc * tx->ac->crate / tx->ac->srate / af->ch;
+	mtx_unlock(tx->mtx);
+}
+
+
+/* While on hold the shared music-on-hold replaces the audio source */
+static void moh_update(struct audio *a)
+{
+	struct autx *tx = &a->tx;
+	int err;
+
+	moh_stop(tx);
+
+	if (!a->hold || !tx->ac || !moh_enabled())
+		return;
+
+	if (!tx->moh_mb) {
+		tx->moh_mb = mbuf_alloc(STREAM_PRESZ + 1024);
+		if (!tx->moh_mb)
+			return;
+	}
+
+	tx->moh_marker = true;
+	re_atomic_rlx_set(&tx->moh_on, true);
+
+	/* the shared encoder must match the one of this call */
+	err = moh_subscribe(&tx->moh, tx->ac, tx->params, tx->ptime,
+			    moh_frame_handler, a);
+	if (err) {
+		warning("audio: music-on-hold failed (%m)\n", err);
+		re_atomic_rlx_set(&tx->moh_on, false);
+		return;
+	}
+
+	/* the audio source is not needed while on hold */
+	tx->ausrc = mem_deref(tx->ausrc);
+}
+
+
 /*
  * @note This function has REAL-TIME properties
  */
@@ -415,7 +559,6 @@ static void poll_aubuf_tx(struct audio *a)
 	int16_t *sampv = tx->sampv;
 	size_t sampc;
 	size_t sz;
-	struct le *le;
 	uint32_t srate;
 	uint8_t ch;
 	int err = 0;
@@ -433,23 +576,11 @@ static void poll_aubuf_tx(struct audio *a)
 	aubuf_read_auframe(tx->aubuf, &af);
 
 	/* Process exactly one audio-frame in list order */
-	for (le = tx->filtl.head; le; le = le->next) {
-		struct aufilt_enc_st *st = le->data;
-
-		if (st->af && st->af->ench)
-			err |= st->af->ench(st, &af);
-	}
+	err = aufilt_chain_encode(&tx->filtl, tx->arena, &af, tx->enc_fmt);
 	if (err) {
 		warning("audio: aufilter encode: %m\n", err);
 	}
 
-	if (af.fmt != tx->enc_fmt) {
-		warning("audio: tx: invalid sample formats (%s -> %s). %s\n",
-			aufmt_name(af.fmt), aufmt_name(tx->enc_fmt),
-			tx->enc_fmt == AUFMT_S16LE ? "Use module auconv!" : ""
-			);
-	}
-
 	/* Encode and send */
 	encode_rtp_send(a, tx, &af);
 }
@@ -641,6 +772,70 @@ static void stream_recv_handler(const struct rtp_header *hdr,
 }
 
 
+/*
+ * The encoder can adapt its in-band FEC to the loss seen by the peer.
+ * Only codecs with a loss handler are told, the handler must not touch
+ * the encoder state that the TX thread is using.
+ */
+static void audio_encoder_loss(struct audio *a, uint8_t fraction)
+{
+	struct autx *tx = &a->tx;
+	const struct aucodec *ac;
+	int loss = fraction * 100 / 256;
+
+	mtx_lock(tx->mtx);
+
+	ac = tx->ac;
+	if (ac && ac->lossh && tx->enc && loss != tx->loss) {
+		tx->loss = loss;
+		ac->lossh(tx->enc, loss);
+	}
+
+	mtx_unlock(tx->mtx);
+}
+
+
+static void rtcp_rr_handler(struct audio *a, const struct rtcp_rr *rrv,
+			    size_t rrc)
+{
+	uint32_t ssrc = rtp_sess_ssrc(stream_rtp_sock(a->strm));
+
+	if (!rrv)
+		return;
+
+	for (size_t i = 0; i < rrc; i++) {
+
+		if (rrv[i].ssrc == ssrc) {
+			audio_encoder_loss(a, rrv[i].fraction);
+			break;
+		}
+	}
+}
+
+
+static void rtcp_handler(struct stream *strm, struct rtcp_msg *msg, void *arg)
+{
+	struct audio *a = arg;
+	(void)strm;
+
+	MAGIC_CHECK(a);
+
+	switch (msg->hdr.pt) {
+
+	case RTCP_SR:
+		rtcp_rr_handler(a, msg->r.sr.rrv, msg->hdr.count);
+		break;
+
+	case RTCP_RR:
+		rtcp_rr_handler(a, msg->r.rr.rrv, msg->hdr.count);
+		break;
+
+	default:
+		break;
+	}
+}
+
+
 static int add_telev_codec(struct audio *a)
 {
 	struct sdp_media *m = stream_sdpmedia(audio_strm(a));
@@ -664,6 +859,56 @@ static int add_telev_codec(struct audio *a)
 }
 
 
+static int red_fmtp_print(struct re_printf *pf, const struct audio *a)
+{
+	const struct sdp_media *m = stream_sdpmedia(a->strm);
+	const struct sdp_format *fmt;
+	struct le *le;
+	int err = 0;
+
+	le = list_head(sdp_media_format_lst(m, true));
+	if (!le)
+		return 0;
+
+	fmt = le->data;
+
+	for (uint32_t i = 0; i <= a->cfg.red; i++)
+		err |= re_hprintf(pf, "%s%s", i ? "/" : "", fmt->id);
+
+	return err;
+}
+
+
+/**
+ * Offer redundant audio data (RFC 2198) for the preferred codec
+ *
+ * @param a Audio object
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+static int red_offer(struct audio *a)
+{
+	struct sdp_media *m = stream_sdpmedia(a->strm);
+	const struct sdp_format *fmt;
+	struct le *le;
+	int err;
+
+	le = list_head(sdp_media_format_lst(m, true));
+	if (!le)
+		return 0;
+
+	fmt = le->data;
+
+	err = red_enc_alloc(&a->tx.red, a->cfg.red);
+	if (err)
+		return err;
+
+	return sdp_format_add(NULL, m, false, NULL, red_name,
+			      fmt->srate, fmt->ch, NULL, NULL, NULL, false,
+			      "%H", red_fmtp_print, a);
+}
+
+
 /**
  * Allocate an audio stream
  *
@@ -728,12 +973,13 @@ int audio_alloc(struct audio **ap, struct list *streaml,
 			   stream_prm, &cfg->avt, sdp_sess,
 			   MEDIA_AUDIO,
 			   mnat, mnat_sess, menc, menc_sess, offerer,
-			   stream_recv_handler, NULL, stream_pt_handler,
-			   a);
+			   stream_recv_handler, rtcp_handler,
+			   stream_pt_handler, a);
 	if (err)
 		goto out;
 
-	err = aurecv_alloc(&a->aur, &a->cfg, AUDIO_SAMPSZ, ptime);
+	err = aurecv_alloc(&a->aur, &a->cfg, AUDIO_SAMPSZ, ptime,
+			   stream_prm->arena);
 	if (err)
 		goto out;
 
@@ -756,6 +1002,12 @@ int audio_alloc(struct audio **ap, struct list *streaml,
 			goto out;
 	}
 
+	if (a->cfg.red) {
+		err = red_offer(a);
+		if (err)
+			goto out;
+	}
+
 	err  = sdp_media_set_lattr(stream_sdpmedia(a->strm), true,
 				   "minptime", "%u", minptime);
 	err |= sdp_media_set_lattr(stream_sdpmedia(a->strm), true,
@@ -777,14 +1029,26 @@ int audio_alloc(struct audio **ap, struct list *streaml,
 	}
 
 	tx->mb = mbuf_alloc(STREAM_PRESZ + 4096);
-	tx->sampv = mem_zalloc(AUDIO_SAMPSZ * aufmt_sample_size(tx->enc_fmt),
-			       NULL);
+	if (stream_prm->arena) {
+		tx->sampv = call_arena_zalloc(stream_prm->arena, AUDIO_SAMPSZ *
+					      aufmt_sample_size(tx->enc_fmt));
+		if (tx->sampv)
+			tx->carena = mem_ref(stream_prm->arena);
+	}
+	else {
+		tx->sampv = mem_zalloc(AUDIO_SAMPSZ *
+				       aufmt_sample_size(tx->enc_fmt), NULL);
+	}
 
 	if (!tx->mb || !tx->sampv) {
 		err = ENOMEM;
 		goto out;
 	}
 
+	err = aufilt_arena_alloc(&tx->arena, AUDIO_SAMPSZ * sizeof(float));
+	if (err)
+		goto out;
+
 	if (acc && acc->autelev_pt)
 		a->cfg.telev_pt = acc->autelev_pt;
 
@@ -814,6 +1078,9 @@ int audio_alloc(struct audio **ap, struct list *streaml,
 	tx->ptime  = ptime;
 	tx->ts_ext = tx->ts_base = rand_u16();
 	tx->marker = true;
+	tx->loss   = -1;
+	tx->pt     = -1;
+	tx->red_pt = -1;
 
 	if (acc && acc->auplay_mod) {
 		err  = aurecv_set_module(a->aur, acc->auplay_mod);
@@ -854,6 +1121,8 @@ static int tx_thread(void *arg)
 	struct autx *tx = &a->tx;
 	uint64_t ts = 0;
 
+	media_thread_place(MEDIA_THREAD_AUDIO_TX);
+
 	mtx_lock(tx->mtx);
 	while (re_atomic_rlx(&tx->thr.run)) {
 		uint64_t now;
@@ -932,8 +1201,12 @@ static int autx_print_pipeline(struct re_printf *pf, const struct autx *autx)
 	for (le = list_head(&autx->filtl); le; le = le->next) {
 		struct aufilt_enc_st *st = le->data;
 
-		if (st->af->ench)
-			err |= re_hprintf(pf, " ---> %s", st->af->name);
+		if (!st->af->ench)
+			continue;
+
+		err |= re_hprintf(pf, " ---> %s", st->af->name);
+		if (st->ifmt >= 0)
+			err |= re_hprintf(pf, "(%s)", aufmt_name(st->ifmt));
 	}
 
 	err |= re_hprintf(pf, " ---> %s",
@@ -943,6 +1216,46 @@ static int autx_print_pipeline(struct re_printf *pf, const struct autx *autx)
 }
 
 
+/* Input format of each decode filter, negotiated in processing order */
+struct decfmt {
+	int ifmt;
+	int fmt;
+};
+
+
+static struct decfmt *decfmt_alloc(struct list *aufiltl,
+				   const struct aufilt_prm *plprm)
+{
+	struct decfmt *decfmtv;
+	int fmt = plprm->fmt;
+	unsigned i = list_count(aufiltl);
+	struct le *le;
+
+	decfmtv = mem_zalloc((i + 1) * sizeof(*decfmtv), NULL);
+	if (!decfmtv)
+		return NULL;
+
+	/* the decode chain runs in reverse order */
+	for (le = list_tail(aufiltl); le; le = le->prev) {
+		struct aufilt *af = le->data;
+		struct aufilt_prm prm = *plprm;
+
+		--i;
+
+		if (af->flags & AUFILT_CONV || !af->decupdh)
+			continue;
+
+		prm.fmt = fmt;
+		decfmtv[i].ifmt = aufilt_negotiate(af, &prm);
+		decfmtv[i].fmt  = prm.fmt;
+
+		fmt = prm.fmt;
+	}
+
+	return decfmtv;
+}
+
+
 /**
  * Setup the audio-filter chain
  *
@@ -956,8 +1269,10 @@ static int aufilt_setup(struct audio *a, struct list *aufiltl)
 {
 	struct aufilt_prm encprm, plprm;
 	struct autx *tx = &a->tx;
+	struct decfmt *decfmtv = NULL;
 	struct le *le;
 	bool update_enc, update_dec;
+	unsigned i = 0;
 	int err = 0;
 
 	/* wait until we have both Encoder and Decoder */
@@ -977,33 +1292,57 @@ static int aufilt_setup(struct audio *a, struct list *aufiltl)
 		plprm.ch = a->cfg.channels_play;
 	}
 
-	/* Audio filters */
-	for (le = list_head(aufiltl); le; le = le->next) {
+	if (update_dec) {
+		decfmtv = decfmt_alloc(aufiltl, &plprm);
+		if (!decfmtv)
+			return ENOMEM;
+	}
+
+	/*
+	 * Audio filters, each filter gets the format of the previous one,
+	 * so the formats only change where a filter needs it
+	 */
+	for (le = list_head(aufiltl); le; le = le->next, ++i) {
 		struct aufilt *af = le->data;
 		struct aufilt_enc_st *encst = NULL;
 		struct aufilt_dec_st *decst = NULL;
+		struct aufilt_prm prm;
 		void *ctx = NULL;
+		int ifmt;
+
+		/* format conversion is planned by the core */
+		if (af->flags & AUFILT_CONV)
+			continue;
 
 		if (af->encupdh && update_enc) {
-			err = af->encupdh(&encst, &ctx, af, &encprm, a);
+			prm  = encprm;
+			ifmt = aufilt_negotiate(af, &prm);
+			err  = af->encupdh(&encst, &ctx, af, &prm, a);
 			if (err) {
 				warning("audio: error in encode audio-filter"
 					" '%s' (%m)\n", af->name, err);
 			}
 			else {
-				encst->af = af;
+				encst->af   = af;
+				encst->ifmt = ifmt;
 				list_append(&tx->filtl, &encst->le, encst);
+
+				encprm.fmt = prm.fmt;
 			}
 		}
 
 		if (af->decupdh && update_dec) {
-			err = af->decupdh(&decst, &ctx, af, &plprm, a);
+			prm     = plprm;
+			prm.fmt = decfmtv[i].fmt;
+			ifmt    = decfmtv[i].ifmt;
+			err     = af->decupdh(&decst, &ctx, af, &prm, a);
 			if (err) {
 				warning("audio: error in decode audio-filter"
 					" '%s' (%m)\n", af->name, err);
 			}
 			else {
-				decst->af = af;
+				decst->af   = af;
+				decst->ifmt = ifmt;
 				aurecv_filt_append(a->aur, decst);
 			}
 		}
@@ -1015,6 +1354,8 @@ static int aufilt_setup(struct audio *a, struct list *aufiltl)
 		}
 	}
 
+	mem_deref(decfmtv);
+
 	return 0;
 }
 
@@ -1103,7 +1444,8 @@ static int start_source(struct autx *tx, struct audio *a, struct list *ausrcl)
 		case AUDIO_MODE_THREAD:
 			if (!re_atomic_rlx(&tx->thr.run)) {
 				re_atomic_rlx_set(&tx->thr.run, true);
-				err = thread_create_name(&tx->thr.tid,
+				err = media_worker_start(&tx->thr.tid,
+							 MEDIA_THREAD_AUDIO_TX,
 							 "Audio TX",
 							 tx_thread, a);
 				if (err) {
@@ -1295,6 +1637,50 @@ bool audio_started(const struct audio *a)
 }
 
 
+/**
+ * Negotiate redundant audio data (RFC 2198)
+ *
+ * RED is sent if the peer supports it with the clock rate of the encoder,
+ * and received with the local payload type.
+ *
+ * @param a Audio object
+ */
+static void red_update(struct audio *a)
+{
+	struct sdp_media *m = stream_sdpmedia(a->strm);
+	const struct sdp_format *lf, *rf;
+	struct autx *tx = &a->tx;
+	int pt_tx = -1, pt_rx = -1;
+	int err;
+
+	if (!tx->red)
+		return;
+
+	rf = sdp_media_rformat(m, red_name);
+	lf = sdp_media_format(m, true, NULL, -1, red_name, -1, -1);
+	if (rf && lf) {
+		pt_rx = lf->pt;
+
+		if (tx->ac && rf->srate == tx->ac->crate)
+			pt_tx = rf->pt;
+	}
+
+	mtx_lock(tx->mtx);
+	if (tx->pt < 0)
+		pt_tx = -1;
+
+	if (pt_tx >= 0 && pt_tx != tx->red_pt)
+		info("audio: redundant audio data (pt=%d)\n", pt_tx);
+
+	tx->red_pt = pt_tx;
+	mtx_unlock(tx->mtx);
+
+	err = stream_set_red(a->strm, pt_rx, aurecv_red(a->aur));
+	if (err)
+		warning("audio: red: receiver (%m)\n", err);
+}
+
+
 /**
  * Set the audio encoder used
  *
@@ -1309,6 +1695,7 @@ int audio_encoder_set(struct audio *a, const struct aucodec *ac,
 		      int pt_tx, const char *params)
 {
 	struct autx *tx;
+	bool moh_restart = false;
 	int err = 0;
 
 	if (!a || !ac)
@@ -1320,6 +1707,9 @@ int audio_encoder_set(struct audio *a, const struct aucodec *ac,
 		info("audio: Set audio encoder: %s %uHz %dch\n",
 		     ac->name, ac->srate, ac->ch);
 
+		/* music-on-hold of the new codec is subscribed below */
+		moh_stop(tx);
+
 		/* Should the source be stopped first? */
 		if (!aucodec_equal(ac, tx->ac)) {
 			tx->ausrc = mem_deref(tx->ausrc);
@@ -1327,8 +1717,24 @@ int audio_encoder_set(struct audio *a, const struct aucodec *ac,
 			aubuf_flush(tx->aubuf);
 		}
 
-		tx->enc = mem_deref(tx->enc);
-		tx->ac = ac;
+		mtx_lock(tx->mtx);
+		tx->enc  = mem_deref(tx->enc);
+		tx->ac   = ac;
+		tx->loss = -1;
+		mtx_unlock(tx->mtx);
+	}
+
+	if (0 != str_cmp(params ? params : "",
+			 tx->params ? tx->params : "")) {
+		tx->params = mem_deref(tx->params);
+		if (str_isset(params)) {
+			err = str_dup(&tx->params, params);
+			if (err)
+				return err;
+		}
+
+		/* music-on-hold is encoded with the new parameters */
+		moh_restart = tx->moh != NULL;
 	}
 
 	if (ac->encupdh) {
@@ -1347,14 +1753,20 @@ int audio_encoder_set(struct audio *a, const struct aucodec *ac,
 
 	mtx_lock(a->tx.mtx);
 	stream_update_encoder(a->strm, pt_tx);
+	tx->pt = pt_tx;
 	mtx_unlock(a->tx.mtx);
 
+	red_update(a);
+
 	telev_set_srate(a->telev, ac->crate);
 
 	/* use a codec-specific ptime */
 	if (ac->ptime)
 		tx->ptime = ac->ptime;
 
+	if (a->hold && (!tx->moh || moh_restart))
+		moh_update(a);
+
 	if (!tx->ausrc) {
 		err |= audio_start(a);
 	}
@@ -1572,6 +1984,8 @@ void audio_sdp_attr_decode(struct audio *a)
 				      "extmap",
 				      extmap_handler, a);
 	}
+
+	red_update(a);
 }
 
 
@@ -1661,6 +2075,15 @@ int audio_debug(struct re_printf *pf, const struct audio *a)
 			  aufmt_name(tx->src_fmt));
 	err |= re_hprintf(pf, "       time = %.3f sec\n",
 			  autx_calc_seconds(tx));
+	err |= re_hprintf(pf, "       filter conversions: %llu\n",
+			  aufilt_arena_convc(tx->arena));
+	err |= re_hprintf(pf, "       dtx: %llu frames, peer loss %d%%\n",
+			  tx->stats.dtx, tx->loss);
+	if (tx->red_pt >= 0) {
+		err |= re_hprintf(pf, "       red: pt=%d,"
+				  " %u previous frames\n",
+				  tx->red_pt, a->cfg.red);
+	}
 
 	err |= aurecv_debug(pf, a->aur);
 	err |= re_hprintf(pf,
@@ -1852,10 +2275,19 @@ bool audio_rxaubuf_started(const struct audio *au)
  */
 void audio_set_hold(struct audio *au, bool hold)
 {
-	if (!au)
+	if (!au || au->hold == hold)
 		return;
 
 	au->hold = hold;
+
+	moh_update(au);
+
+	/* restart the audio source, if it was stopped */
+	if (!hold && au->started) {
+		int err = start_source(&au->tx, au, baresip_ausrcl());
+		if (err)
+			warning("audio: resume source failed (%m)\n", err);
+	}
 }
 
 
@@ -4,6 +4,7 @@
  * Copyright (C) 2010 Alfred E. Heggestad
  */
 #include <re.h>
+#include <rem.h>
 #include <baresip.h>
 #include "core.h"
 
@@ -37,3 +38,274 @@ void aufilt_unregister(struct aufilt *af)
 
 	list_unlink(&af->le);
 }
+
+
+/*
+ * Double-buffered arena for one audio-filter chain.
+ *
+ * Format conversions ping-pong between the two buffers, so a frame is
+ * only moved when the next filter cannot process it in-place.
+ */
+struct aufilt_arena {
+	void *bufv[2];         /**< Conversion buffers           */
+	size_t szv[2];         /**< Buffer sizes in [bytes]      */
+	RE_ATOMIC uint64_t n_conv; /**< Number of conversions    */
+};
+
+
+static void arena_destructor(void *arg)
+{
+	struct aufilt_arena *arena = arg;
+
+	mem_deref(arena->bufv[0]);
+	mem_deref(arena->bufv[1]);
+}
+
+
+/**
+ * Allocate a conversion arena for an audio-filter chain
+ *
+ * @param arenap Pointer to allocated arena
+ * @param sz     Initial size of each buffer in [bytes]
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int aufilt_arena_alloc(struct aufilt_arena **arenap, size_t sz)
+{
+	struct aufilt_arena *arena;
+	int err = 0;
+
+	if (!arenap || !sz)
+		return EINVAL;
+
+	arena = mem_zalloc(sizeof(*arena), arena_destructor);
+	if (!arena)
+		return ENOMEM;
+
+	arena->bufv[0] = mem_zalloc(sz, NULL);
+	arena->bufv[1] = mem_zalloc(sz, NULL);
+	if (!arena->bufv[0] || !arena->bufv[1]) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	arena->szv[0] = arena->szv[1] = sz;
+
+ out:
+	if (err)
+		mem_deref(arena);
+	else
+		*arenap = arena;
+
+	return err;
+}
+
+
+/**
+ * Convert an audio frame to a new sample format using the arena
+ *
+ * The samples are written to the arena buffer that is not currently
+ * referenced by the frame. Nothing is done if the format already matches.
+ *
+ * @param arena Conversion arena
+ * @param af    Audio frame, updated on success
+ * @param fmt   Target sample format
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int aufilt_arena_conv(struct aufilt_arena *arena, struct auframe *af,
+		      enum aufmt fmt)
+{
+	size_t sz;
+	int i;
+
+	if (!arena || !af)
+		return EINVAL;
+
+	if (af->fmt == fmt)
+		return 0;
+
+	sz = aufmt_sample_size(fmt);
+	if (!sz || !aufmt_sample_size(af->fmt))
+		return ENOTSUP;
+
+	if (fmt != AUFMT_S16LE && fmt != AUFMT_FLOAT &&
+	    af->fmt != AUFMT_S16LE)
+		return ENOTSUP;
+
+	i = af->sampv == arena->bufv[0] ? 1 : 0;
+
+	/* only the target buffer may move, the frame can use the other */
+	if (af->sampc * sz > arena->szv[i]) {
+		void *buf = mem_realloc(arena->bufv[i], af->sampc * sz);
+		if (!buf)
+			return ENOMEM;
+
+		arena->bufv[i] = buf;
+		arena->szv[i]  = af->sampc * sz;
+	}
+
+	switch (fmt) {
+
+	case AUFMT_S16LE:
+		auconv_to_s16(arena->bufv[i], af->fmt, af->sampv, af->sampc);
+		break;
+
+	case AUFMT_FLOAT:
+		auconv_to_float(arena->bufv[i], af->fmt, af->sampv,
+				af->sampc);
+		break;
+
+	default:
+		auconv_from_s16(fmt, arena->bufv[i], af->sampv, af->sampc);
+		break;
+	}
+
+	af->sampv = arena->bufv[i];
+	af->fmt   = fmt;
+	re_atomic_rlx_add(&arena->n_conv, 1);
+
+	return 0;
+}
+
+
+/**
+ * Get the number of sample format conversions done by the arena
+ *
+ * @param arena Conversion arena
+ *
+ * @return Number of conversions
+ */
+uint64_t aufilt_arena_convc(struct aufilt_arena *arena)
+{
+	return arena ? re_atomic_rlx(&arena->n_conv) : 0;
+}
+
+
+/**
+ * Negotiate the input sample format of an audio filter
+ *
+ * The chain format in prm is kept if the filter supports it, so a chain
+ * of capable filters runs without any conversion.
+ *
+ * @param af  Audio Filter
+ * @param prm Filter parameters, format is updated to the negotiated one
+ *
+ * @return Sample format the core must deliver, or -1 for any format
+ */
+int aufilt_negotiate(const struct aufilt *af, struct aufilt_prm *prm)
+{
+	uint32_t fmts;
+
+	if (!af || !prm)
+		return -1;
+
+	fmts = af->flags & (AUFILT_S16 | AUFILT_FLOAT);
+	if (!fmts || af->flags & AUFILT_INPLACE)
+		return -1;
+
+	if (prm->fmt == AUFMT_S16LE && fmts & AUFILT_S16)
+		return AUFMT_S16LE;
+
+	if (prm->fmt == AUFMT_FLOAT && fmts & AUFILT_FLOAT)
+		return AUFMT_FLOAT;
+
+	prm->fmt = (fmts & AUFILT_S16) ? AUFMT_S16LE : AUFMT_FLOAT;
+
+	return prm->fmt;
+}
+
+
+/**
+ * Process one audio frame through an encode filter chain in list order
+ *
+ * All filters are run, errors are accumulated. The frame is converted to
+ * the negotiated filter formats and finally to the encoder format. A
+ * filter is skipped if the frame cannot be converted to its format.
+ *
+ * @param filtl List of encode filter states (struct aufilt_enc_st)
+ * @param arena Conversion arena of the chain
+ * @param af    Audio frame
+ * @param fmt   Encoder sample format
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int aufilt_chain_encode(struct list *filtl, struct aufilt_arena *arena,
+			struct auframe *af, enum aufmt fmt)
+{
+	struct le *le;
+	int err = 0;
+
+	if (!filtl || !af)
+		return EINVAL;
+
+	for (le = filtl->head; le; le = le->next) {
+		struct aufilt_enc_st *st = le->data;
+
+		/* convert only if the filter cannot take the frame as is */
+		if (st->ifmt >= 0) {
+			int e = aufilt_arena_conv(arena, af, st->ifmt);
+			if (e) {
+				err |= e;
+				continue;
+			}
+		}
+
+		if (st->af && st->af->ench)
+			err |= st->af->ench(st, af);
+	}
+
+	if (aufilt_arena_conv(arena, af, fmt)) {
+		warning("aufilt: encode: invalid sample formats (%s -> %s)\n",
+			aufmt_name(af->fmt), aufmt_name(fmt));
+		err |= ENOTSUP;
+	}
+
+	return err;
+}
+
+
+/**
+ * Process one audio frame through a decode filter chain in reverse order
+ *
+ * Processing stops at the first filter error. The frame is converted to
+ * the negotiated filter formats and finally to the playback format.
+ *
+ * @param filtl List of decode filter states (struct aufilt_dec_st)
+ * @param arena Conversion arena of the chain
+ * @param af    Audio frame
+ * @param fmt   Playback sample format
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int aufilt_chain_decode(struct list *filtl, struct aufilt_arena *arena,
+			struct auframe *af, enum aufmt fmt)
+{
+	struct le *le;
+	int err = 0;
+
+	if (!filtl || !af)
+		return EINVAL;
+
+	for (le = filtl->tail; le; le = le->prev) {
+		struct aufilt_dec_st *st = le->data;
+
+		/* convert only if the filter cannot take the frame as is */
+		if (st->ifmt >= 0)
+			err = aufilt_arena_conv(arena, af, st->ifmt);
+
+		if (!err && st->af && st->af->dech)
+			err = st->af->dech(st, af);
+
+		if (err)
+			return err;
+	}
+
+	err = aufilt_arena_conv(arena, af, fmt);
+	if (err) {
+		warning("aufilt: decode: invalid sample formats (%s -> %s)\n",
+			aufmt_name(af->fmt), aufmt_name(fmt));
+	}
+
+	return err;
+}
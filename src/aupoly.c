@@ -0,0 +1,554 @@
+/**
+ * @file aupoly.c  Polyphase audio resampler
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <math.h>
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define AUPOLY_SSE 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define AUPOLY_NEON 1
+#endif
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/**
+ * The resampler converts between arbitrary rational sample rates
+ * (e.g. 44100 <-> 48000) by interpolating with factor L, lowpass filtering
+ * and decimating with factor M, where L/M = orate/irate.
+ *
+ * The lowpass filter is a Kaiser windowed sinc, split into L polyphase
+ * branches. Only the branch needed for each output sample is evaluated.
+ * The filter bank only depends on the rate pair and is shared between all
+ * resamplers with the same irate/orate via a global cache.
+ */
+
+
+enum {
+	TAPS       =   64,  /**< Taps per phase for ratio <= 1      */
+	TAPS_MAX   =  768,  /**< Upper bound for steep decimation   */
+	PHASES_MAX = 4096,  /**< Upper bound of interpolation factor */
+	TAPS_ALIGN =    8,  /**< SIMD unroll, taps are a multiple   */
+};
+
+#define KAISER_BETA 8.0   /* approx. 80 dB stopband attenuation  */
+#define CUTOFF      0.46  /* Cutoff relative to the lower srate  */
+
+static const double PI = 3.14159265358979323846264338328;
+
+
+/** Polyphase filter bank for one rate pair */
+struct aupoly_bank {
+	struct le le;
+	uint32_t irate;    /**< Input sample rate in [Hz]              */
+	uint32_t orate;    /**< Output sample rate in [Hz]             */
+	uint32_t up;       /**< Interpolation factor L                 */
+	uint32_t down;     /**< Decimation factor M                    */
+	uint32_t taps;     /**< Taps per phase                         */
+	float *coeffv;     /**< up * taps coeffs, reversed per phase   */
+};
+
+/** Polyphase resampler state (one per stream) */
+struct aupoly {
+	struct aupoly_bank *bank;  /**< Shared filter bank              */
+	uint8_t ich;               /**< Input channels                  */
+	uint8_t och;               /**< Output channels                 */
+	uint8_t ch;                /**< Filtered channels               */
+	float *xv;                 /**< History + input, per channel    */
+	size_t stride;             /**< Samples per channel in xv       */
+	uint32_t pos;              /**< Index of newest tap sample      */
+	uint32_t phase;            /**< Current polyphase branch        */
+};
+
+
+static struct {
+	struct list bankl;
+	mtx_t *mtx;
+} cache;
+
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+
+static double bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0;
+
+	for (int k = 1; k < 64; k++) {
+		const double y = x / (2.0 * k);
+
+		term *= y * y;
+		sum  += term;
+
+		if (term < sum * 1e-12)
+			break;
+	}
+
+	return sum;
+}
+
+
+static void bank_destructor(void *arg)
+{
+	struct aupoly_bank *bank = arg;
+
+	list_unlink(&bank->le);
+	mem_deref(bank->coeffv);
+}
+
+
+static void bank_design(struct aupoly_bank *bank)
+{
+	const uint32_t n = bank->up * bank->taps;
+	const double ratio = min(1.0, (double)bank->orate / bank->irate);
+	const double fc = CUTOFF * ratio / bank->up;
+	const double center = (n - 1) / 2.0;
+	const double i0b = bessel_i0(KAISER_BETA);
+
+	for (uint32_t j = 0; j < n; j++) {
+		const double t = j - center;
+		const double r = t / center;
+		const uint32_t p = j % bank->up;
+		const uint32_t k = j / bank->up;
+		double s, w;
+
+		w = bessel_i0(KAISER_BETA * sqrt(max(0.0, 1.0 - r * r))) / i0b;
+
+		if (t == 0.0)
+			s = 2.0 * fc;
+		else
+			s = sin(2.0 * PI * fc * t) / (PI * t);
+
+		/* reversed per phase, so each branch is a plain dotproduct */
+		bank->coeffv[p * bank->taps + (bank->taps - 1 - k)] =
+			(float)(s * w * bank->up);
+	}
+}
+
+
+static int bank_alloc(struct aupoly_bank **bankp, uint32_t irate,
+		      uint32_t orate)
+{
+	struct aupoly_bank *bank;
+	uint32_t g, taps;
+
+	g = gcd(irate, orate);
+
+	bank = mem_zalloc(sizeof(*bank), bank_destructor);
+	if (!bank)
+		return ENOMEM;
+
+	bank->irate = irate;
+	bank->orate = orate;
+	bank->up    = orate / g;
+	bank->down  = irate / g;
+
+	/* stretch the kernel for decimation to keep the transition band */
+	taps = (uint32_t)((uint64_t)TAPS * max(bank->up, bank->down) /
+			  bank->up);
+	taps = (taps + TAPS_ALIGN - 1) & ~(uint32_t)(TAPS_ALIGN - 1);
+
+	if (bank->up > PHASES_MAX || taps > TAPS_MAX) {
+		mem_deref(bank);
+		return ENOTSUP;
+	}
+
+	bank->taps = taps;
+
+	bank->coeffv = mem_zalloc(bank->up * taps * sizeof(float), NULL);
+	if (!bank->coeffv) {
+		mem_deref(bank);
+		return ENOMEM;
+	}
+
+	bank_design(bank);
+
+	*bankp = bank;
+
+	return 0;
+}
+
+
+static int bank_get(struct aupoly_bank **bankp, uint32_t irate,
+		    uint32_t orate)
+{
+	struct aupoly_bank *bank = NULL;
+	struct le *le;
+	int err = 0;
+
+	/* without a cache every resampler owns its bank */
+	if (!cache.mtx)
+		return bank_alloc(bankp, irate, orate);
+
+	mtx_lock(cache.mtx);
+
+	for (le = list_head(&cache.bankl); le; le = le->next) {
+		struct aupoly_bank *b = le->data;
+
+		if (b->irate == irate && b->orate == orate) {
+			bank = b;
+			break;
+		}
+	}
+
+	if (!bank) {
+		err = bank_alloc(&bank, irate, orate);
+		if (err)
+			goto out;
+
+		list_append(&cache.bankl, &bank->le, bank);
+
+		debug("aupoly: new filter bank %u --> %u (L=%u M=%u, "
+		      "%u taps)\n", irate, orate,
+		      bank->up, bank->down, bank->taps);
+	}
+
+	*bankp = mem_ref(bank);
+
+ out:
+	mtx_unlock(cache.mtx);
+
+	return err;
+}
+
+
+static inline float dotprod(const float *a, const float *b, uint32_t n)
+{
+#if defined(AUPOLY_SSE)
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	float v[4];
+
+	for (uint32_t i = 0; i < n; i += 8) {
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i),
+						   _mm_loadu_ps(b + i)));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4),
+						   _mm_loadu_ps(b + i + 4)));
+	}
+
+	_mm_storeu_ps(v, _mm_add_ps(acc0, acc1));
+
+	return v[0] + v[1] + v[2] + v[3];
+#elif defined(AUPOLY_NEON)
+	float32x4_t acc0 = vdupq_n_f32(0.0f);
+	float32x4_t acc1 = vdupq_n_f32(0.0f);
+
+	for (uint32_t i = 0; i < n; i += 8) {
+		acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+		acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4),
+				 vld1q_f32(b + i + 4));
+	}
+
+	acc0 = vaddq_f32(acc0, acc1);
+
+	return vgetq_lane_f32(acc0, 0) + vgetq_lane_f32(acc0, 1) +
+	       vgetq_lane_f32(acc0, 2) + vgetq_lane_f32(acc0, 3);
+#else
+	float acc[TAPS_ALIGN] = {0};
+	float sum = 0.0f;
+
+	for (uint32_t i = 0; i < n; i += TAPS_ALIGN) {
+		for (uint32_t j = 0; j < TAPS_ALIGN; j++)
+			acc[j] += a[i + j] * b[i + j];
+	}
+
+	for (uint32_t j = 0; j < TAPS_ALIGN; j++)
+		sum += acc[j];
+
+	return sum;
+#endif
+}
+
+
+static inline int16_t saturate(float v)
+{
+	if (v >= 32767.0f)
+		return 32767;
+	if (v <= -32768.0f)
+		return -32768;
+
+	return (int16_t)lrintf(v);
+}
+
+
+static void aupoly_destructor(void *arg)
+{
+	struct aupoly *rs = arg;
+
+	mem_deref(rs->xv);
+	mem_deref(rs->bank);
+}
+
+
+static int xv_check_size(struct aupoly *rs, size_t frames)
+{
+	const size_t stride = rs->bank->taps - 1 + frames;
+	size_t hist = rs->bank->taps - 1;
+	float *xv;
+
+	if (stride <= rs->stride)
+		return 0;
+
+	xv = mem_zalloc(rs->ch * stride * sizeof(float), NULL);
+	if (!xv)
+		return ENOMEM;
+
+	if (rs->xv) {
+		for (uint8_t c = 0; c < rs->ch; c++) {
+			memcpy(&xv[c * stride], &rs->xv[c * rs->stride],
+			       hist * sizeof(float));
+		}
+	}
+
+	mem_deref(rs->xv);
+	rs->xv     = xv;
+	rs->stride = stride;
+
+	return 0;
+}
+
+
+/**
+ * Allocate a polyphase resampler
+ *
+ * @param rsp   Pointer to allocated resampler
+ * @param irate Input sample rate in [Hz]
+ * @param ich   Input channels
+ * @param orate Output sample rate in [Hz]
+ * @param och   Output channels
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int aupoly_alloc(struct aupoly **rsp, uint32_t irate, uint8_t ich,
+		 uint32_t orate, uint8_t och)
+{
+	struct aupoly *rs;
+	int err;
+
+	if (!rsp || !irate || !orate || !ich || !och)
+		return EINVAL;
+
+	if (ich != och && (ich > 2 || och > 2))
+		return ENOTSUP;
+
+	rs = mem_zalloc(sizeof(*rs), aupoly_destructor);
+	if (!rs)
+		return ENOMEM;
+
+	rs->ich = ich;
+	rs->och = och;
+	rs->ch  = min(ich, och);
+
+	err = bank_get(&rs->bank, irate, orate);
+	if (err)
+		goto out;
+
+	err = xv_check_size(rs, irate / 50);
+	if (err)
+		goto out;
+
+	rs->pos = rs->bank->taps - 1;
+
+ out:
+	if (err)
+		mem_deref(rs);
+	else
+		*rsp = rs;
+
+	return err;
+}
+
+
+/**
+ * Check if the resampler converts the given formats
+ *
+ * @param rs    Polyphase resampler
+ * @param irate Input sample rate in [Hz]
+ * @param ich   Input channels
+ * @param orate Output sample rate in [Hz]
+ * @param och   Output channels
+ *
+ * @return True if matching, otherwise false
+ */
+bool aupoly_match(const struct aupoly *rs, uint32_t irate, uint8_t ich,
+		  uint32_t orate, uint8_t och)
+{
+	if (!rs)
+		return false;
+
+	return rs->bank->irate == irate && rs->bank->orate == orate &&
+	       rs->ich == ich && rs->och == och;
+}
+
+
+/**
+ * Get the maximum number of output samples for a given input
+ *
+ * @param rs  Polyphase resampler
+ * @param inc Number of input samples (all channels)
+ *
+ * @return Maximum number of output samples (all channels)
+ */
+size_t aupoly_maxoutc(const struct aupoly *rs, size_t inc)
+{
+	size_t frames;
+
+	if (!rs)
+		return 0;
+
+	frames = inc / rs->ich;
+
+	return ((frames * rs->bank->up) / rs->bank->down + 1) * rs->och;
+}
+
+
+/**
+ * Clear the filter history and restart at phase zero
+ *
+ * @param rs  Polyphase resampler
+ */
+void aupoly_reset(struct aupoly *rs)
+{
+	if (!rs)
+		return;
+
+	memset(rs->xv, 0, rs->ch * rs->stride * sizeof(float));
+	rs->pos   = rs->bank->taps - 1;
+	rs->phase = 0;
+}
+
+
+/**
+ * Resample interleaved S16 audio
+ *
+ * @param rs   Polyphase resampler
+ * @param outv Output samples
+ * @param outc Size of output buffer, number of written samples on return
+ * @param inv  Input samples
+ * @param inc  Number of input samples (all channels)
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int aupoly_process(struct aupoly *rs, int16_t *outv, size_t *outc,
+		   const int16_t *inv, size_t inc)
+{
+	const struct aupoly_bank *bank;
+	size_t frames, hist, n = 0;
+	int err;
+
+	if (!rs || !outv || !outc || !inv)
+		return EINVAL;
+
+	bank   = rs->bank;
+	frames = inc / rs->ich;
+	hist   = bank->taps - 1;
+
+	if (*outc < aupoly_maxoutc(rs, inc))
+		return ENOMEM;
+
+	err = xv_check_size(rs, frames);
+	if (err)
+		return err;
+
+	/* deinterleave, stereo to mono is mixed before filtering */
+	if (rs->ich == 2 && rs->ch == 1) {
+		float *x = &rs->xv[hist];
+
+		for (size_t i = 0; i < frames; i++)
+			x[i] = 0.5f * ((float)inv[2*i] + (float)inv[2*i + 1]);
+	}
+	else {
+		for (uint8_t c = 0; c < rs->ch; c++) {
+			float *x = &rs->xv[c * rs->stride + hist];
+
+			for (size_t i = 0; i < frames; i++)
+				x[i] = inv[i * rs->ich + c];
+		}
+	}
+
+	while (rs->pos < hist + frames) {
+		const float *h = &bank->coeffv[rs->phase * bank->taps];
+		const size_t start = rs->pos - hist;
+
+		for (uint8_t c = 0; c < rs->ch; c++) {
+			const float *x = &rs->xv[c * rs->stride + start];
+
+			outv[n * rs->och + c] =
+				saturate(dotprod(h, x, bank->taps));
+		}
+
+		/* mono to stereo is duplicated after filtering */
+		for (uint8_t c = rs->ch; c < rs->och; c++)
+			outv[n * rs->och + c] = outv[n * rs->och];
+
+		++n;
+
+		rs->phase += bank->down;
+		rs->pos   += rs->phase / bank->up;
+		rs->phase %= bank->up;
+	}
+
+	rs->pos -= (uint32_t)frames;
+
+	for (uint8_t c = 0; c < rs->ch; c++) {
+		float *x = &rs->xv[c * rs->stride];
+
+		memmove(x, &x[frames], hist * sizeof(float));
+	}
+
+	*outc = n * rs->och;
+
+	return 0;
+}
+
+
+/**
+ * Print polyphase resampler debug info
+ *
+ * @param pf  Print function
+ * @param rs  Polyphase resampler
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int aupoly_debug(struct re_printf *pf, const struct aupoly *rs)
+{
+	if (!rs)
+		return 0;
+
+	return re_hprintf(pf, "aupoly: %u/%u --> %u/%u (L=%u M=%u, %u taps)",
+			  rs->bank->irate, rs->ich, rs->bank->orate, rs->och,
+			  rs->bank->up, rs->bank->down, rs->bank->taps);
+}
+
+
+int aupoly_init(void)
+{
+	if (cache.mtx)
+		return 0;
+
+	list_init(&cache.bankl);
+
+	return mutex_alloc(&cache.mtx);
+}
+
+
+void aupoly_close(void)
+{
+	list_flush(&cache.bankl);
+	cache.mtx = mem_deref(cache.mtx);
+}
@@ -30,6 +30,9 @@
 
 enum {
 	JITTER_EMA_COEFF   = 128,     /**< Jitter EMA coefficient            */
+	PLC_MAX            = 10,      /**< Max. concealed frames per gap     */
+	JITTER_FACTOR      = 3,       /**< Stretch target in jitter units    */
+	STRETCH_RATIO      = 20,      /**< Min. samples per stretched sample */
 };
 
 
@@ -44,10 +47,16 @@ struct audio_recv {
 	mtx_t *aubuf_mtx;             /**< Mutex for aubuf allocation        */
 	uint32_t ssrc;                /**< Incoming synchronization source   */
 	struct list filtl;            /**< Audio filters in decoding order   */
+	struct aufilt_arena *arena;   /**< Filter format conversion arena    */
+	struct red_dec *red;          /**< RED decoder (optional)            */
+	struct austretch *stretch;    /**< Time-stretcher (optional)         */
+	size_t stretch_wait;          /**< Samples until next stretch        */
 	void *sampv;                  /**< Sample buffer                     */
 	size_t sampvsz;               /**< Sample buffer size                */
+	struct call_arena *carena;    /**< Call arena of sampv (optional)    */
 	uint64_t t;                   /**< Last auframe push time            */
 	uint32_t ptime;               /**< Packet time for receiving [us]    */
+	uint32_t ts_frame;            /**< RTP timestamp units per frame     */
 
 	double level_last;            /**< Last audio level value [dBov]     */
 	bool level_set;               /**< True if level_last is set         */
@@ -57,6 +66,8 @@ struct audio_recv {
 
 	struct {
 		uint64_t n_discard;   /**< Nbr of discarded packets          */
+		uint64_t n_fec;       /**< Nbr of frames recovered with FEC  */
+		uint64_t n_plc;       /**< Nbr of concealed frames           */
 		RE_ATOMIC uint64_t latency;   /**< Latency in [ms]           */
 		int32_t jitter;       /**< Auframe push jitter [us]          */
 		int32_t dmax;         /**< Max deviation [us]                */
@@ -81,7 +92,12 @@ static void destructor(void *arg)
 	mem_deref(ar->dec);
 	mem_deref(ar->aubuf);
 	mem_deref(ar->aubuf_mtx);
-	mem_deref(ar->sampv);
+	if (!ar->carena)
+		mem_deref(ar->sampv);
+	mem_deref(ar->carena);
+	mem_deref(ar->arena);
+	mem_deref(ar->red);
+	mem_deref(ar->stretch);
 	mem_deref(ar->mtx);
 	list_flush(&ar->filtl);
 	mem_deref(ar->module);
@@ -91,20 +107,8 @@ static void destructor(void *arg)
 
 static int aurecv_process_decfilt(struct audio_recv *ar, struct auframe *af)
 {
-	int err = 0;
-
 	/* Process exactly one audio-frame in reverse list order */
-	for (struct le *le = ar->filtl.tail; le; le = le->prev) {
-		struct aufilt_dec_st *st = le->data;
-
-		if (st->af && st->af->dech)
-			err = st->af->dech(st, af);
-
-		if (err)
-			break;
-	}
-
-	return err;
+	return aufilt_chain_decode(&ar->filtl, ar->arena, af, ar->play_fmt);
 }
 
 
@@ -148,7 +152,8 @@ static int aurecv_alloc_aubuf(struct audio_recv *ar, const struct auframe *af)
 			err);
 	}
 
-	aubuf_set_mode(ar->aubuf, cfg->adaptive ?
+	/* the time-stretcher replaces the adaptive frame drop/insert */
+	aubuf_set_mode(ar->aubuf, cfg->adaptive && !cfg->stretch ?
 		       AUBUF_ADAPTIVE : AUBUF_FIXED);
 	aubuf_set_silence(ar->aubuf, cfg->silence);
 	mtx_unlock(ar->aubuf_mtx);
@@ -167,7 +172,7 @@ static int aurecv_push_aubuf(struct audio_recv *ar, const struct auframe *af)
 			return err;
 	}
 
-#ifndef RELEASE
+	/* the jitter is also the target of the time-stretcher */
 	int32_t d, da;
 	uint64_t t;
 	t = tmr_jiffies_usec();
@@ -179,17 +184,17 @@ static int aurecv_push_aubuf(struct audio_recv *ar, const struct auframe *af)
 	}
 
 	ar->t = t;
-#endif
+
 	err = aubuf_write_auframe(ar->aubuf, af);
 	if (err)
 		return err;
 
 	ar->srate = af->srate;
 	ar->ch    = af->ch;
-	ar->fmt   = af->fmt;
 
-	bpms = (uint64_t)ar->srate * ar->ch * aufmt_sample_size(ar->fmt) /
-	       1000;
+	/* the filter chain always delivers play_fmt to the aubuf */
+	bpms = (uint64_t)ar->srate * ar->ch *
+	       aufmt_sample_size(ar->play_fmt) / 1000;
 	if (bpms)
 		re_atomic_rlx_set(&ar->stats.latency,
 				  aubuf_cur_size(ar->aubuf) / bpms);
@@ -198,6 +203,71 @@ static int aurecv_push_aubuf(struct audio_recv *ar, const struct auframe *af)
 }
 
 
+static uint32_t aurecv_stretch_target(const struct audio_recv *ar)
+{
+	uint32_t target = JITTER_FACTOR * (uint32_t)ar->stats.jitter / 1000;
+
+	target = max(target, ar->cfg->buffer.min);
+
+	return min(target, ar->cfg->buffer.max);
+}
+
+
+/*
+ * Steer the audio buffer towards a target derived from the jitter, by
+ * removing or repeating one pitch period of the frame. This changes the
+ * playout rate by at most 1/STRETCH_RATIO, instead of dropping or
+ * inserting whole frames.
+ */
+static void aurecv_stretch(struct audio_recv *ar, struct auframe *af)
+{
+	uint64_t bpms, cur;
+	uint32_t target, ptime;
+	size_t n, outn;
+	bool compress;
+
+	if (!ar->stretch || !ar->aubuf || !af->sampc || !af->ch)
+		return;
+
+	n = af->sampc / af->ch;
+	if (ar->stretch_wait > n) {
+		ar->stretch_wait -= n;
+		return;
+	}
+
+	ar->stretch_wait = 0;
+
+	bpms = (uint64_t)af->srate * af->ch * aufmt_sample_size(af->fmt) /
+	       1000;
+	if (!bpms)
+		return;
+
+	cur    = aubuf_cur_size(ar->aubuf) / bpms;
+	ptime  = ar->ptime / 1000;
+	target = aurecv_stretch_target(ar);
+
+	if (cur > target + ptime)
+		compress = true;
+	else if (cur + ptime < target)
+		compress = false;
+	else
+		return;
+
+	/* not periodic enough, try again with the next frame */
+	if (austretch_process(ar->stretch, af, compress))
+		return;
+
+	outn = af->sampc / af->ch;
+	ar->stretch_wait = STRETCH_RATIO * (compress ? n - outn : outn - n);
+}
+
+
+/*
+ * Decode one frame. If lostc is not zero, the frame lostc packets before
+ * hdr/mb is missing and is concealed instead. The frame directly before
+ * the received packet is recovered from its in-band FEC data (if any),
+ * earlier frames are generated by the codec's packet loss concealment.
+ */
 static int aurecv_stream_decode(struct audio_recv *ar,
 				const struct rtp_header *hdr,
 				struct mbuf *mb, unsigned lostc, bool drop)
@@ -208,6 +278,7 @@ static int aurecv_stream_decode(struct audio_recv *ar,
 	int err = 0;
 	const struct aucodec *ac = ar->ac;
 	bool flush = ar->ssrc != hdr->ssrc;
+	uint32_t ts = hdr->ts;
 
 	/* No decoder set */
 	if (!ac)
@@ -215,17 +286,30 @@ static int aurecv_stream_decode(struct audio_recv *ar,
 
 	ar->ssrc = hdr->ssrc;
 
-	/* TODO: PLC */
 	if (lostc && ac->plch) {
+		const bool fec = lostc == 1;
+
+		/* frame size of the sender, the local ptime until known */
+		if (ar->ts_frame)
+			ts -= lostc * ar->ts_frame;
+		else
+			ts -= (uint32_t)(lostc * (uint64_t)ar->ptime *
+					 ac->crate / 1000000);
 
 		err = ac->plch(ar->dec,
 				   ar->fmt, ar->sampv, &sampc,
-				   mbuf_buf(mb), mbuf_get_left(mb));
+				   fec ? mbuf_buf(mb) : NULL,
+				   fec ? mbuf_get_left(mb) : 0);
 		if (err) {
-			warning("audio: %s codec decode %u bytes: %m\n",
+			warning("audio: %s codec plc %u bytes: %m\n",
 				ac->name, mbuf_get_left(mb), err);
 			goto out;
 		}
+
+		if (fec)
+			++ar->stats.n_fec;
+		else
+			++ar->stats.n_plc;
 	}
 	else if (mbuf_get_left(mb)) {
 
@@ -237,6 +321,11 @@ static int aurecv_stream_decode(struct audio_recv *ar,
 				ac->name, mbuf_get_left(mb), err);
 			goto out;
 		}
+
+		if (sampc && ac->ch && ac->srate) {
+			ar->ts_frame = (uint32_t)((uint64_t)sampc / ac->ch *
+						  ac->crate / ac->srate);
+		}
 	}
 	else {
 		/* no PLC in the codec, might be done in filters below */
@@ -244,7 +333,7 @@ static int aurecv_stream_decode(struct audio_recv *ar,
 	}
 
 	auframe_init(&af, ar->fmt, ar->sampv, sampc, ac->srate, ac->ch);
-	af.timestamp = ((uint64_t) hdr->ts) * AUDIO_TIMEBASE / ac->crate;
+	af.timestamp = ((uint64_t) ts) * AUDIO_TIMEBASE / ac->crate;
 
 	if (drop) {
 		aubuf_drop_auframe(ar->aubuf, &af);
@@ -258,6 +347,8 @@ static int aurecv_stream_decode(struct audio_recv *ar,
 	if (err)
 		goto out;
 
+	aurecv_stretch(ar, &af);
+
 	err = aurecv_push_aubuf(ar, &af);
  out:
 	return err;
@@ -287,7 +378,6 @@ void aurecv_receive(struct audio_recv *ar, const struct rtp_header *hdr,
 	bool discard = false;
 	bool drop = *ignore;
 	int wrap;
-	(void) lostc;
 
 	if (!mb)
 		return;
@@ -342,12 +432,12 @@ void aurecv_receive(struct audio_recv *ar, const struct rtp_header *hdr,
 		goto out;
 	}
 
-	/* TODO:  what if lostc > 1 ?*/
-	/* PLC should generate lostc frames here. Not only one.
-	 * aubuf should replace PLC frames with late arriving real frames.
-	 * It should use timestamp to decide if a frame should be replaced. */
-/*        if (lostc)*/
-/*                (void)aurecv_stream_decode(ar, hdr, mb, lostc, drop);*/
+	/* Conceal the lost frames in order, the last one from FEC data */
+	if (lostc && ar->ac && ar->ac->plch && !drop) {
+
+		for (unsigned i = min(lostc, (unsigned)PLC_MAX); i > 0; i--)
+			(void)aurecv_stream_decode(ar, hdr, mb, i, drop);
+	}
 
 	(void)aurecv_stream_decode(ar, hdr, mb, 0, drop);
 
@@ -397,7 +487,7 @@ uint64_t aurecv_latency(const struct audio_recv *ar)
 
 
 int aurecv_alloc(struct audio_recv **aupp, const struct config_audio *cfg,
-		 size_t sampc, uint32_t ptime)
+		 size_t sampc, uint32_t ptime, struct call_arena *arena)
 {
 	struct audio_recv *ar;
 	int err;
@@ -415,7 +505,13 @@ int aurecv_alloc(struct audio_recv **aupp, const struct config_audio *cfg,
 	ar->fmt   = cfg->dec_fmt;
 	ar->play_fmt = cfg->play_fmt;
 	ar->sampvsz = sampc * aufmt_sample_size(ar->fmt);
-	ar->sampv   = mem_zalloc(ar->sampvsz, NULL);
+	if (arena) {
+		ar->sampv  = call_arena_zalloc(arena, ar->sampvsz);
+		ar->carena = ar->sampv ? mem_ref(arena) : NULL;
+	}
+	else {
+		ar->sampv  = mem_zalloc(ar->sampvsz, NULL);
+	}
 	ar->ptime   = ptime * 1000;
 	ar->pt      = -1;
 	if (!ar->sampv) {
@@ -423,6 +519,22 @@ int aurecv_alloc(struct audio_recv **aupp, const struct config_audio *cfg,
 		goto out;
 	}
 
+	err = aufilt_arena_alloc(&ar->arena, sampc * sizeof(float));
+	if (err)
+		goto out;
+
+	if (cfg->red) {
+		err = red_dec_alloc(&ar->red);
+		if (err)
+			goto out;
+	}
+
+	if (cfg->stretch) {
+		err = austretch_alloc(&ar->stretch);
+		if (err)
+			goto out;
+	}
+
 	err  = mutex_alloc(&ar->mtx);
 	err |= mutex_alloc(&ar->aubuf_mtx);
 
@@ -465,6 +577,7 @@ int aurecv_decoder_set(struct audio_recv *ar,
 	if (ac != ar->ac) {
 		ar->ac = ac;
 		ar->dec = mem_deref(ar->dec);
+		ar->ts_frame = 0;
 	}
 
 	if (ac->decupdh) {
@@ -547,6 +660,20 @@ double aurecv_level(const struct audio_recv *ar)
 }
 
 
+/**
+ * Get the RED decoder, it is used by the RTP receiver before the jitter
+ * buffer
+ *
+ * @param ar Audio receiver
+ *
+ * @return RED decoder, NULL if redundancy is not enabled
+ */
+struct red_dec *aurecv_red(const struct audio_recv *ar)
+{
+	return ar ? ar->red : NULL;
+}
+
+
 const struct aucodec *aurecv_codec(const struct audio_recv *ar)
 {
 	const struct aucodec *ac;
@@ -736,8 +863,8 @@ int aurecv_debug(struct re_printf *pf, const struct audio_recv *ar)
 	}
 
 	mtx_lock(ar->mtx);
-	bpms = (double)ar->srate * ar->ch * aufmt_sample_size(ar->fmt) /
-	       1000.0;
+	bpms = (double)ar->srate * ar->ch *
+	       aufmt_sample_size(ar->play_fmt) / 1000.0;
 	err  = mbuf_printf(mb,
 			   " rx:   decode: %H %s\n",
 			   aucodec_print, ar->ac,
@@ -757,6 +884,19 @@ int aurecv_debug(struct re_printf *pf, const struct audio_recv *ar)
 #endif
 	err |= mbuf_printf(mb, "       n_discard: %llu\n",
 			   ar->stats.n_discard);
+	err |= mbuf_printf(mb, "       concealed: %llu fec, %llu plc\n",
+			   ar->stats.n_fec, ar->stats.n_plc);
+	if (ar->red) {
+		err |= mbuf_printf(mb, "       red: %H\n",
+				   red_dec_debug, ar->red);
+	}
+	if (ar->stretch) {
+		err |= mbuf_printf(mb, "       stretch: %H (target %ums)\n",
+				   austretch_debug, ar->stretch,
+				   aurecv_stretch_target(ar));
+	}
+	err |= mbuf_printf(mb, "       filter conversions: %llu\n",
+			   aufilt_arena_convc(ar->arena));
 	if (ar->level_set) {
 		err |= mbuf_printf(mb, "       level %.3f dBov\n",
 				   ar->level_last);
@@ -805,8 +945,12 @@ int aurecv_print_pipeline(struct re_printf *pf, const struct audio_recv *ar)
 	for (le = list_head(&ar->filtl); le; le = le->next) {
 		struct aufilt_dec_st *st = le->data;
 
-		if (st->af->dech)
-			err |= mbuf_printf(mb, " <--- %s", st->af->name);
+		if (!st->af->dech)
+			continue;
+
+		err |= mbuf_printf(mb, " <--- %s", st->af->name);
+		if (st->ifmt >= 0)
+			err |= mbuf_printf(mb, "(%s)", aufmt_name(st->ifmt));
 	}
 	mtx_unlock(ar->mtx);
 
@@ -0,0 +1,345 @@
+/**
+ * @file austretch.c  Audio time-stretching for the receive buffer
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <math.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+
+
+/**
+ * A frame is shortened or lengthened by one pitch period, in the style of
+ * WSOLA/PSOLA without a look-ahead buffer, so no delay is added:
+ *
+ \verbatim
+   compress:  [ A | B | C ... ]  ->  [ A x B | C ... ]
+   expand:    [ A | B | C ... ]  ->  [ A | B x A | B | C ... ]
+ \endverbatim
+ *
+ * A and B are two consecutive segments of the pitch period L, x is a
+ * linear crossfade. The period is searched with the normalized
+ * cross-correlation on a mono signal decimated to about 8 kHz, and refined
+ * at the full rate. Frames which are not periodic enough are left as they
+ * are, except for silence which can always be stretched.
+ */
+
+
+enum {
+	ANALYSIS_RATE = 8000,    /**< Sample rate of the coarse search [Hz] */
+	LAG_MIN_US    = 2500,    /**< Shortest pitch period (400 Hz) [us]   */
+	LAG_MAX_US    = 15000,   /**< Longest pitch period (66 Hz) [us]     */
+};
+
+#define CORR_MIN 0.8f    /* Min. correlation of the two periods      */
+#define SILENCE  1e-5f   /* Mean square below -50 dBFS is silence    */
+
+
+struct austretch {
+	float *inv;              /**< Input frame, interleaved          */
+	float *monov;            /**< Input frame, mono                 */
+	float *decv;             /**< Decimated mono for the search     */
+	void *outv;              /**< Output frame                      */
+	size_t sampc;            /**< Capacity of the input buffers     */
+	uint64_t n_compress;     /**< Compressed frames                 */
+	uint64_t n_expand;       /**< Expanded frames                   */
+	uint64_t n_skip;         /**< Frames not periodic enough        */
+	int64_t delta;           /**< Net added samples per channel     */
+};
+
+
+static void destructor(void *arg)
+{
+	struct austretch *st = arg;
+
+	mem_deref(st->inv);
+	mem_deref(st->monov);
+	mem_deref(st->decv);
+	mem_deref(st->outv);
+}
+
+
+/**
+ * Allocate a time-stretcher
+ *
+ * @param stp Pointer to allocated time-stretcher
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int austretch_alloc(struct austretch **stp)
+{
+	struct austretch *st;
+
+	if (!stp)
+		return EINVAL;
+
+	st = mem_zalloc(sizeof(*st), destructor);
+	if (!st)
+		return ENOMEM;
+
+	*stp = st;
+
+	return 0;
+}
+
+
+static int buffers_alloc(struct austretch *st, size_t sampc)
+{
+	if (sampc <= st->sampc)
+		return 0;
+
+	st->inv   = mem_deref(st->inv);
+	st->monov = mem_deref(st->monov);
+	st->decv  = mem_deref(st->decv);
+	st->outv  = mem_deref(st->outv);
+	st->sampc = 0;
+
+	st->inv   = mem_alloc(sampc * sizeof(float), NULL);
+	st->monov = mem_alloc(sampc * sizeof(float), NULL);
+	st->decv  = mem_alloc(sampc * sizeof(float), NULL);
+
+	/* expanded by up to half a frame */
+	st->outv  = mem_alloc((sampc + sampc / 2) * sizeof(float), NULL);
+
+	if (!st->inv || !st->monov || !st->decv || !st->outv)
+		return ENOMEM;
+
+	st->sampc = sampc;
+
+	return 0;
+}
+
+
+static void frame_load(struct austretch *st, const struct auframe *af,
+		       size_t n)
+{
+	const size_t sampc = n * af->ch;
+
+	if (af->fmt == AUFMT_S16LE) {
+		const int16_t *v = af->sampv;
+
+		for (size_t i = 0; i < sampc; i++)
+			st->inv[i] = v[i] * (1.0f / 32768.0f);
+	}
+	else {
+		memcpy(st->inv, af->sampv, sampc * sizeof(float));
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		float sum = 0;
+
+		for (uint8_t c = 0; c < af->ch; c++)
+			sum += st->inv[i * af->ch + c];
+
+		st->monov[i] = sum / af->ch;
+	}
+}
+
+
+static float ncorr(const float *a, const float *b, size_t len)
+{
+	float ab = 0, aa = 0, bb = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		ab += a[i] * b[i];
+		aa += a[i] * a[i];
+		bb += b[i] * b[i];
+	}
+
+	return ab / sqrtf(aa * bb + 1e-20f);
+}
+
+
+/* Find the pitch period in samples per channel, 0 if not periodic */
+static size_t find_lag(struct austretch *st, size_t n, uint32_t srate)
+{
+	const size_t d = max(srate / ANALYSIS_RATE, 1u);
+	const size_t lag_min = (size_t)srate * LAG_MIN_US / 1000000;
+	const size_t m = n / d;
+	size_t lag_max = (size_t)srate * LAG_MAX_US / 1000000;
+	size_t best_lag = 0, lo, hi;
+	float best = -1, energy = 0;
+
+	lag_max = min(lag_max, n / 2);
+
+	if (lag_min / d < 1 || lag_max / d <= lag_min / d)
+		return 0;
+
+	for (size_t i = 0; i < n; i++)
+		energy += st->monov[i] * st->monov[i];
+
+	if (energy / n < SILENCE)
+		return lag_max;
+
+	for (size_t j = 0; j < m; j++) {
+		float sum = 0;
+
+		for (size_t k = 0; k < d; k++)
+			sum += st->monov[j * d + k];
+
+		st->decv[j] = sum;
+	}
+
+	for (size_t l = lag_min / d; l <= lag_max / d; l++) {
+		const float c = ncorr(st->decv, &st->decv[l], l);
+
+		if (c > best) {
+			best = c;
+			best_lag = l;
+		}
+	}
+
+	if (best < CORR_MIN)
+		return 0;
+
+	/* refine at the full rate */
+	lo = max(best_lag * d - (d - 1), lag_min);
+	hi = min(best_lag * d + (d - 1), lag_max);
+	best = -1;
+
+	for (size_t l = lo; l <= hi; l++) {
+		const float c = ncorr(st->monov, &st->monov[l], l);
+
+		if (c > best) {
+			best = c;
+			best_lag = l;
+		}
+	}
+
+	return best_lag;
+}
+
+
+static void sample_put(void *outv, enum aufmt fmt, size_t i, float v)
+{
+	if (fmt == AUFMT_S16LE) {
+		v *= 32768.0f;
+		v = v > 32767.0f ? 32767.0f : v < -32768.0f ? -32768.0f : v;
+
+		((int16_t *)outv)[i] = (int16_t)lrintf(v);
+	}
+	else {
+		((float *)outv)[i] = v;
+	}
+}
+
+
+static size_t frame_compress(struct austretch *st, enum aufmt fmt, uint8_t ch,
+			     size_t n, size_t lag)
+{
+	const float *x = st->inv;
+	size_t o = 0;
+
+	for (size_t i = 0; i < lag; i++) {
+		const float w = (i + 0.5f) / lag;
+
+		for (uint8_t c = 0; c < ch; c++) {
+			const float a = x[i * ch + c];
+			const float b = x[(lag + i) * ch + c];
+
+			sample_put(st->outv, fmt, o++, a + (b - a) * w);
+		}
+	}
+
+	for (size_t i = 2 * lag * ch; i < n * ch; i++)
+		sample_put(st->outv, fmt, o++, x[i]);
+
+	return n - lag;
+}
+
+
+static size_t frame_expand(struct austretch *st, enum aufmt fmt, uint8_t ch,
+			   size_t n, size_t lag)
+{
+	const float *x = st->inv;
+	size_t o = 0;
+
+	for (size_t i = 0; i < lag * ch; i++)
+		sample_put(st->outv, fmt, o++, x[i]);
+
+	for (size_t i = 0; i < lag; i++) {
+		const float w = (i + 0.5f) / lag;
+
+		for (uint8_t c = 0; c < ch; c++) {
+			const float b = x[(lag + i) * ch + c];
+			const float a = x[i * ch + c];
+
+			sample_put(st->outv, fmt, o++, b + (a - b) * w);
+		}
+	}
+
+	for (size_t i = lag * ch; i < n * ch; i++)
+		sample_put(st->outv, fmt, o++, x[i]);
+
+	return n + lag;
+}
+
+
+/**
+ * Shorten or lengthen an audio frame by one pitch period
+ *
+ * On success the frame points to the output buffer of the time-stretcher,
+ * which is valid until the next call.
+ *
+ * @param st       Time-stretcher
+ * @param af       Audio frame (S16LE or FLOAT)
+ * @param compress True to shorten, false to lengthen the frame
+ *
+ * @return 0 if success, ENOENT if the frame is not periodic enough,
+ *         otherwise errorcode
+ */
+int austretch_process(struct austretch *st, struct auframe *af,
+		      bool compress)
+{
+	size_t n, lag, outn;
+	int err;
+
+	if (!st || !af || !af->ch || !af->srate)
+		return EINVAL;
+
+	if (af->fmt != AUFMT_S16LE && af->fmt != AUFMT_FLOAT)
+		return ENOTSUP;
+
+	n = af->sampc / af->ch;
+
+	err = buffers_alloc(st, af->sampc);
+	if (err)
+		return err;
+
+	frame_load(st, af, n);
+
+	lag = find_lag(st, n, af->srate);
+	if (!lag) {
+		++st->n_skip;
+		return ENOENT;
+	}
+
+	if (compress) {
+		outn = frame_compress(st, af->fmt, af->ch, n, lag);
+		st->delta -= (int64_t)lag;
+		++st->n_compress;
+	}
+	else {
+		outn = frame_expand(st, af->fmt, af->ch, n, lag);
+		st->delta += (int64_t)lag;
+		++st->n_expand;
+	}
+
+	af->sampv = st->outv;
+	af->sampc = outn * af->ch;
+
+	return 0;
+}
+
+
+int austretch_debug(struct re_printf *pf, const struct austretch *st)
+{
+	if (!st)
+		return 0;
+
+	return re_hprintf(pf, "%llu compressed, %llu expanded, %llu skipped"
+			  " (net %lld samples)",
+			  st->n_compress, st->n_expand, st->n_skip, st->delta);
+}
@@ -80,6 +80,9 @@ static const struct cmd corecmdv[] = {
 	{"quit", 'q', 0, "Quit",                     cmd_quit             },
 	{"insmod", 0, CMD_PRM, "Load module",        insmod_handler       },
 	{"rmmod",  0, CMD_PRM, "Unload module",      rmmod_handler        },
+	{"vidconv", 0, 0,      "Video converter",    vidconv_mt_debug     },
+	{"moh",     0, 0,      "Music on hold",      moh_debug            },
+	{"rxpool",  0, 0,      "RTP receive workers", rxpool_debug        },
 };
 
 
@@ -116,6 +119,29 @@ int baresip_init(struct config *cfg)
 		return err;
 	}
 
+	err = aupoly_init();
+	if (err)
+		return err;
+
+	err = vidconv_mt_init(cfg->video.conv_threads);
+	if (err) {
+		warning("baresip: video converter init failed: %m\n", err);
+		return err;
+	}
+
+	err = media_worker_init();
+	if (err)
+		return err;
+
+	if (cfg->avt.rxmode == RECEIVE_MODE_POOL) {
+		err = rxpool_init(cfg->avt.rxworkers);
+		if (err) {
+			warning("baresip: RTP receive pool init failed: %m\n",
+				err);
+			return err;
+		}
+	}
+
 	err = contact_init(&baresip.contacts);
 	if (err)
 		return err;
@@ -156,6 +182,12 @@ void baresip_close(void)
 
 	baresip.net = mem_deref(baresip.net);
 
+	aupoly_close();
+	vidconv_mt_close();
+	rxpool_close();
+	media_worker_close();
+	call_arena_flush();
+
 	ui_reset(&baresip.uis);
 }
 
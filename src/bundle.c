@@ -4,18 +4,64 @@
  * Copyright (C) 2020 Alfred E. Heggestad
  */
 
+#include <string.h>
 #include <re.h>
 #include <baresip.h>
 #include "core.h"
 
 
 static const char uri_mid[] = "urn:ietf:params:rtp-hdrext:sdes:mid";
+static const char uri_rid[] =
+	"urn:ietf:params:rtp-hdrext:sdes:rtp-stream-id";
 
 
+enum {
+	SSRC_HASH_SIZE = 16,
+	PEND_MAX       = 64,      /* Max. buffered packets of unknown SSRC */
+	PEND_TIMEOUT   = 500,     /* Max. time in the buffer [ms]          */
+};
+
+
+/*
+ * Demultiplexing on the base stream: the SSRC is taken from the packet
+ * header and looked up in a hash table. An unknown SSRC is resolved once
+ * with the signaled SSRCs of the streams, the MID or the RID header
+ * extension. Until then its RTP packets are buffered for a short time.
+ */
 struct bundle {
 	struct udp_helper *uh;
 	enum bundle_state state;
 	uint8_t extmap_mid;         /* Range 1-14  */
+	const struct list *streaml; /* Bundled streams (base only)      */
+	struct hash *ssrch;         /* SSRC to stream (base only)       */
+	struct list ssrcl;          /* SSRCs demuxed to this stream     */
+	struct list pendl;          /* Packets with unknown SSRC        */
+	uint32_t n_pend;            /* Number of buffered packets       */
+	struct {
+		uint64_t n_learn;   /* SSRCs learned                    */
+		uint64_t n_pend;    /* Packets buffered                 */
+		uint64_t n_drop;    /* Packets dropped, SSRC unknown    */
+	} stats;
+};
+
+/*
+ * An SSRC entry is owned by the hash table of the base stream and is
+ * also linked to the bundle of its stream. It is removed with either of
+ * them, so it never points to a destroyed stream.
+ */
+struct ssrc_entry {
+	struct le he;               /* Member of the SSRC hash table    */
+	struct le le;               /* Member of the stream's SSRC list */
+	uint32_t ssrc;
+	struct stream *strm;
+};
+
+struct pending {
+	struct le le;
+	struct sa src;
+	struct mbuf *mb;
+	uint32_t ssrc;
+	uint64_t t;
 };
 
 
@@ -24,6 +70,31 @@ static void destructor(void *data)
 	struct bundle *bun = data;
 
 	mem_deref(bun->uh);
+	hash_flush(bun->ssrch);
+	mem_deref(bun->ssrch);
+	list_flush(&bun->pendl);
+
+	/* the stream is gone, remove it from the table of the base */
+	while (bun->ssrcl.head)
+		mem_deref(bun->ssrcl.head->data);
+}
+
+
+static void ssrc_entry_destructor(void *data)
+{
+	struct ssrc_entry *ent = data;
+
+	hash_unlink(&ent->he);
+	list_unlink(&ent->le);
+}
+
+
+static void pending_destructor(void *data)
+{
+	struct pending *pend = data;
+
+	list_unlink(&pend->le);
+	mem_deref(pend->mb);
 }
 
 
@@ -146,14 +217,21 @@ int bundle_sdp_decode(struct sdp_session *sdp, struct list *streaml)
 int bundle_set_extmap(struct bundle *bun, struct sdp_media *sdp,
 		      uint8_t extmap_mid)
 {
+	bool replace;
 	int err;
 
 	if (!sdp || !bun)
 		return EINVAL;
 
+	if (extmap_mid == bun->extmap_mid)
+		return 0;
+
+	/* the first extmap keeps other header extensions of the media */
+	replace = bun->extmap_mid != 0;
+
 	bun->extmap_mid = extmap_mid;
 
-	err = sdp_media_set_lattr(sdp, true, "extmap",
+	err = sdp_media_set_lattr(sdp, replace, "extmap",
 				  "%u %s", bun->extmap_mid, uri_mid);
 
 	return err;
@@ -225,6 +303,7 @@ int bundle_sdp_encode(struct sdp_session *sdp, const struct list *streaml)
 }
 
 
+/* signaled or already received SSRC of the stream */
 static struct stream *lookup_remote_ssrc(const struct list *streaml,
 					 uint32_t ssrc)
 {
@@ -245,47 +324,6 @@ static struct stream *lookup_remote_ssrc(const struct list *streaml,
 }
 
 
-static int get_rtcp_ssrc(const struct rtcp_msg *msg, uint32_t *ssrcp)
-{
-	uint32_t ssrc;
-
-	switch (msg->hdr.pt) {
-
-	case RTCP_APP:
-		ssrc = msg->r.app.src;
-		break;
-
-	case RTCP_SR:
-		ssrc = msg->r.sr.ssrc;
-		break;
-
-	case RTCP_SDES:
-		ssrc = msg->r.sdesv->src;
-		break;
-
-	case RTCP_PSFB:
-		ssrc = msg->r.fb.ssrc_packet;
-		break;
-
-	case RTCP_BYE:
-		ssrc = msg->r.bye.srcv[0];
-		break;
-
-	case RTCP_RR:
-		ssrc = msg->r.rr.ssrc;
-		break;
-
-	default:
-		warning("bundle: rtcp not sup (pt=%d)\n", msg->hdr.pt);
-		return ENOTSUP;
-	}
-
-	*ssrcp = ssrc;
-
-	return 0;
-}
-
-
 static struct stream *bundle_find_base(const struct list *streaml)
 {
 	struct le *le;
@@ -306,7 +344,7 @@ static struct stream *bundle_find_base(const struct list *streaml)
 static bool udp_helper_send_handler(int *err, struct sa *dst,
 				    struct mbuf *mb, void *arg)
 {
-	const struct list *streaml = arg;
+	const struct bundle *bun = arg;
 	struct stream *strm;
 
 #if 0
@@ -317,7 +355,7 @@ static bool udp_helper_send_handler(int *err, struct sa *dst,
 	}
 #endif
 
-	strm = bundle_find_base(streaml);
+	strm = bundle_find_base(bun->streaml);
 	if (strm) {
 		struct udp_sock *us = rtp_sock(stream_rtp_sock(strm));
 		struct bundle *bun2 = stream_bundle(strm);
@@ -336,63 +374,309 @@ static bool udp_helper_send_handler(int *err, struct sa *dst,
 }
 
 
-/* recv: used by base stream */
-static bool udp_helper_recv_handler(struct sa *src, struct mbuf *mb, void *arg)
+static bool ssrc_cmp_handler(struct le *le, void *arg)
 {
-	const struct list *streaml = arg;
-	struct stream *strm;
-	size_t pos = mb->pos;
-	uint32_t ssrc;
-	int err;
+	const struct ssrc_entry *ent = le->data;
 
-#if 0
-	if (bun->state != BUNDLE_BASE) {
-		warning("recv: expect state=base, but state=%s\n",
-			bundle_state_name(bun->state));
+	return ent->ssrc == *(uint32_t *)arg;
+}
+
+
+static struct stream *ssrc_lookup(const struct bundle *bun, uint32_t ssrc)
+{
+	struct ssrc_entry *ent;
+
+	ent = list_ledata(hash_lookup(bun->ssrch, ssrc, ssrc_cmp_handler,
+				      &ssrc));
+
+	return ent ? ent->strm : NULL;
+}
+
+
+static int ssrc_learn(struct bundle *bun, uint32_t ssrc, struct stream *strm)
+{
+	struct bundle *bun2 = stream_bundle(strm);
+	struct ssrc_entry *ent;
+
+	if (!bun2)
+		return EINVAL;
+
+	ent = mem_zalloc(sizeof(*ent), ssrc_entry_destructor);
+	if (!ent)
+		return ENOMEM;
+
+	ent->ssrc = ssrc;
+	ent->strm = strm;
+
+	hash_append(bun->ssrch, ssrc, &ent->he, ent);
+	list_append(&bun2->ssrcl, &ent->le, ent);
+	++bun->stats.n_learn;
+
+	debug("bundle: ssrc %08x -> %s\n", ssrc, stream_name(strm));
+
+	return 0;
+}
+
+
+/* SSRC from the fixed header, or the sender SSRC of the RTCP packet */
+static int peek_ssrc(const struct mbuf *mb, bool rtcp, uint32_t *ssrcp)
+{
+	const uint8_t *p = mbuf_buf(mb);
+	const size_t off = rtcp ? 4 : 8;
+
+	if (mbuf_get_left(mb) < off + 4 || (p[0] >> 6) != RTP_VERSION)
+		return EBADMSG;
+
+	*ssrcp = (uint32_t)p[off] << 24 | (uint32_t)p[off+1] << 16 |
+		 (uint32_t)p[off+2] << 8 | p[off+3];
+
+	return 0;
+}
+
+
+struct rid_arg {
+	const struct rtpext *ext;
+	bool found;
+};
+
+
+static bool rid_handler(const char *name, const char *value, void *arg)
+{
+	struct rid_arg *ra = arg;
+	struct pl rid;
+	(void)name;
+
+	if (re_regex(value, str_len(value), "[^ ]+ send", &rid))
 		return false;
+
+	ra->found = rid.l == ra->ext->len &&
+		0 == memcmp(rid.p, ra->ext->data, rid.l);
+
+	return ra->found;
+}
+
+
+static bool extmap_rid_handler(const char *name, const char *value,
+			       void *arg)
+{
+	uint8_t *idp = arg;
+	struct sdp_extmap extmap;
+	(void)name;
+
+	if (sdp_extmap_decode(&extmap, value))
+		return false;
+
+	if (0 == pl_strcasecmp(&extmap.name, uri_rid)) {
+		*idp = (uint8_t)extmap.id;
+		return true;
 	}
-#endif
 
-	if (!rtp_is_rtcp_packet(mb)) {
+	return false;
+}
+
 
-		struct rtp_header hdr;
+/* The stream which receives the RTP stream with this RID (RFC 8852) */
+static struct stream *lookup_rid(const struct list *streaml,
+				 const struct rtpext *extv, size_t extc)
+{
+	for (struct le *le = list_head(streaml); le; le = le->next) {
+		struct stream *strm = le->data;
+		struct sdp_media *m = stream_sdpmedia(strm);
+		uint8_t id = 0;
 
-		err = rtp_hdr_decode(&hdr, mb);
-		if (err) {
-			warning("bundle: rtp decode error (%m)\n", err);
-			return false;
+		(void)sdp_media_rattr_apply(m, "extmap", extmap_rid_handler,
+					    &id);
+		if (!id)
+			continue;
+
+		for (size_t i = 0; i < extc; i++) {
+			struct rid_arg ra = {&extv[i], false};
+
+			if (extv[i].id != id)
+				continue;
+
+			(void)sdp_media_rattr_apply(m, "rid", rid_handler,
+						    &ra);
+			if (ra.found)
+				return strm;
 		}
+	}
+
+	return NULL;
+}
+
+
+/* Find the stream of an RTP packet with the MID or RID header extension */
+static struct stream *lookup_rtpext(const struct bundle *bun,
+				    struct mbuf *mb)
+{
+	const size_t pos = mb->pos;
+	const size_t end = mb->end;
+	struct rtpext extv[8];
+	struct rtp_header hdr;
+	struct stream *strm = NULL;
+	size_t extc = 0, ext_len;
+
+	if (rtp_hdr_decode(&hdr, mb))
+		goto out;
+
+	if (!hdr.ext || hdr.x.type != RTPEXT_TYPE_MAGIC)
+		goto out;
 
-		ssrc = hdr.ssrc;
+	ext_len = hdr.x.len * sizeof(uint32_t);
+	if (mb->pos < ext_len)
+		goto out;
+
+	mb->end = mb->pos;
+	mb->pos = mb->pos - ext_len;
+
+	while (extc < RE_ARRAY_SIZE(extv) && mbuf_get_left(mb)) {
+		if (rtpext_decode(&extv[extc], mb))
+			break;
+		++extc;
 	}
-	else {
-		struct rtcp_msg *msg;
 
-		err = rtcp_decode(&msg, mb);
-		if (err) {
-			warning("rtcp decode error (%m)\n", err);
-			return false;
+	for (size_t i = 0; i < extc; i++) {
+		if (bun->extmap_mid && extv[i].id == bun->extmap_mid) {
+			strm = stream_lookup_mid(bun->streaml,
+						 (const char *)extv[i].data,
+						 extv[i].len);
+			if (strm)
+				goto out;
 		}
+	}
 
-		err = get_rtcp_ssrc(msg, &ssrc);
-		mem_deref(msg);
+	strm = lookup_rid(bun->streaml, extv, extc);
 
-		if (err)
-			return false;
+ out:
+	mb->pos = pos;
+	mb->end = end;
+
+	return strm;
+}
+
+
+static void stream_deliver(struct stream *strm, struct sa *src,
+			   struct mbuf *mb)
+{
+	struct udp_sock *us = rtp_sock(stream_rtp_sock(strm));
+	struct bundle *bun2 = stream_bundle(strm);
+
+	udp_recv_helper(us, src, mb, bun2->uh);
+}
+
+
+static int pending_add(struct bundle *bun, const struct sa *src,
+		       const struct mbuf *mb, uint32_t ssrc)
+{
+	struct pending *pend;
+	int err;
+
+	/* the oldest packet makes room */
+	if (bun->n_pend >= PEND_MAX) {
+		mem_deref(list_ledata(list_head(&bun->pendl)));
+		--bun->n_pend;
+		++bun->stats.n_drop;
 	}
 
-	strm = lookup_remote_ssrc(streaml, ssrc);
+	pend = mem_zalloc(sizeof(*pend), pending_destructor);
+	if (!pend)
+		return ENOMEM;
+
+	pend->mb = mbuf_alloc(mbuf_get_left(mb));
+	if (!pend->mb) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	err = mbuf_write_mem(pend->mb, mbuf_buf(mb), mbuf_get_left(mb));
+	if (err)
+		goto out;
+
+	pend->mb->pos = 0;
+	pend->src  = *src;
+	pend->ssrc = ssrc;
+	pend->t    = tmr_jiffies();
+
+	list_append(&bun->pendl, &pend->le, pend);
+	++bun->n_pend;
+	++bun->stats.n_pend;
+
+ out:
+	if (err)
+		mem_deref(pend);
+
+	return err;
+}
+
+
+/* Deliver the buffered packets of a learned SSRC, drop expired ones */
+static void pending_flush(struct bundle *bun, uint32_t ssrc,
+			  struct stream *strm)
+{
+	const uint64_t now = tmr_jiffies();
+	struct le *le = list_head(&bun->pendl);
+
+	while (le) {
+		struct pending *pend = le->data;
+
+		le = le->next;
+
+		if (strm && pend->ssrc == ssrc) {
+			stream_deliver(strm, &pend->src, pend->mb);
+		}
+		else if (now - pend->t > PEND_TIMEOUT) {
+			debug("bundle: stream not found (ssrc=%x)\n",
+			      pend->ssrc);
+			++bun->stats.n_drop;
+		}
+		else {
+			continue;
+		}
+
+		mem_deref(pend);
+		--bun->n_pend;
+	}
+}
+
+
+/* recv: used by base stream */
+static bool udp_helper_recv_handler(struct sa *src, struct mbuf *mb, void *arg)
+{
+	struct bundle *bun = arg;
+	struct stream *strm;
+	bool rtcp;
+	uint32_t ssrc;
+
+	rtcp = rtp_is_rtcp_packet(mb);
+
+	if (peek_ssrc(mb, rtcp, &ssrc)) {
+		warning("bundle: %s decode error\n", rtcp ? "rtcp" : "rtp");
+		return false;
+	}
+
+	strm = ssrc_lookup(bun, ssrc);
 	if (strm) {
-		struct udp_sock *us = rtp_sock(stream_rtp_sock(strm));
-		struct bundle *bun2 = stream_bundle(strm);
+		stream_deliver(strm, src, mb);
+		return true;
+	}
 
-		mb->pos = pos;
+	strm = lookup_remote_ssrc(bun->streaml, ssrc);
+	if (!strm && !rtcp)
+		strm = lookup_rtpext(bun, mb);
 
-		udp_recv_helper(us, src, mb, bun2->uh);
+	if (strm) {
+		(void)ssrc_learn(bun, ssrc, strm);
+		pending_flush(bun, ssrc, strm);
+		stream_deliver(strm, src, mb);
+	}
+	else if (rtcp) {
+		debug("bundle: rtcp for unknown ssrc %x\n", ssrc);
+		++bun->stats.n_drop;
 	}
 	else {
-		warning("bundle: stream not found (ssrc=%x)\n",
-			ssrc);
+		pending_flush(bun, ssrc, NULL);
+		(void)pending_add(bun, src, mb, ssrc);
 	}
 
 	return true; /* stop */
@@ -418,11 +702,19 @@ int bundle_start_socket(struct bundle *bun, struct udp_sock *us,
 	muxed = bun->state == BUNDLE_MUX;
 	based = bun->state == BUNDLE_BASE;
 
+	bun->streaml = streaml;
+
+	if (based) {
+		err = hash_alloc(&bun->ssrch, SSRC_HASH_SIZE);
+		if (err)
+			return err;
+	}
+
 	/* NOTE: UDP helper must be injected below the RTP stack */
 	err = udp_register_helper(&bun->uh, us, RTP_TRANSP_LAYER,
 				  muxed ? udp_helper_send_handler : NULL,
 				  based ? udp_helper_recv_handler : NULL,
-				  streaml);
+				  bun);
 	if (err)
 		return err;
 
@@ -453,6 +745,12 @@ int bundle_debug(struct re_printf *pf, const struct bundle *bun)
 	err |= re_hprintf(pf, " state:         %s\n",
 			  bundle_state_name(bun->state));
 	err |= re_hprintf(pf, " extmap_mid:    %u\n", bun->extmap_mid);
+	if (bun->ssrch) {
+		err |= re_hprintf(pf, " demux:         %llu ssrcs learned,"
+				  " %llu buffered, %llu dropped\n",
+				  bun->stats.n_learn, bun->stats.n_pend,
+				  bun->stats.n_drop);
+	}
 	err |= re_hprintf(pf, "\n");
 
 	return err;
@@ -37,6 +37,7 @@ struct call {
 	struct list streaml;      /**< List of mediastreams (struct stream) */
 	struct audio *audio;      /**< Audio stream                         */
 	struct video *video;      /**< Video stream                         */
+	struct call_arena *arena; /**< Memory arena of the streams          */
 	enum call_state state;    /**< Call state                           */
 	int32_t adelay;           /**< Auto answer delay in ms              */
 	char *aluri;              /**< Alert-Info URI                       */
@@ -447,6 +448,13 @@ static void call_destructor(void *arg)
 	mem_deref(call->diverter_uri);
 	mem_deref(call->audio);
 	mem_deref(call->video);
+
+	if (call->arena) {
+		debug("call: arena: %zu bytes\n",
+		      call_arena_used(call->arena));
+		mem_deref(call->arena);
+	}
+
 	mem_deref(call->sdp);
 	mem_deref(call->mnats);
 	mem_deref(call->mencs);
@@ -644,6 +652,14 @@ static void stream_rtcp_handler(struct stream *strm,
 			 "%s", sdp_media_name(stream_sdpmedia(strm)));
 		break;
 	}
+
+	/* the congestion controller has been updated */
+	if (strm == video_strm(call->video) &&
+	    video_cc_changed(call->video)) {
+
+		ua_event(call->ua, UA_EVENT_CALL_BITRATE, call,
+			 "video,%H", video_cc_print, call->video);
+	}
 }
 
 
@@ -830,6 +846,7 @@ int call_streams_alloc(struct call *call)
 	strm_prm.cname	  = call->local_uri;
 	strm_prm.peer	  = call->peer_uri;
 	strm_prm.rtcp_mux = call->acc->rtcp_mux;
+	strm_prm.arena    = call->arena;
 
 	/* Audio stream */
 	err = audio_alloc(&call->audio, &call->streaml, &strm_prm,
@@ -961,6 +978,12 @@ int call_alloc(struct call **callp, const struct config *cfg, struct list *lst,
 	if (err)
 		goto out;
 
+	if (cfg->call.arena_size) {
+		err = call_arena_alloc(&call->arena, cfg->call.arena_size);
+		if (err)
+			goto out;
+	}
+
 	if (sip_msg_hdr_has_value(msg, SIP_HDR_SUPPORTED, "replaces"))
 		call->supported |= REPLACES;
 
@@ -1472,6 +1495,8 @@ int call_hold(struct call *call, bool hold)
 	FOREACH_STREAM
 		stream_hold(le->data, hold);
 
+	audio_set_hold(call->audio, hold);
+
 	return call_modify(call);
 }
 
@@ -1670,6 +1695,8 @@ int call_debug(struct re_printf *pf, const struct call *call)
 	err |= re_hprintf(pf, " direction: %s\n",
 			  call->outgoing ? "Outgoing" : "Incoming");
 
+	err |= call_arena_debug(pf, call->arena);
+
 	/* SDP debug */
 	err |= sdp_session_debug(pf, call->sdp);
 
@@ -0,0 +1,279 @@
+/**
+ * @file callarena.c  Per-call memory arena
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/*
+ * The fixed-size buffers of a call, e.g. the sample buffers of the audio
+ * stream and the packet pools of the jitter buffers, are carved from a few
+ * contiguous chunks instead of separate heap allocations. The objects are
+ * not freed one by one, all chunks are released in one shot when the last
+ * reference to the arena is gone.
+ *
+ * The memory is zeroed and aligned to ARENA_ALIGN bytes. An arena is not
+ * thread safe, it is used while the call and its streams are set up.
+ *
+ * Chunks of the default size are not freed with the arena, up to
+ * "call_arena_pool" of them are kept and cleared for the next call.
+ * Arenas must be allocated and released in the main thread.
+ */
+
+
+enum {
+	ARENA_ALIGN = 16,
+};
+
+
+struct chunk {
+	struct le le;
+	size_t size;              /**< Usable size of data    */
+	size_t pos;               /**< Offset of free memory  */
+	uint8_t *data;            /**< Aligned start of data  */
+};
+
+struct call_arena {
+	struct list chunkl;       /**< Chunks, current last   */
+	size_t chunksz;           /**< Default chunk size     */
+	size_t used;              /**< Allocated bytes        */
+	size_t size;              /**< Size of all chunks     */
+	uint32_t n_alloc;         /**< Number of allocations  */
+};
+
+
+/* All arenas that have been released */
+static struct {
+	uint64_t n_arena;
+	uint64_t used;
+	size_t peak;
+	uint64_t n_chunk;         /**< Allocated chunks       */
+	uint64_t n_reused;        /**< Recycled chunks        */
+} stats;
+
+static struct list freel;  /**< Recycled chunks, cleared */
+
+
+static void destructor(void *arg)
+{
+	struct call_arena *arena = arg;
+	const uint32_t pool = conf_config()->call.arena_pool;
+	struct le *le;
+
+	++stats.n_arena;
+	stats.used += arena->used;
+	stats.peak  = max(stats.peak, arena->used);
+
+	le = list_head(&arena->chunkl);
+	while (le) {
+		struct chunk *ch = le->data;
+
+		le = le->next;
+
+		if (ch->size != arena->chunksz || list_count(&freel) >= pool)
+			continue;
+
+		memset(ch->data, 0, ch->pos);
+		ch->pos = 0;
+
+		list_unlink(&ch->le);
+		list_append(&freel, &ch->le, ch);
+	}
+
+	list_flush(&arena->chunkl);
+}
+
+
+static struct chunk *chunk_recycle(size_t size)
+{
+	struct le *le = list_head(&freel);
+
+	while (le) {
+		struct chunk *ch = le->data;
+
+		le = le->next;
+
+		if (ch->size == size) {
+			list_unlink(&ch->le);
+			++stats.n_reused;
+			return ch;
+		}
+	}
+
+	return NULL;
+}
+
+
+static struct chunk *chunk_alloc(struct call_arena *arena, size_t size)
+{
+	struct chunk *ch;
+	uintptr_t p;
+
+	ch = chunk_recycle(size);
+	if (ch)
+		goto out;
+
+	ch = mem_zalloc(sizeof(*ch) + size + ARENA_ALIGN - 1, NULL);
+	if (!ch)
+		return NULL;
+
+	p = (uintptr_t)(ch + 1);
+	p = (p + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1);
+
+	ch->data = (uint8_t *)p;
+	ch->size = size;
+	++stats.n_chunk;
+
+ out:
+	list_append(&arena->chunkl, &ch->le, ch);
+	arena->size += size;
+
+	return ch;
+}
+
+
+/**
+ * Allocate a memory arena for a call
+ *
+ * @param arenap  Pointer to allocated arena
+ * @param chunksz Size of the memory chunks in [bytes]
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int call_arena_alloc(struct call_arena **arenap, size_t chunksz)
+{
+	struct call_arena *arena;
+
+	if (!arenap || !chunksz)
+		return EINVAL;
+
+	arena = mem_zalloc(sizeof(*arena), destructor);
+	if (!arena)
+		return ENOMEM;
+
+	arena->chunksz = chunksz;
+
+	if (!chunk_alloc(arena, chunksz)) {
+		mem_deref(arena);
+		return ENOMEM;
+	}
+
+	*arenap = arena;
+
+	return 0;
+}
+
+
+/**
+ * Allocate zeroed memory from a call arena
+ *
+ * The memory must not be dereferenced, it is valid as long as the arena.
+ * A caller that keeps the memory must keep a reference to the arena.
+ *
+ * @param arena Call arena
+ * @param size  Number of bytes
+ *
+ * @return Pointer to memory, or NULL if no memory
+ */
+void *call_arena_zalloc(struct call_arena *arena, size_t size)
+{
+	struct chunk *ch;
+	size_t pos;
+
+	if (!arena || !size)
+		return NULL;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	ch = list_ledata(list_tail(&arena->chunkl));
+	if (!ch || ch->size - ch->pos < size) {
+
+		ch = chunk_alloc(arena, max(size, arena->chunksz));
+		if (!ch)
+			return NULL;
+	}
+
+	pos      = ch->pos;
+	ch->pos += size;
+
+	arena->used += size;
+	++arena->n_alloc;
+
+	return ch->data + pos;
+}
+
+
+/**
+ * Get the number of bytes allocated from a call arena
+ *
+ * @param arena Call arena
+ *
+ * @return Allocated bytes
+ */
+size_t call_arena_used(const struct call_arena *arena)
+{
+	return arena ? arena->used : 0;
+}
+
+
+/**
+ * Free the recycled chunks of all call arenas
+ */
+void call_arena_flush(void)
+{
+	list_flush(&freel);
+}
+
+
+/**
+ * Get the chunk counters of all call arenas
+ *
+ * @param n_chunk  Optional number of allocated chunks
+ * @param n_reused Optional number of recycled chunks
+ */
+void call_arena_stats(uint64_t *n_chunk, uint64_t *n_reused)
+{
+	if (n_chunk)
+		*n_chunk = stats.n_chunk;
+	if (n_reused)
+		*n_reused = stats.n_reused;
+}
+
+
+/**
+ * Print the usage of a call arena and of all released arenas
+ *
+ * @param pf    Print handler
+ * @param arena Call arena
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int call_arena_debug(struct re_printf *pf, const struct call_arena *arena)
+{
+	int err;
+
+	if (!arena)
+		return 0;
+
+	err = re_hprintf(pf, " arena: %zu of %zu bytes in %u chunks,"
+			 " %u allocations\n",
+			 arena->used, arena->size, list_count(&arena->chunkl),
+			 arena->n_alloc);
+
+	if (stats.n_arena) {
+		err |= re_hprintf(pf, " arena: %llu bytes/call average,"
+				  " %zu peak (%llu calls)\n",
+				  stats.used / stats.n_arena, stats.peak,
+				  stats.n_arena);
+	}
+
+	err |= re_hprintf(pf, " arena: %llu chunks allocated, %llu recycled,"
+			  " %u free\n", stats.n_chunk, stats.n_reused,
+			  list_count(&freel));
+
+	return err;
+}
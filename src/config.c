@@ -45,7 +45,9 @@ static struct config core_config = {
 	{
 		120,
 		4,
-		true
+		true,
+		65536,
+		16,
 	},
 
 	/** Audio */
@@ -67,7 +69,10 @@ static struct config core_config = {
 		{20, 160},
 		false,
 		-35.0,
-		101
+		101,
+		0,
+		false,
+		"", "",
 	},
 
 	/** Video */
@@ -81,6 +86,10 @@ static struct config core_config = {
 		30,
 		true,
 		VID_FMT_YUV420P,
+		2,
+		1,
+		false,
+		false,
 	},
 
 	/** Audio/Video Transport */
@@ -93,15 +102,18 @@ static struct config core_config = {
 		{
 			JBUF_FIXED,
 			{5, 10},
+			95,
 		},
 		{
 			JBUF_FIXED,
 			{5, 50},
+			95,
 		},
 		false,
 		0,
 		false,
 		RECEIVE_MODE_MAIN,
+		4,
 	},
 
 	/* Network */
@@ -113,6 +125,14 @@ static struct config core_config = {
 		true,
 		false,
 	},
+
+	/* Media thread placement */
+	{
+		{"", "", "", ""},
+		0,
+		false,
+		4,
+	},
 };
 
 
@@ -194,6 +214,7 @@ enum rtp_receive_mode resolve_receive_mode(const struct pl *fmt)
 			"experimental\n");
 		return RECEIVE_MODE_THREAD;
 	}
+	if (0 == pl_strcasecmp(fmt, "pool"))     return RECEIVE_MODE_POOL;
 
 	warning("rtp_rxmode %r is not supported\n", fmt);
 	return RECEIVE_MODE_MAIN;
@@ -207,6 +228,8 @@ const char *rtp_receive_mode_str(enum rtp_receive_mode rxmode)
 		return "main";
 	case RECEIVE_MODE_THREAD:
 		return "thread";
+	case RECEIVE_MODE_POOL:
+		return "pool";
 	default:
 		return "?";
 	}
@@ -420,6 +443,8 @@ int config_parse_conf(struct config *cfg, const struct conf *conf)
 			   &cfg->call.max_calls);
 	(void)conf_get_bool(conf, "call_hold_other_calls",
 			   &cfg->call.hold_other_calls);
+	(void)conf_get_u32(conf, "call_arena_size", &cfg->call.arena_size);
+	(void)conf_get_u32(conf, "call_arena_pool", &cfg->call.arena_pool);
 
 	/* Audio */
 	(void)conf_get_str(conf, "audio_path", cfg->audio.audio_path,
@@ -440,6 +465,10 @@ int config_parse_conf(struct config *cfg, const struct conf *conf)
 			   cfg->audio.alert_dev,
 			   sizeof(cfg->audio.alert_dev));
 
+	(void)conf_get_csv(conf, "audio_moh",
+			   cfg->audio.moh_mod, sizeof(cfg->audio.moh_mod),
+			   cfg->audio.moh_dev, sizeof(cfg->audio.moh_dev));
+
 	(void)conf_get_u32(conf, "ausrc_srate", &cfg->audio.srate_src);
 	(void)conf_get_u32(conf, "auplay_srate", &cfg->audio.srate_play);
 	(void)conf_get_u32(conf, "ausrc_channels", &cfg->audio.channels_src);
@@ -474,6 +503,9 @@ int config_parse_conf(struct config *cfg, const struct conf *conf)
 
 	(void)conf_get_float(conf, "audio_silence", &cfg->audio.silence);
 	(void)conf_get_u32(conf, "audio_telev_pt", &cfg->audio.telev_pt);
+	(void)conf_get_u32(conf, "audio_red", &cfg->audio.red);
+	cfg->audio.red = min(cfg->audio.red, (uint32_t)RED_LEVEL_MAX);
+	(void)conf_get_bool(conf, "audio_stretch", &cfg->audio.stretch);
 
 	/* Video */
 	(void)conf_get_csv(conf, "video_source",
@@ -493,6 +525,11 @@ int config_parse_conf(struct config *cfg, const struct conf *conf)
 	(void)conf_get_bool(conf, "video_fullscreen", &cfg->video.fullscreen);
 
 	conf_get_vidfmt(conf, "videnc_format", &cfg->video.enc_fmt);
+	(void)conf_get_u32(conf, "video_conv_threads",
+			   &cfg->video.conv_threads);
+	(void)conf_get_u32(conf, "video_simulcast", &cfg->video.simulcast);
+	(void)conf_get_bool(conf, "video_cc", &cfg->video.cc);
+	(void)conf_get_bool(conf, "video_fec", &cfg->video.fec);
 
 	/* AVT - Audio/Video Transport */
 	if (0 == conf_get_u32(conf, "rtp_tos", &v))
@@ -524,12 +561,22 @@ int config_parse_conf(struct config *cfg, const struct conf *conf)
 
 	(void)conf_get_range(conf, "audio_jitter_buffer_delay",
 			     &cfg->avt.audio.jbuf_del);
+	(void)conf_get_u32(conf, "audio_jitter_buffer_percentile",
+			   &cfg->avt.audio.jbuf_pct);
 
 	if (0 == conf_get(conf, "video_jitter_buffer_type", &jbtype))
 		cfg->avt.video.jbtype = conf_get_jbuf_type(&jbtype);
 
 	(void)conf_get_range(conf, "video_jitter_buffer_delay",
 			     &cfg->avt.video.jbuf_del);
+	(void)conf_get_u32(conf, "video_jitter_buffer_percentile",
+			   &cfg->avt.video.jbuf_pct);
+
+	if (cfg->avt.audio.jbuf_pct < 50 || cfg->avt.audio.jbuf_pct > 100 ||
+	    cfg->avt.video.jbuf_pct < 50 || cfg->avt.video.jbuf_pct > 100) {
+		warning("config: jitter_buffer_percentile must be 50-100\n");
+		return EINVAL;
+	}
 
 	(void)conf_get_bool(conf, "rtp_stats", &cfg->avt.rtp_stats);
 	(void)conf_get_u32(conf, "rtp_timeout", &cfg->avt.rtp_timeout);
@@ -538,6 +585,11 @@ int config_parse_conf(struct config *cfg, const struct conf *conf)
 	if (0 == conf_get(conf, "rtp_rxmode", &rxmode)) {
 		cfg->avt.rxmode = resolve_receive_mode(&rxmode);
 	}
+	(void)conf_get_u32(conf, "rtp_rxworkers", &cfg->avt.rxworkers);
+	if (cfg->avt.rxmode == RECEIVE_MODE_POOL && !cfg->avt.rxworkers) {
+		warning("config: rtp_rxworkers must be at least 1\n");
+		return EINVAL;
+	}
 
 	if (err) {
 		warning("config: configure parse error (%m)\n", err);
@@ -561,6 +613,21 @@ int config_parse_conf(struct config *cfg, const struct conf *conf)
 		}
 	}
 
+	/* Media thread placement */
+	for (int i = 0; i < MEDIA_THREAD_MAX; i++) {
+		char key[64];
+
+		re_snprintf(key, sizeof(key), "sched_cpus_%s",
+			    media_thread_name(i));
+		(void)conf_get_str(conf, key, cfg->sched.cpus[i],
+				   sizeof(cfg->sched.cpus[i]));
+	}
+	(void)conf_get_u32(conf, "sched_rt_priority", &cfg->sched.rt_prio);
+	(void)conf_get_bool(conf, "sched_numa_local",
+			    &cfg->sched.numa_local);
+	(void)conf_get_u32(conf, "sched_thread_pool",
+			   &cfg->sched.thread_pool);
+
 	return err;
 }
 
@@ -598,6 +665,8 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 "call_local_timeout\t%u\n"
 			 "call_max_calls\t\t%u\n"
 			 "call_hold_other_calls\t%s\n"
+			 "call_arena_size\t\t%u\n"
+			 "call_arena_pool\t\t%u\n"
 			 "\n",
 			 cfg->sip.local, cfg->sip.cert, cfg->sip.cafile,
 			 cfg->sip.capath, sip_transports_print,
@@ -610,7 +679,9 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 
 			 cfg->call.local_timeout,
 			 cfg->call.max_calls,
-			 cfg->call.hold_other_calls ? "yes" : "no");
+			 cfg->call.hold_other_calls ? "yes" : "no",
+			 cfg->call.arena_size,
+			 cfg->call.arena_pool);
 	if (err)
 		return err;
 
@@ -634,6 +705,9 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 "audio_buffer_mode\t%s\t\t# fixed, adaptive\n"
 			 "audio_silence\t\t%.1lf\t\t# in [dB]\n"
 			 "audio_telev_pt\t\t%u\n"
+			 "audio_red\t\t%u\n"
+			 "audio_stretch\t\t%s\n"
+			 "audio_moh\t\t%s,%s\n"
 			 "\n",
 			 cfg->audio.audio_path,
 			 cfg->audio.play_mod,  cfg->audio.play_dev,
@@ -651,7 +725,10 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 range_print, &cfg->audio.buffer,
 			 cfg->audio.adaptive ? "adaptive" : "fixed",
 			 cfg->audio.silence,
-			 cfg->audio.telev_pt);
+			 cfg->audio.telev_pt,
+			 cfg->audio.red,
+			 cfg->audio.stretch ? "yes" : "no",
+			 cfg->audio.moh_mod, cfg->audio.moh_dev);
 	if (err)
 		return err;
 
@@ -665,13 +742,21 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 "video_fps\t\t%.2f\n"
 			 "video_fullscreen\t%s\n"
 			 "videnc_format\t\t%s\n"
+			 "video_conv_threads\t%u\n"
+			 "video_simulcast\t\t%u\n"
+			 "video_cc\t\t%s\n"
+			 "video_fec\t\t%s\n"
 			 "\n",
 			 cfg->video.src_mod, cfg->video.src_dev,
 			 cfg->video.disp_mod, cfg->video.disp_dev,
 			 cfg->video.width, cfg->video.height,
 			 cfg->video.bitrate, cfg->video.fps,
 			 cfg->video.fullscreen ? "yes" : "no",
-			 vidfmt_name(cfg->video.enc_fmt));
+			 vidfmt_name(cfg->video.enc_fmt),
+			 cfg->video.conv_threads,
+			 cfg->video.simulcast,
+			 cfg->video.cc ? "yes" : "no",
+			 cfg->video.fec ? "yes" : "no");
 	if (err)
 		return err;
 
@@ -683,12 +768,15 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 "rtp_bandwidth\t\t%H\n"
 			 "audio_jitter_buffer_type\t%s\n"
 			 "audio_jitter_buffer_delay\t%H\n"
+			 "audio_jitter_buffer_percentile\t%u\n"
 			 "video_jitter_buffer_type\t%s\n"
 			 "video_jitter_buffer_delay\t%H\n"
+			 "video_jitter_buffer_percentile\t%u\n"
 			 "rtp_stats\t\t%s\n"
 			 "rtp_timeout\t\t%u # in seconds\n"
 			 "avt_bundle\t\t%s\n"
 			 "rtp_rxmode\t\t\t%s\n"
+			 "rtp_rxworkers\t\t%u\n"
 			 "\n"
 			 "# Network\n"
 			 "net_interface\t\t%s\n"
@@ -701,16 +789,41 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 range_print, &cfg->avt.rtp_bw,
 			 jbuf_type_str(cfg->avt.audio.jbtype),
 			 range_print, &cfg->avt.audio.jbuf_del,
+			 cfg->avt.audio.jbuf_pct,
 			 jbuf_type_str(cfg->avt.video.jbtype),
 			 range_print, &cfg->avt.video.jbuf_del,
+			 cfg->avt.video.jbuf_pct,
 			 cfg->avt.rtp_stats ? "yes" : "no",
 			 cfg->avt.rtp_timeout,
 			 cfg->avt.bundle ? "yes" : "no",
 			 rtp_receive_mode_str(cfg->avt.rxmode),
+			 cfg->avt.rxworkers,
 
 			 cfg->net.ifname,
 			 net_af_str(cfg->net.af)
 		   );
+	if (err)
+		return err;
+
+	err = re_hprintf(pf,
+			 "# Media threads\n"
+			 "sched_cpus_audio_tx\t%s\n"
+			 "sched_cpus_audio_rx\t%s\n"
+			 "sched_cpus_audio_drv\t%s\n"
+			 "sched_cpus_video\t%s\n"
+			 "sched_rt_priority\t%u\n"
+			 "sched_numa_local\t%s\n"
+			 "sched_thread_pool\t%u\n"
+			 "\n",
+
+			 cfg->sched.cpus[MEDIA_THREAD_AUDIO_TX],
+			 cfg->sched.cpus[MEDIA_THREAD_AUDIO_RX],
+			 cfg->sched.cpus[MEDIA_THREAD_AUDIO_DRV],
+			 cfg->sched.cpus[MEDIA_THREAD_VIDEO],
+			 cfg->sched.rt_prio,
+			 cfg->sched.numa_local ? "yes" : "no",
+			 cfg->sched.thread_pool
+		   );
 
 	return err;
 }
@@ -869,6 +982,8 @@ static int core_config_template(struct re_printf *pf, const struct config *cfg)
 			  "call_local_timeout\t%u\n"
 			  "call_max_calls\t\t%u\n"
 			  "call_hold_other_calls\tyes\n"
+			  "#call_arena_size\t65536\t\t# bytes, 0 is off\n"
+			  "#call_arena_pool\t16\t\t# recycled chunks\n"
 			  "\n"
 			  ,
 			  cfg->call.local_timeout,
@@ -895,6 +1010,11 @@ static int core_config_template(struct re_printf *pf, const struct config *cfg)
 			  "audio_silence\t\t%.1lf\t\t# in [dB]\n"
 			  "audio_telev_pt\t\t%u\t\t"
 			  "# payload type for telephone-event\n"
+			  "#audio_red\t\t0\t\t"
+			  "# redundant frames per packet (0-2)\n"
+			  "#audio_stretch\t\tno\t\t"
+			  "# time-stretch toward a jitter target\n"
+			  "#audio_moh\t\taufile,/usr/share/baresip/moh.wav\n"
 			  "\n"
 			  ,
 			  default_audio_path(),
@@ -915,12 +1035,17 @@ static int core_config_template(struct re_printf *pf, const struct config *cfg)
 			  "video_fps\t\t%.2f\n"
 			  "video_fullscreen\tno\n"
 			  "videnc_format\t\t%s\n"
+			  "video_conv_threads\t%u\n"
+			  "video_simulcast\t\t1\t\t# layers, 1 to 3\n"
+			  "video_cc\t\tno\t\t# congestion control\n"
+			  "video_fec\t\tno\t\t# forward error correction\n"
 			  ,
 			  default_video_device(),
 			  default_video_display(),
 			  cfg->video.width, cfg->video.height,
 			  cfg->video.bitrate, cfg->video.fps,
-			  vidfmt_name(cfg->video.enc_fmt));
+			  vidfmt_name(cfg->video.enc_fmt),
+			  cfg->video.conv_threads);
 
 	err |= re_hprintf(pf,
 			  "\n# AVT - Audio/Video Transport\n"
@@ -932,14 +1057,19 @@ static int core_config_template(struct re_printf *pf, const struct config *cfg)
 				" adaptive\n"
 			  "audio_jitter_buffer_delay\t%u-%u\t\t"
 					"# (min. frames)-(max. packets)\n"
+			  "#audio_jitter_buffer_percentile\t95\t"
+					"# adaptive target delay [%%]\n"
 			  "video_jitter_buffer_type\tfixed\t\t# off, fixed,"
 				" adaptive\n"
 			  "video_jitter_buffer_delay\t%u-%u\t\t"
 					"# (min. frames)-(max. packets)\n"
+			  "#video_jitter_buffer_percentile\t95\t"
+					"# adaptive target delay [%%]\n"
 			  "rtp_stats\t\tno\n"
 			  "#rtp_timeout\t\t60\n"
 			  "#avt_bundle\t\tno\n"
 			  "#rtp_rxmode\t\tmain\n"
+			  "#rtp_rxworkers\t\t4\n"
 			  "\n# Network\n"
 			  "#dns_server\t\t1.1.1.1:53\n"
 			  "#dns_server\t\t1.0.0.1:53\n"
@@ -947,10 +1077,21 @@ static int core_config_template(struct re_printf *pf, const struct config *cfg)
 			  "#dns_getaddrinfo\t\tno\n"
 			  "#net_interface\t\t%H\n"
 			  "\n"
+			  "# Media threads\n"
+			  "#sched_cpus_audio_tx\t2-3\t\t# CPU set\n"
+			  "#sched_cpus_audio_rx\t2-3\n"
+			  "#sched_cpus_audio_drv\t2-3\n"
+			  "#sched_cpus_video\t4-7\n"
+			  "#sched_rt_priority\t0\t\t# SCHED_FIFO for audio\n"
+			  "#sched_numa_local\tno\n"
+			  "#sched_thread_pool\t4\t\t# parked threads\n"
+			  "\n"
 			  "# Play tones\n"
 			  "#file_ausrc\t\taufile\n"
 			  "#file_srate\t\t16000\n"
-			  "#file_channels\t\t1\n",
+			  "#file_channels\t\t1\n"
+			  "#file_cache_size\t4096\t\t# Decoded files [KB]\n"
+			  "#file_cache_preload\t/usr/share/baresip\n",
 			  cfg->avt.audio.jbuf_del.min,
 			  cfg->avt.audio.jbuf_del.max,
 			  cfg->avt.video.jbuf_del.min,
@@ -1247,6 +1388,8 @@ int config_write_template(const char *file, const struct config *cfg)
 
 	(void)re_fprintf(f, "# DTLS SRTP parameters\n");
 	(void)re_fprintf(f, "#dtls_srtp_use_ec\tprime256v1\n");
+	(void)re_fprintf(f, "#dtls_srtp_resumption\tall"
+			 "\t\t# none, ids, tickets, all (server)\n");
 	(void)re_fprintf(f, "\n");
 
 	(void)re_fprintf(f, "\n# UI Modules parameters\n");
@@ -1277,6 +1420,8 @@ int config_write_template(const char *file, const struct config *cfg)
 	(void)re_fprintf(f, "#opus_samplerate\t48000\n");
 	(void)re_fprintf(f, "#opus_packet_loss\t10\t# 0-100 percent "
 				"(expected packet loss)\n");
+	(void)re_fprintf(f, "#opus_adaptive\t\tno\t# FEC/DTX from "
+				"RTCP loss\n");
 
 	(void)re_fprintf(f, "\n# Opus Multistream codec parameters\n");
 	(void)re_fprintf(f,
@@ -1360,7 +1505,12 @@ int config_write_template(const char *file, const struct config *cfg)
 
 	(void)re_fprintf(f,
 			 "\n# sndfile\n"
-			 "#snd_path\t\t/tmp\n");
+			 "#snd_path\t\t/tmp\n"
+			 "#snd_format\t\twav\t# wav,flac,opus\n"
+			 "#snd_mode\t\tsplit\t# split,stereo\n"
+			 "#snd_threads\t\t1\n"
+			 "#snd_buffer\t\t2000\t# ring size in [ms]\n"
+			 "#snd_flush\t\t200\t# write period in [ms]\n");
 
 	(void)re_fprintf(f,
 			 "\n# EBU ACIP\n"
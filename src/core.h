@@ -121,7 +121,7 @@ int aucodec_print(struct re_printf *pf, const struct aucodec *ac);
 struct audio_recv;
 
 int  aurecv_alloc(struct audio_recv **aupp, const struct config_audio *cfg,
-		  size_t sampc, uint32_t ptime);
+		  size_t sampc, uint32_t ptime, struct call_arena *arena);
 int  aurecv_decoder_set(struct audio_recv *ar,
 			const struct aucodec *ac, int pt, const char *params);
 int  aurecv_payload_type(const struct audio_recv *ar);
@@ -139,6 +139,7 @@ void aurecv_stop(struct audio_recv *ar);
 void aurecv_stop_auplay(struct audio_recv *ar);
 
 const struct aucodec *aurecv_codec(const struct audio_recv *ar);
+struct red_dec *aurecv_red(const struct audio_recv *ar);
 uint64_t aurecv_latency(const struct audio_recv *ar);
 bool aurecv_started(const struct audio_recv *ar);
 bool aurecv_filt_empty(const struct audio_recv *ar);
@@ -148,6 +149,60 @@ int aurecv_debug(struct re_printf *pf, const struct audio_recv *ar);
 int aurecv_print_pipeline(struct re_printf *pf, const struct audio_recv *ar);
 
 
+/*
+ * Polyphase audio resampler
+ */
+
+int  aupoly_init(void);
+void aupoly_close(void);
+
+
+/*
+ * Parallel video converter
+ */
+
+int  vidconv_mt_init(unsigned threads);
+void vidconv_mt_close(void);
+
+
+/*
+ * RTP receive worker pool
+ */
+
+struct rxworker;
+
+typedef void (rxworker_h)(void *arg);
+
+int  rxpool_init(unsigned workers);
+void rxpool_close(void);
+struct rxworker *rxpool_worker(uint32_t key);
+unsigned rxworker_id(const struct rxworker *w);
+int  rxpool_debug(struct re_printf *pf, void *unused);
+int  rxworker_call(struct rxworker *w, rxworker_h *h, void *arg);
+void rxworker_streams(struct rxworker *w, int delta);
+void rxworker_count(struct rxworker *w, size_t bytes);
+
+
+/*
+ * Call memory arena
+ */
+
+void call_arena_flush(void);
+
+
+/*
+ * Media workers
+ */
+
+struct media_worker;
+
+int  media_worker_init(void);
+void media_worker_close(void);
+int  media_worker_start(struct media_worker **wp, enum media_thread cls,
+			const char *name, thrd_start_t fn, void *arg);
+int  media_worker_join(struct media_worker *w);
+
+
 /*
  * Call Control
  */
@@ -221,6 +276,22 @@ struct metric *metric_alloc(void);
 int module_init(const struct conf *conf);
 
 
+/*
+ * Music on hold
+ */
+
+struct moh_sub;
+
+typedef void (moh_frame_h)(const struct auframe *af, bool marker,
+			   const uint8_t *buf, size_t len, void *arg);
+
+bool moh_enabled(void);
+int  moh_subscribe(struct moh_sub **subp, const struct aucodec *ac,
+		   const char *fmtp, uint32_t ptime,
+		   moh_frame_h *frameh, void *arg);
+int  moh_debug(struct re_printf *pf, void *unused);
+
+
 /*
  * Register client
  */
@@ -341,10 +412,18 @@ int  stream_send(struct stream *s, bool ext, bool marker, int pt, uint32_t ts,
 		 struct mbuf *mb);
 int  stream_resend(struct stream *s, uint16_t seq, bool ext, bool marker,
 		  int pt, uint32_t ts, struct mbuf *mb);
+int  stream_send_ssrc(struct stream *s, uint32_t ssrc, uint16_t seq,
+		      bool ext, bool marker, int pt, uint32_t ts,
+		      struct mbuf *mb);
+int  stream_send_hdr(struct stream *s, const struct rtp_header *hdr,
+		     struct mbuf *mb);
 
 /* Receive */
 void stream_flush(struct stream *s);
 int  stream_ssrc_rx(const struct stream *strm, uint32_t *ssrc);
+void stream_set_ssrc_lock(struct stream *strm, bool enable);
+int  stream_set_fec(struct stream *strm, int pt);
+int  stream_set_red(struct stream *strm, int pt, struct red_dec *dec);
 
 
 struct bundle *stream_bundle(const struct stream *strm);
@@ -420,6 +499,8 @@ struct video;
 int  video_decoder_set(struct video *v, struct vidcodec *vc, int pt_rx,
 		       const char *fmtp);
 int  video_print(struct re_printf *pf, const struct video *v);
+bool video_cc_changed(struct video *v);
+int  video_cc_print(struct re_printf *pf, const struct video *v);
 
 
 /*
@@ -500,6 +581,7 @@ int  rtprecv_alloc(struct rtp_receiver **rxp,
 		   struct stream *strm,
 		   const char *name,
 		   const struct config_avt *cfg,
+		   struct call_arena *arena,
 		   stream_rtp_h *rtph,
 		   stream_pt_h *pth, void *arg);
 void rtprecv_set_handlers(struct rtp_receiver *rx,
@@ -512,6 +594,9 @@ void rtprecv_handle_rtcp(const struct sa *src, struct rtcp_msg *msg,
 			 void *arg);
 void rtprecv_set_socket(struct rtp_receiver *rx, struct rtp_sock *rtp);
 void rtprecv_set_ssrc(struct rtp_receiver *rx, uint32_t ssrc);
+void rtprecv_set_ssrc_lock(struct rtp_receiver *rx, bool enable);
+int  rtprecv_set_fec(struct rtp_receiver *rx, int pt);
+void rtprecv_set_red(struct rtp_receiver *rx, int pt, struct red_dec *dec);
 uint64_t rtprecv_ts_last(struct rtp_receiver *rx);
 void rtprecv_set_ts_last(struct rtp_receiver *rx, uint64_t ts_last);
 void rtprecv_flush(struct rtp_receiver *rx);
@@ -520,6 +605,7 @@ int  rtprecv_get_ssrc(struct rtp_receiver *rx, uint32_t *ssrc);
 void rtprecv_enable_mux(struct rtp_receiver *rx, bool enable);
 int  rtprecv_debug(struct re_printf *pf, const struct rtp_receiver *rx);
 int  rtprecv_start_thread(struct rtp_receiver *rx);
+int  rtprecv_start_pool(struct rtp_receiver *rx);
 void rtprecv_mnat_connected_handler(const struct sa *raddr1,
 				    const struct sa *raddr2, void *arg);
 int  rtprecv_start_rtcp(struct rtp_receiver *rx, const char *cname,
@@ -71,6 +71,7 @@ static const char *event_class_name(enum ua_event ev)
 	case UA_EVENT_CALL_REMOTE_SDP:
 	case UA_EVENT_CALL_HOLD:
 	case UA_EVENT_CALL_RESUME:
+	case UA_EVENT_CALL_BITRATE:
 		return "call";
 	case UA_EVENT_VU_RX:
 	case UA_EVENT_VU_TX:
@@ -453,6 +454,7 @@ const char *uag_event_str(enum ua_event ev)
 	case UA_EVENT_CALL_REMOTE_SDP:      return "CALL_REMOTE_SDP";
 	case UA_EVENT_CALL_HOLD:            return "CALL_HOLD";
 	case UA_EVENT_CALL_RESUME:          return "CALL_RESUME";
+	case UA_EVENT_CALL_BITRATE:         return "CALL_BITRATE";
 	case UA_EVENT_REFER:                return "REFER";
 	case UA_EVENT_MODULE:               return "MODULE";
 	case UA_EVENT_END_OF_FILE:          return "END_OF_FILE";
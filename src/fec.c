@@ -0,0 +1,509 @@
+/**
+ * @file fec.c  Forward error correction with XOR parity (RFC 8627)
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re_atomic.h>
+#include <re.h>
+#include <baresip.h>
+
+
+/*
+ * A subset of Flexible Forward Error Correction (FlexFEC, RFC 8627).
+ *
+ * The sender XORs a group of consecutive media packets into one repair
+ * packet. Repair packets have their own SSRC and sequence numbers, so
+ * they do not leave gaps in the media stream, and carry the protected
+ * SSRC in the CSRC list. One lost packet per group can be recovered, the
+ * group size k sets the overhead (one repair packet for k media packets).
+ *
+ * Only the flexible mask with one row (R=0, F=0) and a 15 bit mask is
+ * used, packet padding is not protected.
+ */
+
+
+enum {
+	FEC_HDR_SIZE = 12,        /* FlexFEC header with a 15 bit mask  */
+	HEAD_SIZE    = 8,         /* Protected part of the RTP header   */
+	MAX_LEN      = 1500,      /* Max protected length [bytes]       */
+	RING_SIZE    = 64,        /* Stored media packets, power of two */
+	PRESZ        = 4 + RTP_HEADER_SIZE + 4,  /* TURN, RTP and CSRC  */
+	TRAILSZ      = 12 + 4,    /* SRTP trailer                       */
+	MASK_K       = 0x8000,    /* Last mask bit-field                */
+};
+
+
+/* The protected bits of a packet, the RTP header with the length of the
+ * packet after the SSRC instead of the sequence number, and the data */
+struct fec_pkt {
+	uint8_t head[HEAD_SIZE];
+	uint8_t data[MAX_LEN];
+	size_t len;
+	uint32_t ssrc;
+	uint16_t seq;
+	bool valid;
+};
+
+struct fec_enc {
+	struct fec_pkt parity;         /**< XOR of the current group        */
+	uint16_t sn_base;              /**< First sequence number of group  */
+	uint16_t mask;                 /**< Protected packets of the group  */
+	unsigned n;                    /**< Packets in the current group    */
+	RE_ATOMIC unsigned k;          /**< Group size, 0 if disabled       */
+	uint64_t n_repair;             /**< Repair packets generated        */
+};
+
+struct fec_dec {
+	struct fec_pkt ringv[RING_SIZE];  /**< Received media packets    */
+	uint64_t n_repair;             /**< Repair packets received         */
+	uint64_t n_recovered;          /**< Media packets recovered         */
+	uint64_t n_lost;               /**< Unrecoverable, more than one    */
+};
+
+
+static void head_encode(uint8_t *b, const struct rtp_header *hdr, size_t len)
+{
+	b[0] = hdr->ver << 6 | hdr->pad << 5 | hdr->ext << 4 | (hdr->cc & 0xf);
+	b[1] = hdr->m << 7 | (hdr->pt & 0x7f);
+	b[2] = (uint8_t)(len >> 8);
+	b[3] = (uint8_t)len;
+	b[4] = (uint8_t)(hdr->ts >> 24);
+	b[5] = (uint8_t)(hdr->ts >> 16);
+	b[6] = (uint8_t)(hdr->ts >> 8);
+	b[7] = (uint8_t)hdr->ts;
+}
+
+
+static void xor_mem(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		dst[i] ^= src[i];
+}
+
+
+static void xor_pkt(struct fec_pkt *dst, const struct fec_pkt *src)
+{
+	xor_mem(dst->head, src->head, HEAD_SIZE);
+	xor_mem(dst->data, src->data, src->len);
+
+	dst->len = max(dst->len, src->len);
+}
+
+
+/**
+ * Get the FEC group size for a packet loss rate
+ *
+ * The group gets smaller, and the overhead larger, with more loss.
+ *
+ * @param loss Packet loss fraction (0.0 - 1.0)
+ *
+ * @return Group size, number of media packets per repair packet
+ */
+unsigned fec_group_size(double loss)
+{
+	if (loss >= 0.15)
+		return FEC_GROUP_MIN;
+	else if (loss >= 0.08)
+		return 3;
+	else if (loss >= 0.03)
+		return 5;
+	else if (loss >= 0.01)
+		return 10;
+	else
+		return FEC_GROUP_MAX;
+}
+
+
+/**
+ * Allocate a FEC encoder, disabled until a group size is set
+ *
+ * @param encp Pointer to allocated FEC encoder
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int fec_enc_alloc(struct fec_enc **encp)
+{
+	struct fec_enc *enc;
+
+	if (!encp)
+		return EINVAL;
+
+	enc = mem_zalloc(sizeof(*enc), NULL);
+	if (!enc)
+		return ENOMEM;
+
+	*encp = enc;
+
+	return 0;
+}
+
+
+/**
+ * Set the FEC group size, the next group uses the new size
+ *
+ * @param enc FEC encoder
+ * @param k   Media packets per repair packet, 0 to disable
+ */
+void fec_enc_set_group(struct fec_enc *enc, unsigned k)
+{
+	if (!enc)
+		return;
+
+	if (k)
+		k = min(max(k, (unsigned)FEC_GROUP_MIN),
+			(unsigned)FEC_GROUP_MAX);
+
+	re_atomic_rlx_set(&enc->k, k);
+}
+
+
+/**
+ * Get the FEC group size
+ *
+ * @param enc FEC encoder
+ *
+ * @return Media packets per repair packet, 0 if disabled
+ */
+unsigned fec_enc_group(const struct fec_enc *enc)
+{
+	return enc ? re_atomic_rlx(&enc->k) : 0;
+}
+
+
+static int repair_encode(struct mbuf **mbp, const struct fec_enc *enc)
+{
+	const struct fec_pkt *par = &enc->parity;
+	struct mbuf *mb;
+	int err = 0;
+
+	mb = mbuf_alloc(PRESZ + FEC_HDR_SIZE + par->len + TRAILSZ);
+	if (!mb)
+		return ENOMEM;
+
+	mb->pos = mb->end = PRESZ;
+
+	/* R=0, F=0 replace the version bits */
+	err |= mbuf_write_u8(mb, par->head[0] & 0x3f);
+	err |= mbuf_write_mem(mb, &par->head[1], HEAD_SIZE - 1);
+	err |= mbuf_write_u16(mb, htons(enc->sn_base));
+	err |= mbuf_write_u16(mb, htons(MASK_K | enc->mask));
+	err |= mbuf_write_mem(mb, par->data, par->len);
+	if (err) {
+		mem_deref(mb);
+		return err;
+	}
+
+	mb->pos = PRESZ;
+	*mbp = mb;
+
+	return 0;
+}
+
+
+/**
+ * Protect a sent media packet
+ *
+ * When the group is complete, the repair packet is returned. It has
+ * headroom for the RTP header with one CSRC.
+ *
+ * @param enc FEC encoder
+ * @param mbp Pointer to repair packet, NULL if the group is not complete
+ * @param hdr RTP header of the media packet
+ * @param p   Media packet after the SSRC (extension and payload)
+ * @param len Length of the media packet after the SSRC
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int fec_enc_packet(struct fec_enc *enc, struct mbuf **mbp,
+		   const struct rtp_header *hdr, const uint8_t *p, size_t len)
+{
+	uint8_t head[HEAD_SIZE];
+	struct fec_pkt *par;
+	uint16_t off;
+	unsigned k;
+	int err;
+
+	if (!enc || !mbp || !hdr || !p)
+		return EINVAL;
+
+	*mbp = NULL;
+
+	k = re_atomic_rlx(&enc->k);
+	if (!k)
+		return 0;
+
+	if (len > MAX_LEN)
+		return EOVERFLOW;
+
+	par = &enc->parity;
+	off = hdr->seq - enc->sn_base;
+
+	/* a new group, or the sequence jumped out of the mask */
+	if (!enc->n || off >= FEC_GROUP_MAX) {
+		memset(par->head, 0, sizeof(par->head));
+		par->len     = 0;
+		enc->sn_base = hdr->seq;
+		enc->mask    = 0;
+		enc->n       = 0;
+		off          = 0;
+	}
+
+	/* clear stale bytes of an earlier group */
+	for (size_t i = par->len; i < len; i++)
+		par->data[i] = 0;
+
+	head_encode(head, hdr, len);
+	xor_mem(par->head, head, HEAD_SIZE);
+	xor_mem(par->data, p, len);
+	par->len = max(par->len, len);
+
+	enc->mask |= (uint16_t)(1 << (14 - off));
+
+	if (++enc->n < k)
+		return 0;
+
+	err = repair_encode(mbp, enc);
+
+	enc->n = 0;
+	++enc->n_repair;
+
+	return err;
+}
+
+
+int fec_enc_debug(struct re_printf *pf, const struct fec_enc *enc)
+{
+	if (!enc)
+		return 0;
+
+	return re_hprintf(pf, "group %u, %llu repair packets",
+			  re_atomic_rlx(&enc->k), enc->n_repair);
+}
+
+
+/**
+ * Allocate a FEC decoder
+ *
+ * @param decp Pointer to allocated FEC decoder
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int fec_dec_alloc(struct fec_dec **decp)
+{
+	struct fec_dec *dec;
+
+	if (!decp)
+		return EINVAL;
+
+	dec = mem_zalloc(sizeof(*dec), NULL);
+	if (!dec)
+		return ENOMEM;
+
+	*decp = dec;
+
+	return 0;
+}
+
+
+/**
+ * Store a received media packet for recovery
+ *
+ * @param dec FEC decoder
+ * @param hdr Decoded RTP header
+ * @param mb  RTP packet, the position is at the payload
+ */
+void fec_dec_media(struct fec_dec *dec, const struct rtp_header *hdr,
+		   const struct mbuf *mb)
+{
+	struct fec_pkt *pkt;
+	size_t start, len;
+
+	if (!dec || !hdr || !mb)
+		return;
+
+	/* the protected data starts after the SSRC */
+	start = hdr->cc * sizeof(uint32_t);
+	if (hdr->ext)
+		start += RTPEXT_HDR_SIZE + hdr->x.len * sizeof(uint32_t);
+
+	if (start > mb->pos)
+		return;
+
+	start = mb->pos - start;
+	len   = mb->end - start;
+	if (len > MAX_LEN)
+		return;
+
+	pkt = &dec->ringv[hdr->seq & (RING_SIZE - 1)];
+
+	head_encode(pkt->head, hdr, len);
+	memcpy(pkt->data, mb->buf + start, len);
+	pkt->len   = len;
+	pkt->ssrc  = hdr->ssrc;
+	pkt->seq   = hdr->seq;
+	pkt->valid = true;
+}
+
+
+static int recovered_encode(struct mbuf **mbp, const struct fec_pkt *pkt)
+{
+	struct mbuf *mb;
+	int err = 0;
+
+	mb = mbuf_alloc(RTP_HEADER_SIZE + pkt->len);
+	if (!mb)
+		return ENOMEM;
+
+	err |= mbuf_write_u8(mb, RTP_VERSION << 6 | (pkt->head[0] & 0x3f));
+	err |= mbuf_write_u8(mb, pkt->head[1]);
+	err |= mbuf_write_u16(mb, htons(pkt->seq));
+	err |= mbuf_write_mem(mb, &pkt->head[4], 4);
+	err |= mbuf_write_u32(mb, htonl(pkt->ssrc));
+	err |= mbuf_write_mem(mb, pkt->data, pkt->len);
+	if (err) {
+		mem_deref(mb);
+		return err;
+	}
+
+	mb->pos = 0;
+	*mbp = mb;
+
+	return 0;
+}
+
+
+/**
+ * Handle a received repair packet, and recover one lost media packet
+ *
+ * @param dec  FEC decoder
+ * @param hdr  Decoded RTP header of the repair packet
+ * @param mb   Repair packet, the position is at the FlexFEC header
+ * @param rech Handler for the recovered media packet
+ * @param arg  Handler argument
+ *
+ * @return 0 if success, ENOENT if more than one packet is missing,
+ *         otherwise errorcode
+ */
+int fec_dec_repair(struct fec_dec *dec, const struct rtp_header *hdr,
+		   const struct mbuf *mb, fec_recover_h *rech, void *arg)
+{
+	const uint8_t *p;
+	struct fec_pkt *rec = NULL;
+	struct rtp_header rhdr;
+	struct mbuf *rmb = NULL;
+	uint16_t sn_base, mask, seq = 0;
+	uint32_t ssrc;
+	unsigned missing = 0;
+	size_t len;
+	int err;
+
+	if (!dec || !hdr || !mb || !rech)
+		return EINVAL;
+
+	if (hdr->cc < 1 || mbuf_get_left(mb) < FEC_HDR_SIZE)
+		return EBADMSG;
+
+	p    = mbuf_buf(mb);
+	len  = mbuf_get_left(mb) - FEC_HDR_SIZE;
+	ssrc = hdr->csrc[0];
+
+	/* retransmissions, fixed masks and longer masks */
+	if ((p[0] & 0xc0) || !(p[10] & 0x80))
+		return ENOTSUP;
+
+	if (len > MAX_LEN)
+		return EOVERFLOW;
+
+	++dec->n_repair;
+
+	sn_base = p[8] << 8 | p[9];
+	mask    = (p[10] << 8 | p[11]) & ~MASK_K;
+
+	for (unsigned i = 0; i < FEC_GROUP_MAX; i++) {
+		const struct fec_pkt *pkt;
+		uint16_t sn = sn_base + i;
+
+		if (!(mask & (1 << (14 - i))))
+			continue;
+
+		pkt = &dec->ringv[sn & (RING_SIZE - 1)];
+		if (!pkt->valid || pkt->seq != sn || pkt->ssrc != ssrc) {
+			++missing;
+			seq = sn;
+		}
+	}
+
+	if (!missing)
+		return 0;
+
+	if (missing > 1) {
+		++dec->n_lost;
+		return ENOENT;
+	}
+
+	/* the missing packet slot is the work buffer */
+	rec = &dec->ringv[seq & (RING_SIZE - 1)];
+
+	memcpy(rec->head, p, HEAD_SIZE);
+	memcpy(rec->data, p + FEC_HDR_SIZE, len);
+	rec->len = len;
+
+	for (unsigned i = 0; i < FEC_GROUP_MAX; i++) {
+		const struct fec_pkt *pkt;
+		uint16_t sn = sn_base + i;
+
+		if (!(mask & (1 << (14 - i))) || sn == seq)
+			continue;
+
+		pkt = &dec->ringv[sn & (RING_SIZE - 1)];
+		if (pkt->len > len) {
+			err = EBADMSG;
+			goto out;
+		}
+
+		xor_pkt(rec, pkt);
+	}
+
+	rec->len = rec->head[2] << 8 | rec->head[3];
+	if (rec->len > len) {
+		err = EBADMSG;
+		goto out;
+	}
+
+	rec->head[0] = RTP_VERSION << 6 | (rec->head[0] & 0x3f);
+	rec->ssrc    = ssrc;
+	rec->seq     = seq;
+	rec->valid   = true;
+
+	err = recovered_encode(&rmb, rec);
+	if (err)
+		goto out;
+
+	err = rtp_hdr_decode(&rhdr, rmb);
+	if (err)
+		goto out;
+
+	++dec->n_recovered;
+
+	rech(&rhdr, rmb, arg);
+
+ out:
+	if (err && rec)
+		rec->valid = false;
+
+	mem_deref(rmb);
+
+	return err;
+}
+
+
+int fec_dec_debug(struct re_printf *pf, const struct fec_dec *dec)
+{
+	if (!dec)
+		return 0;
+
+	return re_hprintf(pf, "%llu repair packets, %llu recovered,"
+			  " %llu unrecoverable",
+			  dec->n_repair, dec->n_recovered, dec->n_lost);
+}
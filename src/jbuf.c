@@ -35,6 +35,11 @@ enum {
 	JBUF_RDIFF_EMA_COEFF = 1024,
 	JBUF_RDIFF_UP_SPEED  = 512,
 	JBUF_PUT_TIMEOUT     = 400,
+	JBUF_PERCENTILE      = 95,        /**< Default target percentile [%] */
+	JBUF_HIST_ONE        = 1 << 30,   /**< Probability 1.0 (Q30)         */
+	JBUF_HIST_FORGET     = 32745,     /**< Forget factor 0.9993 (Q15)    */
+	JBUF_HIST_WIN        = 2000,      /**< Min. delay window [ms]        */
+	JBUF_PEAK_HOLD       = 2000,      /**< Delay peak hold time [ms]     */
 };
 
 
@@ -54,6 +59,8 @@ struct packet {
  */
 struct jbuf {
 	struct list pooll;   /**< List of free packets in pool               */
+	struct packet *packetv; /**< Storage of all packets                  */
+	struct call_arena *arena; /**< Arena of packetv (optional)           */
 	struct list packetl; /**< List of buffered packets                   */
 	uint32_t n;          /**< [# packets] Current # of packets in buffer */
 	uint32_t nf;         /**< [# frames] Current # of frames in buffer   */
@@ -68,6 +75,24 @@ struct jbuf {
 	bool running;        /**< Jitter buffer is running                   */
 	int32_t rdiff;       /**< Average out of order reverse diff          */
 	struct tmr tmr;      /**< Rdiff down timer                           */
+	uint32_t srate;      /**< RTP clock rate, 0 if unknown               */
+	uint32_t pct;        /**< Target delay percentile [%]                */
+	uint32_t fdur;       /**< Frame duration [RTP timestamp units]       */
+	uint32_t ts_put;     /**< Timestamp for last jbuf_put()              */
+
+	/** Relative arrival delay histogram */
+	struct {
+		uint32_t probv[JBUF_HIST_SIZE]; /**< Probabilities (Q30)     */
+		uint32_t n;        /**< Number of delay samples              */
+		bool started;      /**< Reference packet is set              */
+		uint64_t t_ref;    /**< Arrival of reference packet [ms]     */
+		uint32_t ts_ref;   /**< Timestamp of reference packet        */
+		int32_t minv[2];   /**< Min. delay, current/previous window  */
+		uint64_t t_win;    /**< Start of current window [ms]         */
+		uint32_t peak;     /**< Delay peak [ms]                      */
+		uint64_t t_peak;   /**< Time of delay peak [ms]              */
+		uint32_t target;   /**< Target delay [ms]                    */
+	} hist;
 
 	mtx_t *lock;         /**< Makes jitter buffer thread safe            */
 	enum jbuf_type jbtype;  /**< Jitter buffer type                      */
@@ -194,8 +219,11 @@ static void jbuf_destructor(void *data)
 	tmr_cancel(&jb->tmr);
 	jbuf_flush(jb);
 
-	/* Free all packets in the pool list */
-	list_flush(&jb->pooll);
+	/* The packets are freed in one block */
+	list_clear(&jb->pooll);
+	if (!jb->arena)
+		mem_deref(jb->packetv);
+	mem_deref(jb->arena);
 	mem_deref(jb->lock);
 }
 
@@ -210,6 +238,23 @@ static void jbuf_destructor(void *data)
  * @return 0 if success, otherwise errorcode
  */
 int jbuf_alloc(struct jbuf **jbp, uint32_t min, uint32_t max)
+{
+	return jbuf_alloc_arena(jbp, min, max, NULL);
+}
+
+
+/**
+ * Allocate a new jitter buffer with the packets in a call arena
+ *
+ * @param jbp    Pointer to returned jitter buffer
+ * @param min    Minimum delay in [frames]
+ * @param max    Maximum delay in [packets]
+ * @param arena  Call arena for the packets (optional)
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int jbuf_alloc_arena(struct jbuf **jbp, uint32_t min, uint32_t max,
+		     struct call_arena *arena)
 {
 	struct jbuf *jb;
 	uint32_t i;
@@ -235,6 +280,7 @@ int jbuf_alloc(struct jbuf **jbp, uint32_t min, uint32_t max)
 	jb->min  = min;
 	jb->max  = max;
 	jb->wish = min;
+	jb->pct  = JBUF_PERCENTILE;
 	tmr_init(&jb->tmr);
 
 	DEBUG_INFO("alloc: delay=%u-%u frames/packets\n", min, max);
@@ -246,13 +292,27 @@ int jbuf_alloc(struct jbuf **jbp, uint32_t min, uint32_t max)
 
 	mem_destructor(jb, jbuf_destructor);
 
-	/* Allocate all packets now */
-	for (i=0; i<jb->max; i++) {
-		struct packet *f = mem_zalloc(sizeof(*f), NULL);
-		if (!f) {
+	/* Allocate all packets now, in one block */
+	if (max) {
+		if (arena) {
+			jb->packetv = call_arena_zalloc(arena,
+						max * sizeof(*jb->packetv));
+			if (jb->packetv)
+				jb->arena = mem_ref(arena);
+		}
+		else {
+			jb->packetv = mem_zalloc(max * sizeof(*jb->packetv),
+						 NULL);
+		}
+
+		if (!jb->packetv) {
 			err = ENOMEM;
-			break;
+			goto out;
 		}
+	}
+
+	for (i=0; i<jb->max; i++) {
+		struct packet *f = &jb->packetv[i];
 
 		list_append(&jb->pooll, &f->le, f);
 		DEBUG_INFO("alloc: adding to pool list %u\n", i);
@@ -287,6 +347,149 @@ int jbuf_set_type(struct jbuf *jb, enum jbuf_type jbtype)
 }
 
 
+/**
+ * Set the RTP clock rate, which enables the delay histogram
+ *
+ * @param jb    The jitter buffer.
+ * @param srate RTP clock rate in [Hz]
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int jbuf_set_srate(struct jbuf *jb, uint32_t srate)
+{
+	if (!jb)
+		return EINVAL;
+
+	mtx_lock(jb->lock);
+	if (srate != jb->srate) {
+		jb->srate = srate;
+		jb->fdur  = 0;
+		jb->hist.started = false;
+	}
+	mtx_unlock(jb->lock);
+
+	return 0;
+}
+
+
+/**
+ * Set the percentile of the delay histogram used as target delay
+ *
+ * @param jb  The jitter buffer.
+ * @param pct Percentile in [%] (50-100)
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int jbuf_set_percentile(struct jbuf *jb, uint32_t pct)
+{
+	if (!jb || pct < 50 || pct > 100)
+		return EINVAL;
+
+	mtx_lock(jb->lock);
+	jb->pct = pct;
+	mtx_unlock(jb->lock);
+
+	return 0;
+}
+
+
+static void hist_add(struct jbuf *jb, uint32_t delay)
+{
+	const uint32_t bucket = min(delay / JBUF_HIST_MS,
+				    (uint32_t)JBUF_HIST_SIZE - 1);
+	uint32_t forget;
+	uint32_t sum = 0;
+
+	/* plain average for the first samples, then forget exponentially */
+	forget = 32768 - 32768 / (jb->hist.n + 1);
+	forget = min(forget, (uint32_t)JBUF_HIST_FORGET);
+
+	for (size_t i = 0; i < JBUF_HIST_SIZE; i++) {
+		jb->hist.probv[i] = (uint32_t)
+			((uint64_t)jb->hist.probv[i] * forget >> 15);
+		sum += jb->hist.probv[i];
+	}
+
+	/* the sum of all probabilities stays at 1.0 */
+	jb->hist.probv[bucket] += JBUF_HIST_ONE - sum;
+
+	if (jb->hist.n < UINT32_MAX)
+		++jb->hist.n;
+}
+
+
+static uint32_t hist_percentile(const struct jbuf *jb)
+{
+	const uint64_t limit = (uint64_t)JBUF_HIST_ONE * jb->pct / 100;
+	uint64_t sum = 0;
+	size_t i;
+
+	for (i = 0; i < JBUF_HIST_SIZE - 1; i++) {
+		sum += jb->hist.probv[i];
+		if (sum >= limit)
+			break;
+	}
+
+	/* upper edge of the bucket */
+	return (uint32_t)(i + 1) * JBUF_HIST_MS;
+}
+
+
+/*
+ * The arrival delay of a packet is relative to the fastest packet of the
+ * last two windows (2-4 seconds), so clock offset and drift cancel out. The
+ * target delay is the configured percentile of the delay histogram, or a
+ * recent delay peak if that is larger. The peak gives a fast attack, the
+ * forget factor of the histogram and the wish_down() timer a slow decay.
+ */
+static void hist_update(struct jbuf *jb, const struct rtp_header *hdr,
+			uint64_t tr)
+{
+	int32_t d, delay;
+
+	if (!jb->srate)
+		return;
+
+	if (!jb->hist.started) {
+		jb->hist.t_ref   = tr;
+		jb->hist.ts_ref  = hdr->ts;
+		jb->hist.minv[0] = 0;
+		jb->hist.minv[1] = 0;
+		jb->hist.t_win   = tr;
+		jb->hist.started = true;
+	}
+
+	d = (int32_t)(tr - jb->hist.t_ref) -
+	    (int32_t)((int64_t)(int32_t)(hdr->ts - jb->hist.ts_ref) * 1000 /
+		      jb->srate);
+
+	if (tr - jb->hist.t_win > JBUF_HIST_WIN) {
+		jb->hist.minv[1] = jb->hist.minv[0];
+		jb->hist.minv[0] = d;
+		jb->hist.t_win   = tr;
+	}
+	else if (d < jb->hist.minv[0]) {
+		jb->hist.minv[0] = d;
+	}
+
+	delay = d - min(jb->hist.minv[0], jb->hist.minv[1]);
+	if (delay < 0)
+		delay = 0;
+
+	hist_add(jb, (uint32_t)delay);
+
+	if ((uint32_t)delay >= jb->hist.peak) {
+		jb->hist.peak   = delay;
+		jb->hist.t_peak = tr;
+	}
+	else if (tr - jb->hist.t_peak > JBUF_PEAK_HOLD) {
+		jb->hist.peak = 0;
+	}
+
+	jb->hist.target = max(hist_percentile(jb), jb->hist.peak);
+}
+
+
 static void wish_down(void *arg)
 {
 	struct jbuf *jb = arg;
@@ -327,7 +530,18 @@ static void calc_rdiff(struct jbuf *jb, uint16_t seq)
 		jb->wish > 1  ? 2 : 3;
 	jb->rdiff += (adiff - jb->rdiff) * s / JBUF_RDIFF_EMA_COEFF;
 
-	wish = (uint32_t)(jb->rdiff / (float)JBUF_RDIFF_EMA_COEFF / ratio);
+	/* the target delay in frames, if the clock rate is known */
+	if (jb->hist.target && jb->fdur) {
+		uint64_t fms = (uint64_t)jb->fdur * 1000;
+
+		wish = (uint32_t)(((uint64_t)jb->hist.target * jb->srate +
+				   fms - 1) / fms);
+	}
+	else {
+		wish = (uint32_t)(jb->rdiff / (float)JBUF_RDIFF_EMA_COEFF /
+				  ratio);
+	}
+
 	if (wish < jb->min)
 		wish = jb->min;
 
@@ -395,6 +609,9 @@ int jbuf_put(struct jbuf *jb, const struct rtp_header *hdr, void *mem)
 	mtx_lock(jb->lock);
 	jb->ssrc = hdr->ssrc;
 
+	/* late packets count as well */
+	hist_update(jb, hdr, tr);
+
 	if (jb->running) {
 
 		if (jb->jbtype == JBUF_ADAPTIVE)
@@ -463,9 +680,15 @@ int jbuf_put(struct jbuf *jb, const struct rtp_header *hdr, void *mem)
 	plot_jbuf_event(jb, 'S');
 
 success:
+	/* frame duration from two consecutive frames */
+	if (jb->running && seq == (uint16_t)(jb->seq_put + 1) &&
+	    hdr->ts != jb->ts_put && hdr->ts - jb->ts_put < jb->srate)
+		jb->fdur = hdr->ts - jb->ts_put;
+
 	/* Update last sequence */
 	jb->running = true;
 	jb->seq_put = seq;
+	jb->ts_put  = hdr->ts;
 
 	/* Success */
 	f->hdr = *hdr;
@@ -664,6 +887,9 @@ void jbuf_flush(struct jbuf *jb)
 	jb->running = false;
 
 	jb->seq_get = 0;
+
+	/* the histogram is kept, the new stream needs a new reference */
+	jb->hist.started = false;
 #if JBUF_STAT
 	n_flush = STAT_INC(n_flush);
 	memset(&jb->stat, 0, sizeof(jb->stat));
@@ -739,6 +965,37 @@ int jbuf_stats(const struct jbuf *jb, struct jbuf_stat *jstat)
 }
 
 
+/**
+ * Get the relative arrival delay histogram and the target delay
+ *
+ * @param jb   Jitter buffer
+ * @param hist Pointer to histogram storage
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int jbuf_hist(const struct jbuf *jb, struct jbuf_hist *hist)
+{
+	if (!jb || !hist)
+		return EINVAL;
+
+	mtx_lock(jb->lock);
+
+	for (size_t i = 0; i < JBUF_HIST_SIZE; i++) {
+		hist->probv[i] = (uint32_t)
+			((uint64_t)jb->hist.probv[i] * 1000000 >> 30);
+	}
+
+	hist->n      = jb->hist.n;
+	hist->pct    = jb->pct;
+	hist->target = jb->hist.target;
+	hist->wish   = jb->wish;
+
+	mtx_unlock(jb->lock);
+
+	return 0;
+}
+
+
 /**
  * Debug the jitter buffer. This function is thread safe with short blocking
  *
@@ -765,6 +1022,24 @@ int jbuf_debug(struct re_printf *pf, const struct jbuf *jb)
 	err |= mbuf_printf(mb, " min=%u cur=%u/%u max=%u [frames/packets]\n",
 			  jb->min, jb->nf, jb->n, jb->max);
 	err |= mbuf_printf(mb, " seq_put=%u\n", jb->seq_put);
+	if (jb->hist.n) {
+		err |= mbuf_printf(mb, " delay: target=%ums (p%u) wish=%u"
+				   " [ms/frames]\n hist:",
+				   jb->hist.target, jb->pct, jb->wish);
+
+		for (size_t i = 0; i < JBUF_HIST_SIZE; i++) {
+			uint32_t pm = (uint32_t)
+				((uint64_t)jb->hist.probv[i] * 1000 >> 30);
+
+			if (pm)
+				err |= mbuf_printf(mb, " %zu-%zums=%u.%u%%",
+						   i * JBUF_HIST_MS,
+						   (i + 1) * JBUF_HIST_MS,
+						   pm / 10, pm % 10);
+		}
+
+		err |= mbuf_printf(mb, "\n");
+	}
 
 #if JBUF_STAT
 	err |= mbuf_printf(mb, " Stat: put=%u", jb->stat.n_put);
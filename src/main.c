@@ -91,6 +91,7 @@ int main(int argc, char *argv[])
 	const char *execmdv[16];
 	const char *net_interface = NULL;
 	const char *audio_path = NULL;
+	char preload_path[FS_PATH_MAX];
 	const char *modv[16];
 	struct tmr tmr_quit;
 	bool sip_trace = false;
@@ -267,6 +268,11 @@ int main(int argc, char *argv[])
 			      conf_config()->audio.audio_path);
 	}
 
+	/* Decode the audio files once, e.g. the prompts of an IVR */
+	if (0 == conf_get_str(conf_cur(), "file_cache_preload",
+			      preload_path, sizeof(preload_path)))
+		(void)play_cache_preload(baresip_player(), preload_path);
+
 	/* NOTE: must be done after all arguments are processed */
 	if (modc) {
 
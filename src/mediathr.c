@@ -0,0 +1,563 @@
+/**
+ * @file mediathr.c  Placement of media threads
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#include <stdlib.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#ifndef WIN32
+#include <unistd.h>
+#endif
+#include <re.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/*
+ * Media threads place themselves when they start, so they do not compete
+ * with the SIP and TLS processing of the main thread:
+ *
+ * - the CPU set of the thread class ("sched_cpus_<class>")
+ * - SCHED_FIFO for the audio TX and RX threads ("sched_rt_priority")
+ * - memory from the NUMA node the thread runs on ("sched_numa_local"),
+ *   i.e. the buffers a media thread allocates, such as received packets
+ *   and decoded frames, are local to its CPU set
+ *
+ * The audio TX and RX threads of a call are run by media workers. When
+ * the thread function returns, the worker is parked and the next call
+ * reuses it instead of creating a new thread. Up to "sched_thread_pool"
+ * workers are parked per class.
+ */
+
+
+#ifndef MPOL_LOCAL
+#define MPOL_LOCAL 4
+#endif
+
+
+struct placement {
+	RE_ATOMIC uint32_t n_placed;   /* Started threads             */
+	RE_ATOMIC uint32_t n_failed;   /* Threads with a failed step  */
+	RE_ATOMIC int last_err;        /* Error of the last failure   */
+};
+
+struct media_worker {
+	struct le le;                  /* Parked list of its class    */
+	thrd_t thr;
+	enum media_thread cls;
+	cnd_t cnd;                     /* Signals a new job or done   */
+	thrd_start_t fn;               /* Current job, NULL if parked */
+	void *arg;
+	int ret;                       /* Result of the last job      */
+	bool done;
+	bool quit;
+};
+
+
+static struct placement placev[MEDIA_THREAD_MAX];
+
+static struct {
+	mtx_t *mtx;
+	struct list parkedv[MEDIA_THREAD_MAX];
+	uint64_t n_created;
+	uint64_t n_reused;
+} park;
+
+
+static const char *namev[MEDIA_THREAD_MAX] = {
+	"audio_tx",
+	"audio_rx",
+	"audio_drv",
+	"video",
+};
+
+
+#ifdef __linux__
+/* CPU list like "2-3,6" */
+static int cpuset_parse(cpu_set_t *set, const char *str)
+{
+	const char *p = str;
+
+	CPU_ZERO(set);
+
+	while (*p) {
+		unsigned long lo, hi;
+		char *end;
+
+		lo = strtoul(p, &end, 10);
+		if (end == p)
+			return EINVAL;
+
+		hi = lo;
+		p  = end;
+
+		if (*p == '-') {
+			hi = strtoul(p + 1, &end, 10);
+			if (end == p + 1 || hi < lo)
+				return EINVAL;
+
+			p = end;
+		}
+
+		if (hi >= CPU_SETSIZE)
+			return ERANGE;
+
+		for (; lo <= hi; lo++)
+			CPU_SET(lo, set);
+
+		if (*p == ',')
+			++p;
+		else if (*p)
+			return EINVAL;
+	}
+
+	return CPU_COUNT(set) ? 0 : EINVAL;
+}
+
+
+static int set_affinity(const char *cpus)
+{
+	cpu_set_t set;
+	int err;
+
+	err = cpuset_parse(&set, cpus);
+	if (err)
+		return err;
+
+	/* 0 is the calling thread */
+	if (sched_setaffinity(0, sizeof(set), &set))
+		return errno;
+
+	return 0;
+}
+
+
+static int set_numa_local(void)
+{
+#ifdef SYS_set_mempolicy
+	if (syscall(SYS_set_mempolicy, MPOL_LOCAL, NULL, 0))
+		return errno;
+
+	return 0;
+#else
+	return ENOSYS;
+#endif
+}
+#else
+static int set_affinity(const char *cpus)
+{
+	(void)cpus;
+	return ENOSYS;
+}
+
+
+static int set_numa_local(void)
+{
+	return ENOSYS;
+}
+#endif
+
+
+static int set_fifo(uint32_t prio)
+{
+#if defined(HAVE_PTHREAD) && !defined(WIN32)
+	struct sched_param param;
+
+	param.sched_priority = (int)prio;
+
+	return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#else
+	(void)prio;
+	return ENOSYS;
+#endif
+}
+
+
+/**
+ * Get the name of a media thread class
+ *
+ * @param cls Media thread class
+ *
+ * @return Name of the class, as used in the config
+ */
+const char *media_thread_name(enum media_thread cls)
+{
+	if ((unsigned)cls >= MEDIA_THREAD_MAX)
+		return "?";
+
+	return namev[cls];
+}
+
+
+/**
+ * Apply the configured placement to the calling thread
+ *
+ * This is called by a media thread when it starts. The CPU set, the
+ * real-time priority and the NUMA policy are applied independently, a
+ * failed step is logged and does not skip the others.
+ *
+ * @param cls Media thread class of the calling thread
+ *
+ * @return 0 if success, otherwise the errorcode of the last failed step
+ */
+int media_thread_place(enum media_thread cls)
+{
+	const struct config_sched *cfg;
+	struct placement *pl;
+	int err = 0, lerr;
+
+	if ((unsigned)cls >= MEDIA_THREAD_MAX)
+		return EINVAL;
+
+	cfg = &conf_config()->sched;
+	pl  = &placev[cls];
+
+	if (str_isset(cfg->cpus[cls])) {
+		lerr = set_affinity(cfg->cpus[cls]);
+		if (lerr) {
+			warning("mediathr: %s: could not set CPU set %s"
+				" (%m)\n", namev[cls], cfg->cpus[cls], lerr);
+			err = lerr;
+		}
+	}
+
+	if (cfg->rt_prio && (cls == MEDIA_THREAD_AUDIO_TX ||
+			     cls == MEDIA_THREAD_AUDIO_RX)) {
+		lerr = set_fifo(cfg->rt_prio);
+		if (lerr) {
+			warning("mediathr: %s: could not set SCHED_FIFO"
+				" priority %u (%m)\n",
+				namev[cls], cfg->rt_prio, lerr);
+			err = lerr;
+		}
+	}
+
+	if (cfg->numa_local) {
+		lerr = set_numa_local();
+		if (lerr) {
+			warning("mediathr: %s: could not set local NUMA"
+				" policy (%m)\n", namev[cls], lerr);
+			err = lerr;
+		}
+	}
+
+	re_atomic_rlx_add(&pl->n_placed, 1);
+
+	if (err) {
+		re_atomic_rlx_add(&pl->n_failed, 1);
+		re_atomic_rlx_set(&pl->last_err, err);
+	}
+
+	return err;
+}
+
+
+/**
+ * Get the media worker counters
+ *
+ * @param n_created Optional number of created worker threads
+ * @param n_reused  Optional number of jobs run by a parked worker
+ */
+void media_worker_stats(uint64_t *n_created, uint64_t *n_reused)
+{
+	if (!park.mtx) {
+		if (n_created)
+			*n_created = 0;
+		if (n_reused)
+			*n_reused = 0;
+		return;
+	}
+
+	mtx_lock(park.mtx);
+	if (n_created)
+		*n_created = park.n_created;
+	if (n_reused)
+		*n_reused = park.n_reused;
+	mtx_unlock(park.mtx);
+}
+
+
+static void worker_destructor(void *arg)
+{
+	struct media_worker *w = arg;
+
+	cnd_destroy(&w->cnd);
+}
+
+
+static int worker_thread(void *arg)
+{
+	struct media_worker *w = arg;
+
+	mtx_lock(park.mtx);
+
+	while (!w->quit) {
+		thrd_start_t fn = w->fn;
+		void *fnarg = w->arg;
+		int ret;
+
+		if (!fn) {
+			cnd_wait(&w->cnd, park.mtx);
+			continue;
+		}
+
+		mtx_unlock(park.mtx);
+		ret = fn(fnarg);
+		mtx_lock(park.mtx);
+
+		w->fn   = NULL;
+		w->ret  = ret;
+		w->done = true;
+		cnd_broadcast(&w->cnd);
+	}
+
+	mtx_unlock(park.mtx);
+
+	return 0;
+}
+
+
+/* The worker is not parked */
+static void worker_stop(struct media_worker *w)
+{
+	mtx_lock(park.mtx);
+	w->quit = true;
+	cnd_broadcast(&w->cnd);
+	mtx_unlock(park.mtx);
+
+	thrd_join(w->thr, NULL);
+	mem_deref(w);
+}
+
+
+/**
+ * Initialize the media workers
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int media_worker_init(void)
+{
+	if (park.mtx)
+		return 0;
+
+	for (int i = 0; i < MEDIA_THREAD_MAX; i++)
+		list_init(&park.parkedv[i]);
+
+	park.n_created = park.n_reused = 0;
+
+	return mutex_alloc(&park.mtx);
+}
+
+
+/**
+ * Stop all parked media workers
+ */
+void media_worker_close(void)
+{
+	if (!park.mtx)
+		return;
+
+	for (int i = 0; i < MEDIA_THREAD_MAX; i++) {
+
+		mtx_lock(park.mtx);
+		while (!list_isempty(&park.parkedv[i])) {
+			struct media_worker *w;
+
+			w = list_ledata(list_head(&park.parkedv[i]));
+			list_unlink(&w->le);
+			mtx_unlock(park.mtx);
+
+			worker_stop(w);
+
+			mtx_lock(park.mtx);
+		}
+		mtx_unlock(park.mtx);
+	}
+
+	park.mtx = mem_deref(park.mtx);
+}
+
+
+/**
+ * Run a thread function on a media worker
+ *
+ * A parked worker of the same class is reused, otherwise a new thread is
+ * created.
+ *
+ * @param wp   Pointer to the worker, valid until media_worker_join()
+ * @param cls  Media thread class
+ * @param name Name of a new thread
+ * @param fn   Thread function
+ * @param arg  Thread function argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int media_worker_start(struct media_worker **wp, enum media_thread cls,
+		       const char *name, thrd_start_t fn, void *arg)
+{
+	struct media_worker *w;
+	struct le *le;
+	int err;
+
+	if (!wp || (unsigned)cls >= MEDIA_THREAD_MAX || !fn)
+		return EINVAL;
+
+	if (!park.mtx)
+		return EINVAL;
+
+	mtx_lock(park.mtx);
+	le = list_head(&park.parkedv[cls]);
+	if (le) {
+		w = le->data;
+		list_unlink(le);
+
+		w->fn  = fn;
+		w->arg = arg;
+		cnd_broadcast(&w->cnd);
+		++park.n_reused;
+		mtx_unlock(park.mtx);
+
+		*wp = w;
+		return 0;
+	}
+	mtx_unlock(park.mtx);
+
+	w = mem_zalloc(sizeof(*w), NULL);
+	if (!w)
+		return ENOMEM;
+
+	if (cnd_init(&w->cnd) != thrd_success) {
+		mem_deref(w);
+		return ENOMEM;
+	}
+
+	mem_destructor(w, worker_destructor);
+
+	w->cls = cls;
+	w->fn  = fn;
+	w->arg = arg;
+
+	err = thread_create_name(&w->thr, name, worker_thread, w);
+	if (err) {
+		mem_deref(w);
+		return err;
+	}
+
+	mtx_lock(park.mtx);
+	++park.n_created;
+	mtx_unlock(park.mtx);
+
+	*wp = w;
+
+	return 0;
+}
+
+
+/**
+ * Wait for the thread function of a media worker to return
+ *
+ * The worker is parked for reuse, or stopped if enough workers of its
+ * class are parked.
+ *
+ * @param w Media worker
+ *
+ * @return Return value of the thread function
+ */
+int media_worker_join(struct media_worker *w)
+{
+	const uint32_t max_parked = conf_config()->sched.thread_pool;
+	int ret;
+
+	if (!w)
+		return EINVAL;
+
+	mtx_lock(park.mtx);
+
+	while (!w->done)
+		cnd_wait(&w->cnd, park.mtx);
+
+	w->done = false;
+	ret = w->ret;
+
+	if (list_count(&park.parkedv[w->cls]) < max_parked) {
+		list_append(&park.parkedv[w->cls], &w->le, w);
+		mtx_unlock(park.mtx);
+		return ret;
+	}
+
+	mtx_unlock(park.mtx);
+
+	worker_stop(w);
+
+	return ret;
+}
+
+
+/**
+ * Print the media thread placement
+ *
+ * @param pf     Print handler
+ * @param unused Unused parameter
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int media_thread_debug(struct re_printf *pf, void *unused)
+{
+	const struct config_sched *cfg = &conf_config()->sched;
+	long cpus = -1;
+	int err;
+	(void)unused;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+	err = re_hprintf(pf, "Media threads: %ld CPUs online,"
+			 " SCHED_FIFO %u, NUMA local %s\n",
+			 cpus, cfg->rt_prio, cfg->numa_local ? "yes" : "no");
+
+	for (int i = 0; i < MEDIA_THREAD_MAX; i++) {
+		struct placement *pl = &placev[i];
+		const char *set = cfg->cpus[i];
+		int last_err = re_atomic_rlx(&pl->last_err);
+
+		err |= re_hprintf(pf, "  %-10s cpus=%-12s %u threads,"
+				  " %u failed",
+				  namev[i], str_isset(set) ? set : "any",
+				  re_atomic_rlx(&pl->n_placed),
+				  re_atomic_rlx(&pl->n_failed));
+
+		if (last_err)
+			err |= re_hprintf(pf, " (%m)", last_err);
+
+		err |= re_hprintf(pf, "\n");
+	}
+
+	if (!park.mtx)
+		return err;
+
+	mtx_lock(park.mtx);
+
+	err |= re_hprintf(pf, "Media workers: %llu created, %llu reused,"
+			  " parked:", park.n_created, park.n_reused);
+
+	for (int i = 0; i < MEDIA_THREAD_MAX; i++) {
+		err |= re_hprintf(pf, " %s=%u", namev[i],
+				  list_count(&park.parkedv[i]));
+	}
+
+	mtx_unlock(park.mtx);
+
+	err |= re_hprintf(pf, "\n");
+
+	return err;
+}
@@ -0,0 +1,449 @@
+/**
+ * @file moh.c  Shared music-on-hold source
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/**
+ * Calls on hold get their audio from a shared stream instead of their own
+ * audio source. The hold music is read, resampled and encoded once per
+ * codec, format parameters and ptime, and the encoded frames are sent to
+ * all subscribed calls. Each call only writes its own RTP header, i.e.
+ * SSRC, sequence number and timestamp:
+ *
+ \verbatim
+
+ .-------.   .--------.   .--------.       .--------.
+ |       |   |        |   |        |  +--->| call 1 |---> RTP
+ | ausrc |-->| aupoly |-->| encode |--+--->| call 2 |---> RTP
+ |       |   |        |   |        |  +--->| call N |---> RTP
+ '-------'   '--------'   '--------'       '--------'
+
+ \endverbatim
+ *
+ * The hold music is configured with "audio_moh", e.g.
+ * aufile,/usr/share/baresip/moh.wav and restarted at the end of the file.
+ */
+
+
+enum {
+	RESTART_DELAY = 10,     /**< Restart delay of the source [ms] */
+	PAYLOAD_MAX   = 1500,   /**< Maximum encoded frame size       */
+};
+
+
+/** One encoded stream per codec, fmtp and ptime */
+struct moh_stream {
+	struct le le;
+	const struct aucodec *ac;     /**< Audio codec                     */
+	char *fmtp;                   /**< Encoder format parameters       */
+	uint32_t ptime;               /**< Packet time [ms]                */
+	struct auenc_state *enc;      /**< Shared encoder state            */
+	struct ausrc_st *ausrc;       /**< Hold music source               */
+	struct ausrc_prm prm;         /**< Format of the source            */
+	struct aupoly *rs;            /**< Resampler to the codec format   */
+	int16_t *rsv;                 /**< Resampled samples               */
+	size_t rsc;                   /**< Capacity of rsv                 */
+	int16_t *sampv;               /**< One frame for the encoder       */
+	size_t sampc;                 /**< Samples per frame               */
+	size_t fill;                  /**< Samples in sampv                */
+	uint8_t *buf;                 /**< Encoded frame                   */
+	struct tmr tmr;               /**< Restart of the source           */
+	struct list subl;             /**< Subscribers (struct moh_sub)    */
+	mtx_t *mtx;                   /**< Protects subl                   */
+	uint64_t n_frames;            /**< Encoded frames                  */
+};
+
+/** A call subscribed to a shared stream */
+struct moh_sub {
+	struct le le;
+	struct moh_stream *ms;
+	moh_frame_h *frameh;
+	void *arg;
+};
+
+
+static struct list streaml;
+
+
+static void stream_destructor(void *arg)
+{
+	struct moh_stream *ms = arg;
+
+	/* the source must be stopped first */
+	ms->ausrc = mem_deref(ms->ausrc);
+
+	tmr_cancel(&ms->tmr);
+	list_unlink(&ms->le);
+
+	mem_deref(ms->enc);
+	mem_deref(ms->fmtp);
+	mem_deref(ms->rs);
+	mem_deref(ms->rsv);
+	mem_deref(ms->sampv);
+	mem_deref(ms->buf);
+	mem_deref(ms->mtx);
+}
+
+
+static void sub_destructor(void *arg)
+{
+	struct moh_sub *sub = arg;
+
+	/* no more frames when this returns */
+	mtx_lock(sub->ms->mtx);
+	list_unlink(&sub->le);
+	mtx_unlock(sub->ms->mtx);
+
+	mem_deref(sub->ms);
+}
+
+
+static bool fmtp_equal(const char *a, const char *b)
+{
+	if (!str_isset(a) || !str_isset(b))
+		return str_isset(a) == str_isset(b);
+
+	return 0 == str_cmp(a, b);
+}
+
+
+/*
+ * @note This function has REAL-TIME properties
+ */
+static void encode_frame(struct moh_stream *ms)
+{
+	struct auframe af;
+	bool marker = false;
+	size_t len = PAYLOAD_MAX;
+	struct le *le;
+	int err;
+
+	auframe_init(&af, AUFMT_S16LE, ms->sampv, ms->sampc,
+		     ms->ac->srate, ms->ac->ch);
+
+	err = ms->ac->ench(ms->enc, &marker, ms->buf, &len,
+			   af.fmt, af.sampv, af.sampc);
+	if (err) {
+		warning("moh: %s encode error (%m)\n", ms->ac->name, err);
+		return;
+	}
+
+	++ms->n_frames;
+
+	mtx_lock(ms->mtx);
+
+	for (le = ms->subl.head; le; le = le->next) {
+		struct moh_sub *sub = le->data;
+
+		sub->frameh(&af, marker, ms->buf, len, sub->arg);
+	}
+
+	mtx_unlock(ms->mtx);
+}
+
+
+/*
+ * @note This function may be called from any thread
+ */
+static void ausrc_read_handler(struct auframe *af, void *arg)
+{
+	struct moh_stream *ms = arg;
+	const int16_t *sampv = af->sampv;
+	size_t sampc = af->sampc;
+
+	if (af->fmt != AUFMT_S16LE)
+		return;
+
+	if (ms->rs) {
+		size_t outc = aupoly_maxoutc(ms->rs, sampc);
+
+		if (outc > ms->rsc) {
+			int16_t *rsv = mem_realloc(ms->rsv,
+						   outc * sizeof(int16_t));
+			if (!rsv)
+				return;
+
+			ms->rsv = rsv;
+			ms->rsc = outc;
+		}
+
+		if (aupoly_process(ms->rs, ms->rsv, &outc, sampv, sampc))
+			return;
+
+		sampv = ms->rsv;
+		sampc = outc;
+	}
+
+	/* the source may deliver other frame sizes than the codec */
+	while (sampc) {
+		size_t n = min(sampc, ms->sampc - ms->fill);
+
+		memcpy(&ms->sampv[ms->fill], sampv, n * sizeof(int16_t));
+
+		ms->fill += n;
+		sampv    += n;
+		sampc    -= n;
+
+		if (ms->fill == ms->sampc) {
+			encode_frame(ms);
+			ms->fill = 0;
+		}
+	}
+}
+
+
+static int source_start(struct moh_stream *ms);
+
+
+static void restart_handler(void *arg)
+{
+	struct moh_stream *ms = arg;
+	int err;
+
+	ms->ausrc = mem_deref(ms->ausrc);
+
+	err = source_start(ms);
+	if (err)
+		warning("moh: could not restart source (%m)\n", err);
+}
+
+
+static void ausrc_error_handler(int err, const char *str, void *arg)
+{
+	struct moh_stream *ms = arg;
+
+	debug("moh: source stopped: %s (%m)\n", str, err);
+
+	/* loop the hold music, the source is not freed from its handler */
+	tmr_start(&ms->tmr, RESTART_DELAY, restart_handler, ms);
+}
+
+
+static int source_start(struct moh_stream *ms)
+{
+	const struct config_audio *cfg = &conf_config()->audio;
+	struct ausrc_prm prm;
+	int err;
+
+	prm.srate = ms->ac->srate;
+	prm.ch    = ms->ac->ch;
+	prm.ptime = ms->ptime;
+	prm.fmt   = AUFMT_S16LE;
+
+	err = ausrc_alloc(&ms->ausrc, baresip_ausrcl(), cfg->moh_mod, &prm,
+			  cfg->moh_dev, ausrc_read_handler,
+			  ausrc_error_handler, ms);
+	if (err)
+		return err;
+
+	/* the source may change the format, e.g. of a file */
+	if (prm.fmt != AUFMT_S16LE) {
+		ms->ausrc = mem_deref(ms->ausrc);
+		return ENOTSUP;
+	}
+
+	if (prm.srate == ms->ac->srate && prm.ch == ms->ac->ch) {
+		ms->rs = mem_deref(ms->rs);
+	}
+	else if (!aupoly_match(ms->rs, prm.srate, prm.ch,
+			       ms->ac->srate, ms->ac->ch)) {
+		ms->rs = mem_deref(ms->rs);
+		err = aupoly_alloc(&ms->rs, prm.srate, prm.ch,
+				   ms->ac->srate, ms->ac->ch);
+		if (err)
+			return err;
+	}
+
+	ms->prm = prm;
+
+	return 0;
+}
+
+
+static int moh_stream_alloc(struct moh_stream **msp,
+			    const struct aucodec *ac, const char *fmtp,
+			    uint32_t ptime)
+{
+	struct moh_stream *ms;
+	int err;
+
+	ms = mem_zalloc(sizeof(*ms), stream_destructor);
+	if (!ms)
+		return ENOMEM;
+
+	ms->ac    = ac;
+	ms->ptime = ptime;
+	ms->sampc = (size_t)ac->srate * ac->ch * ptime / 1000;
+
+	tmr_init(&ms->tmr);
+
+	ms->sampv = mem_alloc(ms->sampc * sizeof(int16_t), NULL);
+	ms->buf   = mem_alloc(PAYLOAD_MAX, NULL);
+	if (!ms->sampv || !ms->buf) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	err = mutex_alloc(&ms->mtx);
+	if (err)
+		goto out;
+
+	if (str_isset(fmtp)) {
+		err = str_dup(&ms->fmtp, fmtp);
+		if (err)
+			goto out;
+	}
+
+	if (ac->encupdh) {
+		struct auenc_param prm;
+
+		prm.bitrate = 0;        /* auto */
+
+		err = ac->encupdh(&ms->enc, ac, &prm, ms->fmtp);
+		if (err)
+			goto out;
+	}
+
+	list_append(&streaml, &ms->le, ms);
+
+	err = source_start(ms);
+	if (err)
+		goto out;
+
+	info("moh: %s %uHz/%uch %ums from %s,%s\n", ac->name,
+	     ac->srate, ac->ch, ptime, conf_config()->audio.moh_mod,
+	     conf_config()->audio.moh_dev);
+
+ out:
+	if (err)
+		mem_deref(ms);
+	else
+		*msp = ms;
+
+	return err;
+}
+
+
+/**
+ * Check if music-on-hold is configured
+ *
+ * @return True if configured, otherwise false
+ */
+bool moh_enabled(void)
+{
+	const struct config *cfg = conf_config();
+
+	return cfg && str_isset(cfg->audio.moh_mod);
+}
+
+
+/**
+ * Subscribe to the music-on-hold stream of a codec, fmtp and ptime
+ *
+ * The frame handler is called from the thread of the audio source, the
+ * subscription is ended by dereferencing it.
+ *
+ * @param subp   Pointer to allocated subscription
+ * @param ac     Audio codec
+ * @param fmtp   Encoder format parameters (optional)
+ * @param ptime  Packet time [ms]
+ * @param frameh Handler for encoded frames
+ * @param arg    Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int moh_subscribe(struct moh_sub **subp, const struct aucodec *ac,
+		  const char *fmtp, uint32_t ptime,
+		  moh_frame_h *frameh, void *arg)
+{
+	struct moh_stream *ms = NULL;
+	struct moh_sub *sub;
+	struct le *le;
+	int err;
+
+	if (!subp || !ac || !ac->ench || !ptime || !frameh)
+		return EINVAL;
+
+	if (!moh_enabled())
+		return ENOENT;
+
+	for (le = streaml.head; le; le = le->next) {
+		struct moh_stream *s = le->data;
+
+		/* e.g. the remote Opus parameters change the encoding */
+		if (s->ac == ac && s->ptime == ptime &&
+		    fmtp_equal(s->fmtp, fmtp)) {
+			ms = mem_ref(s);
+			break;
+		}
+	}
+
+	if (!ms) {
+		err = moh_stream_alloc(&ms, ac, fmtp, ptime);
+		if (err)
+			return err;
+	}
+
+	sub = mem_zalloc(sizeof(*sub), sub_destructor);
+	if (!sub) {
+		mem_deref(ms);
+		return ENOMEM;
+	}
+
+	sub->ms     = ms;
+	sub->frameh = frameh;
+	sub->arg    = arg;
+
+	mtx_lock(ms->mtx);
+	list_append(&ms->subl, &sub->le, sub);
+	mtx_unlock(ms->mtx);
+
+	*subp = sub;
+
+	return 0;
+}
+
+
+/**
+ * Print the music-on-hold streams
+ *
+ * @param pf     Print handler
+ * @param unused Unused parameter
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int moh_debug(struct re_printf *pf, void *unused)
+{
+	struct le *le;
+	int err;
+	(void)unused;
+
+	err = re_hprintf(pf, "Music on hold: %s,%s (%u streams)\n",
+			 conf_config()->audio.moh_mod,
+			 conf_config()->audio.moh_dev, list_count(&streaml));
+
+	for (le = streaml.head; le; le = le->next) {
+		const struct moh_stream *ms = le->data;
+		uint32_t n;
+
+		mtx_lock(ms->mtx);
+		n = list_count(&ms->subl);
+		mtx_unlock(ms->mtx);
+
+		err |= re_hprintf(pf, "  %s %uHz/%uch %ums fmtp=%s: %u calls,"
+				  " %llu frames, source %uHz/%uch\n",
+				  ms->ac->name, ms->ac->srate, ms->ac->ch,
+				  ms->ptime, ms->fmtp ? ms->fmtp : "",
+				  n, ms->n_frames,
+				  ms->prm.srate, ms->prm.ch);
+	}
+
+	return err;
+}
@@ -5,13 +5,22 @@
  */
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef WIN32
+#include <dirent.h>
+#endif
 #include <re.h>
 #include <rem.h>
 #include <baresip.h>
 #include "core.h"
 
 
-enum {PTIME = 40};
+enum {
+	PTIME            = 40,
+	CACHE_SIZE       = 4096,    /**< Default cache size [KB]  */
+	CACHE_HASH_SIZE  = 32,
+};
 
 /** Audio file player */
 struct play {
@@ -19,6 +28,7 @@ struct play {
 	struct play **playp;
 	mtx_t lock;
 	struct mbuf *mb;
+	size_t pos;
 	struct auplay_st *auplay;
 	char *mod;
 	char *dev;
@@ -47,6 +57,31 @@ static const char default_play_path[FS_PATH_MAX] = PREFIX "/share/baresip";
 struct player {
 	struct list playl;
 	char play_path[FS_PATH_MAX];
+
+	/** Cache of decoded audio files, shared by all players */
+	struct {
+		struct hash *ht;     /**< Entries by path           */
+		struct list lrul;    /**< Least recently used first */
+		mtx_t *lock;         /**< Protects the cache        */
+		size_t size;         /**< Current size [bytes]      */
+		size_t max;          /**< Maximum size [bytes]      */
+		uint64_t n_hit;      /**< Cache hits                */
+		uint64_t n_miss;     /**< Cache misses              */
+		uint64_t n_evict;    /**< Evicted entries           */
+	} cache;
+};
+
+
+/** A decoded audio file, the PCM buffer is shared with the players */
+struct cache_entry {
+	struct le he;
+	struct le le;
+	char *path;
+	struct mbuf *mb;
+	uint32_t srate;
+	uint8_t ch;
+	time_t mtime;
+	off_t fsize;
 };
 
 
@@ -134,20 +169,22 @@ static void write_handler(struct auframe *af, void *arg)
 	if (play->eof)
 		goto silence;
 
+	/* the PCM buffer may be shared, it is not modified */
 	while (pos < sz) {
-		left = mbuf_get_left(play->mb);
+		left = play->mb->end - play->pos;
 		count = (left > sz - pos) ? sz - pos : left;
 
-		(void)mbuf_read_mem(play->mb, (uint8_t *)af->sampv + pos,
-				    count);
+		memcpy((uint8_t *)af->sampv + pos,
+		       play->mb->buf + play->pos, count);
 
+		play->pos += count;
 		pos += count;
 
 		if (pos < sz) {
 			if (!check_restart(play))
 				goto silence;
 
-			play->mb->pos = 0;
+			play->pos = 0;
 		}
 	}
 
@@ -200,8 +237,9 @@ static int aufile_load(struct mbuf *mb, const char *filename,
 
 	while (!err) {
 		uint8_t buf[4096];
+		int16_t sampv[4096];
+		const int16_t *p = (void *)buf;
 		size_t i, n;
-		int16_t *p = (void *)buf;
 
 		n = sizeof(buf);
 
@@ -209,35 +247,34 @@ static int aufile_load(struct mbuf *mb, const char *filename,
 		if (err || !n)
 			break;
 
+		/* convert a block, then write it at once */
 		switch (prm.fmt) {
 
 		case AUFMT_S16LE:
 			/* convert from Little-Endian to Native-Endian */
-			for (i=0; i<n/2; i++) {
-				int16_t s = sys_ltohs(*p++);
-				err |= mbuf_write_u16(mb, s);
-			}
-
+			n /= 2;
+			for (i=0; i<n; i++)
+				sampv[i] = sys_ltohs(p[i]);
 			break;
 
 		case AUFMT_PCMA:
-			for (i=0; i<n; i++) {
-				err |= mbuf_write_u16(mb,
-						      g711_alaw2pcm(buf[i]));
-			}
+			for (i=0; i<n; i++)
+				sampv[i] = g711_alaw2pcm(buf[i]);
 			break;
 
 		case AUFMT_PCMU:
-			for (i=0; i<n; i++) {
-				err |= mbuf_write_u16(mb,
-						      g711_ulaw2pcm(buf[i]));
-			}
+			for (i=0; i<n; i++)
+				sampv[i] = g711_ulaw2pcm(buf[i]);
 			break;
 
 		default:
 			err = ENOSYS;
 			break;
 		}
+
+		if (!err)
+			err = mbuf_write_mem(mb, (void *)sampv,
+					     n * sizeof(int16_t));
 	}
 
 	mem_deref(af);
@@ -253,6 +290,142 @@ static int aufile_load(struct mbuf *mb, const char *filename,
 }
 
 
+static void cache_entry_destructor(void *data)
+{
+	struct cache_entry *ent = data;
+
+	hash_unlink(&ent->he);
+	list_unlink(&ent->le);
+	mem_deref(ent->path);
+	mem_deref(ent->mb);
+}
+
+
+static bool cache_cmp_handler(struct le *le, void *arg)
+{
+	const struct cache_entry *ent = le->data;
+
+	return 0 == str_cmp(ent->path, arg);
+}
+
+
+static struct cache_entry *cache_lookup(const struct player *player,
+					const char *path)
+{
+	return list_ledata(hash_lookup(player->cache.ht,
+				       hash_joaat_str(path),
+				       cache_cmp_handler, (void *)path));
+}
+
+
+static void cache_remove(struct player *player, struct cache_entry *ent)
+{
+	player->cache.size -= ent->mb->end;
+	mem_deref(ent);
+}
+
+
+/* Insert a new entry, the least recently used entries make room */
+static void cache_insert(struct player *player, const char *path,
+			 const struct stat *st, struct mbuf *mb,
+			 uint32_t srate, uint8_t ch)
+{
+	struct cache_entry *ent;
+
+	if (mb->end > player->cache.max || cache_lookup(player, path))
+		return;
+
+	while (player->cache.size + mb->end > player->cache.max) {
+		cache_remove(player, list_ledata(list_head(
+					     &player->cache.lrul)));
+		++player->cache.n_evict;
+	}
+
+	ent = mem_zalloc(sizeof(*ent), cache_entry_destructor);
+	if (!ent)
+		return;
+
+	if (str_dup(&ent->path, path)) {
+		mem_deref(ent);
+		return;
+	}
+
+	ent->mb    = mem_ref(mb);
+	ent->srate = srate;
+	ent->ch    = ch;
+	ent->mtime = st->st_mtime;
+	ent->fsize = st->st_size;
+
+	hash_append(player->cache.ht, hash_joaat_str(path), &ent->he, ent);
+	list_append(&player->cache.lrul, &ent->le, ent);
+	player->cache.size += mb->end;
+}
+
+
+/*
+ * Load a decoded audio file from the cache, or decode it and add it to
+ * the cache. An entry is replaced if the file was modified.
+ */
+static int cache_load(struct player *player, struct mbuf **mbp,
+		      const char *path, uint32_t *srate, uint8_t *ch)
+{
+	struct cache_entry *ent;
+	struct mbuf *mb;
+	struct stat st;
+	bool cache;
+	int err;
+
+	cache = player->cache.max && 0 == stat(path, &st);
+
+	if (cache) {
+		mtx_lock(player->cache.lock);
+
+		ent = cache_lookup(player, path);
+		if (ent && ent->mtime == st.st_mtime &&
+		    ent->fsize == st.st_size) {
+
+			/* most recently used */
+			list_unlink(&ent->le);
+			list_append(&player->cache.lrul, &ent->le, ent);
+
+			*mbp   = mem_ref(ent->mb);
+			*srate = ent->srate;
+			*ch    = ent->ch;
+			++player->cache.n_hit;
+
+			mtx_unlock(player->cache.lock);
+			return 0;
+		}
+
+		if (ent)
+			cache_remove(player, ent);
+
+		++player->cache.n_miss;
+		mtx_unlock(player->cache.lock);
+	}
+
+	mb = mbuf_alloc(1024);
+	if (!mb)
+		return ENOMEM;
+
+	err = aufile_load(mb, path, srate, ch);
+	if (err) {
+		mem_deref(mb);
+		return err;
+	}
+
+	if (cache) {
+		mtx_lock(player->cache.lock);
+		cache_insert(player, path, &st, mb, *srate, *ch);
+		mtx_unlock(player->cache.lock);
+	}
+
+	*mbp = mb;
+
+	return 0;
+}
+
+
 /**
  * Play a tone from a PCM buffer
  *
@@ -288,6 +461,7 @@ int play_tone(struct play **playp, struct player *player,
 	tmr_init(&play->tmr);
 	play->repeat = repeat ? repeat : 1;
 	play->mb     = mem_ref(tone);
+	play->pos    = tone->pos;
 
 	err = mtx_init(&play->lock, mtx_plain) != thrd_success;
 	if (err) {
@@ -571,11 +745,7 @@ int play_file(struct play **playp, struct player *player,
 		}
 	}
 
-	mb = mbuf_alloc(1024);
-	if (!mb)
-		return ENOMEM;
-
-	err = aufile_load(mb, path, &srate, &ch);
+	err = cache_load(player, &mb, path, &srate, &ch);
 	if (err) {
 		warning("play: %s: %m\n", path, err);
 		goto out;
@@ -623,6 +793,9 @@ static void player_destructor(void *data)
 	struct player *player = data;
 
 	list_flush(&player->playl);
+	hash_flush(player->cache.ht);
+	mem_deref(player->cache.ht);
+	mem_deref(player->cache.lock);
 }
 
 
@@ -636,6 +809,8 @@ static void player_destructor(void *data)
 int play_init(struct player **playerp)
 {
 	struct player *player;
+	uint32_t kbytes = CACHE_SIZE;
+	int err;
 
 	if (!playerp)
 		return EINVAL;
@@ -649,6 +824,16 @@ int play_init(struct player **playerp)
 	str_ncpy(player->play_path, default_play_path,
 		 sizeof(player->play_path));
 
+	(void)conf_get_u32(conf_cur(), "file_cache_size", &kbytes);
+	player->cache.max = (size_t)kbytes * 1024;
+
+	err  = hash_alloc(&player->cache.ht, CACHE_HASH_SIZE);
+	err |= mutex_alloc(&player->cache.lock);
+	if (err) {
+		mem_deref(player);
+		return err;
+	}
+
 	*playerp = player;
 
 	return 0;
@@ -668,3 +853,92 @@ void play_set_path(struct player *player, const char *path)
 
 	str_ncpy(player->play_path, path, sizeof(player->play_path));
 }
+
+
+/**
+ * Decode all WAV files of a directory into the cache, e.g. the prompts
+ * of an IVR
+ *
+ * @param player Player state
+ * @param dir    Directory with audio files
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int play_cache_preload(struct player *player, const char *dir)
+{
+#ifdef WIN32
+	(void)player;
+	(void)dir;
+	return ENOSYS;
+#else
+	struct dirent *dp;
+	DIR *dirp;
+	unsigned n = 0;
+
+	if (!player || !dir)
+		return EINVAL;
+
+	dirp = opendir(dir);
+	if (!dirp)
+		return errno;
+
+	while ((dp = readdir(dirp)) != NULL) {
+
+		char path[FS_PATH_MAX];
+		size_t len = strlen(dp->d_name);
+		struct mbuf *mb = NULL;
+		uint32_t srate;
+		uint8_t ch;
+
+		if (len <= 4 || str_casecmp(&dp->d_name[len - 4], ".wav"))
+			continue;
+
+		if (re_snprintf(path, sizeof(path), "%s/%s",
+				dir, dp->d_name) < 0)
+			continue;
+
+		if (cache_load(player, &mb, path, &srate, &ch)) {
+			warning("play: preload %s failed\n", path);
+			continue;
+		}
+
+		mem_deref(mb);
+		++n;
+	}
+
+	(void)closedir(dirp);
+
+	info("play: preloaded %u files from %s (%zu KB)\n",
+	     n, dir, player->cache.size / 1024);
+
+	return 0;
+#endif
+}
+
+
+/**
+ * Print the audio file cache
+ *
+ * @param pf     Print handler
+ * @param player Player state
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int play_debug(struct re_printf *pf, const struct player *player)
+{
+	int err;
+
+	if (!player)
+		return 0;
+
+	mtx_lock(player->cache.lock);
+	err = re_hprintf(pf, "play: cache %u files, %zu/%zu KB,"
+			 " %llu hits, %llu misses, %llu evicted\n",
+			 list_count(&player->cache.lrul),
+			 player->cache.size / 1024, player->cache.max / 1024,
+			 player->cache.n_hit, player->cache.n_miss,
+			 player->cache.n_evict);
+	mtx_unlock(player->cache.lock);
+
+	return err;
+}
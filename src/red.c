@@ -0,0 +1,438 @@
+/**
+ * @file red.c  Redundant audio data (RFC 2198)
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <baresip.h>
+
+
+/*
+ * RTP Payload for Redundant Audio Data (RFC 2198).
+ *
+ * Each packet carries the primary frame and copies of the previous
+ * frames, so a lost frame can be taken from one of the next packets.
+ * The redundant blocks do not have a sequence number, block n of N is
+ * assumed to be the packet with sequence number seq - (N - n), which
+ * holds as long as the sender puts every sent frame in the next packets.
+ */
+
+
+enum {
+	BLOCK_MAX  = 1023,     /* Max. length of a redundant block [bytes] */
+	OFFSET_MAX = 0x3fff,   /* Max. timestamp offset of a block         */
+	BLOCKS_MAX = 8,        /* Max. redundant blocks in a packet        */
+	HIST_SIZE  = 64,       /* Sequence numbers in the receive history  */
+};
+
+
+struct red_frame {
+	uint8_t data[BLOCK_MAX];
+	size_t len;
+	uint32_t ts;
+	uint8_t pt;
+	bool valid;
+};
+
+struct red_enc {
+	struct red_frame framev[RED_LEVEL_MAX];  /**< Previous frames  */
+	struct mbuf *mb;               /**< Buffer for the RED payload      */
+	unsigned level;                /**< Redundant frames per packet     */
+};
+
+struct red_dec {
+	uint64_t hist;                 /**< Bit n set: seq - n was received */
+	uint32_t ssrc;                 /**< Synchronization source          */
+	uint16_t seq;                  /**< Highest sequence number         */
+	bool started;                  /**< Sequence number is set          */
+	uint64_t n_red;                /**< Redundant packets received      */
+	uint64_t n_recovered;          /**< Lost frames recovered           */
+	uint64_t n_err;                /**< Malformed packets               */
+};
+
+
+struct red_block {
+	uint8_t pt;
+	uint16_t offset;
+	size_t len;
+};
+
+
+static void enc_destructor(void *arg)
+{
+	struct red_enc *enc = arg;
+
+	mem_deref(enc->mb);
+}
+
+
+/**
+ * Allocate a RED encoder
+ *
+ * @param encp  Pointer to allocated RED encoder
+ * @param level Number of previous frames in each packet (1-2)
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int red_enc_alloc(struct red_enc **encp, unsigned level)
+{
+	struct red_enc *enc;
+
+	if (!encp || !level || level > RED_LEVEL_MAX)
+		return EINVAL;
+
+	enc = mem_zalloc(sizeof(*enc), enc_destructor);
+	if (!enc)
+		return ENOMEM;
+
+	enc->mb = mbuf_alloc(512);
+	if (!enc->mb) {
+		mem_deref(enc);
+		return ENOMEM;
+	}
+
+	enc->level = level;
+
+	*encp = enc;
+
+	return 0;
+}
+
+
+static void enc_save(struct red_enc *enc, uint8_t pt, uint32_t ts,
+		     const uint8_t *p, size_t len)
+{
+	struct red_frame *frm;
+
+	memmove(&enc->framev[0], &enc->framev[1],
+		(RED_LEVEL_MAX - 1) * sizeof(enc->framev[0]));
+
+	frm = &enc->framev[RED_LEVEL_MAX - 1];
+
+	/* too large for a redundant block */
+	frm->valid = len <= BLOCK_MAX;
+	if (!frm->valid)
+		return;
+
+	memcpy(frm->data, p, len);
+	frm->len = len;
+	frm->ts  = ts;
+	frm->pt  = pt;
+}
+
+
+/* The blocks must be the frames right before the primary frame */
+static unsigned enc_first(const struct red_enc *enc, uint32_t ts)
+{
+	unsigned i = RED_LEVEL_MAX;
+
+	while (i > RED_LEVEL_MAX - enc->level) {
+		const struct red_frame *frm = &enc->framev[i - 1];
+
+		if (!frm->valid || ts - frm->ts > OFFSET_MAX)
+			break;
+
+		--i;
+	}
+
+	return i;
+}
+
+
+/**
+ * Encode a frame as RED payload with the previous frames
+ *
+ * @param enc RED encoder
+ * @param mb  Packet buffer, the position is at the encoded frame. The
+ *            buffer is updated with the RED payload.
+ * @param pt  Payload type of the frame
+ * @param ts  RTP timestamp of the frame
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int red_enc_encode(struct red_enc *enc, struct mbuf *mb, uint8_t pt,
+		   uint32_t ts)
+{
+	const size_t pos = mb ? mb->pos : 0;
+	struct mbuf *rmb;
+	unsigned first;
+	int err = 0;
+
+	if (!enc || !mb)
+		return EINVAL;
+
+	rmb = enc->mb;
+	mbuf_rewind(rmb);
+
+	first = enc_first(enc, ts);
+
+	for (unsigned i = first; i < RED_LEVEL_MAX; i++) {
+		const struct red_frame *frm = &enc->framev[i];
+
+		err |= mbuf_write_u32(rmb, htonl(1u << 31 |
+						 (uint32_t)frm->pt << 24 |
+						 (ts - frm->ts) << 10 |
+						 (uint32_t)frm->len));
+	}
+
+	err |= mbuf_write_u8(rmb, pt & 0x7f);
+
+	for (unsigned i = first; i < RED_LEVEL_MAX; i++) {
+		const struct red_frame *frm = &enc->framev[i];
+
+		err |= mbuf_write_mem(rmb, frm->data, frm->len);
+	}
+
+	err |= mbuf_write_mem(rmb, mbuf_buf(mb), mbuf_get_left(mb));
+	if (err)
+		return err;
+
+	enc_save(enc, pt, ts, mbuf_buf(mb), mbuf_get_left(mb));
+
+	mb->end = pos;
+	err = mbuf_write_mem(mb, rmb->buf, rmb->end);
+	mb->pos = pos;
+
+	return err;
+}
+
+
+/**
+ * Allocate a RED decoder
+ *
+ * @param decp Pointer to allocated RED decoder
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int red_dec_alloc(struct red_dec **decp)
+{
+	struct red_dec *dec;
+
+	if (!decp)
+		return EINVAL;
+
+	dec = mem_zalloc(sizeof(*dec), NULL);
+	if (!dec)
+		return ENOMEM;
+
+	*decp = dec;
+
+	return 0;
+}
+
+
+static void hist_set(struct red_dec *dec, uint16_t seq)
+{
+	int16_t d = (int16_t)(seq - dec->seq);
+
+	if (d > 0) {
+		dec->hist = d < HIST_SIZE ? dec->hist << d : 0;
+		dec->hist |= 1;
+		dec->seq = seq;
+	}
+	else if (-d < HIST_SIZE) {
+		dec->hist |= 1ULL << -d;
+	}
+}
+
+
+/* Packets before the history are treated as received */
+static bool hist_isset(const struct red_dec *dec, uint16_t seq)
+{
+	int16_t d = (int16_t)(dec->seq - seq);
+
+	if (d < 0)
+		return false;
+
+	return d >= HIST_SIZE || (dec->hist & (1ULL << d));
+}
+
+
+/**
+ * Record a received packet without redundancy
+ *
+ * @param dec RED decoder
+ * @param hdr Decoded RTP header
+ */
+void red_dec_media(struct red_dec *dec, const struct rtp_header *hdr)
+{
+	if (!dec || !hdr)
+		return;
+
+	if (!dec->started || hdr->ssrc != dec->ssrc) {
+		dec->hist    = 0;
+		dec->seq     = hdr->seq;
+		dec->ssrc    = hdr->ssrc;
+		dec->started = true;
+	}
+
+	hist_set(dec, hdr->seq);
+}
+
+
+static int blocks_decode(struct red_block *blkv, size_t *nblk,
+			 size_t *hlenp, uint8_t *ptp,
+			 const uint8_t *p, size_t len)
+{
+	size_t n = 0, sum = 0, hlen = 0;
+
+	for (;;) {
+		uint32_t v;
+
+		if (hlen >= len)
+			return EBADMSG;
+
+		/* the last header is for the primary block */
+		if (!(p[hlen] & 0x80)) {
+			*ptp = p[hlen++] & 0x7f;
+			break;
+		}
+
+		if (len - hlen < 4)
+			return EBADMSG;
+
+		if (n >= BLOCKS_MAX)
+			return EOVERFLOW;
+
+		v = (uint32_t)p[hlen] << 24 | (uint32_t)p[hlen+1] << 16 |
+		    (uint32_t)p[hlen+2] << 8 | p[hlen+3];
+
+		blkv[n].pt     = (v >> 24) & 0x7f;
+		blkv[n].offset = (v >> 10) & OFFSET_MAX;
+		blkv[n].len    = v & BLOCK_MAX;
+
+		sum  += blkv[n].len;
+		hlen += 4;
+		++n;
+	}
+
+	if (sum > len - hlen)
+		return EBADMSG;
+
+	*nblk  = n;
+	*hlenp = hlen;
+
+	return 0;
+}
+
+
+static int block_frame(struct mbuf **mbp, const uint8_t *p, size_t len)
+{
+	struct mbuf *mb;
+	int err;
+
+	mb = mbuf_alloc(len);
+	if (!mb)
+		return ENOMEM;
+
+	err = mbuf_write_mem(mb, p, len);
+	if (err) {
+		mem_deref(mb);
+		return err;
+	}
+
+	mb->pos = 0;
+	*mbp = mb;
+
+	return 0;
+}
+
+
+/**
+ * Decode a RED packet
+ *
+ * The frame handler is called for the redundant blocks of lost packets,
+ * oldest first, and then for the primary frame. The primary frame is
+ * passed in the packet buffer, with the header extension moved in front
+ * of it.
+ *
+ * @param dec    RED decoder
+ * @param hdr    Decoded RTP header of the RED packet
+ * @param mb     RTP packet, the position is at the RED payload
+ * @param frameh Frame handler
+ * @param arg    Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int red_dec_decode(struct red_dec *dec, const struct rtp_header *hdr,
+		   struct mbuf *mb, red_frame_h *frameh, void *arg)
+{
+	struct red_block blkv[BLOCKS_MAX];
+	struct rtp_header fhdr;
+	size_t nblk = 0, hlen = 0, off, ext_len;
+	uint8_t pt = 0;
+	bool started;
+	int err;
+
+	if (!dec || !hdr || !mb || !frameh)
+		return EINVAL;
+
+	err = blocks_decode(blkv, &nblk, &hlen, &pt, mbuf_buf(mb),
+			    mbuf_get_left(mb));
+	if (err) {
+		++dec->n_err;
+		return err;
+	}
+
+	started = dec->started && hdr->ssrc == dec->ssrc;
+	red_dec_media(dec, hdr);
+	++dec->n_red;
+
+	off = mb->pos + hlen;
+
+	for (size_t i = 0; i < nblk; i++) {
+		const struct red_block *blk = &blkv[i];
+		uint16_t seq = hdr->seq - (uint16_t)(nblk - i);
+		struct mbuf *fmb;
+
+		if (!started || !blk->len || hist_isset(dec, seq)) {
+			off += blk->len;
+			continue;
+		}
+
+		if (block_frame(&fmb, mb->buf + off, blk->len))
+			break;
+
+		fhdr      = *hdr;
+		fhdr.ext  = false;
+		fhdr.m    = false;
+		fhdr.pt   = blk->pt;
+		fhdr.seq  = seq;
+		fhdr.ts   = hdr->ts - blk->offset;
+
+		hist_set(dec, seq);
+		++dec->n_recovered;
+
+		frameh(&fhdr, fmb, true, arg);
+		mem_deref(fmb);
+
+		off += blk->len;
+	}
+
+	/* the header extension is expected right before the payload */
+	ext_len = hdr->ext ? hdr->x.len * sizeof(uint32_t) : 0;
+	if (ext_len && mb->pos >= ext_len) {
+		memmove(mb->buf + off - ext_len, mb->buf + mb->pos - ext_len,
+			ext_len);
+	}
+
+	mb->pos = off;
+
+	fhdr    = *hdr;
+	fhdr.pt = pt;
+
+	frameh(&fhdr, mb, false, arg);
+
+	return 0;
+}
+
+
+int red_dec_debug(struct re_printf *pf, const struct red_dec *dec)
+{
+	if (!dec)
+		return 0;
+
+	return re_hprintf(pf, "%llu packets, %llu recovered, %llu errors",
+			  dec->n_red, dec->n_recovered, dec->n_err);
+}
@@ -27,6 +27,8 @@ struct rtp_receiver {
 	uint64_t ts_last;              /**< Timestamp of last recv RTP pkt   */
 	uint32_t ssrc;                 /**< Incoming synchronization source  */
 	bool ssrc_set;                 /**< Incoming SSRC is set             */
+	bool ssrc_lock;                /**< Drop packets from other SSRCs    */
+	uint64_t n_ssrc_drop;          /**< Packets dropped by the SSRC lock */
 	uint32_t pseq;                 /**< Sequence number for incoming RTP */
 	bool pseq_set;                 /**< True if sequence number is set   */
 	bool rtp_estab;                /**< True if RTP stream established   */
@@ -35,6 +37,10 @@ struct rtp_receiver {
 	char *cname;                   /**< Canonical Name for RTCP send     */
 	struct sa rtcp_peer;           /**< RTCP address of Peer             */
 	bool pinhole;                  /**< Open RTCP NAT pinhole flag       */
+	struct fec_dec *fec;           /**< FEC decoder (optional)           */
+	int pt_fec;                    /**< Payload type for FEC repair      */
+	struct red_dec *red;           /**< RED decoder (optional)           */
+	int pt_red;                    /**< Payload type for RED             */
 	mtx_t *mtx;                    /**< Mutex protects above fields      */
 
 	/* Unprotected data */
@@ -45,7 +51,8 @@ struct rtp_receiver {
 	stream_rtpestab_h *rtpestabh;  /**< RTP established handler          */
 	void *arg;                     /**< Stream argument                  */
 	void *sessarg;                 /**< Session argument                 */
-	thrd_t thr;                    /**< RX thread                        */
+	struct media_worker *thr;      /**< RX thread                        */
+	struct rxworker *worker;       /**< RX pool worker (optional)        */
 	struct tmr tmr;                /**< Timer for stopping RX thread     */
 	int pt;                        /**< Previous payload type            */
 	int pt_tel;                    /**< Payload type for tel event       */
@@ -188,7 +195,7 @@ static void rtprecv_periodic(void *arg)
 			mtx_unlock(rx->mtx);
 		}
 	}
-	else {
+	else if (!rx->worker) {
 		udp_thread_detach(rtp_sock(rx->rtp));
 		udp_thread_detach(rtcp_sock(rx->rtp));
 		re_cancel();
@@ -196,12 +203,41 @@ static void rtprecv_periodic(void *arg)
 }
 
 
+static void pool_attach(void *arg)
+{
+	struct rtp_receiver *rx = arg;
+	int err;
+
+	err  = udp_thread_attach(rtp_sock(rx->rtp));
+	err |= udp_thread_attach(rtcp_sock(rx->rtp));
+	if (err) {
+		warning("rtp_receiver: could not attach to RTP socket (%m)\n",
+			err);
+	}
+
+	rxworker_streams(rx->worker, +1);
+	tmr_start(&rx->tmr, 10, rtprecv_periodic, rx);
+}
+
+
+static void pool_detach(void *arg)
+{
+	struct rtp_receiver *rx = arg;
+
+	tmr_cancel(&rx->tmr);
+	udp_thread_detach(rtp_sock(rx->rtp));
+	udp_thread_detach(rtcp_sock(rx->rtp));
+	rxworker_streams(rx->worker, -1);
+}
+
+
 static int rtprecv_thread(void *arg)
 {
 	struct rtp_receiver *rx = arg;
 	int err;
 
 	re_thread_init();
+	media_thread_place(MEDIA_THREAD_AUDIO_RX);
 	info("rtp_receiver: RTP RX thread started\n");
 	tmr_start(&rx->tmr, 10, rtprecv_periodic, rx);
 
@@ -209,18 +245,20 @@ static int rtprecv_thread(void *arg)
 	if (err) {
 		warning("rtp_receiver: could not attach to RTP socket (%m)\n",
 			err);
-		return err;
+		goto out;
 	}
 
 	err = udp_thread_attach(rtcp_sock(rx->rtp));
 	if (err) {
 		warning("rtp_receiver: could not attach to RTCP socket (%m)\n",
 			err);
-		return err;
+		goto out;
 	}
 
 	err = re_main(NULL);
 
+ out:
+	/* the thread is parked and reused, leave no state behind */
 	tmr_cancel(&rx->tmr);
 	re_thread_close();
 	return err;
@@ -363,20 +401,120 @@ static bool rtprecv_filter_pt(struct rtp_receiver *rx,
 	if (lc && !str_casecmp(lc->name, "telephone-event")) {
 		rx->pt_tel = hdr->pt;
 	}
+	else if (lc && rx->jbuf) {
+		(void)jbuf_set_srate(rx->jbuf, lc->srate);
+	}
 
 	rx->pt = hdr->pt;
 	return true;
 }
 
 
+struct fec_arg {
+	struct rtp_receiver *rx;
+	const struct sa *src;
+};
+
+
+static void fec_recover_handler(const struct rtp_header *hdr,
+				struct mbuf *mb, void *arg)
+{
+	struct fec_arg *fa = arg;
+
+	debug("stream: %s: FEC recovered seq=%u\n", fa->rx->name, hdr->seq);
+
+	rtprecv_decode(fa->src, hdr, mb, fa->rx);
+}
+
+
+/* A recovered packet is decoded like a received packet */
+static void fec_repair(struct rtp_receiver *rx, struct fec_dec *fec,
+		       const struct sa *src, const struct rtp_header *hdr,
+		       struct mbuf *mb)
+{
+	struct fec_arg fa = {rx, src};
+	int err;
+
+	err = fec_dec_repair(fec, hdr, mb, fec_recover_handler, &fa);
+	if (err && err != ENOENT)
+		debug("stream: %s: FEC repair packet (%m)\n", rx->name, err);
+}
+
+
+static void rtprecv_put(struct rtp_receiver *rx, const struct sa *src,
+			const struct rtp_header *hdr, struct mbuf *mb,
+			bool flush, bool first)
+{
+	int err = 0;
+
+	if (rtprecv_filter_pt(rx, hdr)) {
+		err = pass_pt_work(rx, hdr->pt, mb);
+		if (err && err != ENODATA)
+			return;
+	}
+
+	if (rx->jbuf) {
+
+		/* Put frame in Jitter Buffer */
+		if (flush)
+			jbuf_flush(rx->jbuf);
+
+		if (first && err == ENODATA)
+			return;
+
+		err = jbuf_put(rx->jbuf, hdr, mb);
+		if (err) {
+			info("stream: %s: dropping %u bytes from %J"
+			     " [seq=%u, ts=%u] (%m)\n",
+			     rx->name, mb->end,
+			     src, hdr->seq, hdr->ts, err);
+			metric_inc_err(rx->metric);
+		}
+
+		uint32_t n = jbuf_packets(rx->jbuf);
+		while (n--) {
+			if (decode_frame(rx) != EAGAIN)
+				break;
+		}
+	}
+	else {
+		(void)handle_rtp(rx, hdr, mb, 0, false);
+	}
+}
+
+
+struct red_arg {
+	struct rtp_receiver *rx;
+	const struct sa *src;
+	bool flush;
+	bool first;
+};
+
+
+static void red_frame_handler(const struct rtp_header *hdr, struct mbuf *mb,
+			      bool recovered, void *arg)
+{
+	struct red_arg *ra = arg;
+
+	if (recovered)
+		debug("stream: %s: RED recovered seq=%u\n", ra->rx->name,
+		      hdr->seq);
+
+	rtprecv_put(ra->rx, ra->src, hdr, mb, ra->flush, ra->first);
+
+	ra->flush = false;
+	ra->first = false;
+}
+
+
 void rtprecv_decode(const struct sa *src, const struct rtp_header *hdr,
 		     struct mbuf *mb, void *arg)
 {
 	struct rtp_receiver *rx = arg;
+	struct red_dec *red = NULL;
 	uint32_t ssrc0;
 	bool flush = false;
 	bool first = false;
-	int err = 0;
 
 	if (!rx)
 		return;
@@ -398,6 +536,7 @@ void rtprecv_decode(const struct sa *src, const struct rtp_header *hdr,
 	rx->ts_last = tmr_jiffies();
 
 	metric_add_packet(rx->metric, mbuf_get_left(mb));
+	rxworker_count(rx->worker, mbuf_get_left(mb));
 
 	if (!rx->rtp_estab) {
 		if (rx->rtpestabh) {
@@ -408,7 +547,26 @@ void rtprecv_decode(const struct sa *src, const struct rtp_header *hdr,
 		}
 	}
 
+	/* RFC 8627 -- repair packets have their own SSRC */
+	if (rx->fec && hdr->pt == rx->pt_fec) {
+
+		struct fec_dec *fec = mem_ref(rx->fec);
+		mtx_unlock(rx->mtx);
+
+		fec_repair(rx, fec, src, hdr, mb);
+		mem_deref(fec);
+		return;
+	}
+
 	ssrc0 = rx->ssrc;
+	if (rx->ssrc_lock && rx->ssrc_set && hdr->ssrc != ssrc0) {
+
+		/* e.g. another simulcast layer */
+		++rx->n_ssrc_drop;
+		mtx_unlock(rx->mtx);
+		return;
+	}
+
 	if (!rx->pseq_set) {
 		rx->ssrc = hdr->ssrc;
 		rx->ssrc_set = true;
@@ -427,41 +585,29 @@ void rtprecv_decode(const struct sa *src, const struct rtp_header *hdr,
 		rx->pseq = hdr->seq - 1;
 		flush = true;
 	}
-	mtx_unlock(rx->mtx);
-
-	if (rtprecv_filter_pt(rx, hdr)) {
-		err = pass_pt_work(rx, hdr->pt, mb);
-		if (err && err != ENODATA)
-			return;
-	}
 
-	if (rx->jbuf) {
+	fec_dec_media(rx->fec, hdr, mb);
 
-		/* Put frame in Jitter Buffer */
-		if (flush)
-			jbuf_flush(rx->jbuf);
+	/* RFC 2198 -- lost frames are recovered before the jitter buffer */
+	if (rx->red && hdr->pt == rx->pt_red)
+		red = mem_ref(rx->red);
+	else
+		red_dec_media(rx->red, hdr);
+	mtx_unlock(rx->mtx);
 
-		if (first && err == ENODATA)
-			return;
+	if (red) {
+		struct red_arg ra = {rx, src, flush, first};
+		int err;
 
-		err = jbuf_put(rx->jbuf, hdr, mb);
-		if (err) {
-			info("stream: %s: dropping %u bytes from %J"
-			     " [seq=%u, ts=%u] (%m)\n",
-			     rx->name, mb->end,
-			     src, hdr->seq, hdr->ts, err);
-			metric_inc_err(rx->metric);
-		}
+		err = red_dec_decode(red, hdr, mb, red_frame_handler, &ra);
+		if (err)
+			debug("stream: %s: RED packet (%m)\n", rx->name, err);
 
-		uint32_t n = jbuf_packets(rx->jbuf);
-		while (n--) {
-			if (decode_frame(rx) != EAGAIN)
-				break;
-		}
-	}
-	else {
-		(void)handle_rtp(rx, hdr, mb, 0, false);
+		mem_deref(red);
+		return;
 	}
+
+	rtprecv_put(rx, src, hdr, mb, flush, first);
 }
 
 
@@ -553,6 +699,78 @@ void rtprecv_set_ssrc(struct rtp_receiver *rx, uint32_t ssrc)
 }
 
 
+/**
+ * Lock the receiver to one SSRC, packets from other SSRCs are dropped
+ *
+ * The SSRC is taken from the SDP, or from the first packet received.
+ *
+ * @param rx     RTP Receiver
+ * @param enable True to lock, false to follow SSRC changes
+ */
+void rtprecv_set_ssrc_lock(struct rtp_receiver *rx, bool enable)
+{
+	if (!rx)
+		return;
+
+	mtx_lock(rx->mtx);
+	rx->ssrc_lock = enable;
+	mtx_unlock(rx->mtx);
+}
+
+
+/**
+ * Enable recovery of lost packets with FEC repair packets (RFC 8627)
+ *
+ * @param rx RTP Receiver
+ * @param pt Payload type of the repair packets, or -1 to disable
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rtprecv_set_fec(struct rtp_receiver *rx, int pt)
+{
+	int err = 0;
+
+	if (!rx)
+		return EINVAL;
+
+	mtx_lock(rx->mtx);
+	if (pt < 0)
+		rx->fec = mem_deref(rx->fec);
+	else if (!rx->fec)
+		err = fec_dec_alloc(&rx->fec);
+
+	rx->pt_fec = pt;
+	mtx_unlock(rx->mtx);
+
+	return err;
+}
+
+
+/**
+ * Decode RED packets (RFC 2198) and put the recovered frames into the
+ * jitter buffer
+ *
+ * @param rx  RTP Receiver
+ * @param pt  Payload type of RED packets, or -1 to disable
+ * @param dec RED decoder, or NULL to disable
+ */
+void rtprecv_set_red(struct rtp_receiver *rx, int pt, struct red_dec *dec)
+{
+	if (!rx)
+		return;
+
+	if (pt < 0)
+		dec = NULL;
+
+	mtx_lock(rx->mtx);
+	mem_ref(dec);
+	mem_deref(rx->red);
+	rx->red    = dec;
+	rx->pt_red = pt;
+	mtx_unlock(rx->mtx);
+}
+
+
 uint64_t rtprecv_ts_last(struct rtp_receiver *rx)
 {
 	if (!rx)
@@ -647,16 +865,32 @@ void rtprecv_enable_mux(struct rtp_receiver *rx, bool enable)
 int rtprecv_debug(struct re_printf *pf, const struct rtp_receiver *rx)
 {
 	int err;
-	bool enabled;
+	bool enabled, ssrc_lock;
+	uint64_t n_ssrc_drop;
+	struct fec_dec *fec;
+	int pt_fec;
 
 	if (!rx)
 		return 0;
 
 	mtx_lock(rx->mtx);
 	enabled = rx->enabled;
+	ssrc_lock = rx->ssrc_lock;
+	n_ssrc_drop = rx->n_ssrc_drop;
+	fec = mem_ref(rx->fec);
+	pt_fec = rx->pt_fec;
 	mtx_unlock(rx->mtx);
 
 	err  = re_hprintf(pf, " rx.enabled: %s\n", enabled ? "yes" : "no");
+	if (ssrc_lock) {
+		err |= re_hprintf(pf, " rx.ssrc_lock: 0x%08x (dropped %llu)\n",
+				  rx->ssrc, n_ssrc_drop);
+	}
+	if (fec) {
+		err |= re_hprintf(pf, " rx.fec: pt=%d, %H\n",
+				  pt_fec, fec_dec_debug, fec);
+		mem_deref(fec);
+	}
 	err |= jbuf_debug(pf, rx->jbuf);
 
 	return err;
@@ -670,7 +904,10 @@ static void destructor(void *arg)
 	if (re_atomic_rlx(&rx->run)) {
 		rtprecv_enable(rx, false);
 		re_atomic_rlx_set(&rx->run, false);
-		thrd_join(rx->thr, NULL);
+		if (rx->worker)
+			rxworker_call(rx->worker, pool_detach, rx);
+		else
+			media_worker_join(rx->thr);
 		re_thread_async_main_cancel((intptr_t)rx);
 	}
 	else {
@@ -683,6 +920,8 @@ static void destructor(void *arg)
 	mem_deref(rx->mtx);
 	mem_deref(rx->jbuf);
 	mem_deref(rx->cname);
+	mem_deref(rx->fec);
+	mem_deref(rx->red);
 }
 
 
@@ -690,6 +929,7 @@ int rtprecv_alloc(struct rtp_receiver **rxp,
 		   struct stream *strm,
 		   const char *name,
 		   const struct config_avt *cfg,
+		   struct call_arena *arena,
 		   stream_rtp_h *rtph,
 		   stream_pt_h *pth, void *arg)
 {
@@ -710,6 +950,8 @@ int rtprecv_alloc(struct rtp_receiver **rxp,
 	rx->arg    = arg;
 	rx->pseq   = -1;
 	rx->pt     = -1;
+	rx->pt_fec = -1;
+	rx->pt_red = -1;
 	err  = str_dup(&rx->name, name);
 	err |= mutex_alloc(&rx->mtx);
 	if (err)
@@ -719,23 +961,33 @@ int rtprecv_alloc(struct rtp_receiver **rxp,
 	if (stream_type(strm) == MEDIA_AUDIO &&
 	    cfg->audio.jbtype != JBUF_OFF && cfg->audio.jbuf_del.max) {
 
-		err = jbuf_alloc(&rx->jbuf, cfg->audio.jbuf_del.min,
-				 cfg->audio.jbuf_del.max);
+		err = jbuf_alloc_arena(&rx->jbuf, cfg->audio.jbuf_del.min,
+				       cfg->audio.jbuf_del.max, arena);
 		err |= jbuf_set_type(rx->jbuf, cfg->audio.jbtype);
+		if (cfg->audio.jbuf_pct)
+			err |= jbuf_set_percentile(rx->jbuf,
+						   cfg->audio.jbuf_pct);
 	}
 
 	/* Video Jitter buffer */
 	if (stream_type(strm) == MEDIA_VIDEO &&
 	    cfg->video.jbtype != JBUF_OFF && cfg->video.jbuf_del.max) {
 
-		err = jbuf_alloc(&rx->jbuf, cfg->video.jbuf_del.min,
-				 cfg->video.jbuf_del.max);
+		err = jbuf_alloc_arena(&rx->jbuf, cfg->video.jbuf_del.min,
+				       cfg->video.jbuf_del.max, arena);
 		if (err)
 			goto out;
 
 		err = jbuf_set_type(rx->jbuf, cfg->video.jbtype);
 		if (err)
 			goto out;
+
+		if (cfg->video.jbuf_pct) {
+			err = jbuf_set_percentile(rx->jbuf,
+						  cfg->video.jbuf_pct);
+			if (err)
+				goto out;
+		}
 	}
 
 	rx->metric = metric_alloc();
@@ -767,11 +1019,48 @@ int rtprecv_start_thread(struct rtp_receiver *rx)
 	udp_thread_detach(rtp_sock(rx->rtp));
 	udp_thread_detach(rtcp_sock(rx->rtp));
 	re_atomic_rlx_set(&rx->run, true);
-	err = thread_create_name(&rx->thr,
-				 "RX thread",
-				 rtprecv_thread, rx);
+	err = media_worker_start(&rx->thr, MEDIA_THREAD_AUDIO_RX,
+				 "RX thread", rtprecv_thread, rx);
+	if (err) {
+		re_atomic_rlx_set(&rx->run, false);
+		udp_thread_attach(rtp_sock(rx->rtp));
+		udp_thread_attach(rtcp_sock(rx->rtp));
+	}
+
+	return err;
+}
+
+
+/**
+ * Move the RTP and RTCP sockets of a receiver to its RX pool worker
+ *
+ * @param rx RTP receiver
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rtprecv_start_pool(struct rtp_receiver *rx)
+{
+	struct rxworker *w;
+	int err;
+
+	if (!rx)
+		return EINVAL;
+
+	if (re_atomic_rlx(&rx->run))
+		return 0;
+
+	w = rxpool_worker(sa_hash(rtp_local(rx->rtp), SA_ALL));
+	if (!w)
+		return ENOENT;
+
+	udp_thread_detach(rtp_sock(rx->rtp));
+	udp_thread_detach(rtcp_sock(rx->rtp));
+	rx->worker = w;
+	re_atomic_rlx_set(&rx->run, true);
+	err = rxworker_call(w, pool_attach, rx);
 	if (err) {
 		re_atomic_rlx_set(&rx->run, false);
+		rx->worker = NULL;
 		udp_thread_attach(rtp_sock(rx->rtp));
 		udp_thread_attach(rtcp_sock(rx->rtp));
 	}
@@ -0,0 +1,413 @@
+/**
+ * @file rxpool.c  Pool of RTP receive worker threads
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <stdlib.h>
+#include <re.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/*
+ * With "rtp_rxmode pool" the RTP and RTCP sockets of the audio streams are
+ * serviced by a fixed number of worker threads instead of one thread per
+ * stream. Each worker runs its own re main loop, i.e. its own epoll set,
+ * and the sockets of a stream are attached to exactly one worker.
+ *
+ * A stream is assigned to a worker by consistent hashing of its local RTP
+ * address, with a number of virtual nodes per worker on the hash ring. The
+ * receiver state of a stream is only touched by its worker.
+ */
+
+
+enum {
+	VNODES = 64,   /* Virtual nodes per worker on the hash ring */
+};
+
+
+enum job_id {
+	JOB_CALL,
+	JOB_STOP,
+};
+
+
+struct rxworker {
+	thrd_t thr;
+	unsigned id;
+	struct mqueue *mq;            /* Jobs, owned by the worker thread */
+	bool ready;                   /* Worker thread is started         */
+	int err;                      /* Startup error                    */
+	RE_ATOMIC uint32_t n_streams; /* Attached streams                 */
+	RE_ATOMIC uint64_t n_packets; /* Received packets                 */
+	RE_ATOMIC uint64_t n_bytes;   /* Received bytes                   */
+};
+
+struct vnode {
+	uint32_t hash;
+	unsigned worker;
+};
+
+struct job {
+	rxworker_h *h;
+	void *arg;
+	bool done;
+};
+
+static struct {
+	mtx_t *mtx;
+	cnd_t cnd;                    /* Signals started workers and jobs */
+	struct rxworker *workerv;
+	unsigned workerc;
+	struct vnode *ringv;          /* Hash ring, sorted by hash        */
+	size_t ringc;
+} pool;
+
+
+static void mqueue_handler(int id, void *data, void *arg)
+{
+	struct job *job = data;
+	(void)arg;
+
+	switch (id) {
+
+	case JOB_CALL:
+		job->h(job->arg);
+
+		mtx_lock(pool.mtx);
+		job->done = true;
+		cnd_broadcast(&pool.cnd);
+		mtx_unlock(pool.mtx);
+		break;
+
+	case JOB_STOP:
+		re_cancel();
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+static int worker_thread(void *arg)
+{
+	struct rxworker *w = arg;
+	int err;
+
+	re_thread_init();
+	media_thread_place(MEDIA_THREAD_AUDIO_RX);
+
+	err = mqueue_alloc(&w->mq, mqueue_handler, w);
+
+	mtx_lock(pool.mtx);
+	w->err   = err;
+	w->ready = true;
+	cnd_broadcast(&pool.cnd);
+	mtx_unlock(pool.mtx);
+
+	if (!err)
+		err = re_main(NULL);
+
+	w->mq = mem_deref(w->mq);
+	re_thread_close();
+
+	return err;
+}
+
+
+static int vnode_cmp(const void *a, const void *b)
+{
+	const struct vnode *va = a, *vb = b;
+
+	if (va->hash != vb->hash)
+		return va->hash < vb->hash ? -1 : 1;
+
+	return (int)va->worker - (int)vb->worker;
+}
+
+
+static int ring_alloc(unsigned workerc)
+{
+	pool.ringv = mem_zalloc(workerc * VNODES * sizeof(*pool.ringv),
+				NULL);
+	if (!pool.ringv)
+		return ENOMEM;
+
+	for (unsigned i = 0; i < workerc; i++) {
+
+		for (unsigned j = 0; j < VNODES; j++) {
+			struct vnode *vn = &pool.ringv[pool.ringc++];
+			uint32_t key[2] = {i, j};
+
+			vn->hash   = hash_joaat((uint8_t *)key, sizeof(key));
+			vn->worker = i;
+		}
+	}
+
+	qsort(pool.ringv, pool.ringc, sizeof(*pool.ringv), vnode_cmp);
+
+	return 0;
+}
+
+
+/**
+ * Start the RTP receive workers
+ *
+ * @param workers Number of worker threads
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rxpool_init(unsigned workers)
+{
+	int err;
+
+	if (pool.mtx)
+		return 0;
+
+	if (!workers)
+		return EINVAL;
+
+	err = mutex_alloc(&pool.mtx);
+	if (err)
+		return err;
+
+	if (cnd_init(&pool.cnd) != thrd_success) {
+		pool.mtx = mem_deref(pool.mtx);
+		return ENOMEM;
+	}
+
+	pool.workerv = mem_zalloc(workers * sizeof(*pool.workerv), NULL);
+	if (!pool.workerv) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	err = ring_alloc(workers);
+	if (err)
+		goto out;
+
+	for (unsigned i = 0; i < workers; i++) {
+		struct rxworker *w = &pool.workerv[i];
+
+		w->id = i;
+
+		err = thread_create_name(&w->thr, "RX worker",
+					 worker_thread, w);
+		if (err)
+			goto out;
+
+		++pool.workerc;
+
+		mtx_lock(pool.mtx);
+		while (!w->ready)
+			cnd_wait(&pool.cnd, pool.mtx);
+		mtx_unlock(pool.mtx);
+
+		if (w->err) {
+			err = w->err;
+			goto out;
+		}
+	}
+
+	info("rxpool: %u RTP receive workers\n", pool.workerc);
+
+ out:
+	if (err)
+		rxpool_close();
+
+	return err;
+}
+
+
+/**
+ * Stop the RTP receive workers, all streams must be detached
+ */
+void rxpool_close(void)
+{
+	if (!pool.mtx)
+		return;
+
+	for (unsigned i = 0; i < pool.workerc; i++) {
+		struct rxworker *w = &pool.workerv[i];
+
+		if (w->mq)
+			mqueue_push(w->mq, JOB_STOP, NULL);
+
+		thrd_join(w->thr, NULL);
+	}
+
+	pool.workerv = mem_deref(pool.workerv);
+	pool.workerc = 0;
+	pool.ringv   = mem_deref(pool.ringv);
+	pool.ringc   = 0;
+
+	cnd_destroy(&pool.cnd);
+	pool.mtx = mem_deref(pool.mtx);
+}
+
+
+/**
+ * Get the worker of a stream
+ *
+ * The same key is always mapped to the same worker, and a change of the
+ * number of workers only moves the keys of the added or removed workers.
+ *
+ * @param key Hash key of the stream, e.g. of its local RTP address
+ *
+ * @return Worker, or NULL if the pool is not running
+ */
+struct rxworker *rxpool_worker(uint32_t key)
+{
+	size_t lo = 0, hi;
+	uint32_t hash;
+
+	if (!pool.ringc)
+		return NULL;
+
+	hash = hash_joaat((uint8_t *)&key, sizeof(key));
+	hi   = pool.ringc;
+
+	/* first virtual node clockwise from the hash */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (pool.ringv[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == pool.ringc)
+		lo = 0;
+
+	return &pool.workerv[pool.ringv[lo].worker];
+}
+
+
+/**
+ * Get the index of a worker
+ *
+ * @param w Worker
+ *
+ * @return Index of the worker in the pool
+ */
+unsigned rxworker_id(const struct rxworker *w)
+{
+	return w ? w->id : 0;
+}
+
+
+/**
+ * Call a handler in the thread of a worker and wait for it
+ *
+ * @note The handler must not wait for the calling thread
+ *
+ * @param w   Worker
+ * @param h   Handler
+ * @param arg Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rxworker_call(struct rxworker *w, rxworker_h *h, void *arg)
+{
+	struct job job = {h, arg, false};
+	int err;
+
+	if (!w || !h)
+		return EINVAL;
+
+	if (thrd_equal(w->thr, thrd_current())) {
+		h(arg);
+		return 0;
+	}
+
+	err = mqueue_push(w->mq, JOB_CALL, &job);
+	if (err)
+		return err;
+
+	mtx_lock(pool.mtx);
+	while (!job.done)
+		cnd_wait(&pool.cnd, pool.mtx);
+	mtx_unlock(pool.mtx);
+
+	return 0;
+}
+
+
+/**
+ * Count the attached streams of a worker, called from the worker thread
+ *
+ * @param w     Worker
+ * @param delta Positive for an attached, negative for a detached stream
+ */
+void rxworker_streams(struct rxworker *w, int delta)
+{
+	if (!w)
+		return;
+
+	if (delta > 0)
+		re_atomic_rlx_add(&w->n_streams, 1);
+	else
+		re_atomic_rlx_sub(&w->n_streams, 1);
+}
+
+
+/**
+ * Count a received packet, called from the worker thread
+ *
+ * @param w     Worker
+ * @param bytes Size of the packet
+ */
+void rxworker_count(struct rxworker *w, size_t bytes)
+{
+	if (!w)
+		return;
+
+	re_atomic_rlx_add(&w->n_packets, 1);
+	re_atomic_rlx_add(&w->n_bytes, bytes);
+}
+
+
+/**
+ * Print the load of the RTP receive workers
+ *
+ * @param pf     Print handler
+ * @param unused Unused parameter
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rxpool_debug(struct re_printf *pf, void *unused)
+{
+	uint64_t total = 0, peak = 0;
+	int err;
+	(void)unused;
+
+	if (!pool.workerc)
+		return re_hprintf(pf, "rxpool: not running\n");
+
+	for (unsigned i = 0; i < pool.workerc; i++) {
+		uint64_t n = re_atomic_rlx(&pool.workerv[i].n_packets);
+
+		total += n;
+		peak   = max(peak, n);
+	}
+
+	/* peak-to-mean ratio of the packets, 1.00 is a perfect balance */
+	err = re_hprintf(pf, "rxpool: %u workers, %llu packets,"
+			 " imbalance %.2f\n", pool.workerc, total,
+			 total ? (double)peak * pool.workerc / total : 1.0);
+
+	for (unsigned i = 0; i < pool.workerc; i++) {
+		struct rxworker *w = &pool.workerv[i];
+		uint64_t n = re_atomic_rlx(&w->n_packets);
+
+		err |= re_hprintf(pf, "  worker %u: %u streams,"
+				  " %llu packets (%.1f%%), %llu bytes\n",
+				  w->id, re_atomic_rlx(&w->n_streams), n,
+				  total ? 100.0 * n / total : 0.0,
+				  re_atomic_rlx(&w->n_bytes));
+	}
+
+	return err;
+}
@@ -228,7 +228,17 @@ int stream_enable_tx(struct stream *strm, bool enable)
 static void stream_start_receiver(void *arg)
 {
 	struct stream *s = arg;
-	rtprecv_start_thread(s->rx);
+	int err;
+
+	if (s->cfg.rxmode == RECEIVE_MODE_POOL)
+		err = rtprecv_start_pool(s->rx);
+	else
+		err = rtprecv_start_thread(s->rx);
+
+	if (err) {
+		warning("stream: %s: could not start RTP receiver (%m)\n",
+			media_name(s->type), err);
+	}
 }
 
 
@@ -259,12 +269,13 @@ int stream_enable_rx(struct stream *strm, bool enable)
 	debug("stream: enable %s RTP receiver\n", media_name(strm->type));
 	rtprecv_enable(strm->rx, true);
 
-	if (strm->rtp && strm->cfg.rxmode == RECEIVE_MODE_THREAD &&
+	if (strm->rtp && strm->cfg.rxmode != RECEIVE_MODE_MAIN &&
 	    strm->type == MEDIA_AUDIO && !rtprecv_running(strm->rx)) {
 		if (stream_bundle(strm)) {
-			warning("stream: rtp_rxmode thread was disabled "
+			warning("stream: rtp_rxmode %s was disabled "
 				"because it is not supported in combination "
-				"with avt_bundle\n");
+				"with avt_bundle\n",
+				rtp_receive_mode_str(strm->cfg.rxmode));
 		}
 		else {
 			strm->rxm.use_rxthread = true;
@@ -573,7 +584,7 @@ int stream_alloc(struct stream **sp, struct list *streaml,
 
 	if (prm->use_rtp) {
 		err = rtprecv_alloc(&s->rx, s, media_name(type), cfg,
-			       rtph, pth, arg);
+				    prm->arena, rtph, pth, arg);
 		if (err) {
 			warning("stream: failed to create receiver"
 				" for media '%s' (%m)\n",
@@ -797,6 +808,107 @@ int stream_resend(struct stream *s, uint16_t seq, bool ext, bool marker,
 }
 
 
+/**
+ * Write stream data with a complete RTP header
+ *
+ * The packet shares the RTP socket and the media encryption of the stream,
+ * RTCP is only sent for the primary SSRC of the stream.
+ *
+ * @param s		Stream object
+ * @param hdr		RTP header, with payload type and CSRC list
+ * @param mb		Payload buffer, with headroom for the RTP header
+ *
+ * @return int	0 if success, errorcode otherwise
+ */
+int stream_send_hdr(struct stream *s, const struct rtp_header *hdr,
+		    struct mbuf *mb)
+{
+	struct sa raddr_rtp;
+	size_t len, pos;
+	int err;
+
+	if (!s || !hdr || !mb)
+		return EINVAL;
+
+	len = RTP_HEADER_SIZE + hdr->cc * sizeof(uint32_t);
+	if (mb->pos < len)
+		return EINVAL;
+
+	if (!re_atomic_acq(&s->tx.enabled))
+		return 0;
+
+	if (re_atomic_rlx(&s->hold))
+		return 0;
+
+	mtx_lock(s->tx.lock);
+	sa_cpy(&raddr_rtp, &s->tx.raddr_rtp);
+	mtx_unlock(s->tx.lock);
+
+	metric_add_packet(s->tx.metric, mbuf_get_left(mb));
+
+	mb->pos -= len;
+	pos = mb->pos;
+
+	err = rtp_hdr_encode(mb, hdr);
+	mb->pos = pos;
+	if (err)
+		return err;
+
+	err = udp_send(rtp_sock(s->rtp), &raddr_rtp, mb);
+	if (err)
+		metric_inc_err(s->tx.metric);
+
+	return err;
+}
+
+
+/**
+ * Write stream data with a separate SSRC and sequence number
+ *
+ * Used for the additional simulcast layers.
+ *
+ * @param s		Stream object
+ * @param ssrc		Synchronization source
+ * @param seq		Sequence number
+ * @param ext		Extension bit
+ * @param marker	Marker bit
+ * @param pt		Payload type
+ * @param ts		Timestamp
+ * @param mb		Payload buffer, with headroom for the RTP header
+ *
+ * @return int	0 if success, errorcode otherwise
+ */
+int stream_send_ssrc(struct stream *s, uint32_t ssrc, uint16_t seq,
+		     bool ext, bool marker, int pt, uint32_t ts,
+		     struct mbuf *mb)
+{
+	struct rtp_header hdr;
+
+	if (!s)
+		return EINVAL;
+
+	if (pt < 0) {
+		mtx_lock(s->tx.lock);
+		pt = s->tx.pt_enc;
+		mtx_unlock(s->tx.lock);
+	}
+
+	if (pt < 0)
+		return 0;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.ver  = RTP_VERSION;
+	hdr.ext  = ext;
+	hdr.m    = marker;
+	hdr.pt   = pt;
+	hdr.seq  = seq;
+	hdr.ts   = ts;
+	hdr.ssrc = ssrc;
+
+	return stream_send_hdr(s, &hdr, mb);
+}
+
+
 static void disable_mnat(struct stream *s)
 {
 	info("stream: disable MNAT (%s)\n", media_name(s->type));
@@ -1153,6 +1265,23 @@ int stream_jbuf_stats(const struct stream *strm, struct jbuf_stat *stat)
 }
 
 
+/**
+ * Get the jitter buffer delay histogram of the stream
+ *
+ * @param strm Stream object
+ * @param hist Pointer to histogram storage
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int stream_jbuf_hist(const struct stream *strm, struct jbuf_hist *hist)
+{
+	if (!strm)
+		return EINVAL;
+
+	return jbuf_hist(rtprecv_jbuf(strm->rx), hist);
+}
+
+
 /**
  * Get the number of transmitted RTP packets
  *
@@ -1605,6 +1734,59 @@ int stream_ssrc_rx(const struct stream *strm, uint32_t *ssrc)
 }
 
 
+/**
+ * Lock the receiver to the SSRC of the peer, e.g. when receiving one
+ * layer of a simulcast stream
+ *
+ * @param strm   Stream object
+ * @param enable True to drop packets from other SSRCs
+ */
+void stream_set_ssrc_lock(struct stream *strm, bool enable)
+{
+	if (!strm)
+		return;
+
+	rtprecv_set_ssrc_lock(strm->rx, enable);
+}
+
+
+/**
+ * Set the payload type of received FEC repair packets (RFC 8627)
+ *
+ * @param strm Stream object
+ * @param pt   Payload type, or -1 to disable
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int stream_set_fec(struct stream *strm, int pt)
+{
+	if (!strm)
+		return EINVAL;
+
+	return rtprecv_set_fec(strm->rx, pt);
+}
+
+
+/**
+ * Decode received RED packets (RFC 2198) before the jitter buffer
+ *
+ * @param strm Stream object
+ * @param pt   Payload type of RED packets, or -1 to disable
+ * @param dec  RED decoder
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int stream_set_red(struct stream *strm, int pt, struct red_dec *dec)
+{
+	if (!strm)
+		return EINVAL;
+
+	rtprecv_set_red(strm->rx, pt, dec);
+
+	return 0;
+}
+
+
 void stream_mnat_attr(struct stream *strm, const char *name, const char *value)
 {
 	if (!strm)
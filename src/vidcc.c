@@ -0,0 +1,811 @@
+/**
+ * @file vidcc.c  Delay-based congestion control for video
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re_atomic.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+
+
+/*
+ * A simplified Google Congestion Control (draft-ietf-rmcat-gcc-02).
+ *
+ * The delay-based part uses transport-wide feedback (TWCC): packets are
+ * grouped in bursts, and the growth of the one-way queuing delay between
+ * groups is fitted to a trendline. A trend above an adaptive threshold
+ * is overuse and the rate is reduced to a fraction of the acknowledged
+ * rate, otherwise the rate is increased slowly, or faster (probe) if no
+ * congestion has been seen for a while.
+ *
+ * The loss-based part uses RTCP receiver reports. Heavy loss reduces the
+ * rate, and if there is no transport-wide feedback, a growing round-trip
+ * time is used as the delay signal.
+ */
+
+
+enum {
+	HIST_SIZE      = 1024,     /* Sent packets history, power of two  */
+	BURST_US       = 5000,     /* Packet group send interval [us]     */
+	TREND_WIN      = 20,       /* Trendline window in packet groups   */
+	OVERUSE_US     = 10000,    /* Time over threshold for overuse     */
+	ACKED_WIN_US   = 500000,   /* Acknowledged bitrate window [us]    */
+	HOLD_MIN_US    = 300000,   /* Min time in backoff [us]            */
+	PROBE_AFTER_US = 3000000,  /* No congestion before probing [us]   */
+	FB_TIMEOUT_US  = 2000000,  /* Transport-wide feedback timeout     */
+	RTT_QUEUE_US   = 100000,   /* RTT above minimum for overuse [us]  */
+	MIN_DIV        = 10,       /* Min bitrate is max / MIN_DIV        */
+};
+
+#define SMOOTHING    0.9     /* Delay smoothing coefficient             */
+#define TREND_GAIN   4.0     /* Trendline gain                          */
+#define THRESH_INIT  12.5    /* Initial overuse threshold [ms]          */
+#define K_UP         0.0087  /* Threshold adaptation, trend above       */
+#define K_DOWN       0.039   /* Threshold adaptation, trend below       */
+#define BETA         0.85    /* Backoff factor of the acknowledged rate */
+#define INC_RATE     0.08    /* Increase per second                     */
+#define PROBE_RATE   0.5     /* Increase per second when probing        */
+#define LOSS_HIGH    0.10    /* Loss fraction for backoff               */
+#define LOSS_LOW     0.02    /* Loss fraction for increase              */
+
+
+enum signal {
+	SIG_NORMAL = 0,
+	SIG_OVERUSE,
+	SIG_UNDERUSE,
+};
+
+struct sent_pkt {
+	uint64_t sent;       /**< Send time [us], 0 if unused         */
+	uint32_t size;       /**< Packet size [bytes]                 */
+	uint16_t seq;        /**< Transport-wide sequence number      */
+};
+
+struct pkt_group {
+	uint64_t first_sent; /**< Send time of the first packet [us]  */
+	uint64_t last_sent;  /**< Send time of the last packet [us]   */
+	int64_t arrival;     /**< Arrival of the last packet [us]     */
+	bool valid;
+};
+
+struct vidcc {
+	mtx_t *mtx;
+	struct sent_pkt histv[HIST_SIZE];
+	uint32_t min;                  /**< Min bitrate [bit/s]             */
+	uint32_t max;                  /**< Max bitrate [bit/s]             */
+	double rate;                   /**< Estimated bitrate [bit/s]       */
+	RE_ATOMIC uint32_t bitrate;    /**< Estimate for lock-free readers  */
+	enum vidcc_state state;
+	uint64_t t_update;             /**< Last rate update [us]           */
+	uint64_t t_backoff;            /**< Last backoff [us]               */
+	uint64_t t_congested;          /**< Last congestion signal [us]     */
+	uint64_t t_feedback;           /**< Last transport-wide feedback    */
+
+	/* Packet groups */
+	struct pkt_group grp;
+	struct pkt_group prev;
+
+	/* Trendline */
+	double acc_delay;              /**< Accumulated delay [ms]          */
+	double smoothed;               /**< Smoothed delay [ms]             */
+	double xv[TREND_WIN];          /**< Arrival time [ms]               */
+	double yv[TREND_WIN];          /**< Smoothed delay [ms]             */
+	unsigned trendc;               /**< Number of samples               */
+	unsigned deltac;               /**< Number of group deltas          */
+	int64_t arrival0;              /**< First arrival time [us]         */
+	double trend;                  /**< Modified trend                  */
+
+	/* Overuse detector */
+	double thresh;                 /**< Adaptive threshold [ms]         */
+	double prev_trend;
+	uint64_t overuse_us;           /**< Time over the threshold         */
+	unsigned overusec;
+	int64_t t_detect;              /**< Last detection [us]             */
+	enum signal signal;
+
+	/* Acknowledged bitrate */
+	uint64_t acked_bytes;
+	int64_t acked_t0;
+	uint32_t acked_rate;           /**< [bit/s], 0 if unknown           */
+
+	/* Receiver reports */
+	uint32_t rtt;                  /**< Smoothed round-trip time [us]   */
+	uint32_t rtt_min;              /**< Min round-trip time [us]        */
+	double loss;                   /**< Last loss fraction              */
+
+	bool changed;                  /**< Changed since last event        */
+	uint32_t reported;             /**< Last reported bitrate           */
+
+	struct {
+		uint64_t n_sent;
+		uint64_t n_acked;
+		uint64_t n_lost;
+		uint64_t n_backoff;
+		uint64_t n_feedback;
+	} stats;
+};
+
+
+static const char *state_namev[] = {
+	"probe", "increase", "hold", "backoff"
+};
+
+
+static void destructor(void *arg)
+{
+	struct vidcc *cc = arg;
+
+	mem_deref(cc->mtx);
+}
+
+
+static void set_state(struct vidcc *cc, enum vidcc_state state)
+{
+	if (state != cc->state)
+		cc->changed = true;
+
+	cc->state = state;
+}
+
+
+static void set_rate(struct vidcc *cc, double rate)
+{
+	uint32_t bitrate;
+
+	if (rate < cc->min)
+		rate = cc->min;
+	if (rate > cc->max)
+		rate = cc->max;
+
+	cc->rate = rate;
+	bitrate  = (uint32_t)rate;
+
+	if (bitrate > cc->reported + cc->reported / 10 ||
+	    bitrate < cc->reported - cc->reported / 10)
+		cc->changed = true;
+
+	re_atomic_rlx_set(&cc->bitrate, bitrate);
+}
+
+
+static void backoff(struct vidcc *cc, double rate, uint64_t now)
+{
+	uint32_t hold = max(cc->rtt, (uint32_t)HOLD_MIN_US);
+
+	cc->t_congested = now;
+
+	/* only one backoff per round-trip */
+	if (cc->state == VIDCC_DECREASE && now < cc->t_backoff + hold)
+		return;
+
+	set_rate(cc, rate);
+	set_state(cc, VIDCC_DECREASE);
+	cc->t_backoff = now;
+	++cc->stats.n_backoff;
+}
+
+
+static void increase(struct vidcc *cc, uint64_t now)
+{
+	double dt = (double)min(now - cc->t_update, (uint64_t)1000000) / 1e6;
+	double rate;
+
+	if (cc->state == VIDCC_INCREASE &&
+	    now > cc->t_congested + PROBE_AFTER_US)
+		set_state(cc, VIDCC_PROBE);
+
+	if (cc->state == VIDCC_PROBE)
+		rate = cc->rate * (1.0 + PROBE_RATE * dt);
+	else
+		rate = cc->rate * (1.0 + INC_RATE * dt);
+
+	/* do not run away from what the network delivers */
+	if (cc->acked_rate)
+		rate = min(rate, 1.5 * cc->acked_rate + 10000.0);
+
+	set_rate(cc, max(rate, cc->rate));
+}
+
+
+/* AIMD rate control driven by the detected signal */
+static void rate_update(struct vidcc *cc, enum signal sig, uint64_t now)
+{
+	uint32_t hold = max(cc->rtt, (uint32_t)HOLD_MIN_US);
+
+	switch (sig) {
+
+	case SIG_OVERUSE:
+		backoff(cc, BETA * (cc->acked_rate ? cc->acked_rate
+						   : cc->rate), now);
+		break;
+
+	case SIG_UNDERUSE:
+		/* the queues are draining */
+		set_state(cc, VIDCC_HOLD);
+		break;
+
+	case SIG_NORMAL:
+		if (cc->state == VIDCC_HOLD ||
+		    (cc->state == VIDCC_DECREASE &&
+		     now > cc->t_backoff + hold))
+			set_state(cc, VIDCC_INCREASE);
+
+		if (cc->state == VIDCC_INCREASE || cc->state == VIDCC_PROBE)
+			increase(cc, now);
+		break;
+	}
+
+	cc->t_update = now;
+}
+
+
+static double trendline_slope(const struct vidcc *cc)
+{
+	unsigned n = min(cc->trendc, (unsigned)TREND_WIN);
+	double xm = 0, ym = 0, num = 0, den = 0;
+
+	for (unsigned i = 0; i < n; i++) {
+		xm += cc->xv[i];
+		ym += cc->yv[i];
+	}
+
+	xm /= n;
+	ym /= n;
+
+	for (unsigned i = 0; i < n; i++) {
+		num += (cc->xv[i] - xm) * (cc->yv[i] - ym);
+		den += (cc->xv[i] - xm) * (cc->xv[i] - xm);
+	}
+
+	return den > 0 ? num / den : 0;
+}
+
+
+static void detect(struct vidcc *cc, int64_t arrival)
+{
+	double trend = cc->trend;
+	double abs_trend = trend < 0 ? -trend : trend;
+	int64_t dt = cc->t_detect ? arrival - cc->t_detect : 0;
+
+	dt = min(max(dt, (int64_t)0), (int64_t)100000);
+	cc->t_detect = arrival;
+
+	if (trend > cc->thresh) {
+
+		cc->overuse_us += dt;
+		++cc->overusec;
+
+		if (cc->overuse_us > OVERUSE_US && cc->overusec > 1 &&
+		    trend >= cc->prev_trend) {
+			cc->overuse_us = 0;
+			cc->overusec   = 0;
+			cc->signal     = SIG_OVERUSE;
+		}
+	}
+	else if (trend < -cc->thresh) {
+		cc->overuse_us = 0;
+		cc->overusec   = 0;
+		cc->signal     = SIG_UNDERUSE;
+	}
+	else {
+		cc->overuse_us = 0;
+		cc->overusec   = 0;
+		cc->signal     = SIG_NORMAL;
+	}
+
+	cc->prev_trend = trend;
+
+	/* adapt the threshold, but not to delay spikes */
+	if (abs_trend < cc->thresh + 15.0) {
+		double k = abs_trend < cc->thresh ? K_DOWN : K_UP;
+
+		cc->thresh += k * (abs_trend - cc->thresh) * (double)dt / 1000;
+		cc->thresh  = min(max(cc->thresh, 6.0), 600.0);
+	}
+}
+
+
+/* Delay variation between two packet groups */
+static void group_delta(struct vidcc *cc, const struct pkt_group *prev,
+			const struct pkt_group *grp)
+{
+	double d_send   = (double)(grp->last_sent - prev->last_sent) / 1000;
+	double d_arrive = (double)(grp->arrival - prev->arrival) / 1000;
+	unsigned idx;
+
+	if (!cc->deltac)
+		cc->arrival0 = grp->arrival;
+
+	++cc->deltac;
+
+	cc->acc_delay += d_arrive - d_send;
+	cc->smoothed   = SMOOTHING * cc->smoothed +
+		(1 - SMOOTHING) * cc->acc_delay;
+
+	idx = cc->trendc++ % TREND_WIN;
+	cc->xv[idx] = (double)(grp->arrival - cc->arrival0) / 1000;
+	cc->yv[idx] = cc->smoothed;
+
+	if (cc->trendc >= TREND_WIN) {
+		cc->trend = trendline_slope(cc) *
+			min(cc->deltac, 60u) * TREND_GAIN;
+	}
+
+	detect(cc, grp->arrival);
+}
+
+
+static void acked_update(struct vidcc *cc, uint32_t size, int64_t arrival)
+{
+	if (!cc->acked_t0 || arrival < cc->acked_t0) {
+		cc->acked_t0    = arrival;
+		cc->acked_bytes = 0;
+	}
+
+	cc->acked_bytes += size;
+
+	if (arrival - cc->acked_t0 >= ACKED_WIN_US) {
+		uint64_t rate = cc->acked_bytes * 8 * 1000000 /
+			(uint64_t)(arrival - cc->acked_t0);
+
+		cc->acked_rate  = cc->acked_rate ?
+			(uint32_t)((cc->acked_rate * 3 + rate) / 4) :
+			(uint32_t)rate;
+		cc->acked_t0    = arrival;
+		cc->acked_bytes = 0;
+	}
+}
+
+
+/**
+ * Allocate a video congestion controller
+ *
+ * The estimate starts at the maximum bitrate, the minimum bitrate is a
+ * tenth of the maximum.
+ *
+ * @param ccp Pointer to allocated congestion controller
+ * @param max Maximum bitrate in [bit/s]
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int vidcc_alloc(struct vidcc **ccp, uint32_t max)
+{
+	struct vidcc *cc;
+	int err;
+
+	if (!ccp || !max)
+		return EINVAL;
+
+	cc = mem_zalloc(sizeof(*cc), destructor);
+	if (!cc)
+		return ENOMEM;
+
+	err = mutex_alloc(&cc->mtx);
+	if (err) {
+		mem_deref(cc);
+		return err;
+	}
+
+	cc->max      = max;
+	cc->min      = max / MIN_DIV;
+	cc->state    = VIDCC_INCREASE;
+	cc->thresh   = THRESH_INIT;
+	cc->reported = max;
+	set_rate(cc, max);
+
+	*ccp = cc;
+
+	return 0;
+}
+
+
+/**
+ * Set the maximum bitrate, e.g. when simulcast layers are added
+ *
+ * @param cc  Video congestion controller
+ * @param max Maximum bitrate in [bit/s]
+ */
+void vidcc_set_max(struct vidcc *cc, uint32_t max)
+{
+	if (!cc || !max)
+		return;
+
+	mtx_lock(cc->mtx);
+	cc->rate = cc->rate * max / cc->max;
+	cc->max  = max;
+	cc->min  = max / MIN_DIV;
+	set_rate(cc, cc->rate);
+	mtx_unlock(cc->mtx);
+}
+
+
+/**
+ * Register a sent packet with a transport-wide sequence number
+ *
+ * @param cc   Video congestion controller
+ * @param seq  Transport-wide sequence number
+ * @param size Packet size in [bytes]
+ * @param now  Send time in [us]
+ */
+void vidcc_sent(struct vidcc *cc, uint16_t seq, size_t size, uint64_t now)
+{
+	struct sent_pkt *pkt;
+
+	if (!cc)
+		return;
+
+	mtx_lock(cc->mtx);
+	pkt = &cc->histv[seq & (HIST_SIZE - 1)];
+	pkt->seq  = seq;
+	pkt->size = (uint32_t)size;
+	pkt->sent = now ? now : 1;
+	++cc->stats.n_sent;
+	mtx_unlock(cc->mtx);
+}
+
+
+static void arrival(struct vidcc *cc, uint16_t seq, int64_t t)
+{
+	struct sent_pkt *pkt = &cc->histv[seq & (HIST_SIZE - 1)];
+	struct pkt_group *grp = &cc->grp;
+
+	if (!pkt->sent || pkt->seq != seq)
+		return;
+
+	++cc->stats.n_acked;
+	acked_update(cc, pkt->size, t);
+
+	if (!grp->valid) {
+		grp->first_sent = grp->last_sent = pkt->sent;
+		grp->arrival = t;
+		grp->valid   = true;
+	}
+	else if (pkt->sent < grp->first_sent) {
+		/* reordered, belongs to an earlier group */
+	}
+	else if (pkt->sent - grp->first_sent <= BURST_US) {
+		grp->last_sent = max(grp->last_sent, pkt->sent);
+		grp->arrival   = max(grp->arrival, t);
+	}
+	else {
+		if (cc->prev.valid)
+			group_delta(cc, &cc->prev, grp);
+
+		cc->prev = *grp;
+
+		grp->first_sent = grp->last_sent = pkt->sent;
+		grp->arrival = t;
+	}
+
+	pkt->sent = 0;
+}
+
+
+/**
+ * Register the arrival time of a packet, reported by the receiver
+ *
+ * @param cc      Video congestion controller
+ * @param seq     Transport-wide sequence number
+ * @param arrival_us Arrival time in [us] on the receiver clock
+ */
+void vidcc_arrival(struct vidcc *cc, uint16_t seq, int64_t arrival_us)
+{
+	if (!cc)
+		return;
+
+	mtx_lock(cc->mtx);
+	arrival(cc, seq, arrival_us);
+	mtx_unlock(cc->mtx);
+}
+
+
+/**
+ * Update the estimate after a feedback report has been processed
+ *
+ * @param cc  Video congestion controller
+ * @param now Current time in [us]
+ */
+void vidcc_feedback(struct vidcc *cc, uint64_t now)
+{
+	if (!cc)
+		return;
+
+	mtx_lock(cc->mtx);
+	++cc->stats.n_feedback;
+	cc->t_feedback = now;
+
+	if (cc->signal != SIG_NORMAL)
+		cc->t_congested = now;
+
+	rate_update(cc, cc->signal, now);
+	mtx_unlock(cc->mtx);
+}
+
+
+/**
+ * Handle transport-wide congestion control feedback
+ *
+ * @param cc   Video congestion controller
+ * @param twcc Decoded RTCP transport-wide feedback
+ * @param now  Current time in [us]
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int vidcc_twcc(struct vidcc *cc, const struct twcc *twcc, uint64_t now)
+{
+	const uint8_t *chunk, *chunk_end, *delta, *delta_end;
+	int64_t t;
+	uint16_t seq;
+	unsigned left;
+	int err = 0;
+
+	if (!cc || !twcc || !twcc->chunks || !twcc->deltas)
+		return EINVAL;
+
+	chunk     = twcc->chunks->buf;
+	chunk_end = chunk + twcc->chunks->end;
+	delta     = twcc->deltas->buf;
+	delta_end = delta + twcc->deltas->end;
+
+	t    = (int64_t)twcc->reftime * 64000;
+	seq  = twcc->seq;
+	left = twcc->count;
+
+	mtx_lock(cc->mtx);
+
+	while (left && chunk + 2 <= chunk_end) {
+		uint16_t c = chunk[0] << 8 | chunk[1];
+		unsigned symc, bits;
+
+		chunk += 2;
+
+		if (c & 0x8000) {
+			/* status vector chunk */
+			bits = (c & 0x4000) ? 2 : 1;
+			symc = 14 / bits;
+		}
+		else {
+			/* run length chunk */
+			bits = 0;
+			symc = c & 0x1fff;
+		}
+
+		for (unsigned i = 0; i < symc && left; i++, left--, seq++) {
+			unsigned sym;
+
+			if (bits)
+				sym = (c >> (14 - bits * (i + 1))) &
+					((1u << bits) - 1);
+			else
+				sym = (c >> 13) & 0x3;
+
+			if (sym == 1) {
+				if (delta + 1 > delta_end) {
+					err = EBADMSG;
+					goto out;
+				}
+
+				t += delta[0] * 250;
+				delta += 1;
+			}
+			else if (sym == 2) {
+				if (delta + 2 > delta_end) {
+					err = EBADMSG;
+					goto out;
+				}
+
+				t += (int16_t)(delta[0] << 8 | delta[1]) * 250;
+				delta += 2;
+			}
+			else {
+				++cc->stats.n_lost;
+				continue;
+			}
+
+			arrival(cc, seq, t);
+		}
+	}
+
+ out:
+	mtx_unlock(cc->mtx);
+
+	vidcc_feedback(cc, now);
+
+	return err;
+}
+
+
+/**
+ * Handle a receiver report for the sent stream
+ *
+ * @param cc       Video congestion controller
+ * @param fraction Fraction lost, in units of 1/256
+ * @param rtt      Round-trip time in [us], 0 if unknown
+ * @param now      Current time in [us]
+ */
+void vidcc_loss(struct vidcc *cc, uint8_t fraction, uint32_t rtt,
+		uint64_t now)
+{
+	bool delay_fb;
+
+	if (!cc)
+		return;
+
+	mtx_lock(cc->mtx);
+
+	cc->loss = fraction / 256.0;
+	delay_fb = cc->t_feedback && now < cc->t_feedback + FB_TIMEOUT_US;
+
+	if (rtt) {
+		cc->rtt     = cc->rtt ? (cc->rtt * 7 + rtt) / 8 : rtt;
+		cc->rtt_min = cc->rtt_min ? min(cc->rtt_min, rtt) : rtt;
+	}
+
+	if (cc->loss > LOSS_HIGH) {
+		backoff(cc, cc->rate * (1 - 0.5 * cc->loss), now);
+	}
+	else if (!delay_fb && rtt &&
+		 cc->rtt > cc->rtt_min + RTT_QUEUE_US) {
+		/* queuing delay without transport-wide feedback */
+		rate_update(cc, SIG_OVERUSE, now);
+	}
+	else if (cc->loss < LOSS_LOW && !delay_fb) {
+		rate_update(cc, SIG_NORMAL, now);
+	}
+
+	cc->t_update = now;
+
+	mtx_unlock(cc->mtx);
+}
+
+
+/**
+ * Get the estimated bitrate
+ *
+ * @param cc Video congestion controller
+ *
+ * @return Bitrate in [bit/s]
+ */
+uint32_t vidcc_bitrate(const struct vidcc *cc)
+{
+	return cc ? re_atomic_rlx(&cc->bitrate) : 0;
+}
+
+
+/**
+ * Get the maximum bitrate
+ *
+ * @param cc Video congestion controller
+ *
+ * @return Bitrate in [bit/s]
+ */
+uint32_t vidcc_max(const struct vidcc *cc)
+{
+	uint32_t max;
+
+	if (!cc)
+		return 0;
+
+	mtx_lock(cc->mtx);
+	max = cc->max;
+	mtx_unlock(cc->mtx);
+
+	return max;
+}
+
+
+/**
+ * Get the state of the rate controller
+ *
+ * @param cc Video congestion controller
+ *
+ * @return Rate controller state
+ */
+enum vidcc_state vidcc_state(const struct vidcc *cc)
+{
+	enum vidcc_state state;
+
+	if (!cc)
+		return VIDCC_HOLD;
+
+	mtx_lock(cc->mtx);
+	state = cc->state;
+	mtx_unlock(cc->mtx);
+
+	return state;
+}
+
+
+/**
+ * Get the name of a rate controller state
+ *
+ * @param state Rate controller state
+ *
+ * @return State name
+ */
+const char *vidcc_state_name(enum vidcc_state state)
+{
+	if ((unsigned)state >= RE_ARRAY_SIZE(state_namev))
+		return "?";
+
+	return state_namev[state];
+}
+
+
+/**
+ * Check if the estimate or state changed significantly since the last
+ * call, used to rate-limit events
+ *
+ * @param cc Video congestion controller
+ *
+ * @return True if changed
+ */
+bool vidcc_changed(struct vidcc *cc)
+{
+	bool changed;
+
+	if (!cc)
+		return false;
+
+	mtx_lock(cc->mtx);
+	changed = cc->changed;
+	cc->changed  = false;
+	cc->reported = (uint32_t)cc->rate;
+	mtx_unlock(cc->mtx);
+
+	return changed;
+}
+
+
+/**
+ * Print the estimate and the state
+ *
+ * @param pf Print function
+ * @param cc Video congestion controller
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int vidcc_print(struct re_printf *pf, const struct vidcc *cc)
+{
+	if (!cc)
+		return 0;
+
+	return re_hprintf(pf, "%u,%s", vidcc_bitrate(cc),
+			  vidcc_state_name(vidcc_state(cc)));
+}
+
+
+/**
+ * Print the congestion controller status
+ *
+ * @param pf Print function
+ * @param cc Video congestion controller
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int vidcc_debug(struct re_printf *pf, const struct vidcc *cc)
+{
+	int err;
+
+	if (!cc)
+		return 0;
+
+	mtx_lock(cc->mtx);
+	err = re_hprintf(pf, "estimate=%u bit/s (%u-%u) state=%s"
+			 " acked=%u bit/s\n",
+			 (uint32_t)cc->rate, cc->min, cc->max,
+			 vidcc_state_name(cc->state), cc->acked_rate);
+	err |= re_hprintf(pf, "     trend=%.2f threshold=%.2f"
+			  " rtt=%u us loss=%.1f%%\n",
+			  cc->trend, cc->thresh, cc->rtt, cc->loss * 100);
+	err |= re_hprintf(pf, "     sent=%llu acked=%llu lost=%llu"
+			  " feedback=%llu backoff=%llu\n",
+			  cc->stats.n_sent, cc->stats.n_acked,
+			  cc->stats.n_lost, cc->stats.n_feedback,
+			  cc->stats.n_backoff);
+	mtx_unlock(cc->mtx);
+
+	return err;
+}
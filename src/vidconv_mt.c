@@ -0,0 +1,656 @@
+/**
+ * @file vidconv_mt.c  Parallel video pixel format converter
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define VIDCONV_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define VIDCONV_NEON 1
+#endif
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/*
+ * The common capture formats are converted to YUV420P by SIMD kernels.
+ * A frame is split in slices of rows that are converted in parallel by a
+ * shared pool of worker threads, the calling thread converts one slice
+ * itself. The slice layout of each format and size is cached as a plan.
+ *
+ * Other conversions, and conversions with scaling, use vidconv().
+ */
+
+
+enum {
+	MIN_SLICE_ROWS = 64,   /* Smallest slice height                  */
+	MAX_SLICES     = 16,   /* Max number of slices per frame         */
+	MAX_PLANS      = 16,   /* Number of cached conversion plans      */
+};
+
+
+typedef void (slice_h)(struct vidframe *dst, const struct vidframe *src,
+		       unsigned y0, unsigned y1);
+
+struct vplan {
+	struct le le;
+	enum vidfmt src_fmt;
+	enum vidfmt dst_fmt;
+	struct vidsz size;
+	slice_h *sliceh;
+	unsigned slicec;
+	unsigned rows;             /* Rows per slice, even             */
+	uint64_t usec;             /* Accumulated conversion time      */
+	uint64_t frames;           /* Frames converted                 */
+};
+
+struct batch {
+	struct le le;
+	const struct vplan *plan;
+	struct vidframe *dst;
+	const struct vidframe *src;
+	unsigned next;             /* Next slice to convert            */
+	unsigned done;             /* Slices converted                 */
+};
+
+static struct {
+	mtx_t *mtx;
+	cnd_t work;                /* Signals new batches              */
+	cnd_t done;                /* Signals finished slices          */
+	struct list batchl;
+	struct list planl;         /* Most recently used first         */
+	thrd_t *thrdv;
+	unsigned thrdc;
+	bool run;
+	uint64_t n_hit;
+	uint64_t n_miss;
+	uint64_t n_fallback;
+} pool;
+
+
+static inline uint8_t rgb2y(int r, int g, int b)
+{
+	return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+
+static inline uint8_t rgb2u(int r, int g, int b)
+{
+	return (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+
+static inline uint8_t rgb2v(int r, int g, int b)
+{
+	return (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+
+/* Two packed YUYV rows, returns the number of pixels converted */
+static unsigned yuyv_rows(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+			  const uint8_t *p0, const uint8_t *p1, unsigned n)
+{
+	unsigned x = 0;
+
+#if defined(VIDCONV_SSE2)
+	const __m128i mask = _mm_set1_epi16(0x00ff);
+
+	for (; x + 16 <= n; x += 16) {
+		__m128i a0 = _mm_loadu_si128((const void *)&p0[x * 2]);
+		__m128i a1 = _mm_loadu_si128((const void *)&p0[x * 2 + 16]);
+		__m128i b0 = _mm_loadu_si128((const void *)&p1[x * 2]);
+		__m128i b1 = _mm_loadu_si128((const void *)&p1[x * 2 + 16]);
+		__m128i c0, c1, uv;
+
+		_mm_storeu_si128((void *)&y0[x],
+				 _mm_packus_epi16(_mm_and_si128(a0, mask),
+						  _mm_and_si128(a1, mask)));
+		_mm_storeu_si128((void *)&y1[x],
+				 _mm_packus_epi16(_mm_and_si128(b0, mask),
+						  _mm_and_si128(b1, mask)));
+
+		/* chroma of both rows, rounded average */
+		c0 = _mm_avg_epu8(_mm_srli_epi16(a0, 8),
+				  _mm_srli_epi16(b0, 8));
+		c1 = _mm_avg_epu8(_mm_srli_epi16(a1, 8),
+				  _mm_srli_epi16(b1, 8));
+		uv = _mm_packus_epi16(c0, c1);
+
+		_mm_storel_epi64((void *)&u[x / 2],
+				 _mm_packus_epi16(_mm_and_si128(uv, mask),
+						  _mm_setzero_si128()));
+		_mm_storel_epi64((void *)&v[x / 2],
+				 _mm_packus_epi16(_mm_srli_epi16(uv, 8),
+						  _mm_setzero_si128()));
+	}
+#elif defined(VIDCONV_NEON)
+	for (; x + 32 <= n; x += 32) {
+		uint8x16x4_t a = vld4q_u8(&p0[x * 2]);
+		uint8x16x4_t b = vld4q_u8(&p1[x * 2]);
+		uint8x16x2_t l;
+
+		l.val[0] = a.val[0];
+		l.val[1] = a.val[2];
+		vst2q_u8(&y0[x], l);
+		l.val[0] = b.val[0];
+		l.val[1] = b.val[2];
+		vst2q_u8(&y1[x], l);
+
+		vst1q_u8(&u[x / 2], vrhaddq_u8(a.val[1], b.val[1]));
+		vst1q_u8(&v[x / 2], vrhaddq_u8(a.val[3], b.val[3]));
+	}
+#endif
+
+	return x;
+}
+
+
+static void yuyv_to_yuv420p(struct vidframe *dst, const struct vidframe *src,
+			    unsigned y0, unsigned y1)
+{
+	const unsigned w = dst->size.w;
+
+	for (unsigned yy = y0; yy < y1; yy += 2) {
+		const uint8_t *p0 = src->data[0] + yy * src->linesize[0];
+		const uint8_t *p1 = p0 + src->linesize[0];
+		uint8_t *d0 = dst->data[0] + yy * dst->linesize[0];
+		uint8_t *d1 = d0 + dst->linesize[0];
+		uint8_t *u  = dst->data[1] + yy / 2 * dst->linesize[1];
+		uint8_t *v  = dst->data[2] + yy / 2 * dst->linesize[2];
+		unsigned x = yuyv_rows(d0, d1, u, v, p0, p1, w);
+
+		for (; x < w; x += 2) {
+			d0[x]     = p0[x * 2];
+			d0[x + 1] = p0[x * 2 + 2];
+			d1[x]     = p1[x * 2];
+			d1[x + 1] = p1[x * 2 + 2];
+			u[x / 2]  = (uint8_t)((p0[x * 2 + 1] +
+					       p1[x * 2 + 1] + 1) >> 1);
+			v[x / 2]  = (uint8_t)((p0[x * 2 + 3] +
+					       p1[x * 2 + 3] + 1) >> 1);
+		}
+	}
+}
+
+
+/* Deinterleave n chroma pairs, returns the number of pairs converted */
+static unsigned nv12_row(uint8_t *u, uint8_t *v, const uint8_t *p,
+			 unsigned n)
+{
+	unsigned x = 0;
+
+#if defined(VIDCONV_SSE2)
+	const __m128i mask = _mm_set1_epi16(0x00ff);
+
+	for (; x + 16 <= n; x += 16) {
+		__m128i a = _mm_loadu_si128((const void *)&p[x * 2]);
+		__m128i b = _mm_loadu_si128((const void *)&p[x * 2 + 16]);
+
+		_mm_storeu_si128((void *)&u[x],
+				 _mm_packus_epi16(_mm_and_si128(a, mask),
+						  _mm_and_si128(b, mask)));
+		_mm_storeu_si128((void *)&v[x],
+				 _mm_packus_epi16(_mm_srli_epi16(a, 8),
+						  _mm_srli_epi16(b, 8)));
+	}
+#elif defined(VIDCONV_NEON)
+	for (; x + 16 <= n; x += 16) {
+		uint8x16x2_t a = vld2q_u8(&p[x * 2]);
+
+		vst1q_u8(&u[x], a.val[0]);
+		vst1q_u8(&v[x], a.val[1]);
+	}
+#endif
+
+	return x;
+}
+
+
+static void nv12_to_yuv420p(struct vidframe *dst, const struct vidframe *src,
+			    unsigned y0, unsigned y1)
+{
+	const unsigned w = dst->size.w;
+
+	for (unsigned yy = y0; yy < y1; yy++) {
+		memcpy(dst->data[0] + yy * dst->linesize[0],
+		       src->data[0] + yy * src->linesize[0], w);
+	}
+
+	for (unsigned yy = y0 / 2; yy < y1 / 2; yy++) {
+		const uint8_t *p = src->data[1] + yy * src->linesize[1];
+		uint8_t *u = dst->data[1] + yy * dst->linesize[1];
+		uint8_t *v = dst->data[2] + yy * dst->linesize[2];
+
+		for (unsigned x = nv12_row(u, v, p, w / 2); x < w / 2; x++) {
+			u[x] = p[x * 2];
+			v[x] = p[x * 2 + 1];
+		}
+	}
+}
+
+
+/* Luma of one RGB32 row, returns the number of pixels converted */
+static unsigned rgb32_luma(uint8_t *y, const uint8_t *p, unsigned n)
+{
+	unsigned x = 0;
+
+#if defined(VIDCONV_SSE2)
+	const __m128i m8  = _mm_set1_epi32(0xff);
+	const __m128i cr  = _mm_set1_epi16(66);
+	const __m128i cg  = _mm_set1_epi16(129);
+	const __m128i cb  = _mm_set1_epi16(25);
+	const __m128i rnd = _mm_set1_epi16(128);
+	const __m128i off = _mm_set1_epi16(16);
+
+	for (; x + 8 <= n; x += 8) {
+		__m128i a = _mm_loadu_si128((const void *)&p[x * 4]);
+		__m128i b = _mm_loadu_si128((const void *)&p[x * 4 + 16]);
+		__m128i bb, gg, rr, s;
+
+		bb = _mm_packs_epi32(_mm_and_si128(a, m8),
+				     _mm_and_si128(b, m8));
+		gg = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(a, 8), m8),
+				     _mm_and_si128(_mm_srli_epi32(b, 8), m8));
+		rr = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(a, 16), m8),
+				     _mm_and_si128(_mm_srli_epi32(b, 16), m8));
+
+		/* max 220 * 255 + 128, fits in unsigned 16-bit */
+		s = _mm_add_epi16(_mm_mullo_epi16(rr, cr),
+				  _mm_mullo_epi16(gg, cg));
+		s = _mm_add_epi16(s, _mm_mullo_epi16(bb, cb));
+		s = _mm_add_epi16(_mm_srli_epi16(_mm_add_epi16(s, rnd), 8),
+				  off);
+
+		_mm_storel_epi64((void *)&y[x], _mm_packus_epi16(s, s));
+	}
+#elif defined(VIDCONV_NEON)
+	for (; x + 8 <= n; x += 8) {
+		uint8x8x4_t px = vld4_u8(&p[x * 4]);
+		uint16x8_t s;
+
+		s = vmull_u8(px.val[2], vdup_n_u8(66));
+		s = vmlal_u8(s, px.val[1], vdup_n_u8(129));
+		s = vmlal_u8(s, px.val[0], vdup_n_u8(25));
+
+		vst1_u8(&y[x], vadd_u8(vrshrn_n_u16(s, 8), vdup_n_u8(16)));
+	}
+#endif
+
+	return x;
+}
+
+
+static void rgb32_to_yuv420p(struct vidframe *dst, const struct vidframe *src,
+			     unsigned y0, unsigned y1)
+{
+	const unsigned w = dst->size.w;
+
+	for (unsigned yy = y0; yy < y1; yy++) {
+		const uint8_t *p = src->data[0] + yy * src->linesize[0];
+		uint8_t *d = dst->data[0] + yy * dst->linesize[0];
+
+		for (unsigned x = rgb32_luma(d, p, w); x < w; x++)
+			d[x] = rgb2y(p[x*4 + 2], p[x*4 + 1], p[x*4]);
+	}
+
+	for (unsigned yy = y0; yy < y1; yy += 2) {
+		const uint8_t *p0 = src->data[0] + yy * src->linesize[0];
+		const uint8_t *p1 = p0 + src->linesize[0];
+		uint8_t *u = dst->data[1] + yy / 2 * dst->linesize[1];
+		uint8_t *v = dst->data[2] + yy / 2 * dst->linesize[2];
+
+		for (unsigned x = 0; x < w; x += 2) {
+			const uint8_t *a = &p0[x * 4], *b = &p1[x * 4];
+			int r = (a[2] + a[6] + b[2] + b[6] + 2) >> 2;
+			int g = (a[1] + a[5] + b[1] + b[5] + 2) >> 2;
+			int bl = (a[0] + a[4] + b[0] + b[4] + 2) >> 2;
+
+			u[x / 2] = rgb2u(r, g, bl);
+			v[x / 2] = rgb2v(r, g, bl);
+		}
+	}
+}
+
+
+static slice_h *kernel_find(enum vidfmt src_fmt, enum vidfmt dst_fmt)
+{
+	if (dst_fmt != VID_FMT_YUV420P)
+		return NULL;
+
+	switch (src_fmt) {
+
+	case VID_FMT_YUYV422: return yuyv_to_yuv420p;
+	case VID_FMT_NV12:    return nv12_to_yuv420p;
+	case VID_FMT_RGB32:   return rgb32_to_yuv420p;
+	default:              return NULL;
+	}
+}
+
+
+static void plan_destructor(void *arg)
+{
+	struct vplan *plan = arg;
+
+	list_unlink(&plan->le);
+}
+
+
+/*
+ * Find or create a plan, called with the pool locked. The least recently
+ * used plan is evicted from a full cache, a batch that still converts with
+ * it keeps its own reference.
+ */
+static struct vplan *plan_get(enum vidfmt src_fmt, enum vidfmt dst_fmt,
+			      const struct vidsz *sz)
+{
+	struct vplan *plan = NULL;
+	unsigned slicec;
+	struct le *le;
+
+	for (le = pool.planl.head; le; le = le->next) {
+		const struct vplan *p = le->data;
+
+		if (p->src_fmt == src_fmt && p->dst_fmt == dst_fmt &&
+		    vidsz_cmp(&p->size, sz)) {
+			plan = le->data;
+			break;
+		}
+	}
+
+	if (plan) {
+		/* most recently used first */
+		list_unlink(&plan->le);
+		list_prepend(&pool.planl, &plan->le, plan);
+		++pool.n_hit;
+		return plan;
+	}
+
+	++pool.n_miss;
+
+	if (list_count(&pool.planl) >= MAX_PLANS)
+		mem_deref(list_tail(&pool.planl)->data);
+
+	plan = mem_zalloc(sizeof(*plan), plan_destructor);
+	if (!plan)
+		return NULL;
+
+	slicec = min(pool.thrdc + 1, (unsigned)MAX_SLICES);
+	slicec = min(slicec, max(sz->h / MIN_SLICE_ROWS, 1u));
+
+	plan->src_fmt = src_fmt;
+	plan->dst_fmt = dst_fmt;
+	plan->size    = *sz;
+	plan->sliceh  = kernel_find(src_fmt, dst_fmt);
+	plan->rows    = ((sz->h + slicec - 1) / slicec + 1) & ~1u;
+	plan->slicec  = (sz->h + plan->rows - 1) / plan->rows;
+
+	list_prepend(&pool.planl, &plan->le, plan);
+
+	return plan;
+}
+
+
+static void slice_run(const struct batch *b, unsigned i)
+{
+	const struct vplan *plan = b->plan;
+	unsigned y0 = i * plan->rows;
+	unsigned y1 = min(y0 + plan->rows, plan->size.h);
+
+	plan->sliceh(b->dst, b->src, y0, y1);
+}
+
+
+/* Take the next slice of a batch, called with the pool locked */
+static unsigned slice_take(struct batch *b)
+{
+	unsigned i = b->next++;
+
+	if (b->next == b->plan->slicec)
+		list_unlink(&b->le);
+
+	return i;
+}
+
+
+static int worker_thread(void *arg)
+{
+	(void)arg;
+
+	mtx_lock(pool.mtx);
+	while (pool.run) {
+		struct batch *b;
+		unsigned i;
+
+		if (list_isempty(&pool.batchl)) {
+			cnd_wait(&pool.work, pool.mtx);
+			continue;
+		}
+
+		b = list_head(&pool.batchl)->data;
+		i = slice_take(b);
+		mtx_unlock(pool.mtx);
+
+		slice_run(b, i);
+
+		mtx_lock(pool.mtx);
+		if (++b->done == b->plan->slicec)
+			cnd_broadcast(&pool.done);
+	}
+	mtx_unlock(pool.mtx);
+
+	return 0;
+}
+
+
+/**
+ * Convert a video frame, using the worker pool if possible
+ *
+ * Falls back to vidconv() for conversions without a SIMD kernel and for
+ * conversions with scaling.
+ *
+ * @param dst Destination video frame
+ * @param src Source video frame
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int vidconv_mt(struct vidframe *dst, const struct vidframe *src)
+{
+	struct batch b;
+	struct vplan *plan;
+	uint64_t t0;
+
+	if (!dst || !src)
+		return EINVAL;
+
+	if (!pool.mtx || !vidsz_cmp(&dst->size, &src->size) ||
+	    (src->size.w | src->size.h) & 1 ||
+	    !kernel_find(src->fmt, dst->fmt)) {
+
+		if (pool.mtx) {
+			mtx_lock(pool.mtx);
+			++pool.n_fallback;
+			mtx_unlock(pool.mtx);
+		}
+
+		vidconv(dst, src, NULL);
+		return 0;
+	}
+
+	memset(&b, 0, sizeof(b));
+	b.dst = dst;
+	b.src = src;
+
+	t0 = tmr_jiffies_usec();
+
+	mtx_lock(pool.mtx);
+
+	plan = mem_ref(plan_get(src->fmt, dst->fmt, &src->size));
+	if (!plan) {
+		mtx_unlock(pool.mtx);
+		return ENOMEM;
+	}
+
+	b.plan = plan;
+
+	if (plan->slicec > 1) {
+		list_append(&pool.batchl, &b.le, &b);
+		cnd_broadcast(&pool.work);
+	}
+
+	/* the caller converts slices too */
+	while (b.next < plan->slicec) {
+		unsigned i = slice_take(&b);
+
+		mtx_unlock(pool.mtx);
+		slice_run(&b, i);
+		mtx_lock(pool.mtx);
+
+		++b.done;
+	}
+
+	while (b.done < plan->slicec)
+		cnd_wait(&pool.done, pool.mtx);
+
+	++plan->frames;
+	plan->usec += tmr_jiffies_usec() - t0;
+
+	mem_deref(plan);
+
+	mtx_unlock(pool.mtx);
+
+	return 0;
+}
+
+
+/**
+ * Check if a conversion has a parallel SIMD kernel
+ *
+ * @param src_fmt Source pixel format
+ * @param dst_fmt Destination pixel format
+ *
+ * @return True if supported, otherwise false
+ */
+bool vidconv_mt_supported(enum vidfmt src_fmt, enum vidfmt dst_fmt)
+{
+	return kernel_find(src_fmt, dst_fmt) != NULL;
+}
+
+
+/**
+ * Print the converter statistics and the cached plans
+ *
+ * @param pf     Print function
+ * @param unused Unused parameter
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int vidconv_mt_debug(struct re_printf *pf, void *unused)
+{
+	struct le *le;
+	int err;
+	(void)unused;
+
+	if (!pool.mtx)
+		return re_hprintf(pf, "vidconv: not initialized\n");
+
+	mtx_lock(pool.mtx);
+
+	err = re_hprintf(pf, "vidconv: %u threads, plans: hit=%llu"
+			 " miss=%llu, fallback=%llu\n",
+			 pool.thrdc, pool.n_hit, pool.n_miss,
+			 pool.n_fallback);
+
+	LIST_FOREACH(&pool.planl, le) {
+		const struct vplan *plan = le->data;
+
+		err |= re_hprintf(pf, "  %s -> %s %u x %u: %u slices,"
+				  " %llu frames, %llu us/frame\n",
+				  vidfmt_name(plan->src_fmt),
+				  vidfmt_name(plan->dst_fmt),
+				  plan->size.w, plan->size.h, plan->slicec,
+				  plan->frames,
+				  plan->frames ?
+				  plan->usec / plan->frames : 0);
+	}
+
+	mtx_unlock(pool.mtx);
+
+	return err;
+}
+
+
+int vidconv_mt_init(unsigned threads)
+{
+	int err;
+
+	if (pool.mtx)
+		return 0;
+
+	list_init(&pool.batchl);
+	list_init(&pool.planl);
+	pool.n_hit = pool.n_miss = pool.n_fallback = 0;
+
+	err = mutex_alloc(&pool.mtx);
+	if (err)
+		return err;
+
+	if (cnd_init(&pool.work) != thrd_success ||
+	    cnd_init(&pool.done) != thrd_success) {
+		pool.mtx = mem_deref(pool.mtx);
+		return ENOMEM;
+	}
+
+	if (!threads)
+		return 0;
+
+	pool.thrdv = mem_zalloc(threads * sizeof(*pool.thrdv), NULL);
+	if (!pool.thrdv) {
+		vidconv_mt_close();
+		return ENOMEM;
+	}
+
+	pool.run = true;
+
+	for (unsigned i = 0; i < threads; i++) {
+
+		err = thread_create_name(&pool.thrdv[i], "vidconv",
+					 worker_thread, NULL);
+		if (err) {
+			vidconv_mt_close();
+			return err;
+		}
+
+		++pool.thrdc;
+	}
+
+	return 0;
+}
+
+
+void vidconv_mt_close(void)
+{
+	if (!pool.mtx)
+		return;
+
+	mtx_lock(pool.mtx);
+	pool.run = false;
+	cnd_broadcast(&pool.work);
+	mtx_unlock(pool.mtx);
+
+	for (unsigned i = 0; i < pool.thrdc; i++)
+		thrd_join(pool.thrdv[i], NULL);
+
+	pool.thrdv = mem_deref(pool.thrdv);
+	pool.thrdc = 0;
+
+	list_flush(&pool.planl);
+
+	cnd_destroy(&pool.work);
+	cnd_destroy(&pool.done);
+	pool.mtx = mem_deref(pool.mtx);
+}
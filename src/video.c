@@ -31,9 +31,29 @@ enum {
 	NACK_BLPSZ	= 16,		       /**< NACK bitmask size        */
 	NACK_QUEUE_TIME	= 500,		       /**< in [ms]                  */
 	PKT_SIZE	= 1280,		       /**< max. Packet size in bytes*/
+	SIMULCAST_MAX	= 3,		       /**< Max. simulcast layers    */
+	ENC_RATE_TIME	= 2000,		       /**< Min. encoder update [ms] */
+	ENC_RESTART_TIME = 10000,	       /**< Min. encoder restart [ms]*/
+	FEC_GROUP	= 10,		       /**< FEC group until RR       */
+	FEC_WINDOW	= 200000,	       /**< FEC repair window [us]   */
 };
 
 
+/** RFC 8852 RTP Stream Identifier */
+static const char *uri_rid = "urn:ietf:params:rtp-hdrext:sdes:rtp-stream-id";
+
+/** Transport-wide sequence number (draft-holmer-rmcat-transport-wide-cc) */
+static const char *uri_twcc =
+	"http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc"
+	"-extensions-01";
+
+/** RFC 8627 Flexible Forward Error Correction */
+static const char *fec_name = "flexfec";
+
+/** Simulcast RIDs, full, half and quarter resolution */
+static const char *layer_ridv[SIMULCAST_MAX] = {"f", "h", "q"};
+
+
 /**
  * \page GenericVideoStream Generic Video Stream
  *
@@ -69,14 +89,48 @@ enum {
 
  Processing encoder pipeline:
 
- .         .--------.   .- - - - -.   .---------.   .---------.
- | ._O_.   |        |   !         !   |         |   |         |
- | |___|-->| vidsrc |-->! vidconv !-->| vidfilt |-->| encoder |---> RTP
- |         |        |   !         !   |         |   |         |
- '         '--------'   '- - - - -'   '---------'   '---------'
-                         (optional)
+ .         .--------.       .- - - - -.   .---------.   .---------.
+ | ._O_.   |        |       !         !   |         |   |         |
+ | |___|-->| vidsrc |--|>-->! vidconv !-->| vidfilt |-->| encoder |---> RTP
+ |         |        |       !         !   |         |   |         |
+ '         '--------'       '- - - - -'   '---------'   '---------'
+                      queue  (optional)
+ \endverbatim
+
+ The source thread only copies the frame into a one-slot queue, the
+ encoder thread always takes the latest frame (older frames are skipped).
+
+ With simulcast, the filtered frame is also downscaled for each layer.
+ Every layer is scaled from the layer above, and has its own encoder and
+ SSRC on the same RTP stream:
+
+ \verbatim
+
+ .---------.   .---------.
+ | vidfilt |-->| encoder |---> RTP (primary SSRC, rid "f")
+ '---------'   '---------'
+      |
+   1/2 scale   .---------.
+      |------->| encoder |---> RTP (SSRC 2, rid "h")
+      |        '---------'
+   1/2 scale   .---------.
+      '------->| encoder |---> RTP (SSRC 3, rid "q")
+               '---------'
  \endverbatim
  */
+
+/** Simulcast layer, layer 0 uses the encoder and SSRC of the stream */
+struct vlayer {
+	const char *rid;                   /**< RTP Stream Identifier     */
+	struct videnc_state *enc;          /**< Layer encoder (layer > 0) */
+	struct vidframe *frame;            /**< Downscaled frame          */
+	uint32_t bitrate;                  /**< Layer bitrate [bit/s]     */
+	uint32_t ssrc;                     /**< Layer SSRC (layer > 0)    */
+	uint16_t seq;                      /**< Next RTP sequence number  */
+	bool active;                       /**< Accepted by the peer      */
+	uint64_t frames;                   /**< Frames encoded            */
+};
+
 struct vtx {
 	struct video *video;               /**< Parent                    */
 	const struct vidcodec *vc;         /**< Current Video encoder     */
@@ -90,7 +144,14 @@ struct vtx {
 	mtx_t *lock_tx;                    /**< Protect the sendq         */
 	struct list sendq;                 /**< Tx-Queue (struct vidqent) */
 	struct list sendqnb;               /**< Tx-Queue NACK wait buffer */
-	unsigned skipc;                    /**< Number of frames skipped  */
+	mtx_t *lock_pend;                  /**< Protect the pending frame */
+	struct vidpool *pool;              /**< Frames queued for encoder */
+	struct vidframe *pend;             /**< Latest frame for encoder  */
+	uint64_t pend_ts;                  /**< Pending frame timestamp   */
+	uint64_t pend_jfs;                 /**< Pending frame queue time  */
+	thrd_t enc_thrd;                   /**< Encode-Thread             */
+	RE_ATOMIC bool enc_run;            /**< Encode-Thread is active   */
+	cnd_t enc_wait;                    /**< Encode-Thread wait        */
 	struct list filtl;                 /**< Filters in encoding order */
 	enum vidfmt fmt;                   /**< Outgoing pixel format     */
 	char device[128];                  /**< Source device name        */
@@ -103,10 +164,35 @@ struct vtx {
 	thrd_t thrd;                       /**< Tx-Thread                 */
 	RE_ATOMIC bool run;                /**< Tx-Thread is active       */
 	cnd_t wait;                        /**< Tx-Thread wait            */
+	struct vlayer layerv[SIMULCAST_MAX]; /**< Simulcast layers        */
+	unsigned layerc;                   /**< Number of offered layers  */
+	uint8_t extmap_rid;                /**< RID header extension id   */
+	bool simulcast;                    /**< Simulcast is negotiated   */
+	struct vidcc *cc;                  /**< Congestion controller     */
+	RE_ATOMIC bool cc_on;              /**< Peer sends TWCC feedback  */
+	uint8_t twcc_offer;                /**< Offered transport-wide id */
+	uint8_t extmap_twcc;               /**< Transport-wide seq. id    */
+	uint16_t twseq;                    /**< Next transport-wide seq.  */
+	char *enc_params;                  /**< Encoder fmtp parameters   */
+	uint32_t enc_rate;                 /**< Encoder target [bit/s]    */
+	RE_ATOMIC uint32_t enc_bitrate;    /**< Configured, active layers */
+	uint64_t enc_rate_jfs;             /**< Last encoder update [us]  */
+	struct fec_enc *fec;               /**< FEC encoder (optional)    */
+	int fec_pt;                        /**< FEC payload type, or -1   */
+	uint32_t fec_ssrc;                 /**< FEC repair SSRC           */
+	uint16_t fec_seq;                  /**< Next FEC sequence number  */
+	uint32_t fec_sent;                 /**< Packets sent at last RR   */
+	int32_t fec_lost;                  /**< Packets lost at last RR   */
 
 	/** Statistics */
 	struct {
 		uint64_t src_frames;       /**< Total frames from vidsrc  */
+		uint64_t skip_busy;        /**< Replaced, encoder busy    */
+		uint64_t skip_pacer;       /**< Skipped, pacer backlog    */
+		uint64_t enc_frames;       /**< Frames encoded            */
+		uint64_t enc_lat;          /**< Last encode latency [us]  */
+		uint64_t enc_lat_avg;      /**< Average latency [us]      */
+		uint64_t enc_lat_max;      /**< Max encode latency [us]   */
 	} stats;
 };
 
@@ -136,6 +222,7 @@ struct vrx {
 	struct vidisp_st *vidisp;          /**< Video display             */
 	mtx_t lock;                        /**< Lock for decoder          */
 	struct list filtl;                 /**< Filters in decoding order */
+	struct vidpool *pool;              /**< Pooled frames for filters */
 	struct tmr tmr_picup;              /**< Picture update timer      */
 	struct vidsz size;                 /**< Incoming video resolution */
 	enum vidfmt fmt;                   /**< Incoming pixel format     */
@@ -146,11 +233,13 @@ struct vrx {
 	double efps;                       /**< Estimated frame-rate      */
 	unsigned n_intra;                  /**< Intra-frames decoded      */
 	unsigned n_picup;                  /**< Picture updates sent      */
+	bool simulcast;                    /**< Receiving one sim. layer  */
 	struct timestamp_recv ts_recv;     /**< Receive timestamp state   */
 
 	/** Statistics */
 	struct {
 		uint64_t disp_frames;      /** Total frames displayed     */
+		uint64_t filt_copies;      /** Frames copied for filters  */
 	} stats;
 };
 
@@ -176,6 +265,9 @@ struct vidqent {
 	bool marker;
 	uint8_t pt;
 	uint32_t ts;
+	uint32_t ssrc;          /**< Simulcast layer SSRC, 0 for primary */
+	bool twcc;              /**< Has a transport-wide seq. number    */
+	uint16_t twseq;         /**< Transport-wide sequence number      */
 	uint64_t jfs_nack;
 	uint16_t seq;
 	struct mbuf *mb;
@@ -184,6 +276,7 @@ struct vidqent {
 
 static void request_picture_update(struct vrx *vrx);
 static void video_stop_source(struct video *v);
+static void venc_stop(struct vtx *vtx);
 
 
 static void vidqent_destructor(void *arg)
@@ -195,12 +288,24 @@ static void vidqent_destructor(void *arg)
 }
 
 
+/** RTP header extensions of an outgoing packet */
+struct vidext {
+	uint8_t id_rid;         /**< RID extension id                    */
+	const char *rid;        /**< RTP Stream Identifier, or NULL      */
+	uint8_t id_twcc;        /**< Transport-wide seq. id, 0 if unused */
+	uint16_t twseq;         /**< Transport-wide sequence number      */
+};
+
+
 static int vidqent_alloc(struct vidqent **qentp, struct stream *strm,
+			 const struct vidext *vext,
 			 bool marker, uint8_t pt, uint32_t ts,
 			 const uint8_t *hdr, size_t hdr_len,
 			 const uint8_t *pld, size_t pld_len)
 {
 	struct bundle *bun = stream_bundle(strm);
+	bool bundled = bundle_state(bun) != BUNDLE_NONE;
+	const char *rid = vext->rid;
 	struct vidqent *qent;
 	int err = 0;
 
@@ -215,6 +320,8 @@ static int vidqent_alloc(struct vidqent **qentp, struct stream *strm,
 	qent->marker = marker;
 	qent->pt     = pt;
 	qent->ts     = ts;
+	qent->twcc   = vext->id_twcc != 0;
+	qent->twseq  = vext->twseq;
 
 	qent->mb = mbuf_alloc(RTP_PRESZ + hdr_len + pld_len + RTP_TRAILSZ);
 	if (!qent->mb) {
@@ -224,7 +331,7 @@ static int vidqent_alloc(struct vidqent **qentp, struct stream *strm,
 
 	qent->mb->pos = qent->mb->end = RTP_PRESZ;
 
-	if (bundle_state(bun) != BUNDLE_NONE) {
+	if (bundled || rid || qent->twcc) {
 
 		const char *mid = stream_mid(strm);
 		size_t ext_len = 0;
@@ -236,8 +343,23 @@ static int vidqent_alloc(struct vidqent **qentp, struct stream *strm,
 
 		pos = qent->mb->pos;
 
-		rtpext_encode(qent->mb, bundle_extmap_mid(bun),
-			      str_len(mid), (void *)mid);
+		if (bundled) {
+			rtpext_encode(qent->mb, bundle_extmap_mid(bun),
+				      str_len(mid), (void *)mid);
+		}
+
+		if (rid) {
+			rtpext_encode(qent->mb, vext->id_rid,
+				      str_len(rid), (void *)rid);
+		}
+
+		if (qent->twcc) {
+			uint8_t seq[2] = {qent->twseq >> 8,
+					  qent->twseq & 0xff};
+
+			rtpext_encode(qent->mb, vext->id_twcc,
+				      sizeof(seq), seq);
+		}
 
 		ext_len = qent->mb->pos - pos;
 
@@ -280,6 +402,7 @@ static void video_destructor(void *arg)
 	stream_enable(v->strm, false);
 
 	/* transmit */
+	venc_stop(vtx);
 	if (re_atomic_rlx(&vtx->run)) {
 		re_atomic_rlx_set(&vtx->run, false);
 		cnd_signal(&vtx->wait);
@@ -292,12 +415,24 @@ static void video_destructor(void *arg)
 	mem_deref(vtx->lock_tx);
 
 	mem_deref(vtx->vsrc);
+	mtx_lock(vtx->lock_pend);
+	mem_deref(vtx->pend);
+	mtx_unlock(vtx->lock_pend);
+	mem_deref(vtx->lock_pend);
+	mem_deref(vtx->pool);
 	mtx_lock(vtx->lock_enc);
 	mem_deref(vtx->frame);
 	mem_deref(vtx->enc);
+	for (unsigned i = 0; i < vtx->layerc; i++) {
+		mem_deref(vtx->layerv[i].enc);
+		mem_deref(vtx->layerv[i].frame);
+	}
 	list_flush(&vtx->filtl);
+	mem_deref(vtx->enc_params);
 	mtx_unlock(vtx->lock_enc);
 	mem_deref(vtx->lock_enc);
+	mem_deref(vtx->cc);
+	mem_deref(vtx->fec);
 
 	/* receive */
 	tmr_cancel(&vrx->tmr_picup);
@@ -305,6 +440,7 @@ static void video_destructor(void *arg)
 	mem_deref(vrx->dec);
 	mem_deref(vrx->vidisp);
 	list_flush(&vrx->filtl);
+	mem_deref(vrx->pool);
 	mtx_unlock(&vrx->lock);
 	mtx_destroy(&vrx->lock);
 
@@ -328,13 +464,16 @@ static double get_fps(const struct video *v)
 }
 
 
-static int packet_handler(bool marker, uint64_t ts,
-			  const uint8_t *hdr, size_t hdr_len,
-			  const uint8_t *pld, size_t pld_len,
-			  const struct video *vid)
+/* Queue the packets of one simulcast layer, called with lock_enc held */
+static int layer_packet_send(const struct video *vid, unsigned idx,
+			     bool marker, uint64_t ts,
+			     const uint8_t *hdr, size_t hdr_len,
+			     const uint8_t *pld, size_t pld_len)
 {
 	struct vtx *vtx = (struct vtx *)&vid->vtx;
+	struct vlayer *layer = &vtx->layerv[idx];
 	struct stream *strm = vid->strm;
+	struct vidext vext;
 	struct vidqent *qent;
 	uint32_t rtp_ts;
 	int pt;
@@ -342,21 +481,32 @@ static int packet_handler(bool marker, uint64_t ts,
 
 	MAGIC_CHECK(vid);
 
+	vext.id_rid  = vtx->extmap_rid;
+	vext.rid     = vtx->simulcast ? layer->rid : NULL;
+
 	mtx_lock(vtx->lock_tx);
-	if (!vtx->ts_base)
-		vtx->ts_base = ts;
-	vtx->ts_last = ts;
+	if (idx == 0) {
+		if (!vtx->ts_base)
+			vtx->ts_base = ts;
+		vtx->ts_last = ts;
+	}
 	pt = stream_pt_enc(strm);
+	vext.id_twcc = vtx->extmap_twcc;
+	vext.twseq   = vext.id_twcc ? vtx->twseq++ : 0;
 	mtx_unlock(vtx->lock_tx);
 
 	/* add random timestamp offset */
 	rtp_ts = vtx->ts_offset + (ts & 0xffffffff);
 
-	err = vidqent_alloc(&qent, strm, marker, pt, rtp_ts,
+	err = vidqent_alloc(&qent, strm, &vext, marker, pt, rtp_ts,
 			    hdr, hdr_len, pld, pld_len);
 	if (err)
 		return err;
 
+	qent->ssrc = layer->ssrc;
+	if (layer->ssrc)
+		qent->seq = layer->seq++;
+
 	mtx_lock(vtx->lock_tx);
 	list_append(&vtx->sendq, &qent->le, qent);
 	mtx_unlock(vtx->lock_tx);
@@ -367,54 +517,295 @@ static int packet_handler(bool marker, uint64_t ts,
 }
 
 
+static int packet_handler(bool marker, uint64_t ts,
+			  const uint8_t *hdr, size_t hdr_len,
+			  const uint8_t *pld, size_t pld_len,
+			  const struct video *vid)
+{
+	return layer_packet_send(vid, 0, marker, ts,
+				 hdr, hdr_len, pld, pld_len);
+}
+
+
+static int layer1_packet_handler(bool marker, uint64_t ts,
+				 const uint8_t *hdr, size_t hdr_len,
+				 const uint8_t *pld, size_t pld_len,
+				 const struct video *vid)
+{
+	return layer_packet_send(vid, 1, marker, ts,
+				 hdr, hdr_len, pld, pld_len);
+}
+
+
+static int layer2_packet_handler(bool marker, uint64_t ts,
+				 const uint8_t *hdr, size_t hdr_len,
+				 const uint8_t *pld, size_t pld_len,
+				 const struct video *vid)
+{
+	return layer_packet_send(vid, 2, marker, ts,
+				 hdr, hdr_len, pld, pld_len);
+}
+
+
+static videnc_packet_h *layer_pkthv[SIMULCAST_MAX] = {
+	packet_handler,
+	layer1_packet_handler,
+	layer2_packet_handler,
+};
+
+
+/* Configured bitrate of the encoders, primary and active layers */
+static uint32_t vtx_enc_bitrate(const struct vtx *vtx)
+{
+	uint32_t bitrate = vtx->video->cfg.bitrate;
+
+	for (unsigned i = 1; i < vtx->layerc; i++) {
+
+		if (vtx->layerv[i].active)
+			bitrate += vtx->layerv[i].bitrate;
+	}
+
+	return bitrate;
+}
+
+
+/* Scale a configured bitrate to the congestion control estimate */
+static uint32_t cc_scale(const struct vtx *vtx, uint32_t bitrate)
+{
+	uint32_t max = vidcc_max(vtx->cc);
+
+	if (!re_atomic_rlx(&vtx->cc_on) || !max)
+		return bitrate;
+
+	return (uint32_t)((uint64_t)bitrate * vidcc_bitrate(vtx->cc) / max);
+}
+
+
+/* Pacer bitrate */
+static uint32_t vtx_bitrate(const struct vtx *vtx)
+{
+	const struct config_video *cfg = &vtx->video->cfg;
+	uint32_t bitrate, enc;
+	unsigned k;
+
+	if (cfg->send_bitrate)
+		bitrate = cfg->send_bitrate;
+	else
+		bitrate = cfg->bitrate;
+
+	/* simulcast layers, the active layers are set with lock_enc held */
+	enc = re_atomic_rlx(&vtx->enc_bitrate);
+	if (enc > cfg->bitrate)
+		bitrate += enc - cfg->bitrate;
+
+	/* FEC repair packets */
+	k = fec_enc_group(vtx->fec);
+	if (k)
+		bitrate += bitrate / k;
+
+	return max(cc_scale(vtx, bitrate), 1u);
+}
+
+
+/**
+ * Check if the pacer can send its backlog before the next frame
+ *
+ * @param vtx Video transmit object
+ *
+ * @return True if the frame should be skipped
+ */
+static bool pacer_busy(struct vtx *vtx)
+{
+	uint32_t bitrate = vtx_bitrate(vtx);
+	double fps = vtx->vsrc_prm.fps;
+	uint64_t bits = 0;
+	struct le *le;
+
+	if (!bitrate || fps <= 0)
+		return false;
+
+	mtx_lock(vtx->lock_tx);
+	LIST_FOREACH(&vtx->sendq, le) {
+		struct vidqent *qent = le->data;
+
+		bits += mbuf_get_left(qent->mb) * 8;
+	}
+	mtx_unlock(vtx->lock_tx);
+
+	return bits * 1000000 / bitrate > (uint64_t)(1000000 / fps);
+}
+
+
+/**
+ * Encode the simulcast layers, each downscaled from the layer above
+ *
+ * @note Called with lock_enc held
+ *
+ * @param vtx        Video transmit object
+ * @param frame      Filtered full resolution frame
+ * @param timestamp  Frame timestamp in VIDEO_TIMEBASE units
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+static int encode_layers(struct vtx *vtx, const struct vidframe *frame,
+			 uint64_t timestamp)
+{
+	const struct vidframe *src = frame;
+	int err;
+
+	for (unsigned i = 1; i < vtx->layerc; i++) {
+
+		struct vlayer *layer = &vtx->layerv[i];
+		struct vidsz sz;
+
+		if (!layer->enc)
+			continue;
+
+		sz.w = (frame->size.w >> i) & ~1u;
+		sz.h = (frame->size.h >> i) & ~1u;
+		if (!sz.w || !sz.h)
+			break;
+
+		if (layer->frame && (layer->frame->fmt != frame->fmt ||
+				     !vidsz_cmp(&layer->frame->size, &sz)))
+			layer->frame = mem_deref(layer->frame);
+
+		if (!layer->frame) {
+			err = vidframe_alloc(&layer->frame, frame->fmt, &sz);
+			if (err)
+				return err;
+		}
+
+		err = vidconv_mt(layer->frame, src);
+		if (err)
+			return err;
+
+		src = layer->frame;
+
+		err = vtx->vc->ench(layer->enc, vtx->picup, layer->frame,
+				    timestamp);
+		if (err)
+			return err;
+
+		++layer->frames;
+	}
+
+	return 0;
+}
+
+
+/* Set the bitrate of one encoder, restart it if it has no bitrate handler */
+static int encoder_bitrate(struct vtx *vtx, struct videnc_state **encp,
+			   uint32_t bitrate, videnc_packet_h *pkth)
+{
+	struct video *v = vtx->video;
+	const struct vidcodec *vc = vtx->vc;
+	struct videnc_param prm;
+
+	if (vc->bitrateh)
+		return vc->bitrateh(*encp, bitrate);
+
+	prm.pktsize = PKT_SIZE;
+	prm.fps     = get_fps(v);
+	prm.max_fs  = -1;
+	prm.bitrate = bitrate;
+
+	return vc->encupdh(encp, vc, &prm, vtx->enc_params, pkth, v);
+}
+
+
+/**
+ * Update the encoder bitrates to the congestion control estimate
+ *
+ * Codecs without a bitrate handler are restarted, which usually costs a
+ * keyframe, so they are updated at most every ENC_RESTART_TIME.
+ *
+ * @note Called with lock_enc held
+ *
+ * @param vtx Video transmit object
+ */
+static void encoder_rate_update(struct vtx *vtx)
+{
+	struct video *v = vtx->video;
+	const struct vidcodec *vc = vtx->vc;
+	uint64_t now = tmr_jiffies_usec();
+	uint32_t target, bitrate;
+	unsigned wait;
+	int err;
+
+	if (!re_atomic_rlx(&vtx->cc_on) || !vc)
+		return;
+
+	wait = vc->bitrateh ? ENC_RATE_TIME : ENC_RESTART_TIME;
+	if (now < vtx->enc_rate_jfs + wait * 1000)
+		return;
+
+	target = cc_scale(vtx, vtx_enc_bitrate(vtx));
+
+	/* ignore small changes */
+	if (target < vtx->enc_rate + vtx->enc_rate / 8 &&
+	    target > vtx->enc_rate - vtx->enc_rate / 8)
+		return;
+
+	bitrate = cc_scale(vtx, v->cfg.bitrate);
+
+	debug("video: congestion control: encoder %u bit/s\n", bitrate);
+
+	err = encoder_bitrate(vtx, &vtx->enc, bitrate, packet_handler);
+
+	for (unsigned i = 1; i < vtx->layerc && !err; i++) {
+		struct vlayer *layer = &vtx->layerv[i];
+
+		if (!layer->enc)
+			continue;
+
+		err = encoder_bitrate(vtx, &layer->enc,
+				      cc_scale(vtx, layer->bitrate),
+				      layer_pkthv[i]);
+	}
+
+	if (err)
+		warning("video: encoder bitrate update: %m\n", err);
+
+	vtx->enc_rate     = target;
+	vtx->enc_rate_jfs = now;
+}
+
+
 /**
  * Encode video and send via RTP stream
  *
- * @note This function has REAL-TIME properties
+ * @note Called from the encode thread
  *
  * @param vtx        Video transmit object
  * @param frame      Video frame to send
  * @param timestamp  Frame timestamp in VIDEO_TIMEBASE units
+ * @param jfs        Queue time of the frame in [us]
  */
 static void encode_rtp_send(struct vtx *vtx, struct vidframe *frame,
-			    struct vidpacket *packet, uint64_t timestamp)
+			    uint64_t timestamp, uint64_t jfs)
 {
 	struct le *le;
+	uint64_t lat;
 	int err = 0;
-	bool sendq_empty;
 
 	if (!vtx->enc)
 		return;
 
-	if (packet) {
+	if (pacer_busy(vtx)) {
 		mtx_lock(vtx->lock_enc);
-
-		if (vtx->vc && vtx->vc->packetizeh) {
-			err = vtx->vc->packetizeh(vtx->enc, packet);
-			if (err)
-				goto out;
-
-			vtx->picup = false;
-		}
-		else {
-			warning("video: Skipping Packet as"
-				" Packetize Handler not initialized ..\n");
-		}
-		goto out;
-	}
-
-	mtx_lock(vtx->lock_tx);
-	sendq_empty = (vtx->sendq.head == NULL);
-
-	if (!sendq_empty) {
-		++vtx->skipc;
-		mtx_unlock(vtx->lock_tx);
+		++vtx->stats.skip_pacer;
+		mtx_unlock(vtx->lock_enc);
 		return;
 	}
-	mtx_unlock(vtx->lock_tx);
 
 	mtx_lock(vtx->lock_enc);
 
+	if (!vtx->enc)
+		goto out;
+
+	encoder_rate_update(vtx);
+
 	/* Convert image */
 	if (frame->fmt != (enum vidfmt)vtx->video->cfg.enc_fmt) {
 
@@ -429,7 +820,10 @@ static void encode_rtp_send(struct vtx *vtx, struct vidframe *frame,
 				goto out;
 		}
 
-		vidconv(vtx->frame, frame, 0);
+		err = vidconv_mt(vtx->frame, frame);
+		if (err)
+			goto out;
+
 		frame = vtx->frame;
 	}
 
@@ -453,16 +847,105 @@ static void encode_rtp_send(struct vtx *vtx, struct vidframe *frame,
 	if (err)
 		goto out;
 
+	++vtx->layerv[0].frames;
+
+	err = encode_layers(vtx, frame, timestamp);
+	if (err)
+		goto out;
+
 	vtx->picup = false;
 
+	/* Latency from capture to encoded packets */
+	lat = tmr_jiffies_usec() - jfs;
+
+	++vtx->stats.enc_frames;
+	vtx->stats.enc_lat     = lat;
+	vtx->stats.enc_lat_max = max(vtx->stats.enc_lat_max, lat);
+	vtx->stats.enc_lat_avg = vtx->stats.enc_lat_avg ?
+		(vtx->stats.enc_lat_avg * 7 + lat) / 8 : lat;
+
  out:
 	mtx_unlock(vtx->lock_enc);
 }
 
 
+static int venc_thread(void *arg)
+{
+	struct vtx *vtx = arg;
+
+	media_thread_place(MEDIA_THREAD_VIDEO);
+
+	mtx_lock(vtx->lock_pend);
+	while (re_atomic_rlx(&vtx->enc_run)) {
+		struct vidframe *frame;
+		uint64_t ts, jfs;
+
+		if (!vtx->pend) {
+			cnd_wait(&vtx->enc_wait, vtx->lock_pend);
+			continue;
+		}
+
+		frame = vtx->pend;
+		ts    = vtx->pend_ts;
+		jfs   = vtx->pend_jfs;
+		vtx->pend = NULL;
+		mtx_unlock(vtx->lock_pend);
+
+		encode_rtp_send(vtx, frame, ts, jfs);
+		mem_deref(frame);
+
+		mtx_lock(vtx->lock_pend);
+	}
+	mtx_unlock(vtx->lock_pend);
+
+	return 0;
+}
+
+
+static int venc_start(struct vtx *vtx)
+{
+	int err;
+
+	if (re_atomic_rlx(&vtx->enc_run))
+		return 0;
+
+	re_atomic_rlx_set(&vtx->enc_run, true);
+
+	err = thread_create_name(&vtx->enc_thrd, "Video Enc",
+				 venc_thread, vtx);
+	if (err) {
+		re_atomic_rlx_set(&vtx->enc_run, false);
+		warning("video: could not start encode thread (%m)\n", err);
+	}
+
+	return err;
+}
+
+
+static void venc_stop(struct vtx *vtx)
+{
+	if (!re_atomic_rlx(&vtx->enc_run))
+		return;
+
+	mtx_lock(vtx->lock_pend);
+	re_atomic_rlx_set(&vtx->enc_run, false);
+	cnd_signal(&vtx->enc_wait);
+	mtx_unlock(vtx->lock_pend);
+
+	thrd_join(vtx->enc_thrd, NULL);
+
+	mtx_lock(vtx->lock_pend);
+	vtx->pend = mem_deref(vtx->pend);
+	mtx_unlock(vtx->lock_pend);
+}
+
+
 /**
  * Read frames from video source
  *
+ * The frame is copied and handed over to the encode thread, a pending
+ * frame that was not encoded yet is replaced.
+ *
  * @param frame      Video frame
  * @param timestamp  Frame timestamp in VIDEO_TIMEBASE units
  * @param arg        Handler argument
@@ -473,27 +956,56 @@ static void vidsrc_frame_handler(struct vidframe *frame, uint64_t timestamp,
 				 void *arg)
 {
 	struct vtx *vtx = arg;
+	struct vidframe *qframe = NULL, *old;
 
 	MAGIC_CHECK(vtx->video);
 
-	mtx_lock(vtx->lock_enc);
+	if (vidpool_get(vtx->pool, &qframe, frame->fmt, &frame->size))
+		return;
+
+	vidframe_copy(qframe, frame);
+
+	mtx_lock(vtx->lock_pend);
 	++vtx->frames;
 	++vtx->stats.src_frames;
-	mtx_unlock(vtx->lock_enc);
 
-	/* Encode and send */
-	encode_rtp_send(vtx, frame, NULL, timestamp);
+	old = vtx->pend;
+	if (old)
+		++vtx->stats.skip_busy;
+
+	vtx->pend     = qframe;
+	vtx->pend_ts  = timestamp;
+	vtx->pend_jfs = tmr_jiffies_usec();
+	cnd_signal(&vtx->enc_wait);
+	mtx_unlock(vtx->lock_pend);
+
+	mem_deref(old);
 }
 
 
 static void vidsrc_packet_handler(struct vidpacket *packet, void *arg)
 {
 	struct vtx *vtx = arg;
+	int err;
 
 	MAGIC_CHECK(vtx->video);
 
-	/* Encode and send */
-	encode_rtp_send(vtx, NULL, packet, packet->timestamp);
+	if (!vtx->enc)
+		return;
+
+	mtx_lock(vtx->lock_enc);
+
+	if (vtx->vc && vtx->vc->packetizeh) {
+		err = vtx->vc->packetizeh(vtx->enc, packet);
+		if (!err)
+			vtx->picup = false;
+	}
+	else {
+		warning("video: Skipping Packet as"
+			" Packetize Handler not initialized ..\n");
+	}
+
+	mtx_unlock(vtx->lock_enc);
 }
 
 
@@ -509,28 +1021,93 @@ static void vidsrc_error_handler(int err, void *arg)
 }
 
 
+/**
+ * Protect a sent packet, and send the repair packet of a complete group
+ *
+ * @param vtx  Video transmit object
+ * @param qent Sent packet, with the sequence number of the stream
+ *
+ * @return Number of bytes sent
+ */
+static size_t fec_send(struct vtx *vtx, const struct vidqent *qent)
+{
+	struct stream *strm = vtx->video->strm;
+	struct rtp_header hdr;
+	struct mbuf *mb = NULL;
+	size_t len;
+	int pt;
+	int err;
+
+	mtx_lock(vtx->lock_tx);
+	pt = vtx->fec_pt;
+	mtx_unlock(vtx->lock_tx);
+
+	if (pt < 0 || !qent->mb)
+		return 0;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.ver = RTP_VERSION;
+	hdr.ext = qent->ext;
+	hdr.m   = qent->marker;
+	hdr.pt  = qent->pt;
+	hdr.seq = qent->seq;
+	hdr.ts  = qent->ts;
+
+	err = fec_enc_packet(vtx->fec, &mb, &hdr, mbuf_buf(qent->mb),
+			     mbuf_get_left(qent->mb));
+	if (err || !mb)
+		return 0;
+
+	/* the protected SSRC is the only CSRC */
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.ver     = RTP_VERSION;
+	hdr.cc      = 1;
+	hdr.pt      = pt;
+	hdr.seq     = vtx->fec_seq++;
+	hdr.ts      = qent->ts;
+	hdr.ssrc    = vtx->fec_ssrc;
+	hdr.csrc[0] = rtp_sess_ssrc(stream_rtp_sock(strm));
+
+	len = mbuf_get_left(mb);
+
+	(void)stream_send_hdr(strm, &hdr, mb);
+	mem_deref(mb);
+
+	return len;
+}
+
+
 static int vtx_thread(void *arg)
 {
 	struct vtx *vtx = arg;
 	uint64_t jfs;
 	uint64_t start_jfs  = tmr_jiffies_usec();
 	uint64_t target_jfs = tmr_jiffies_usec();
-	uint32_t bitrate;
-
-	if (vtx->video->cfg.send_bitrate)
-		bitrate = vtx->video->cfg.send_bitrate;
-	else
-		bitrate = vtx->video->cfg.bitrate;
-
-	const uint64_t max_delay = PKT_SIZE * 8 * 1000000LL / bitrate + 1;
-	const uint64_t max_burst =
-		vtx->video->cfg.burst_bits * 1000000LL / bitrate;
+	uint64_t max_delay = 0, max_burst = 0;
+	uint32_t bitrate = 0;
 
 	struct vidqent *qent = NULL;
 	struct mbuf *mbd;
 	size_t sent = 0;
 
+	media_thread_place(MEDIA_THREAD_VIDEO);
+
 	while (re_atomic_rlx(&vtx->run)) {
+
+		uint32_t rate = vtx_bitrate(vtx);
+
+		/* the congestion controller can change the rate */
+		if (rate != bitrate) {
+			bitrate   = rate;
+			max_delay = PKT_SIZE * 8 * 1000000LL / bitrate + 1;
+			max_burst = vtx->video->cfg.burst_bits * 1000000LL /
+				bitrate;
+
+			/* continue the schedule with the new rate */
+			start_jfs = target_jfs;
+			sent	  = 0;
+		}
+
 		mtx_lock(vtx->lock_tx);
 		if (!vtx->sendq.head) {
 			cnd_wait(&vtx->wait, vtx->lock_tx);
@@ -562,6 +1139,24 @@ static int vtx_thread(void *arg)
 		sent += mbuf_get_left(qent->mb) * 8;
 		target_jfs = start_jfs + sent * 1000000 / bitrate;
 
+		if (qent->twcc) {
+			vidcc_sent(vtx->cc, qent->twseq,
+				   mbuf_get_left(qent->mb),
+				   tmr_jiffies_usec());
+		}
+
+		/* simulcast layers are not kept for NACK */
+		if (qent->ssrc) {
+			stream_send_ssrc(vtx->video->strm, qent->ssrc,
+					 qent->seq, qent->ext, qent->marker,
+					 qent->pt, qent->ts, qent->mb);
+
+			mtx_lock(vtx->lock_tx);
+			mem_deref(qent);
+			mtx_unlock(vtx->lock_tx);
+			continue;
+		}
+
 		mbd = mbuf_dup(qent->mb);
 
 		stream_send(vtx->video->strm, qent->ext, qent->marker,
@@ -573,6 +1168,11 @@ static int vtx_thread(void *arg)
 		qent->seq = rtp_sess_seq(stream_rtp_sock(vtx->video->strm));
 		qent->mb  = mbd;
 
+		if (vtx->fec) {
+			sent += fec_send(vtx, qent) * 8;
+			target_jfs = start_jfs + sent * 1000000 / bitrate;
+		}
+
 		mtx_lock(vtx->lock_tx);
 		list_move(&qent->le, &vtx->sendqnb);
 
@@ -607,7 +1207,17 @@ static int vtx_alloc(struct vtx *vtx, struct video *video)
 	if (err)
 		return err;
 
+	err = mutex_alloc(&vtx->lock_pend);
+	if (err)
+		return err;
+
+	/* pending, encoding and the frame being copied */
+	err = vidpool_alloc(&vtx->pool, 3);
+	if (err)
+		return err;
+
 	err |= cnd_init(&vtx->wait) != thrd_success;
+	err |= cnd_init(&vtx->enc_wait) != thrd_success;
 	if (err)
 		return ENOMEM;
 
@@ -616,6 +1226,8 @@ static int vtx_alloc(struct vtx *vtx, struct video *video)
 	/* The initial value of the timestamp SHOULD be random */
 	vtx->ts_offset = rand_u16();
 
+	vtx->fec_pt = -1;
+
 	str_ncpy(vtx->device, video->cfg.src_dev, sizeof(vtx->device));
 
 	vtx->fmt = (enum vidfmt)-1;
@@ -632,6 +1244,10 @@ static int vrx_alloc(struct vrx *vrx, struct video *video)
 	if (err)
 		return ENOMEM;
 
+	err = vidpool_alloc(&vrx->pool, 2);
+	if (err)
+		return err;
+
 	vrx->video  = video;
 	vrx->pt_rx  = -1;
 	vrx->orient = VIDORIENT_PORTRAIT;
@@ -809,24 +1425,34 @@ static int video_stream_decode(struct vrx *vrx, const struct rtp_header *hdr,
 	vrx->size = frame->size;
 	vrx->fmt  = frame->fmt;
 
-	if (!list_isempty(&vrx->filtl)) {
+	/*
+	 * Process video frame through all Video Filters. The decoded frame
+	 * belongs to the decoder, it is copied to a pooled frame before the
+	 * first filter that modifies it (copy-on-write).
+	 */
+	for (le = vrx->filtl.head; le; le = le->next) {
 
-		err = vidframe_alloc(&frame_filt, frame->fmt, &frame->size);
-		if (err)
-			goto out;
+		struct vidfilt_dec_st *st = le->data;
 
-		vidframe_copy(frame_filt, frame);
+		if (!st->vf || !st->vf->dech)
+			continue;
 
-		frame = frame_filt;
-	}
+		if (!frame_filt && !(st->vf->flags & VIDFILT_RDONLY)) {
 
-	/* Process video frame through all Video Filters */
-	for (le = vrx->filtl.head; le; le = le->next) {
+			int lerr = vidpool_get(vrx->pool, &frame_filt,
+					       frame->fmt, &frame->size);
+			if (lerr) {
+				err = lerr;
+				goto out;
+			}
 
-		struct vidfilt_dec_st *st = le->data;
+			vidframe_copy(frame_filt, frame);
+			++vrx->stats.filt_copies;
 
-		if (st->vf && st->vf->dech)
-			err |= st->vf->dech(st, frame, &pkt.timestamp);
+			frame = frame_filt;
+		}
+
+		err |= st->vf->dech(st, frame, &pkt.timestamp);
 	}
 
 	++vrx->stats.disp_frames;
@@ -952,6 +1578,62 @@ static void rtcp_nack_handler(struct vtx *vtx, struct rtcp_msg *msg)
 }
 
 
+/* The FEC overhead follows the loss since the last receiver report */
+static void fec_adapt(struct vtx *vtx, const struct rtcp_stats *stats)
+{
+	uint32_t sent;
+	int32_t lost;
+	unsigned k;
+
+	if (!fec_enc_group(vtx->fec) || !stats)
+		return;
+
+	sent = stats->tx.sent - vtx->fec_sent;
+	lost = stats->tx.lost - vtx->fec_lost;
+
+	vtx->fec_sent = stats->tx.sent;
+	vtx->fec_lost = stats->tx.lost;
+
+	if (!sent)
+		return;
+
+	k = fec_group_size(lost > 0 ? (double)lost / sent : 0.0);
+	if (k == fec_enc_group(vtx->fec))
+		return;
+
+	debug("video: fec: group size %u (lost %d of %u)\n", k, lost, sent);
+
+	fec_enc_set_group(vtx->fec, k);
+}
+
+
+/* Receiver reports of the sent stream drive the loss-based control */
+static void rtcp_rr_handler(struct video *v, const struct rtcp_rr *rrv,
+			    size_t rrc)
+{
+	uint32_t ssrc = rtp_sess_ssrc(stream_rtp_sock(v->strm));
+	const struct rtcp_stats *stats = stream_rtcp_stats(v->strm);
+
+	if (!rrv)
+		return;
+
+	for (size_t i = 0; i < rrc; i++) {
+
+		if (rrv[i].ssrc != ssrc)
+			continue;
+
+		if (re_atomic_rlx(&v->vtx.cc_on)) {
+			vidcc_loss(v->vtx.cc, rrv[i].fraction,
+				   stats ? stats->rtt : 0,
+				   tmr_jiffies_usec());
+		}
+
+		fec_adapt(&v->vtx, stats);
+		break;
+	}
+}
+
+
 static void rtcp_handler(struct stream *strm, struct rtcp_msg *msg, void *arg)
 {
 	struct video *v = arg;
@@ -978,66 +1660,203 @@ static void rtcp_handler(struct stream *strm, struct rtcp_msg *msg, void *arg)
 		break;
 
 	case RTCP_RTPFB:
+		if (msg->hdr.count == RTCP_RTPFB_TWCC) {
+			if (re_atomic_rlx(&vtx->cc_on)) {
+				(void)vidcc_twcc(vtx->cc, msg->r.fb.fci.twccv,
+						 tmr_jiffies_usec());
+			}
+			break;
+		}
+
 		rtcp_nack_handler(vtx, msg);
 		break;
 
+	case RTCP_SR:
+		rtcp_rr_handler(v, msg->r.sr.rrv, msg->hdr.count);
+		break;
+
+	case RTCP_RR:
+		rtcp_rr_handler(v, msg->r.rr.rrv, msg->hdr.count);
+		break;
+
 	default:
 		break;
 	}
 }
 
 
-static int vtx_print_pipeline(struct re_printf *pf, const struct vtx *vtx)
-{
-	struct le *le;
-	struct vidsrc *vs;
-	int err;
+static int vtx_print_pipeline(struct re_printf *pf, const struct vtx *vtx)
+{
+	struct le *le;
+	struct vidsrc *vs;
+	int err;
+
+	if (!vtx)
+		return 0;
+
+	vs = vtx->vs;
+
+	err = re_hprintf(pf, "video tx pipeline: %10s",
+			 vs ? vs->name : "(src)");
+
+	for (le = list_head(&vtx->filtl); le; le = le->next) {
+		struct vidfilt_enc_st *st = le->data;
+
+		if (st->vf->ench)
+			err |= re_hprintf(pf, " ---> %s", st->vf->name);
+	}
+
+	err |= re_hprintf(pf, " ---> %s\n",
+			  vtx->vc ? vtx->vc->name : "(encoder)");
+
+	return err;
+}
+
+
+static int vrx_print_pipeline(struct re_printf *pf, const struct vrx *vrx)
+{
+	struct le *le;
+	struct vidisp *vd;
+	int err;
+
+	if (!vrx)
+		return 0;
+
+	vd = vrx->vd;
+
+	err = re_hprintf(pf, "video rx pipeline: %10s",
+			 vd ? vd->name : "(disp)");
+
+	for (le = list_head(&vrx->filtl); le; le = le->next) {
+		struct vidfilt_dec_st *st = le->data;
+
+		if (st->vf->dech)
+			err |= re_hprintf(pf, " <--- %s", st->vf->name);
+	}
+
+	err |= re_hprintf(pf, " <--- %s\n",
+			  vrx->vc ? vrx->vc->name : "(decoder)");
+
+	return err;
+}
+
+
+static int rid_list_print(struct re_printf *pf, const struct vtx *vtx)
+{
+	int err = 0;
+
+	for (unsigned i = 0; i < vtx->layerc; i++) {
+		err |= re_hprintf(pf, "%s%s", i ? ";" : "",
+				  vtx->layerv[i].rid);
+	}
+
+	return err;
+}
+
+
+static int ssrc_group_print(struct re_printf *pf, const struct video *v)
+{
+	int err;
+
+	err = re_hprintf(pf, "SIM %u",
+			 rtp_sess_ssrc(stream_rtp_sock(v->strm)));
+
+	for (unsigned i = 1; i < v->vtx.layerc; i++)
+		err |= re_hprintf(pf, " %u", v->vtx.layerv[i].ssrc);
+
+	return err;
+}
+
+
+/**
+ * Offer to send simulcast layers, with half the resolution and a quarter
+ * of the bitrate for every layer
+ *
+ * @param v Video object
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+static int simulcast_offer(struct video *v)
+{
+	struct sdp_media *m = stream_sdpmedia(v->strm);
+	struct vtx *vtx = &v->vtx;
+	int err = 0;
+
+	vtx->extmap_rid = stream_generate_extmap_id(v->strm);
+	if (!vtx->extmap_rid)
+		return ERANGE;
+
+	vtx->layerc = min(v->cfg.simulcast, (uint32_t)SIMULCAST_MAX);
 
-	if (!vtx)
-		return 0;
+	for (unsigned i = 0; i < vtx->layerc; i++) {
+		struct vlayer *layer = &vtx->layerv[i];
 
-	vs = vtx->vs;
+		layer->rid     = layer_ridv[i];
+		layer->bitrate = v->cfg.bitrate >> (2 * i);
+		layer->active  = i == 0;
 
-	err = re_hprintf(pf, "video tx pipeline: %10s",
-			 vs ? vs->name : "(src)");
+		if (i) {
+			layer->ssrc = rand_u32();
+			layer->seq  = rand_u16();
 
-	for (le = list_head(&vtx->filtl); le; le = le->next) {
-		struct vidfilt_enc_st *st = le->data;
+			err |= sdp_media_set_lattr(m, false, "ssrc",
+						   "%u cname:%s", layer->ssrc,
+						   stream_cname(v->strm));
+		}
 
-		if (st->vf->ench)
-			err |= re_hprintf(pf, " ---> %s", st->vf->name);
+		err |= sdp_media_set_lattr(m, false, "rid",
+					   "%s send"
+					   " max-width=%u;max-height=%u",
+					   layer->rid, v->cfg.width >> i,
+					   v->cfg.height >> i);
 	}
 
-	err |= re_hprintf(pf, " ---> %s\n",
-			  vtx->vc ? vtx->vc->name : "(encoder)");
+	err |= sdp_media_set_lattr(m, false, "extmap", "%u %s",
+				   vtx->extmap_rid, uri_rid);
+	err |= sdp_media_set_lattr(m, true, "ssrc-group", "%H",
+				   ssrc_group_print, v);
+	err |= sdp_media_set_lattr(m, true, "simulcast", "send %H",
+				   rid_list_print, vtx);
 
 	return err;
 }
 
 
-static int vrx_print_pipeline(struct re_printf *pf, const struct vrx *vrx)
+static int fec_group_print(struct re_printf *pf, const struct video *v)
 {
-	struct le *le;
-	struct vidisp *vd;
-	int err;
-
-	if (!vrx)
-		return 0;
+	return re_hprintf(pf, "FEC-FR %u %u",
+			  rtp_sess_ssrc(stream_rtp_sock(v->strm)),
+			  v->vtx.fec_ssrc);
+}
 
-	vd = vrx->vd;
 
-	err = re_hprintf(pf, "video rx pipeline: %10s",
-			 vd ? vd->name : "(disp)");
+/**
+ * Offer to send and receive FEC repair packets with a separate SSRC
+ *
+ * @param v Video object
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+static int fec_offer(struct video *v)
+{
+	struct sdp_media *m = stream_sdpmedia(v->strm);
+	struct vtx *vtx = &v->vtx;
+	int err;
 
-	for (le = list_head(&vrx->filtl); le; le = le->next) {
-		struct vidfilt_dec_st *st = le->data;
+	err = fec_enc_alloc(&vtx->fec);
+	if (err)
+		return err;
 
-		if (st->vf->dech)
-			err |= re_hprintf(pf, " <--- %s", st->vf->name);
-	}
+	vtx->fec_ssrc = rand_u32();
+	vtx->fec_seq  = rand_u16();
 
-	err |= re_hprintf(pf, " <--- %s\n",
-			  vrx->vc ? vrx->vc->name : "(decoder)");
+	err  = sdp_format_add(NULL, m, false, NULL, fec_name, VIDEO_SRATE, 1,
+			      NULL, NULL, NULL, false,
+			      "repair-window=%u", FEC_WINDOW);
+	err |= sdp_media_set_lattr(m, false, "ssrc", "%u cname:%s",
+				   vtx->fec_ssrc, stream_cname(v->strm));
+	err |= sdp_media_set_lattr(m, false, "ssrc-group", "%H",
+				   fec_group_print, v);
 
 	return err;
 }
@@ -1129,12 +1948,30 @@ int video_alloc(struct video **vp, struct list *streaml,
 	err |= sdp_media_set_lattr(stream_sdpmedia(v->strm), false,
 				   "rtcp-fb", "* nack pli");
 
+	/* only the sending side of transport-cc is implemented, i.e. the
+	   sequence numbers are offered and the feedback of the peer is used */
+	if (v->cfg.cc)
+		err |= vidcc_alloc(&v->vtx.cc, v->cfg.bitrate);
+
+	if (v->vtx.cc && offerer)
+		v->vtx.twcc_offer = stream_generate_extmap_id(v->strm);
+
+	if (v->vtx.twcc_offer) {
+		err |= sdp_media_set_lattr(stream_sdpmedia(v->strm), false,
+					   "extmap", "%u %s",
+					   v->vtx.twcc_offer, uri_twcc);
+	}
+
 	/* RFC 4796 */
 	if (content) {
 		err |= sdp_media_set_lattr(stream_sdpmedia(v->strm), true,
 					   "content", "%s", content);
 	}
 
+	/* RFC 8853 */
+	if (offerer && v->cfg.simulcast > 1)
+		err |= simulcast_offer(v);
+
 	if (err)
 		goto out;
 
@@ -1150,6 +1987,10 @@ int video_alloc(struct video **vp, struct list *streaml,
 				      "%s", vc->fmtp);
 	}
 
+	/* RFC 8627, after the codecs */
+	if (v->cfg.fec)
+		err |= fec_offer(v);
+
 	/* Video filters */
 	for (le = list_head(vidfiltl); le; le = le->next) {
 		struct vidfilt *vf = le->data;
@@ -1233,7 +2074,7 @@ static void tmr_handler(void *arg)
 	tmr_start(&v->tmr, TMR_INTERVAL * 1000, tmr_handler, v);
 
 	/* protect vtx.frames */
-	mtx_lock(v->vtx.lock_enc);
+	mtx_lock(v->vtx.lock_pend);
 
 	/* Estimate framerates */
 	v->vtx.efps = (double)v->vtx.frames / (double)TMR_INTERVAL;
@@ -1242,7 +2083,7 @@ static void tmr_handler(void *arg)
 	v->vtx.frames = 0;
 	v->vrx.frames = 0;
 
-	mtx_unlock(v->vtx.lock_enc);
+	mtx_unlock(v->vtx.lock_pend);
 }
 
 
@@ -1384,6 +2225,10 @@ int video_start_source(struct video *v)
 		warning("video_start_source: Video TX already started\n");
 	}
 
+	err = venc_start(vtx);
+	if (err)
+		return err;
+
 	tmr_start(&v->tmr, TMR_INTERVAL * 1000, tmr_handler, v);
 
 	return 0;
@@ -1450,6 +2295,8 @@ static void video_stop_source(struct video *v)
 
 	v->vtx.vsrc = mem_deref(v->vtx.vsrc);
 
+	venc_stop(&v->vtx);
+
 	if (re_atomic_rlx(&v->vtx.run)) {
 		re_atomic_rlx_set(&v->vtx.run, false);
 		cnd_signal(&v->vtx.wait);
@@ -1533,6 +2380,45 @@ static void vidsrc_update(struct vtx *vtx, const char *dev)
 }
 
 
+/* Allocate the encoders of the accepted simulcast layers */
+static int layers_update(struct video *v, const struct vidcodec *vc,
+			 const char *params)
+{
+	struct vtx *vtx = &v->vtx;
+	int err;
+
+	for (unsigned i = 1; i < vtx->layerc; i++) {
+
+		struct vlayer *layer = &vtx->layerv[i];
+		struct videnc_param prm;
+
+		if (!layer->active) {
+			layer->enc   = mem_deref(layer->enc);
+			layer->frame = mem_deref(layer->frame);
+			continue;
+		}
+
+		if (layer->enc)
+			continue;
+
+		prm.bitrate = layer->bitrate;
+		prm.pktsize = PKT_SIZE;
+		prm.fps     = get_fps(v);
+		prm.max_fs  = -1;
+
+		info("video: simulcast layer '%s' (%u bit/s)\n",
+		     layer->rid, prm.bitrate);
+
+		err = vc->encupdh(&layer->enc, vc, &prm, params,
+				  layer_pkthv[i], v);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+
 /**
  * Set the video encoder used
  *
@@ -1581,7 +2467,33 @@ int video_encoder_set(struct video *v, struct vidcodec *vc,
 			goto out;
 		}
 
+		for (unsigned i = 1; i < vtx->layerc; i++)
+			vtx->layerv[i].enc = mem_deref(vtx->layerv[i].enc);
+
 		vtx->vc = vc;
+		vtx->enc_rate     = vtx_enc_bitrate(vtx);
+		re_atomic_rlx_set(&vtx->enc_bitrate, vtx->enc_rate);
+		vtx->enc_rate_jfs = tmr_jiffies_usec();
+	}
+
+	/* kept for bitrate updates by the congestion controller */
+	if (params != vtx->enc_params) {
+		char *p = NULL;
+
+		if (params) {
+			err = str_dup(&p, params);
+			if (err)
+				goto out;
+		}
+
+		mem_deref(vtx->enc_params);
+		vtx->enc_params = p;
+	}
+
+	err = layers_update(v, vc, params);
+	if (err) {
+		warning("video: simulcast encoder alloc: %m\n", err);
+		goto out;
 	}
 
 	stream_update_encoder(v->strm, pt_tx);
@@ -1680,6 +2592,246 @@ static bool nack_handler(const char *name, const char *value, void *arg)
 }
 
 
+static bool twcc_fb_handler(const char *name, const char *value,
+			    void *arg)
+{
+	struct pl type;
+	(void)name;
+	(void)arg;
+
+	if (re_regex(value, str_len(value), "[^ ]+ [^ ]+", NULL, &type))
+		return false;
+
+	return 0 == pl_strcasecmp(&type, "transport-cc");
+}
+
+
+struct extmap_find {
+	const char *uri;
+	uint8_t id;
+};
+
+
+static bool extmap_find_handler(const char *name, const char *value,
+				void *arg)
+{
+	struct extmap_find *ef = arg;
+	struct sdp_extmap extmap;
+	(void)name;
+
+	if (sdp_extmap_decode(&extmap, value))
+		return false;
+
+	if (pl_strcasecmp(&extmap.name, ef->uri))
+		return false;
+
+	if (extmap.id < RTPEXT_ID_MIN || extmap.id > RTPEXT_ID_MAX)
+		return false;
+
+	ef->id = extmap.id;
+
+	return true;
+}
+
+
+/* Get the remote id of a header extension, 0 if not supported */
+static uint8_t extmap_remote_id(const struct sdp_media *m, const char *uri)
+{
+	struct extmap_find ef = {uri, 0};
+
+	(void)sdp_media_rattr_apply(m, "extmap", extmap_find_handler, &ef);
+
+	return ef.id;
+}
+
+
+static bool rid_recv_handler(const char *name, const char *value, void *arg)
+{
+	struct sdp_media *m = arg;
+	struct pl rid;
+	(void)name;
+
+	if (re_regex(value, str_len(value), "[^ ]+ send", &rid))
+		return false;
+
+	(void)sdp_media_set_lattr(m, false, "rid", "%r recv", &rid);
+
+	return false;
+}
+
+
+/* Check if a RID is in a simulcast stream list, paused streams (~) are not */
+static bool rid_accepted(const struct pl *list, const char *rid)
+{
+	const char *p = list->p, *end = list->p + list->l;
+
+	while (p < end) {
+		struct pl id;
+
+		id.p = p;
+		while (p < end && *p != ';' && *p != ',')
+			++p;
+		id.l = p - id.p;
+
+		if (0 == pl_strcmp(&id, rid))
+			return true;
+
+		++p;
+	}
+
+	return false;
+}
+
+
+/**
+ * Negotiate simulcast (RFC 8853)
+ *
+ * If the peer receives our layers, the accepted layers are enabled. If the
+ * peer sends layers, only the primary layer is received and decoded.
+ *
+ * @param v Video object
+ */
+static void simulcast_decode(struct video *v)
+{
+	struct sdp_media *m = stream_sdpmedia(v->strm);
+	struct vtx *vtx = &v->vtx;
+	const char *attr;
+	struct pl list;
+	uint8_t id;
+	unsigned activec = 0;
+
+	if (v->cfg.simulcast < 2)
+		return;
+
+	attr = sdp_media_rattr(m, "simulcast");
+	id   = extmap_remote_id(m, uri_rid);
+
+	mtx_lock(vtx->lock_enc);
+	for (unsigned i = 0; i < vtx->layerc; i++) {
+		struct vlayer *layer = &vtx->layerv[i];
+
+		if (i == 0)
+			layer->active = true;
+		else
+			layer->active = attr && id &&
+				0 == re_regex(attr, str_len(attr),
+					      "recv [^ ]+", &list) &&
+				rid_accepted(&list, layer->rid);
+
+		activec += layer->active;
+	}
+
+	if (id && vtx->layerc)
+		vtx->extmap_rid = id;
+
+	vtx->simulcast = activec > 1;
+	re_atomic_rlx_set(&vtx->enc_bitrate, vtx_enc_bitrate(vtx));
+	vidcc_set_max(vtx->cc, vtx_enc_bitrate(vtx));
+	mtx_unlock(vtx->lock_enc);
+
+	if (vtx->layerc) {
+		info("video: simulcast: sending %u of %u layers\n",
+		     activec, vtx->layerc);
+		return;
+	}
+
+	if (v->vrx.simulcast || !attr ||
+	    re_regex(attr, str_len(attr), "send [^ ]+", &list))
+		return;
+
+	/* Answer as receiver, only the primary SSRC is decoded */
+	(void)sdp_media_rattr_apply(m, "rid", rid_recv_handler, m);
+	(void)sdp_media_set_lattr(m, true, "simulcast", "recv %r", &list);
+
+	if (id) {
+		(void)sdp_media_set_lattr(m, false, "extmap", "%u %s",
+					  id, uri_rid);
+	}
+
+	stream_set_ssrc_lock(v->strm, true);
+	v->vrx.simulcast = true;
+
+	info("video: simulcast: receiving primary layer of '%r'\n", &list);
+}
+
+
+/**
+ * Negotiate the transport-wide sequence number for congestion control
+ *
+ * @param v Video object
+ */
+static void twcc_decode(struct video *v)
+{
+	struct sdp_media *m = stream_sdpmedia(v->strm);
+	struct vtx *vtx = &v->vtx;
+	uint8_t id;
+
+	if (!vtx->cc)
+		return;
+
+	/* No transport-cc feedback is sent, so an offer of the peer is not
+	   answered. The controller is only used when the peer accepted the
+	   offered sequence numbers and sends feedback for them. */
+	id = extmap_remote_id(m, uri_twcc);
+	if (!vtx->twcc_offer ||
+	    !sdp_media_rattr_apply(m, "rtcp-fb", twcc_fb_handler, NULL))
+		id = 0;
+
+	mtx_lock(vtx->lock_tx);
+	vtx->extmap_twcc = id;
+	mtx_unlock(vtx->lock_tx);
+
+	re_atomic_rlx_set(&vtx->cc_on, id != 0);
+
+	if (id)
+		info("video: transport-wide congestion control (id=%u)\n", id);
+}
+
+
+/**
+ * Negotiate forward error correction (RFC 8627)
+ *
+ * Repair packets are sent with the payload type of the peer, and received
+ * with the local payload type.
+ *
+ * @param v Video object
+ */
+static void fec_decode(struct video *v)
+{
+	struct sdp_media *m = stream_sdpmedia(v->strm);
+	const struct sdp_format *lf, *rf;
+	struct vtx *vtx = &v->vtx;
+	int pt_tx = -1, pt_rx = -1;
+	int err;
+
+	if (!vtx->fec)
+		return;
+
+	rf = sdp_media_rformat(m, fec_name);
+	lf = sdp_media_format(m, true, NULL, -1, fec_name, -1, -1);
+	if (rf && lf) {
+		pt_tx = rf->pt;
+		pt_rx = lf->pt;
+	}
+
+	mtx_lock(vtx->lock_tx);
+	vtx->fec_pt = pt_tx;
+	mtx_unlock(vtx->lock_tx);
+
+	if (pt_tx < 0)
+		fec_enc_set_group(vtx->fec, 0);
+	else if (!fec_enc_group(vtx->fec))
+		fec_enc_set_group(vtx->fec, FEC_GROUP);
+
+	err = stream_set_fec(v->strm, pt_rx);
+	if (err)
+		warning("video: fec: receiver (%m)\n", err);
+
+	if (pt_tx >= 0)
+		info("video: forward error correction (pt=%d)\n", pt_tx);
+}
+
+
 void video_sdp_attr_decode(struct video *v)
 {
 	if (!v)
@@ -1689,6 +2841,10 @@ void video_sdp_attr_decode(struct video *v)
 	if (sdp_media_rattr_apply(stream_sdpmedia(v->strm), "rtcp-fb",
 				  nack_handler, 0))
 		v->nack_pli = true;
+
+	simulcast_decode(v);
+	twcc_decode(v);
+	fec_decode(v);
 }
 
 
@@ -1700,18 +2856,53 @@ static int vtx_debug(struct re_printf *pf, const struct vtx *vtx)
 			  vtx->vc ? vtx->vc->name : "none",
 			  vidfmt_name(vtx->fmt));
 
-	mtx_lock(vtx->lock_enc);
+	mtx_lock(vtx->lock_pend);
 	err |= re_hprintf(pf, "     source: %s %u x %u, fps=%.2f"
 			  " frames=%llu\n",
 			  vtx->vs ? vtx->vs->name : "none",
 			  vtx->vsrc_size.w,
 			  vtx->vsrc_size.h, vtx->vsrc_prm.fps,
 			  vtx->stats.src_frames);
+	err |= re_hprintf(pf, "     skipped: encoder busy=%llu",
+			  vtx->stats.skip_busy);
+	mtx_unlock(vtx->lock_pend);
+
+	mtx_lock(vtx->lock_enc);
+	err |= re_hprintf(pf, " pacer backlog=%llu\n",
+			  vtx->stats.skip_pacer);
+	err |= re_hprintf(pf, "     encoded=%llu latency: last=%llu"
+			  " avg=%llu max=%llu us\n",
+			  vtx->stats.enc_frames, vtx->stats.enc_lat,
+			  vtx->stats.enc_lat_avg, vtx->stats.enc_lat_max);
+
+	for (unsigned i = 0; i < vtx->layerc; i++) {
+		const struct vlayer *layer = &vtx->layerv[i];
+
+		err |= re_hprintf(pf, "     simulcast '%s': %s"
+				  " %u bit/s ssrc=0x%08x frames=%llu\n",
+				  layer->rid,
+				  layer->active ? "active" : "inactive",
+				  layer->bitrate, layer->ssrc, layer->frames);
+	}
+
+	if (re_atomic_rlx(&vtx->cc_on)) {
+		err |= re_hprintf(pf, "     congestion control: encoder=%u"
+				  " bit/s pacer=%u bit/s\n     %H",
+				  vtx->enc_rate, vtx_bitrate(vtx),
+				  vidcc_debug, vtx->cc);
+	}
 	mtx_unlock(vtx->lock_enc);
 
 	mtx_lock(vtx->lock_tx);
-	err |= re_hprintf(pf, "     skipc=%u sendq=%u\n",
-			  vtx->skipc, list_count(&vtx->sendq));
+	err |= re_hprintf(pf, "     sendq=%u twcc=%s\n",
+			  list_count(&vtx->sendq),
+			  vtx->extmap_twcc ? "yes" : "no");
+
+	if (vtx->fec_pt >= 0) {
+		err |= re_hprintf(pf, "     fec: pt=%d ssrc=0x%08x %H\n",
+				  vtx->fec_pt, vtx->fec_ssrc,
+				  fec_enc_debug, vtx->fec);
+	}
 
 	if (vtx->ts_base) {
 		err |= re_hprintf(pf, "     time = %.3f sec\n",
@@ -1737,6 +2928,9 @@ static int vrx_debug(struct re_printf *pf, const struct vrx *vrx)
 			  vrx->vd ? vrx->vd->name : "none",
 			  vrx->size.w, vrx->size.h,
 			  vrx->stats.disp_frames);
+	err |= re_hprintf(pf, "     filter copies=%llu, pool: %H\n",
+			  vrx->stats.filt_copies,
+			  vidpool_debug, vrx->pool);
 	err |= re_hprintf(pf, "     n_keyframes=%u, n_picup=%u\n",
 			  vrx->n_intra, vrx->n_picup);
 
@@ -1922,3 +3116,56 @@ void video_req_keyframe(struct video *vid)
 	vid->vtx.picup = true;
 	mtx_unlock(vid->vtx.lock_enc);
 }
+
+
+/**
+ * Get the number of simulcast layers that are sent
+ *
+ * @param v Video object
+ *
+ * @return Number of layers, 1 if simulcast is not used
+ */
+unsigned video_simulcast_layers(const struct video *v)
+{
+	unsigned n = 1;
+
+	if (!v)
+		return 0;
+
+	mtx_lock(v->vtx.lock_enc);
+	for (unsigned i = 1; i < v->vtx.layerc; i++) {
+
+		if (v->vtx.layerv[i].active)
+			++n;
+	}
+	mtx_unlock(v->vtx.lock_enc);
+
+	return n;
+}
+
+
+/**
+ * Check if the congestion control estimate or state changed
+ *
+ * @param v Video object
+ *
+ * @return True once after a significant change
+ */
+bool video_cc_changed(struct video *v)
+{
+	return v ? vidcc_changed(v->vtx.cc) : false;
+}
+
+
+/**
+ * Print the congestion control estimate and state, "bitrate,state"
+ *
+ * @param pf Print function
+ * @param v  Video object
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int video_cc_print(struct re_printf *pf, const struct video *v)
+{
+	return v ? vidcc_print(pf, v->vtx.cc) : 0;
+}
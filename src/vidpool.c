@@ -0,0 +1,198 @@
+/**
+ * @file vidpool.c  Pool of reference-counted video frames
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+
+#include <string.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/*
+ * The frames are normal memory objects and can be shared with mem_ref().
+ * When the last reference is dropped, the pixel buffer is returned to the
+ * pool and reused for the next frame of the same or smaller size.
+ */
+
+
+struct vidpool {
+	mtx_t *mtx;            /**< Protects the free list              */
+	struct list freel;     /**< Free pixel buffers                  */
+	unsigned maxc;         /**< Max number of free buffers kept     */
+	uint64_t n_alloc;      /**< Pixel buffers allocated             */
+	uint64_t n_reuse;      /**< Pixel buffers reused                */
+};
+
+struct poolbuf {
+	struct le le;
+	size_t sz;
+	uint8_t data[];
+};
+
+struct poolframe {
+	struct vidframe frame; /**< Must be first                       */
+	struct vidpool *pool;
+	struct poolbuf *pb;
+};
+
+
+static void pool_destructor(void *arg)
+{
+	struct vidpool *pool = arg;
+
+	list_flush(&pool->freel);
+	mem_deref(pool->mtx);
+}
+
+
+static void frame_destructor(void *arg)
+{
+	struct poolframe *pf = arg;
+	struct vidpool *pool = pf->pool;
+
+	mtx_lock(pool->mtx);
+	if (list_count(&pool->freel) < pool->maxc) {
+		list_append(&pool->freel, &pf->pb->le, pf->pb);
+		pf->pb = NULL;
+	}
+	mtx_unlock(pool->mtx);
+
+	mem_deref(pf->pb);
+	mem_deref(pool);
+}
+
+
+/**
+ * Allocate a video frame pool
+ *
+ * @param poolp Pointer to allocated frame pool
+ * @param maxc  Maximum number of free frame buffers kept
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int vidpool_alloc(struct vidpool **poolp, unsigned maxc)
+{
+	struct vidpool *pool;
+	int err;
+
+	if (!poolp || !maxc)
+		return EINVAL;
+
+	pool = mem_zalloc(sizeof(*pool), pool_destructor);
+	if (!pool)
+		return ENOMEM;
+
+	pool->maxc = maxc;
+
+	err = mutex_alloc(&pool->mtx);
+	if (err) {
+		mem_deref(pool);
+		return err;
+	}
+
+	*poolp = pool;
+
+	return 0;
+}
+
+
+/**
+ * Get a video frame from the pool
+ *
+ * The frame is reference-counted, the pixel buffer is returned to the
+ * pool when the frame is dereferenced. The pixel data is not initialized.
+ *
+ * @param pool   Video frame pool
+ * @param framep Pointer to allocated video frame
+ * @param fmt    Pixel format
+ * @param sz     Size of the video frame
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int vidpool_get(struct vidpool *pool, struct vidframe **framep,
+		enum vidfmt fmt, const struct vidsz *sz)
+{
+	struct poolframe *pf;
+	struct poolbuf *pb = NULL;
+	struct le *le;
+	size_t need;
+
+	if (!pool || !framep || !sz)
+		return EINVAL;
+
+	need = vidframe_size(fmt, sz);
+	if (!need)
+		return EINVAL;
+
+	pf = mem_zalloc(sizeof(*pf), frame_destructor);
+	if (!pf)
+		return ENOMEM;
+
+	pf->pool = mem_ref(pool);
+
+	mtx_lock(pool->mtx);
+	for (le = pool->freel.head; le; le = le->next) {
+
+		if (((struct poolbuf *)le->data)->sz >= need) {
+			pb = le->data;
+			break;
+		}
+	}
+
+	if (pb) {
+		list_unlink(&pb->le);
+		++pool->n_reuse;
+	}
+	else {
+		++pool->n_alloc;
+	}
+	mtx_unlock(pool->mtx);
+
+	if (!pb) {
+		pb = mem_alloc(sizeof(*pb) + need, NULL);
+		if (!pb) {
+			mem_deref(pf);
+			return ENOMEM;
+		}
+
+		memset(&pb->le, 0, sizeof(pb->le));
+		pb->sz = need;
+	}
+
+	pf->pb = pb;
+	vidframe_init_buf(&pf->frame, fmt, sz, pb->data);
+
+	*framep = &pf->frame;
+
+	return 0;
+}
+
+
+/**
+ * Print the frame pool statistics
+ *
+ * @param pf   Print function
+ * @param pool Video frame pool
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int vidpool_debug(struct re_printf *pf, const struct vidpool *pool)
+{
+	uint64_t n_alloc, n_reuse;
+	uint32_t freec;
+
+	if (!pool)
+		return 0;
+
+	mtx_lock(pool->mtx);
+	n_alloc = pool->n_alloc;
+	n_reuse = pool->n_reuse;
+	freec   = list_count(&pool->freel);
+	mtx_unlock(pool->mtx);
+
+	return re_hprintf(pf, "allocated=%llu reused=%llu free=%u",
+			  n_alloc, n_reuse, freec);
+}
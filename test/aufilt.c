@@ -0,0 +1,329 @@
+/**
+ * @file test/aufilt.c  Audio filter chain Testcode
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "test.h"
+
+
+enum {
+	SRATE  = 48000,
+	SAMPC  = 960,
+	FRAMES = 500,
+};
+
+
+struct chain {
+	struct list encl;
+	struct list decl;
+	struct aufilt_enc_st encv[4];
+	struct aufilt_dec_st decv[4];
+	struct aufilt_arena *arena;
+};
+
+
+static unsigned n_badfmt;   /* frames seen in an undeclared format */
+
+
+/* Check the frame against the filter capabilities and apply some gain */
+static int filt_process(const struct aufilt *flt, struct auframe *af)
+{
+	if (af->fmt == AUFMT_S16LE) {
+		int16_t *v = af->sampv;
+
+		if (!(flt->flags & (AUFILT_S16 | AUFILT_INPLACE)))
+			++n_badfmt;
+
+		for (size_t i = 0; i < af->sampc; i++)
+			v[i] = (int16_t)(v[i] * 3 / 4);
+	}
+	else if (af->fmt == AUFMT_FLOAT) {
+		float *v = af->sampv;
+
+		if (!(flt->flags & (AUFILT_FLOAT | AUFILT_INPLACE)))
+			++n_badfmt;
+
+		for (size_t i = 0; i < af->sampc; i++)
+			v[i] = v[i] * 0.75f;
+	}
+	else {
+		++n_badfmt;
+	}
+
+	return 0;
+}
+
+
+static int filt_encode(struct aufilt_enc_st *st, struct auframe *af)
+{
+	return filt_process(st->af, af);
+}
+
+
+static int filt_decode(struct aufilt_dec_st *st, struct auframe *af)
+{
+	return filt_process(st->af, af);
+}
+
+
+static struct aufilt filt_both = {
+	.name = "both", .ench = filt_encode, .dech = filt_decode,
+	.flags = AUFILT_S16 | AUFILT_FLOAT,
+};
+
+static struct aufilt filt_any = {
+	.name = "any", .ench = filt_encode, .dech = filt_decode,
+	.flags = AUFILT_INPLACE,
+};
+
+static struct aufilt filt_s16 = {
+	.name = "s16", .ench = filt_encode, .dech = filt_decode,
+	.flags = AUFILT_S16,
+};
+
+
+static int chain_init(struct chain *c, struct aufilt * const fltv[],
+		      size_t fltc, enum aufmt fmt)
+{
+	memset(c, 0, sizeof(*c));
+	n_badfmt = 0;
+
+	for (size_t i = 0; i < fltc && i < RE_ARRAY_SIZE(c->encv); i++) {
+		struct aufilt_prm prm = {SRATE, 1, fmt};
+
+		c->encv[i].af   = fltv[i];
+		c->encv[i].ifmt = aufilt_negotiate(fltv[i], &prm);
+		list_append(&c->encl, &c->encv[i].le, &c->encv[i]);
+
+		prm.fmt = fmt;
+		c->decv[i].af   = fltv[i];
+		c->decv[i].ifmt = aufilt_negotiate(fltv[i], &prm);
+		list_append(&c->decl, &c->decv[i].le, &c->decv[i]);
+	}
+
+	return aufilt_arena_alloc(&c->arena, SAMPC * sizeof(float));
+}
+
+
+static void chain_close(struct chain *c)
+{
+	list_clear(&c->encl);
+	list_clear(&c->decl);
+	c->arena = mem_deref(c->arena);
+}
+
+
+/* Run frames through both directions, return conversions per frame */
+static int chain_run(struct chain *c, enum aufmt fmt, void *sampv,
+		     unsigned frames, double *convp, uint64_t *usecp)
+{
+	uint64_t t0 = tmr_jiffies_usec();
+	uint64_t convc;
+	int err = 0;
+
+	for (unsigned i = 0; i < frames; i++) {
+		struct auframe af;
+
+		auframe_init(&af, fmt, sampv, SAMPC, SRATE, 1);
+		err |= aufilt_chain_encode(&c->encl, c->arena, &af, fmt);
+		ASSERT_EQ(fmt, af.fmt);
+
+		auframe_init(&af, fmt, sampv, SAMPC, SRATE, 1);
+		err |= aufilt_chain_decode(&c->decl, c->arena, &af, fmt);
+		ASSERT_EQ(fmt, af.fmt);
+	}
+
+	if (usecp)
+		*usecp = tmr_jiffies_usec() - t0;
+
+	convc  = aufilt_arena_convc(c->arena);
+	*convp = convc / (2.0 * frames);
+
+ out:
+	return err;
+}
+
+
+int test_aufilt_arena(void)
+{
+	struct aufilt_arena *arena = NULL;
+	struct aufilt flt = {0};
+	struct aufilt_prm prm = {8000, 1, AUFMT_FLOAT};
+	struct auframe af;
+	int16_t sampv[160], *big = NULL;
+	const void *prev;
+	int err;
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(sampv); i++)
+		sampv[i] = (int16_t)(i * 64 - 4096);
+
+	/* sized for 80 float samples, must grow on demand */
+	err = aufilt_arena_alloc(&arena, 80 * sizeof(float));
+	TEST_ERR(err);
+
+	auframe_init(&af, AUFMT_S16LE, sampv, RE_ARRAY_SIZE(sampv), 8000, 1);
+
+	/* same format is a no-op */
+	err = aufilt_arena_conv(arena, &af, AUFMT_S16LE);
+	TEST_ERR(err);
+	ASSERT_TRUE(af.sampv == sampv);
+	ASSERT_EQ(0, aufilt_arena_convc(arena));
+
+	err = aufilt_arena_conv(arena, &af, AUFMT_FLOAT);
+	TEST_ERR(err);
+	ASSERT_EQ(AUFMT_FLOAT, af.fmt);
+	ASSERT_TRUE(af.sampv != sampv);
+	ASSERT_EQ(RE_ARRAY_SIZE(sampv), af.sampc);
+
+	prev = af.sampv;
+
+	/* back to S16LE into the other buffer, lossless round-trip */
+	err = aufilt_arena_conv(arena, &af, AUFMT_S16LE);
+	TEST_ERR(err);
+	ASSERT_EQ(AUFMT_S16LE, af.fmt);
+	ASSERT_TRUE(af.sampv != prev && af.sampv != sampv);
+	TEST_MEMCMP(sampv, sizeof(sampv), af.sampv, af.sampc * 2);
+
+	ASSERT_EQ(2, aufilt_arena_convc(arena));
+
+	/* converting from the arena must not move the source buffer */
+	big = mem_zalloc(960 * sizeof(int16_t), NULL);
+	if (!big) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	auframe_init(&af, AUFMT_S16LE, big, 960, 48000, 1);
+	err  = aufilt_arena_conv(arena, &af, AUFMT_FLOAT);
+	err |= aufilt_arena_conv(arena, &af, AUFMT_S16LE);
+	err |= aufilt_arena_conv(arena, &af, AUFMT_FLOAT);
+	TEST_ERR(err);
+	ASSERT_EQ(960, af.sampc);
+
+	/* only S16LE can be converted to other formats */
+	ASSERT_EQ(ENOTSUP, aufilt_arena_conv(arena, &af, AUFMT_S24_3LE));
+
+	/* negotiation */
+	ASSERT_EQ(-1, aufilt_negotiate(&flt, &prm));
+	ASSERT_EQ(AUFMT_FLOAT, prm.fmt);
+
+	flt.flags = AUFILT_INPLACE;
+	ASSERT_EQ(-1, aufilt_negotiate(&flt, &prm));
+	ASSERT_EQ(AUFMT_FLOAT, prm.fmt);
+
+	flt.flags = AUFILT_S16;
+	ASSERT_EQ(AUFMT_S16LE, aufilt_negotiate(&flt, &prm));
+	ASSERT_EQ(AUFMT_S16LE, prm.fmt);
+
+ out:
+	mem_deref(big);
+	mem_deref(arena);
+
+	return err;
+}
+
+
+/*
+ * Float32 pipeline conformance: a chain of float capable filters must not
+ * convert, every filter must only see formats it declared.
+ */
+int test_aufilt_chain(void)
+{
+	struct aufilt * const floatv[] = {&filt_both, &filt_any, &filt_both};
+	struct aufilt * const mixedv[] = {&filt_both, &filt_s16, &filt_any};
+	struct chain c;
+	float *sampv = NULL;
+	double conv;
+	int err;
+
+	sampv = mem_zalloc(SAMPC * sizeof(float), NULL);
+	if (!sampv)
+		return ENOMEM;
+
+	/* float end-to-end */
+	err = chain_init(&c, floatv, RE_ARRAY_SIZE(floatv), AUFMT_FLOAT);
+	TEST_ERR(err);
+	ASSERT_EQ(AUFMT_FLOAT, c.encv[0].ifmt);
+	ASSERT_EQ(-1, c.encv[1].ifmt);
+
+	err = chain_run(&c, AUFMT_FLOAT, sampv, 10, &conv, NULL);
+	TEST_ERR(err);
+	ASSERT_EQ(0, aufilt_arena_convc(c.arena));
+	ASSERT_EQ(0, n_badfmt);
+	chain_close(&c);
+
+	/* S16LE end-to-end */
+	err = chain_init(&c, floatv, RE_ARRAY_SIZE(floatv), AUFMT_S16LE);
+	TEST_ERR(err);
+	err = chain_run(&c, AUFMT_S16LE, sampv, 10, &conv, NULL);
+	TEST_ERR(err);
+	ASSERT_EQ(0, aufilt_arena_convc(c.arena));
+	ASSERT_EQ(0, n_badfmt);
+	chain_close(&c);
+
+	/* one S16LE-only filter costs one conversion in and one out */
+	err = chain_init(&c, mixedv, RE_ARRAY_SIZE(mixedv), AUFMT_FLOAT);
+	TEST_ERR(err);
+	ASSERT_EQ(AUFMT_S16LE, c.encv[1].ifmt);
+	err = chain_run(&c, AUFMT_FLOAT, sampv, 10, &conv, NULL);
+	TEST_ERR(err);
+	ASSERT_EQ(0, n_badfmt);
+	ASSERT_TRUE(conv == 2.0);
+
+ out:
+	chain_close(&c);
+	mem_deref(sampv);
+
+	return err;
+}
+
+
+/* Benchmark float capable filters against S16LE-only filters */
+int test_aufilt_perf(void)
+{
+	struct aufilt * const floatv[] = {
+		&filt_both, &filt_both, &filt_any, &filt_both
+	};
+	struct aufilt * const s16v[] = {
+		&filt_s16, &filt_any, &filt_s16, &filt_s16
+	};
+	struct chain c;
+	float *sampv = NULL;
+	double conv_float, conv_s16;
+	uint64_t usec_float, usec_s16;
+	int err;
+
+	sampv = mem_zalloc(SAMPC * sizeof(float), NULL);
+	if (!sampv)
+		return ENOMEM;
+
+	err = chain_init(&c, floatv, RE_ARRAY_SIZE(floatv), AUFMT_FLOAT);
+	TEST_ERR(err);
+	err = chain_run(&c, AUFMT_FLOAT, sampv, FRAMES, &conv_float,
+			&usec_float);
+	TEST_ERR(err);
+	chain_close(&c);
+
+	err = chain_init(&c, s16v, RE_ARRAY_SIZE(s16v), AUFMT_FLOAT);
+	TEST_ERR(err);
+	err = chain_run(&c, AUFMT_FLOAT, sampv, FRAMES, &conv_s16,
+			&usec_s16);
+	TEST_ERR(err);
+
+	info("aufilt: float pipeline: %.1f conversions/frame, %llu us"
+	     "  (S16LE filters: %.1f conversions/frame, %llu us)\n",
+	     conv_float, (unsigned long long)usec_float,
+	     conv_s16, (unsigned long long)usec_s16);
+
+	ASSERT_TRUE(conv_float < conv_s16);
+
+ out:
+	chain_close(&c);
+	mem_deref(sampv);
+
+	return err;
+}
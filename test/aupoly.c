@@ -0,0 +1,247 @@
+/**
+ * @file test/aupoly.c  Polyphase resampler Testcode
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <math.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "test.h"
+
+
+enum {
+	PTIME = 20,
+	FREQ  = 1000,
+};
+
+static const double PI = 3.14159265358979323846264338328;
+
+
+struct resamp_bench {
+	uint32_t irate;
+	uint32_t orate;
+	double snr;
+	uint64_t usec;
+};
+
+
+static void sine_fill(int16_t *sampv, size_t sampc, uint8_t ch,
+		      uint32_t srate, size_t *pos)
+{
+	for (size_t i = 0; i < sampc / ch; i++) {
+		const double t = (double)(*pos)++ / srate;
+		const int16_t v = (int16_t)(16384 * sin(2 * PI * FREQ * t));
+
+		for (uint8_t c = 0; c < ch; c++)
+			sampv[i * ch + c] = v;
+	}
+}
+
+
+/* Fit a sine of known frequency and return signal to residual in [dB] */
+static double sine_snr(const int16_t *sampv, size_t n, uint32_t srate)
+{
+	double a = 0, b = 0, sig = 0, noise = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		const double w = 2 * PI * FREQ * i / srate;
+
+		a += sampv[i] * sin(w);
+		b += sampv[i] * cos(w);
+	}
+
+	a = 2 * a / n;
+	b = 2 * b / n;
+
+	for (size_t i = 0; i < n; i++) {
+		const double w = 2 * PI * FREQ * i / srate;
+		const double fit = a * sin(w) + b * cos(w);
+
+		sig   += fit * fit;
+		noise += (sampv[i] - fit) * (sampv[i] - fit);
+	}
+
+	if (noise < 1e-9)
+		return 200.0;
+
+	return 10 * log10(sig / noise);
+}
+
+
+/* Resample one second of a mono sine, return SNR and CPU time */
+static int run_resamp(struct resamp_bench *b, bool legacy)
+{
+	const size_t inc  = b->irate * PTIME / 1000;
+	const size_t outn = b->orate;
+	struct auresamp rs;
+	struct aupoly *poly = NULL;
+	int16_t *inv = NULL, *outv = NULL;
+	size_t pos = 0, outpos = 0;
+	uint64_t t0;
+	int err = 0;
+
+	inv  = mem_zalloc(inc * sizeof(int16_t), NULL);
+	outv = mem_zalloc((outn + b->orate / 10) * sizeof(int16_t), NULL);
+	if (!inv || !outv) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	if (legacy) {
+		auresamp_init(&rs);
+		err = auresamp_setup(&rs, b->irate, 1, b->orate, 1);
+	}
+	else {
+		err = aupoly_alloc(&poly, b->irate, 1, b->orate, 1);
+	}
+	if (err)
+		goto out;
+
+	b->usec = 0;
+
+	while (outpos < outn) {
+		size_t outc = outn + b->orate / 10 - outpos;
+
+		sine_fill(inv, inc, 1, b->irate, &pos);
+
+		t0 = tmr_jiffies_usec();
+
+		if (legacy)
+			err = auresamp(&rs, &outv[outpos], &outc, inv, inc);
+		else
+			err = aupoly_process(poly, &outv[outpos], &outc,
+					     inv, inc);
+
+		b->usec += tmr_jiffies_usec() - t0;
+
+		TEST_ERR(err);
+
+		outpos += outc;
+	}
+
+	/* skip the first 100ms (filter delay) */
+	b->snr = sine_snr(&outv[b->orate / 10], outn - b->orate / 5,
+			  b->orate);
+
+ out:
+	mem_deref(poly);
+	mem_deref(outv);
+	mem_deref(inv);
+
+	return err;
+}
+
+
+int test_aupoly(void)
+{
+	static const uint32_t ratev[][2] = {
+		{44100, 48000}, {48000, 44100}, { 8000, 48000},
+		{48000,  8000}, {16000, 44100}, {32000, 16000},
+	};
+	struct aupoly *rs = NULL;
+	int16_t inv[2 * 441], outv[2 * 481];
+	size_t pos = 0, outc;
+	int err = 0;
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(ratev); i++) {
+		struct resamp_bench b = {ratev[i][0], ratev[i][1], 0, 0};
+
+		err = run_resamp(&b, false);
+		TEST_ERR(err);
+
+		if (b.snr < 60.0) {
+			warning("aupoly: %u -> %u: SNR %.1f dB too low\n",
+				b.irate, b.orate, b.snr);
+			err = EINVAL;
+			goto out;
+		}
+	}
+
+	/* 10ms stereo 44.1 kHz to mono 48 kHz, exact frame sizes */
+	err = aupoly_alloc(&rs, 44100, 2, 48000, 1);
+	TEST_ERR(err);
+
+	ASSERT_TRUE(aupoly_match(rs, 44100, 2, 48000, 1));
+	ASSERT_TRUE(!aupoly_match(rs, 44100, 1, 48000, 1));
+
+	for (int i = 0; i < 10; i++) {
+		sine_fill(inv, RE_ARRAY_SIZE(inv), 2, 44100, &pos);
+
+		outc = RE_ARRAY_SIZE(outv);
+		err = aupoly_process(rs, outv, &outc,
+				     inv, RE_ARRAY_SIZE(inv));
+		TEST_ERR(err);
+		ASSERT_EQ(480, outc);
+	}
+
+	/* output buffer too small */
+	outc = 100;
+	err = aupoly_process(rs, outv, &outc, inv, RE_ARRAY_SIZE(inv));
+	ASSERT_EQ(ENOMEM, err);
+	err = 0;
+
+	rs = mem_deref(rs);
+
+	/* mono 8 kHz to stereo 16 kHz */
+	err = aupoly_alloc(&rs, 8000, 1, 16000, 2);
+	TEST_ERR(err);
+
+	pos  = 0;
+	sine_fill(inv, 160, 1, 8000, &pos);
+	outc = RE_ARRAY_SIZE(outv);
+	err  = aupoly_process(rs, outv, &outc, inv, 160);
+	TEST_ERR(err);
+	ASSERT_EQ(640, outc);
+
+	for (size_t i = 0; i < outc; i += 2)
+		ASSERT_EQ(outv[i], outv[i + 1]);
+
+	ASSERT_EQ(EINVAL, aupoly_alloc(&rs, 0, 1, 16000, 1));
+
+ out:
+	mem_deref(rs);
+
+	return err;
+}
+
+
+/* Compare quality and CPU with the librem resampler */
+int test_aupoly_perf(void)
+{
+	static const uint32_t ratev[][2] = {
+		{ 8000, 16000}, {16000,  8000}, {16000, 48000},
+		{48000, 16000}, {44100, 48000},
+	};
+	int err = 0;
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(ratev); i++) {
+		struct resamp_bench poly = {ratev[i][0], ratev[i][1], 0, 0};
+		struct resamp_bench rem  = {ratev[i][0], ratev[i][1], 0, 0};
+		int lerr;
+
+		err = run_resamp(&poly, false);
+		TEST_ERR(err);
+
+		lerr = run_resamp(&rem, true);
+		if (lerr) {
+			info("aupoly: %5u -> %5u: SNR %5.1f dB, %6llu us/s"
+			     "  (auresamp: %m)\n",
+			     poly.irate, poly.orate, poly.snr,
+			     (unsigned long long)poly.usec, lerr);
+			continue;
+		}
+
+		info("aupoly: %5u -> %5u: SNR %5.1f dB, %6llu us/s"
+		     "  (auresamp: SNR %5.1f dB, %6llu us/s)\n",
+		     poly.irate, poly.orate, poly.snr,
+		     (unsigned long long)poly.usec,
+		     rem.snr, (unsigned long long)rem.usec);
+
+		ASSERT_TRUE(poly.snr >= rem.snr);
+	}
+
+ out:
+	return err;
+}
@@ -0,0 +1,175 @@
+/**
+ * @file test/austretch.c  Audio time-stretching Testcode
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <math.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "test.h"
+
+
+enum {
+	SRATE  = 48000,
+	PTIME  = 20,
+	FREQ   = 200,
+	PERIOD = SRATE / FREQ,
+	NSAMP  = SRATE * PTIME / 1000,
+};
+
+static const double PI = 3.14159265358979323846264338328;
+
+
+static double sine(size_t i, uint32_t srate)
+{
+	return 0.5 * sin(2 * PI * FREQ * (double)i / srate);
+}
+
+
+/* The stretched frame must continue the sine without a phase jump */
+static double sine_maxerr(const struct auframe *af)
+{
+	double maxerr = 0;
+
+	for (size_t i = 0; i < af->sampc; i++) {
+		double v;
+
+		if (af->fmt == AUFMT_S16LE)
+			v = ((int16_t *)af->sampv)[i] / 32768.0;
+		else
+			v = ((float *)af->sampv)[i];
+
+		maxerr = max(maxerr, fabs(v - sine(i, af->srate)));
+	}
+
+	return maxerr;
+}
+
+
+int test_austretch(void)
+{
+	struct austretch *st = NULL;
+	int16_t sampv[NSAMP];
+	float floatv[NSAMP];
+	struct auframe af;
+	int err;
+
+	err = austretch_alloc(&st);
+	TEST_ERR(err);
+
+	for (size_t i = 0; i < NSAMP; i++) {
+		sampv[i]  = (int16_t)lrint(32768 * sine(i, SRATE));
+		floatv[i] = (float)sine(i, SRATE);
+	}
+
+	/* compress by whole pitch periods */
+	auframe_init(&af, AUFMT_S16LE, sampv, NSAMP, SRATE, 1);
+	err = austretch_process(st, &af, true);
+	TEST_ERR(err);
+	ASSERT_TRUE(af.sampc < NSAMP);
+	ASSERT_EQ(0, (NSAMP - af.sampc) % PERIOD);
+	ASSERT_TRUE(sine_maxerr(&af) < 0.001);
+
+	/* expand */
+	auframe_init(&af, AUFMT_FLOAT, floatv, NSAMP, SRATE, 1);
+	err = austretch_process(st, &af, false);
+	TEST_ERR(err);
+	ASSERT_TRUE(af.sampc > NSAMP);
+	ASSERT_EQ(0, (af.sampc - NSAMP) % PERIOD);
+	ASSERT_TRUE(sine_maxerr(&af) < 0.001);
+
+	/* noise is not periodic */
+	for (size_t i = 0; i < NSAMP; i++)
+		sampv[i] = (int16_t)rand_u16();
+
+	auframe_init(&af, AUFMT_S16LE, sampv, NSAMP, SRATE, 1);
+	ASSERT_EQ(ENOENT, austretch_process(st, &af, true));
+	ASSERT_EQ(NSAMP, af.sampc);
+
+	/* silence can always be stretched */
+	memset(sampv, 0, sizeof(sampv));
+	err = austretch_process(st, &af, false);
+	TEST_ERR(err);
+	ASSERT_TRUE(af.sampc > NSAMP);
+
+	auframe_init(&af, AUFMT_S24_3LE, sampv, NSAMP, SRATE, 1);
+	ASSERT_EQ(ENOTSUP, austretch_process(st, &af, true));
+
+ out:
+	mem_deref(st);
+
+	return err;
+}
+
+
+/* CPU time per second of audio for one stream, stretching every frame */
+static int run_stretch(uint32_t srate, uint8_t ch, uint64_t *usec)
+{
+	struct austretch *st = NULL;
+	const size_t n = srate * PTIME / 1000;
+	const unsigned frames = 500;
+	int16_t *sampv;
+	uint64_t t0;
+	int err;
+
+	sampv = mem_alloc(n * ch * sizeof(int16_t), NULL);
+	if (!sampv)
+		return ENOMEM;
+
+	for (size_t i = 0; i < n; i++) {
+		for (uint8_t c = 0; c < ch; c++)
+			sampv[i * ch + c] = (int16_t)lrint(32768 *
+							   sine(i, srate));
+	}
+
+	err = austretch_alloc(&st);
+	if (err)
+		goto out;
+
+	t0 = tmr_jiffies_usec();
+
+	for (unsigned i = 0; i < frames; i++) {
+		struct auframe af;
+
+		auframe_init(&af, AUFMT_S16LE, sampv, n * ch, srate, ch);
+
+		err = austretch_process(st, &af, i & 1);
+		if (err)
+			goto out;
+	}
+
+	*usec = (tmr_jiffies_usec() - t0) * 1000 / (frames * PTIME);
+
+ out:
+	mem_deref(st);
+	mem_deref(sampv);
+
+	return err;
+}
+
+
+int test_austretch_perf(void)
+{
+	static const struct {
+		uint32_t srate;
+		uint8_t ch;
+	} fmtv[] = {
+		{8000, 1}, {16000, 1}, {48000, 1}, {48000, 2},
+	};
+	int err = 0;
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(fmtv); i++) {
+		uint64_t usec = 0;
+
+		err = run_stretch(fmtv[i].srate, fmtv[i].ch, &usec);
+		TEST_ERR(err);
+
+		info("austretch: %5u Hz, %u ch: %6llu us/s\n",
+		     fmtv[i].srate, fmtv[i].ch, (unsigned long long)usec);
+	}
+
+ out:
+	return err;
+}
@@ -1205,6 +1205,126 @@ int test_call_max(void)
 }
 
 
+struct setup_reuse {
+	uint64_t n_worker;        /* Media workers reused  */
+	uint64_t n_chunk;         /* Arena chunks recycled */
+};
+
+
+static void setup_reuse_get(struct setup_reuse *r)
+{
+	media_worker_stats(NULL, &r->n_worker);
+	call_arena_stats(NULL, &r->n_chunk);
+}
+
+
+static int call_setup_run(unsigned calls, uint64_t *usecp)
+{
+	struct fixture fix, *f = &fix;
+	uint64_t t0;
+	int err = 0;
+
+	fixture_init(f);
+
+	f->behaviour = BEHAVIOUR_ANSWER;
+
+	t0 = tmr_jiffies_usec();
+
+	for (unsigned i = 0; i < calls; i++) {
+
+		f->exp_estab  = i + 1;
+		f->exp_closed = i + 1;
+
+		err = ua_connect(f->a.ua, 0, NULL, f->buri, VIDMODE_OFF);
+		TEST_ERR(err);
+
+		err = re_main_timeout(5000);
+		TEST_ERR(err);
+		TEST_ERR(fix.err);
+
+		ua_hangup(f->a.ua, NULL, 0, 0);
+
+		err = re_main_timeout(5000);
+		TEST_ERR(err);
+		TEST_ERR(fix.err);
+	}
+
+	*usecp = tmr_jiffies_usec() - t0;
+
+	ASSERT_EQ(calls, fix.a.n_established);
+	ASSERT_EQ(calls, fix.b.n_closed);
+
+ out:
+	fixture_close(f);
+
+	return err;
+}
+
+
+/* Benchmark the call setup rate with and without the media object pools */
+int test_call_setup_perf(void)
+{
+	struct config *cfg = conf_config();
+	const struct config_sched sched = cfg->sched;
+	const struct config_call call = cfg->call;
+	const enum audio_mode txmode = cfg->audio.txmode;
+	const enum rtp_receive_mode rxmode = cfg->avt.rxmode;
+	const unsigned calls = 20;
+	uint64_t usec_cold = 0, usec_warm = 0;
+	struct setup_reuse r0, r1, r2;
+	int err;
+
+	/* one audio TX and RX thread per stream */
+	cfg->audio.txmode = AUDIO_MODE_THREAD;
+	cfg->avt.rxmode   = RECEIVE_MODE_THREAD;
+	cfg->call.arena_size = 4096;
+
+	err = module_load(".", "ausine");
+	TEST_ERR(err);
+
+	cfg->sched.thread_pool = 0;
+	cfg->call.arena_pool   = 0;
+
+	setup_reuse_get(&r0);
+
+	err = call_setup_run(calls, &usec_cold);
+	TEST_ERR(err);
+
+	setup_reuse_get(&r1);
+
+	/* without pools nothing is reused */
+	ASSERT_EQ(r0.n_worker, r1.n_worker);
+	ASSERT_EQ(r0.n_chunk, r1.n_chunk);
+
+	cfg->sched.thread_pool = 4;
+	cfg->call.arena_pool   = 16;
+
+	err = call_setup_run(calls, &usec_warm);
+	TEST_ERR(err);
+
+	setup_reuse_get(&r2);
+
+	/* every call after the first runs on parked workers and chunks */
+	ASSERT_TRUE(r2.n_worker - r1.n_worker >= calls - 1);
+	ASSERT_TRUE(r2.n_chunk - r1.n_chunk >= calls - 1);
+
+	info("call: setup of %u calls: %.0f calls/s with pooling"
+	     "  (without: %.0f calls/s)\n", calls,
+	     usec_warm ? 1e6 * calls / usec_warm : 0.0,
+	     usec_cold ? 1e6 * calls / usec_cold : 0.0);
+
+ out:
+	module_unload("ausine");
+
+	cfg->sched        = sched;
+	cfg->call         = call;
+	cfg->audio.txmode = txmode;
+	cfg->avt.rxmode   = rxmode;
+
+	return err;
+}
+
+
 int test_call_dtmf(void)
 {
 	struct fixture fix, *f = &fix;
@@ -1340,6 +1460,79 @@ int test_call_video(void)
 }
 
 
+static void simulcast_vidisp_handler(const struct vidframe *frame,
+				     uint64_t timestamp, const char *title,
+				     void *arg)
+{
+	struct fixture *fix = arg;
+	int err = 0;
+
+	/* only the full resolution layer is decoded */
+	ASSERT_EQ(conf_config()->video.width,  frame->size.w);
+	ASSERT_EQ(conf_config()->video.height, frame->size.h);
+
+	mock_vidisp_handler(frame, timestamp, title, arg);
+
+ out:
+	if (err)
+		fixture_abort(fix, err);
+}
+
+
+int test_call_video_simulcast(void)
+{
+	struct fixture fix, *f = &fix;
+	struct vidisp *vidisp = NULL;
+	struct cancel_rule *cr;
+	int err = 0;
+
+	conf_config()->video.fps = 100;
+	conf_config()->video.enc_fmt = VID_FMT_YUV420P;
+	conf_config()->video.simulcast = 3;
+
+	fixture_init(f);
+	cancel_rule_new(UA_EVENT_CUSTOM, f->b.ua, 1, 0, 1);
+	cr->prm = "vidframe";
+	cr->n_vidframe = 3;
+
+	mock_vidcodec_register();
+
+	err = mock_vidisp_register(&vidisp, simulcast_vidisp_handler, f);
+	TEST_ERR(err);
+
+	err = module_load(".", "fakevideo");
+	TEST_ERR(err);
+
+	f->behaviour = BEHAVIOUR_ANSWER;
+	f->estab_action = ACTION_NOTHING;
+
+	/* Make a call from A to B */
+	err = ua_connect(f->a.ua, 0, NULL, f->buri, VIDMODE_ON);
+	TEST_ERR(err);
+
+	err = re_main_timeout(10000);
+	TEST_ERR(err);
+	TEST_ERR(fix.err);
+
+	ASSERT_EQ(1, fix.a.n_established);
+	ASSERT_EQ(1, fix.b.n_established);
+	ASSERT_TRUE(fix.b.n_vidframe >= 3);
+
+	/* A sends all layers, B answers as a simulcast receiver */
+	ASSERT_EQ(3, video_simulcast_layers(call_video(ua_call(f->a.ua))));
+	ASSERT_EQ(1, video_simulcast_layers(call_video(ua_call(f->b.ua))));
+
+ out:
+	conf_config()->video.simulcast = 1;
+	fixture_close(f);
+	mem_deref(vidisp);
+	module_unload("fakevideo");
+	mock_vidcodec_unregister();
+
+	return err;
+}
+
+
 int test_call_change_videodir(void)
 {
 	struct fixture fix, *f = &fix;
@@ -2443,6 +2636,8 @@ int test_call_aufilt(void)
 
 /*
  * Simulate a complete WebRTC testcase
+ *
+ * DTLS session resumption is enabled in the test configuration.
  */
 int test_call_webrtc(void)
 {
@@ -2707,119 +2902,360 @@ int test_call_bundle(void)
 }
 
 
-static bool find_ipv6ll(const char *ifname, const struct sa *sa, void *arg)
+struct demux_stats {
+	uint32_t n_learn;
+	uint32_t n_pend;
+	uint32_t n_drop;
+};
+
+
+/* The demux counters of the bundle base stream, from its debug output */
+static int demux_stats_get(struct demux_stats *ds, const struct stream *strm)
 {
-	struct sa *ipv6ll = arg;
-	(void) ifname;
+	struct pl learn, pend, drop;
+	struct mbuf *mb;
+	int err;
 
-	if (sa_af(sa) == AF_INET6 && sa_is_linklocal(sa)) {
-		sa_cpy(ipv6ll, sa);
-		return true;
-	}
+	mb = mbuf_alloc(1024);
+	if (!mb)
+		return ENOMEM;
 
-	return false;
+	err = mbuf_printf(mb, "%H", stream_debug, strm);
+	TEST_ERR(err);
+
+	err = re_regex((char *)mb->buf, mb->end,
+		       "demux:[ ]+[0-9]+ ssrcs learned, [0-9]+ buffered,"
+		       " [0-9]+ dropped", NULL, &learn, &pend, &drop);
+	TEST_ERR(err);
+
+	ds->n_learn = pl_u32(&learn);
+	ds->n_pend  = pl_u32(&pend);
+	ds->n_drop  = pl_u32(&drop);
+
+ out:
+	mem_deref(mb);
+
+	return err;
 }
 
 
-int test_call_ipv6ll(void)
+static bool extmap_mid_handler(const char *name, const char *value,
+			       void *arg)
 {
-	struct fixture fix = {0}, *f = &fix;
-	struct cancel_rule *cr;
-	struct network *net = baresip_network();
-	struct sa ipv6ll;
-	bool found;
-	struct sa dst;
-	char uri[50];
-	int err = 0;
+	uint8_t *idp = arg;
+	struct sdp_extmap extmap;
+	(void)name;
 
-	if (!net_laddr_af(net, AF_INET6)) {
-		info("no IPv6 address -- skipping test %s\n", __func__);
-		return 0;
+	if (sdp_extmap_decode(&extmap, value))
+		return false;
+
+	if (pl_strcasecmp(&extmap.name, "urn:ietf:params:rtp-hdrext:sdes:mid"))
+		return false;
+
+	*idp = (uint8_t)extmap.id;
+
+	return true;
+}
+
+
+/* RTP packet with an optional MID header extension (one-byte header) */
+static int demux_send_rtp(struct udp_sock *us, const struct sa *dst,
+			  uint32_t ssrc, uint8_t mid_id, char mid)
+{
+	struct mbuf *mb;
+	int err;
+
+	mb = mbuf_alloc(64);
+	if (!mb)
+		return ENOMEM;
+
+	err  = mbuf_write_u8(mb, mid_id ? 0x90 : 0x80);
+	err |= mbuf_write_u8(mb, 127);
+	err |= mbuf_write_u16(mb, htons(1));
+	err |= mbuf_write_u32(mb, 0);
+	err |= mbuf_write_u32(mb, htonl(ssrc));
+
+	if (mid_id) {
+		err |= mbuf_write_u16(mb, htons(RTPEXT_TYPE_MAGIC));
+		err |= mbuf_write_u16(mb, htons(1));
+		err |= mbuf_write_u8(mb, (uint8_t)(mid_id << 4));
+		err |= mbuf_write_u8(mb, (uint8_t)mid);
+		err |= mbuf_write_u16(mb, 0);
 	}
 
-	err = module_load(".", "ausine");
-	TEST_ERR(err);
+	err |= mbuf_write_u32(mb, 0);
+	if (err)
+		goto out;
 
-	fixture_init(f);
+	mb->pos = 0;
 
-	f->behaviour = BEHAVIOUR_ANSWER;
-	f->estab_action = ACTION_NOTHING;
-	found = net_laddr_apply(net, find_ipv6ll, &ipv6ll);
-	ASSERT_TRUE(found);
+	err = udp_send(us, dst, mb);
 
-	err = sip_transp_laddr(uag_sip(), &dst, SIP_TRANSP_UDP, &ipv6ll);
-	TEST_ERR(err);
+ out:
+	mem_deref(mb);
 
-	/* Make a call from A to B */
-	re_snprintf(uri, sizeof(uri), "sip:b@%J", &dst);
-	err  = ua_alloc(&f->a.ua, "A <sip:a@kitchen>;regint=0");
-	err |= ua_alloc(&f->b.ua, "B <sip:b@office>;regint=0");
+	return err;
+}
 
-	cancel_rule_new(UA_EVENT_CALL_RTPESTAB, f->b.ua, 1, 0, 1);
-	cancel_rule_and(UA_EVENT_CALL_RTPESTAB, f->a.ua, 0, 0, 1);
 
-	err |= ua_connect(f->a.ua, 0, NULL, uri, VIDMODE_OFF);
-	TEST_ERR(err);
+static void main_wait_handler(void *arg)
+{
+	(void)arg;
 
-	/* run main-loop with timeout, wait for events */
-	err = re_main_timeout(5000);
-	TEST_ERR(err);
-	TEST_ERR(fix.err);
+	re_cancel();
+}
 
-	ASSERT_EQ(0, fix.a.n_incoming);
-	ASSERT_EQ(1, fix.a.n_established);
-	ASSERT_EQ(0, fix.a.n_closed);
-	ASSERT_EQ(0, fix.a.close_scode);
 
-	ASSERT_EQ(1, fix.b.n_incoming);
-	ASSERT_EQ(1, fix.b.n_established);
-	ASSERT_EQ(0, fix.b.n_closed);
-	ASSERT_EQ(0, fix.b.close_scode);
+static int main_wait(uint32_t ms)
+{
+	struct tmr tmr;
+	int err;
 
-	ASSERT_TRUE(fix.a.n_rtpestab > 0);
-	ASSERT_TRUE(fix.b.n_rtpestab > 0);
-	sa_cpy(&ipv6ll,
-	       stream_raddr(audio_strm(call_audio(ua_call(fix.a.ua)))));
-	ASSERT_TRUE(sa_is_linklocal(&ipv6ll) && sa_af(&ipv6ll) == AF_INET6);
-	sa_cpy(&ipv6ll,
-	       stream_raddr(audio_strm(call_audio(ua_call(fix.b.ua)))));
-	ASSERT_TRUE(sa_is_linklocal(&ipv6ll) && sa_af(&ipv6ll) == AF_INET6);
+	tmr_init(&tmr);
+	tmr_start(&tmr, ms, main_wait_handler, NULL);
 
- out:
-	fixture_close(f);
-	module_unload("ausine");
+	err = re_main_timeout(ms + 5000);
+
+	tmr_cancel(&tmr);
 
 	return err;
 }
 
 
-static int test_call_hold_resume_base(bool tcp)
+/*
+ * SSRC demultiplexing on the bundle base stream: a packet with an unknown
+ * SSRC is buffered until the MID header extension resolves the SSRC, and
+ * a buffered packet is dropped when its SSRC stays unknown.
+ */
+int test_call_bundle_demux(void)
 {
-	struct fixture fix, *f = &fix;
+	struct fixture fix = {0}, *f = &fix;
 	struct cancel_rule *cr;
-	int err = 0;
+	struct udp_sock *us = NULL;
+	struct demux_stats ds0, ds;
+	const struct stream *base;
+	struct sa laddr, dst;
+	uint8_t mid_id = 0;
+	int err;
 
+	if (conf_config()->avt.rxmode == RECEIVE_MODE_THREAD)
+		return 0;
 
-	fixture_init(f);
-	cancel_rule_new(UA_EVENT_CALL_RTPESTAB, f->a.ua, 0, 0, 1);
-	cr->n_audio_estab = 1;
-	cancel_rule_and(UA_EVENT_CALL_RTPESTAB, f->b.ua, 1, 0, 1);
-	cr->n_audio_estab = 1;
+	conf_config()->avt.bundle = true;
+	conf_config()->avt.rtcp_mux = true;
+	conf_config()->video.fps = 100;
 
-	err = module_load(".", "ausine");
-	TEST_ERR(err);
-	err = module_load(".", "aufile");
+	mock_vidcodec_register();
+	err = module_load(".", "fakevideo");
 	TEST_ERR(err);
 
-	f->behaviour = BEHAVIOUR_ANSWER;
+	fixture_init_prm(f, "");
+
+	cancel_rule_new(UA_EVENT_CALL_RTPESTAB, f->b.ua, 1, 0, 1);
+	cancel_rule_and(UA_EVENT_CALL_RTPESTAB, f->a.ua, 0, 0, 1);
+
 	f->estab_action = ACTION_NOTHING;
+	f->behaviour = BEHAVIOUR_ANSWER;
 
-	/* Make a call from A to B */
-	err = ua_connect(f->a.ua, 0, NULL, tcp ? f->buri_tcp : f->buri,
-			 VIDMODE_ON);
+	err = ua_connect(f->a.ua, 0, NULL, f->buri, VIDMODE_ON);
 	TEST_ERR(err);
 
-	/* wait for RTP audio */
+	err = re_main_timeout(15000);
+	TEST_ERR(err);
+	TEST_ERR(fix.err);
+
+	cancel_rule_pop();
+
+	base = audio_strm(call_audio(ua_call(f->b.ua)));
+	dst  = *sdp_media_laddr(stream_sdpmedia(base));
+
+	(void)sdp_media_rattr_apply(stream_sdpmedia(base), "extmap",
+				    extmap_mid_handler, &mid_id);
+	ASSERT_TRUE(mid_id != 0);
+
+	err = sa_set_str(&laddr, "127.0.0.1", 0);
+	TEST_ERR(err);
+
+	err = udp_listen(&us, &laddr, NULL, NULL);
+	TEST_ERR(err);
+
+	err = demux_stats_get(&ds0, base);
+	TEST_ERR(err);
+
+	/* the SSRCs of the call are known */
+	ASSERT_TRUE(ds0.n_learn >= 2);
+
+	/* unknown SSRC without header extension: buffered */
+	err = demux_send_rtp(us, &dst, 0x5eed0001, 0, 0);
+	TEST_ERR(err);
+	err = main_wait(20);
+	TEST_ERR(err);
+
+	err = demux_stats_get(&ds, base);
+	TEST_ERR(err);
+	ASSERT_EQ(ds0.n_pend + 1, ds.n_pend);
+	ASSERT_EQ(ds0.n_learn, ds.n_learn);
+
+	/* the MID of the video stream resolves the SSRC */
+	err = demux_send_rtp(us, &dst, 0x5eed0001, mid_id, '1');
+	TEST_ERR(err);
+	err = main_wait(20);
+	TEST_ERR(err);
+
+	err = demux_stats_get(&ds, base);
+	TEST_ERR(err);
+	ASSERT_EQ(ds0.n_learn + 1, ds.n_learn);
+	ASSERT_EQ(ds0.n_pend + 1, ds.n_pend);
+	ASSERT_EQ(ds0.n_drop, ds.n_drop);
+
+	/* an SSRC that stays unknown is dropped after the timeout */
+	err = demux_send_rtp(us, &dst, 0x5eed0002, 0, 0);
+	TEST_ERR(err);
+	err = main_wait(600);
+	TEST_ERR(err);
+
+	err = demux_send_rtp(us, &dst, 0x5eed0003, 0, 0);
+	TEST_ERR(err);
+	err = main_wait(20);
+	TEST_ERR(err);
+
+	err = demux_stats_get(&ds, base);
+	TEST_ERR(err);
+	ASSERT_EQ(ds0.n_learn + 1, ds.n_learn);
+	ASSERT_EQ(ds0.n_pend + 3, ds.n_pend);
+	ASSERT_EQ(ds0.n_drop + 1, ds.n_drop);
+
+ out:
+	/* removes the SSRC entries of both streams */
+	fixture_close(f);
+
+	mem_deref(us);
+	module_unload("fakevideo");
+	mock_vidcodec_unregister();
+
+	conf_config()->avt.bundle = false;
+	conf_config()->avt.rtcp_mux = false;
+
+	if (fix.err)
+		return fix.err;
+
+	return err;
+}
+
+
+static bool find_ipv6ll(const char *ifname, const struct sa *sa, void *arg)
+{
+	struct sa *ipv6ll = arg;
+	(void) ifname;
+
+	if (sa_af(sa) == AF_INET6 && sa_is_linklocal(sa)) {
+		sa_cpy(ipv6ll, sa);
+		return true;
+	}
+
+	return false;
+}
+
+
+int test_call_ipv6ll(void)
+{
+	struct fixture fix = {0}, *f = &fix;
+	struct cancel_rule *cr;
+	struct network *net = baresip_network();
+	struct sa ipv6ll;
+	bool found;
+	struct sa dst;
+	char uri[50];
+	int err = 0;
+
+	if (!net_laddr_af(net, AF_INET6)) {
+		info("no IPv6 address -- skipping test %s\n", __func__);
+		return 0;
+	}
+
+	err = module_load(".", "ausine");
+	TEST_ERR(err);
+
+	fixture_init(f);
+
+	f->behaviour = BEHAVIOUR_ANSWER;
+	f->estab_action = ACTION_NOTHING;
+	found = net_laddr_apply(net, find_ipv6ll, &ipv6ll);
+	ASSERT_TRUE(found);
+
+	err = sip_transp_laddr(uag_sip(), &dst, SIP_TRANSP_UDP, &ipv6ll);
+	TEST_ERR(err);
+
+	/* Make a call from A to B */
+	re_snprintf(uri, sizeof(uri), "sip:b@%J", &dst);
+	err  = ua_alloc(&f->a.ua, "A <sip:a@kitchen>;regint=0");
+	err |= ua_alloc(&f->b.ua, "B <sip:b@office>;regint=0");
+
+	cancel_rule_new(UA_EVENT_CALL_RTPESTAB, f->b.ua, 1, 0, 1);
+	cancel_rule_and(UA_EVENT_CALL_RTPESTAB, f->a.ua, 0, 0, 1);
+
+	err |= ua_connect(f->a.ua, 0, NULL, uri, VIDMODE_OFF);
+	TEST_ERR(err);
+
+	/* run main-loop with timeout, wait for events */
+	err = re_main_timeout(5000);
+	TEST_ERR(err);
+	TEST_ERR(fix.err);
+
+	ASSERT_EQ(0, fix.a.n_incoming);
+	ASSERT_EQ(1, fix.a.n_established);
+	ASSERT_EQ(0, fix.a.n_closed);
+	ASSERT_EQ(0, fix.a.close_scode);
+
+	ASSERT_EQ(1, fix.b.n_incoming);
+	ASSERT_EQ(1, fix.b.n_established);
+	ASSERT_EQ(0, fix.b.n_closed);
+	ASSERT_EQ(0, fix.b.close_scode);
+
+	ASSERT_TRUE(fix.a.n_rtpestab > 0);
+	ASSERT_TRUE(fix.b.n_rtpestab > 0);
+	sa_cpy(&ipv6ll,
+	       stream_raddr(audio_strm(call_audio(ua_call(fix.a.ua)))));
+	ASSERT_TRUE(sa_is_linklocal(&ipv6ll) && sa_af(&ipv6ll) == AF_INET6);
+	sa_cpy(&ipv6ll,
+	       stream_raddr(audio_strm(call_audio(ua_call(fix.b.ua)))));
+	ASSERT_TRUE(sa_is_linklocal(&ipv6ll) && sa_af(&ipv6ll) == AF_INET6);
+
+ out:
+	fixture_close(f);
+	module_unload("ausine");
+
+	return err;
+}
+
+
+static int test_call_hold_resume_base(bool tcp)
+{
+	struct fixture fix, *f = &fix;
+	struct cancel_rule *cr;
+	int err = 0;
+
+
+	fixture_init(f);
+	cancel_rule_new(UA_EVENT_CALL_RTPESTAB, f->a.ua, 0, 0, 1);
+	cr->n_audio_estab = 1;
+	cancel_rule_and(UA_EVENT_CALL_RTPESTAB, f->b.ua, 1, 0, 1);
+	cr->n_audio_estab = 1;
+
+	err = module_load(".", "ausine");
+	TEST_ERR(err);
+	err = module_load(".", "aufile");
+	TEST_ERR(err);
+
+	f->behaviour = BEHAVIOUR_ANSWER;
+	f->estab_action = ACTION_NOTHING;
+
+	/* Make a call from A to B */
+	err = ua_connect(f->a.ua, 0, NULL, tcp ? f->buri_tcp : f->buri,
+			 VIDMODE_ON);
+	TEST_ERR(err);
+
+	/* wait for RTP audio */
 	err = re_main_timeout(10000);
 	TEST_ERR(err);
 	TEST_ERR(fix.err);
@@ -3066,6 +3502,154 @@ out:
 }
 
 
+struct moh_listener {
+	struct moh_sub *sub;
+	const uint8_t *buf;           /**< Last encoded frame       */
+	size_t len;                   /**< Length of the last frame */
+	RE_ATOMIC unsigned n_frame;
+};
+
+
+static void moh_frame_handler(const struct auframe *af, bool marker,
+			      const uint8_t *buf, size_t len, void *arg)
+{
+	struct moh_listener *ml = arg;
+	(void)af;
+	(void)marker;
+
+	ml->buf = buf;
+	ml->len = len;
+	re_atomic_rlx_add(&ml->n_frame, 1);
+}
+
+
+static int moh_debug_count(unsigned *n_stream, unsigned *n_call)
+{
+	char *str = NULL;
+	const char *p;
+	int err;
+
+	err = re_sdprintf(&str, "%H", moh_debug, NULL);
+	if (err)
+		return err;
+
+	*n_stream = 0;
+	*n_call   = 0;
+
+	for (p = strstr(str, " calls,"); p; p = strstr(p + 1, " calls,")) {
+		const char *c = p;
+
+		while (c > str && c[-1] != ' ')
+			--c;
+
+		++*n_stream;
+		*n_call += (unsigned)atoi(c);
+	}
+
+	mem_deref(str);
+
+	return 0;
+}
+
+
+/*
+ * Calls on hold with the same codec, fmtp and ptime share one music-on-hold
+ * encoder and get the same encoded frames; another ptime or fmtp gets its
+ * own stream.
+ */
+int test_call_moh(void)
+{
+	struct config_audio *cfg = &conf_config()->audio;
+	struct config_audio cfg_orig = *cfg;
+	struct moh_listener mlv[5];
+	const struct aucodec *ac;
+	unsigned n_stream, n_call;
+	size_t i;
+	int err;
+
+	memset(mlv, 0, sizeof(mlv));
+
+	err = module_load(".", "g711");
+	TEST_ERR(err);
+	err = module_load(".", "ausine");
+	TEST_ERR(err);
+
+	str_ncpy(cfg->moh_mod, "ausine", sizeof(cfg->moh_mod));
+	str_ncpy(cfg->moh_dev, "440", sizeof(cfg->moh_dev));
+	ASSERT_TRUE(moh_enabled());
+
+	ac = aucodec_find(baresip_aucodecl(), "PCMU", 8000, 1);
+	ASSERT_TRUE(ac != NULL);
+
+	/* three calls on one stream */
+	for (i = 0; i < 3; i++) {
+		err = moh_subscribe(&mlv[i].sub, ac, NULL, 20,
+				    moh_frame_handler, &mlv[i]);
+		TEST_ERR(err);
+	}
+
+	/* an empty fmtp is the same encoder as none */
+	err = moh_subscribe(&mlv[3].sub, ac, "", 30,
+			    moh_frame_handler, &mlv[3]);
+	TEST_ERR(err);
+
+	err = moh_subscribe(&mlv[4].sub, ac, "maxptime=20", 20,
+			    moh_frame_handler, &mlv[4]);
+	TEST_ERR(err);
+
+	err = moh_debug_count(&n_stream, &n_call);
+	TEST_ERR(err);
+	ASSERT_EQ(3, n_stream);
+	ASSERT_EQ(5, n_call);
+
+	for (i = 0; i < 20; i++) {
+		size_t j;
+		bool done = true;
+
+		for (j = 0; j < RE_ARRAY_SIZE(mlv); j++)
+			done &= re_atomic_rlx(&mlv[j].n_frame) >= 2;
+
+		if (done)
+			break;
+
+		err = main_wait(50);
+		TEST_ERR(err);
+	}
+
+	/* no more frames after the subscriptions are gone */
+	for (i = 0; i < RE_ARRAY_SIZE(mlv); i++) {
+		mlv[i].sub = mem_deref(mlv[i].sub);
+		ASSERT_TRUE(re_atomic_rlx(&mlv[i].n_frame) >= 2);
+	}
+
+	/* the frames of one stream are encoded once for all its calls */
+	ASSERT_EQ(160, mlv[0].len);
+	ASSERT_TRUE(mlv[0].buf == mlv[1].buf);
+	ASSERT_TRUE(mlv[0].buf == mlv[2].buf);
+	ASSERT_EQ(240, mlv[3].len);
+	ASSERT_TRUE(mlv[0].buf != mlv[3].buf);
+	ASSERT_EQ(160, mlv[4].len);
+	ASSERT_TRUE(mlv[0].buf != mlv[4].buf);
+
+	/* the last call of a stream stops it */
+	err = moh_debug_count(&n_stream, &n_call);
+	TEST_ERR(err);
+	ASSERT_EQ(0, n_stream);
+	ASSERT_EQ(0, n_call);
+
+ out:
+	for (i = 0; i < RE_ARRAY_SIZE(mlv); i++)
+		mem_deref(mlv[i].sub);
+
+	*cfg = cfg_orig;
+
+	module_unload("ausine");
+	module_unload("g711");
+
+	return err;
+}
+
+
 static bool sdp_crypto_handler(const char *name, const char *value, void *arg)
 {
 	char **key = arg;
@@ -3224,3 +3808,274 @@ out:
 
 	return err;
 }
+
+
+/* Run the main loop until both agents played n more audio frames */
+static int auframes_wait(struct fixture *f, unsigned n)
+{
+	struct cancel_rule *cr = NULL;
+	int err = 0;
+
+	cancel_rule_new(UA_EVENT_CUSTOM, f->a.ua, 0, 0, 1);
+	cr->prm = "auframe";
+	cr->n_auframe = f->a.n_auframe + n;
+	cancel_rule_and(UA_EVENT_CUSTOM, f->b.ua, 1, 0, 1);
+	cr->prm = "auframe";
+	cr->n_auframe = f->b.n_auframe + n;
+
+	err = re_main_timeout(5000);
+	TEST_ERR(err);
+	TEST_ERR(f->err);
+
+ out:
+	if (cr)
+		cancel_rule_pop();
+
+	return err;
+}
+
+
+static uint32_t srtp_rx_packets(const struct agent *ag)
+{
+	return stream_metric_get_rx_n_packets(
+		audio_strm(call_audio(ua_call(ag->ua))));
+}
+
+
+/*
+ * A re-INVITE with unchanged keys keeps the receive context, a new key of
+ * the peer gets a new one. Packets are decrypted in both cases.
+ */
+int test_call_srtp_rx_context(void)
+{
+	struct fixture fix, *f = &fix;
+	struct cancel_rule *cr = NULL;
+	struct auplay *auplay = NULL;
+	struct sdp_media *m;
+	char *b_rx_key = NULL, *b_rx_key_new = NULL;
+	char *a_rx_key = NULL, *a_rx_key_new = NULL;
+	uint32_t n;
+	int err = 0;
+
+	err =  module_load(".", "srtp");
+	err |= module_load(".", "ausine");
+	TEST_ERR(err);
+
+	err = mock_auplay_register(&auplay, baresip_auplayl(),
+		auframe_handler, f);
+	TEST_ERR(err);
+
+	fixture_init_prm(f, ";mediaenc=srtp-mand"
+		";ptime=1;audio_player=mock-auplay,a");
+	f->b.ua = mem_deref(f->b.ua);
+	err = ua_alloc(&f->b.ua, "B <sip:b@127.0.0.1>;mediaenc=srtp-mand"
+		";regint=0;ptime=1;audio_player=mock-auplay,b");
+	TEST_ERR(err);
+
+	f->behaviour = BEHAVIOUR_ANSWER;
+	f->estab_action = ACTION_NOTHING;
+
+	cancel_rule_new(UA_EVENT_CALL_ESTABLISHED, f->a.ua, 0, 0, 1);
+	cancel_rule_and(UA_EVENT_CALL_ESTABLISHED, f->b.ua, 1, 0, 1);
+
+	err = ua_connect(f->a.ua, 0, NULL, f->buri, VIDMODE_ON);
+	TEST_ERR(err);
+
+	err = re_main_timeout(5000);
+	TEST_ERR(err);
+	TEST_ERR(fix.err);
+
+	cancel_rule_pop();
+
+	m = stream_sdpmedia(audio_strm(call_audio(ua_call(f->b.ua))));
+	sdp_media_rattr_apply(m, "crypto", sdp_crypto_handler, &b_rx_key);
+	m = stream_sdpmedia(audio_strm(call_audio(ua_call(f->a.ua))));
+	sdp_media_rattr_apply(m, "crypto", sdp_crypto_handler, &a_rx_key);
+
+	/* re-INVITE from A with unchanged keys */
+	err = call_modify(ua_call(f->a.ua));
+	TEST_ERR(err);
+
+	err = auframes_wait(f, 100);
+	TEST_ERR(err);
+
+	m = stream_sdpmedia(audio_strm(call_audio(ua_call(f->b.ua))));
+	sdp_media_rattr_apply(m, "crypto", sdp_crypto_handler,
+			      &b_rx_key_new);
+	TEST_STRCMP(b_rx_key, str_len(b_rx_key),
+		    b_rx_key_new, str_len(b_rx_key_new));
+
+	/* the kept context still decrypts */
+	n = srtp_rx_packets(&f->b);
+	err = auframes_wait(f, 50);
+	TEST_ERR(err);
+	ASSERT_TRUE(srtp_rx_packets(&f->b) > n);
+
+	/* new transmission key of B */
+	struct le *le;
+	for (le = call_streaml(ua_call(f->b.ua))->head; le; le = le->next)
+		stream_remove_menc_media_state(le->data);
+
+	err = call_update_media(ua_call(f->b.ua));
+	err |= call_modify(ua_call(f->b.ua));
+	TEST_ERR(err);
+
+	err = auframes_wait(f, 100);
+	TEST_ERR(err);
+
+	m = stream_sdpmedia(audio_strm(call_audio(ua_call(f->a.ua))));
+	sdp_media_rattr_apply(m, "crypto", sdp_crypto_handler,
+			      &a_rx_key_new);
+	ASSERT_TRUE(0 != str_casecmp(a_rx_key, a_rx_key_new));
+
+	/* the new context of A decrypts */
+	n = srtp_rx_packets(&f->a);
+	err = auframes_wait(f, 50);
+	TEST_ERR(err);
+	ASSERT_TRUE(srtp_rx_packets(&f->a) > n);
+
+out:
+	if (err)
+		failure_debug(f, false);
+
+	fixture_close(f);
+	mem_deref(auplay);
+
+	module_unload("ausine");
+	module_unload("srtp");
+
+	mem_deref(a_rx_key);
+	mem_deref(a_rx_key_new);
+	mem_deref(b_rx_key);
+	mem_deref(b_rx_key_new);
+
+	return err;
+}
+
+
+struct rec_files {
+	char *filev[4];
+	unsigned n;
+};
+
+
+static void sndfile_event_handler(struct ua *ua, enum ua_event ev,
+				  struct call *call, const char *prm,
+				  void *arg)
+{
+	struct rec_files *rf = arg;
+	struct pl file;
+	(void)ua;
+	(void)call;
+
+	if (ev != UA_EVENT_MODULE || rf->n >= RE_ARRAY_SIZE(rf->filev))
+		return;
+
+	if (re_regex(prm, str_len(prm), "sndfile,dump,[^]+", &file))
+		return;
+
+	(void)pl_strdup(&rf->filev[rf->n++], &file);
+}
+
+
+static long file_size(const char *path)
+{
+	FILE *fp;
+	long sz = -1;
+
+	fp = fopen(path, "rb");
+	if (!fp)
+		return -1;
+
+	if (0 == fseek(fp, 0, SEEK_END))
+		sz = ftell(fp);
+
+	(void)fclose(fp);
+
+	return sz;
+}
+
+
+/* Encoded and decoded audio of both agents, at least 100 ms of 8 kHz */
+static int rec_files_check(const struct rec_files *rf)
+{
+	int err = 0;
+
+	ASSERT_EQ(4, rf->n);
+
+	for (unsigned i = 0; i < rf->n; i++)
+		ASSERT_TRUE(file_size(rf->filev[i]) > 44 + 1600);
+
+ out:
+	return err;
+}
+
+
+/*
+ * The encoded and decoded audio of both agents is queued by the audio
+ * threads and written to disk by the writer threads of the recorder.
+ */
+int test_call_sndfile(void)
+{
+	struct fixture fix = {0}, *f = &fix;
+	struct auplay *auplay = NULL;
+	struct rec_files rf;
+	int err = 0;
+
+	memset(&rf, 0, sizeof(rf));
+
+	err = module_load(".", "sndfile");
+	if (err) {
+		info("sndfile module not available -- skipping test %s\n",
+		     __func__);
+		return 0;
+	}
+
+	err = module_load(".", "ausine");
+	TEST_ERR(err);
+
+	err = uag_event_register(sndfile_event_handler, &rf);
+	TEST_ERR(err);
+
+	err = mock_auplay_register(&auplay, baresip_auplayl(),
+		auframe_handler, f);
+	TEST_ERR(err);
+
+	fixture_init_prm(f, ";ptime=1;audio_player=mock-auplay,a");
+	f->b.ua = mem_deref(f->b.ua);
+	err = ua_alloc(&f->b.ua, "B <sip:b@127.0.0.1>"
+		";regint=0;ptime=1;audio_player=mock-auplay,b");
+	TEST_ERR(err);
+
+	f->behaviour = BEHAVIOUR_ANSWER;
+	f->estab_action = ACTION_NOTHING;
+
+	err = ua_connect(f->a.ua, 0, NULL, f->buri, VIDMODE_OFF);
+	TEST_ERR(err);
+
+	err = auframes_wait(f, 100);
+	TEST_ERR(err);
+
+ out:
+	if (err)
+		failure_debug(f, false);
+
+	fixture_close(f);
+	mem_deref(auplay);
+	uag_event_unregister(sndfile_event_handler);
+
+	module_unload("ausine");
+
+	/* finishes all recordings */
+	module_unload("sndfile");
+
+	if (!err)
+		err = rec_files_check(&rf);
+
+	for (unsigned i = 0; i < rf.n; i++) {
+		(void)remove(rf.filev[i]);
+		mem_deref(rf.filev[i]);
+	}
+
+	return err;
+}
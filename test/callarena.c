@@ -0,0 +1,85 @@
+/**
+ * @file test/callarena.c  Per-call memory arena testcode
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <baresip.h>
+#include "test.h"
+
+
+int test_call_arena(void)
+{
+	struct call_arena *arena = NULL;
+	struct jbuf *jb = NULL;
+	struct rtp_header hdr, hdr2;
+	uint8_t *p1, *p2, *p3;
+	void *mem = NULL;
+	int err;
+
+	ASSERT_EQ(EINVAL, call_arena_alloc(&arena, 0));
+
+	err = call_arena_alloc(&arena, 1024);
+	TEST_ERR(err);
+
+	ASSERT_TRUE(call_arena_zalloc(arena, 0) == NULL);
+
+	/* zeroed, aligned and rounded up */
+	p1 = call_arena_zalloc(arena, 10);
+	p2 = call_arena_zalloc(arena, 100);
+	ASSERT_TRUE(p1 != NULL && p2 != NULL);
+	ASSERT_EQ(0, (uintptr_t)p1 % 16);
+	ASSERT_EQ(0, (uintptr_t)p2 % 16);
+	ASSERT_EQ(16, p2 - p1);
+	ASSERT_EQ(0, p2[99]);
+	ASSERT_EQ(128, call_arena_used(arena));
+
+	memset(p1, 0xff, 10);
+	ASSERT_EQ(0, p2[0]);
+
+	/* larger than a chunk */
+	p3 = call_arena_zalloc(arena, 4000);
+	ASSERT_TRUE(p3 != NULL);
+	ASSERT_EQ(0, p3[3999]);
+	ASSERT_EQ(128 + 4000, call_arena_used(arena));
+
+	/* the jitter buffer keeps the arena */
+	err = jbuf_alloc_arena(&jb, 0, 10, arena);
+	TEST_ERR(err);
+	ASSERT_TRUE(call_arena_used(arena) > 128 + 4000);
+
+	arena = mem_deref(arena);
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.seq = 160;
+	hdr.ts  = 1;
+
+	mem = mem_alloc(32, NULL);
+	ASSERT_TRUE(mem != NULL);
+
+	err = jbuf_put(jb, &hdr, mem);
+	TEST_ERR(err);
+	mem = mem_deref(mem);
+
+	err = jbuf_get(jb, &hdr2, &mem);
+	TEST_ERR(err);
+	ASSERT_EQ(160, hdr2.seq);
+
+	/* the chunk of a released arena is cleared and recycled */
+	jb = mem_deref(jb);
+
+	err = call_arena_alloc(&arena, 1024);
+	TEST_ERR(err);
+
+	p2 = call_arena_zalloc(arena, 10);
+	ASSERT_TRUE(p2 == p1);
+	ASSERT_EQ(0, p2[0]);
+
+ out:
+	mem_deref(mem);
+	mem_deref(jb);
+	mem_deref(arena);
+
+	return err;
+}
@@ -385,3 +385,82 @@ int test_jbuf_adaptive_video(void)
 
 	return err;
 }
+
+
+static int hist_put(struct jbuf *jb, struct rtp_header *hdr, void *mem,
+		    uint32_t delay)
+{
+	enum { SRATE = 8000 };
+	int err;
+
+	/* all packets arrive now, an older timestamp is a larger delay */
+	++hdr->seq;
+	hdr->ts = 1000000 - delay * (SRATE / 1000);
+
+	err = jbuf_put(jb, hdr, mem);
+
+	return err == EALREADY ? 0 : err;
+}
+
+
+int test_jbuf_hist(void)
+{
+	struct rtp_header hdr;
+	struct jbuf_hist hist;
+	struct jbuf *jb = NULL;
+	char *mem = NULL;
+	int err;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.ssrc = 1;
+
+	err = jbuf_alloc(&jb, 1, 128);
+	TEST_ERR(err);
+
+	mem = mem_zalloc(32, NULL);
+	if (!mem) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	ASSERT_EQ(EINVAL, jbuf_set_percentile(jb, 101));
+
+	/* no clock rate, no histogram */
+	err = hist_put(jb, &hdr, mem, 0);
+	TEST_ERR(err);
+	err = jbuf_hist(jb, &hist);
+	TEST_ERR(err);
+	ASSERT_EQ(0, hist.n);
+
+	err = jbuf_set_srate(jb, 8000);
+	TEST_ERR(err);
+
+	/* 90% of the packets without delay, 10% with 100 ms */
+	for (unsigned i = 0; i < 100; i++) {
+		err = hist_put(jb, &hdr, mem, i % 10 == 5 ? 100 : 0);
+		TEST_ERR(err);
+	}
+
+	err = jbuf_hist(jb, &hist);
+	TEST_ERR(err);
+	ASSERT_EQ(100, hist.n);
+	ASSERT_EQ(95, hist.pct);
+	ASSERT_TRUE(hist.probv[0]  > 890000 && hist.probv[0]  < 910000);
+	ASSERT_TRUE(hist.probv[10] >  90000 && hist.probv[10] < 110000);
+	ASSERT_EQ(110, hist.target);
+
+	/* fast attack: a single late packet raises the target at once */
+	err = hist_put(jb, &hdr, mem, 300);
+	TEST_ERR(err);
+
+	err = jbuf_hist(jb, &hist);
+	TEST_ERR(err);
+	ASSERT_TRUE(hist.target >= 300);
+	ASSERT_TRUE(hist.probv[30] > 0 && hist.probv[30] < 20000);
+
+ out:
+	mem_deref(jb);
+	mem_deref(mem);
+
+	return err;
+}
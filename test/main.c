@@ -24,6 +24,13 @@ struct test {
 static const struct test tests[] = {
 	TEST(test_account),
 	TEST(test_account_uri_complete),
+	TEST(test_aufilt_arena),
+	TEST(test_aufilt_chain),
+	TEST(test_aufilt_perf),
+	TEST(test_aupoly),
+	TEST(test_aupoly_perf),
+	TEST(test_austretch),
+	TEST(test_austretch_perf),
 	TEST(test_call_answer),
 	TEST(test_call_answer_hangup_a),
 	TEST(test_call_answer_hangup_b),
@@ -46,14 +53,21 @@ static const struct test tests[] = {
 	TEST(test_call_transfer_fail),
 	TEST(test_call_attended_transfer),
 	TEST(test_call_video),
+	TEST(test_call_video_simulcast),
 	TEST(test_call_change_videodir),
 	TEST(test_call_webrtc),
 	TEST(test_call_bundle),
+	TEST(test_call_bundle_demux),
 	TEST(test_call_ipv6ll),
 	TEST(test_call_100rel_audio),
 	TEST(test_call_100rel_video),
 	TEST(test_call_hold_resume),
+	TEST(test_call_moh),
 	TEST(test_call_srtp_tx_rekey),
+	TEST(test_call_srtp_rx_context),
+	TEST(test_call_sndfile),
+	TEST(test_call_arena),
+	TEST(test_call_setup_perf),
 	TEST(test_cmd),
 	TEST(test_cmd_long),
 	TEST(test_contact),
@@ -61,9 +75,13 @@ static const struct test tests[] = {
 	TEST(test_jbuf),
 	TEST(test_jbuf_adaptive),
 	TEST(test_jbuf_adaptive_video),
+	TEST(test_jbuf_hist),
 	TEST(test_message),
 	TEST(test_network),
 	TEST(test_play),
+	TEST(test_play_cache),
+	TEST(test_red),
+	TEST(test_rxpool),
 	TEST(test_stunuri),
 	TEST(test_ua_alloc),
 	TEST(test_ua_options),
@@ -74,6 +92,10 @@ static const struct test tests[] = {
 	TEST(test_ua_register_dns),
 	TEST(test_uag_find_param),
 	TEST(test_video),
+	TEST(test_vidpool),
+	TEST(test_vidconv_mt),
+	TEST(test_vidcc),
+	TEST(test_fec),
 	TEST(test_clean_number),
 	TEST(test_clean_number_only_numeric),
 };
@@ -238,7 +260,8 @@ static void usage(void)
 
 
 static const char *modconfig =
-	"ausrc_format    s16\n";
+	"ausrc_format    s16\n"
+	"dtls_srtp_resumption all\n";
 
 
 int main(int argc, char *argv[])
@@ -103,3 +103,179 @@ int test_play(void)
 	mem_deref(auplay);
 	return err;
 }
+
+
+struct cache_stats {
+	uint32_t files;
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evicted;
+};
+
+
+static int cache_stats_get(struct cache_stats *cs,
+			   const struct player *player)
+{
+	struct pl files, hits, misses, evicted;
+	char buf[256];
+	int err = 0;
+
+	if (re_snprintf(buf, sizeof(buf), "%H", play_debug, player) < 0)
+		return ENOMEM;
+
+	err = re_regex(buf, str_len(buf),
+		       "cache [0-9]+ files, [^,]+, [0-9]+ hits,"
+		       " [0-9]+ misses, [0-9]+ evicted",
+		       &files, NULL, &hits, &misses, &evicted);
+	TEST_ERR(err);
+
+	cs->files   = pl_u32(&files);
+	cs->hits    = pl_u32(&hits);
+	cs->misses  = pl_u32(&misses);
+	cs->evicted = pl_u32(&evicted);
+
+ out:
+	return err;
+}
+
+
+/* Write a WAV file with sampc samples of 8000 Hz mono */
+static int wav_write(const char *path, size_t sampc)
+{
+	struct aufile_prm prm;
+	struct aufile *af = NULL;
+	int16_t sampv[NUM_SAMPLES];
+	int err;
+
+	prm.srate    = 8000;
+	prm.channels = 1;
+	prm.fmt      = AUFMT_S16LE;
+
+	for (size_t i = 0; i < NUM_SAMPLES; i++)
+		sampv[i] = (int16_t)(i * 64);
+
+	err = aufile_open(&af, &prm, path, AUFILE_WRITE);
+	if (err)
+		return err;
+
+	while (sampc) {
+		size_t n = min(sampc, (size_t)NUM_SAMPLES);
+
+		err = aufile_write(af, (uint8_t *)sampv, n * sizeof(int16_t));
+		if (err)
+			break;
+
+		sampc -= n;
+	}
+
+	mem_deref(af);
+
+	return err;
+}
+
+
+static int play_start(struct player *player, const char *file)
+{
+	struct play *play = NULL;
+	int err;
+
+	err = play_file(&play, player, file, 1, NULL, NULL);
+
+	mem_deref(play);
+
+	return err;
+}
+
+
+static void silent_auframe_handler(struct auframe *af, const char *dev,
+				   void *arg)
+{
+	(void)af;
+	(void)dev;
+	(void)arg;
+}
+
+
+/*
+ * The decoded files are cached up to the default cache size of 4 MB, the
+ * least recently used file is evicted and a modified file is decoded
+ * again.
+ */
+int test_play_cache(void)
+{
+	static const char *filev[] = {
+		"play_cache_1.wav", "play_cache_2.wav", "play_cache_3.wav"
+	};
+	const size_t sampc = 750000;  /* 1.5 MB decoded */
+	struct auplay *auplay = NULL;
+	struct player *player = NULL;
+	struct cache_stats cs;
+	int err;
+
+	err = mock_auplay_register(&auplay, baresip_auplayl(),
+				   silent_auframe_handler, NULL);
+	TEST_ERR(err);
+
+	err = play_init(&player);
+	TEST_ERR(err);
+
+	play_set_path(player, ".");
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(filev); i++) {
+		err = wav_write(filev[i], sampc);
+		TEST_ERR(err);
+	}
+
+	/* miss, then hit */
+	err  = play_start(player, filev[0]);
+	err |= play_start(player, filev[0]);
+	TEST_ERR(err);
+
+	err = cache_stats_get(&cs, player);
+	TEST_ERR(err);
+	ASSERT_EQ(1, cs.files);
+	ASSERT_EQ(1, cs.misses);
+	ASSERT_EQ(1, cs.hits);
+
+	/* the third file evicts the least recently used one */
+	err  = play_start(player, filev[1]);
+	err |= play_start(player, filev[0]);
+	err |= play_start(player, filev[2]);
+	TEST_ERR(err);
+
+	err = cache_stats_get(&cs, player);
+	TEST_ERR(err);
+	ASSERT_EQ(2, cs.files);
+	ASSERT_EQ(3, cs.misses);
+	ASSERT_EQ(2, cs.hits);
+	ASSERT_EQ(1, cs.evicted);
+
+	/* file 1 was used more recently than file 2 */
+	err = play_start(player, filev[0]);
+	TEST_ERR(err);
+
+	err = cache_stats_get(&cs, player);
+	TEST_ERR(err);
+	ASSERT_EQ(3, cs.hits);
+
+	/* a modified file is decoded again */
+	err = wav_write(filev[0], sampc / 2);
+	TEST_ERR(err);
+
+	err = play_start(player, filev[0]);
+	TEST_ERR(err);
+
+	err = cache_stats_get(&cs, player);
+	TEST_ERR(err);
+	ASSERT_EQ(3, cs.hits);
+	ASSERT_EQ(4, cs.misses);
+
+ out:
+	mem_deref(player);
+	mem_deref(auplay);
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(filev); i++)
+		(void)remove(filev[i]);
+
+	return err;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file test/red.c  Redundant audio data (RFC 2198) testcode
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <baresip.h>
+#include "test.h"
+
+
+enum {
+	SEQ_BASE = 65534,
+	TS_STEP  = 160,
+};
+
+
+struct red_test {
+	struct rtp_header hdrv[8];
+	bool recovered[8];
+	unsigned n;
+	int err;
+};
+
+
+static void red_frame_handler(const struct rtp_header *hdr, struct mbuf *mb,
+			      bool recovered, void *arg)
+{
+	struct red_test *rt = arg;
+	uint16_t i = hdr->seq - SEQ_BASE;
+
+	if (rt->n >= RE_ARRAY_SIZE(rt->hdrv)) {
+		rt->err = EOVERFLOW;
+		return;
+	}
+
+	/* frame i has 20 + i bytes with the value i */
+	if (mbuf_get_left(mb) != 20u + i || mbuf_buf(mb)[0] != i)
+		rt->err = EPROTO;
+
+	rt->hdrv[rt->n]      = *hdr;
+	rt->recovered[rt->n] = recovered;
+	++rt->n;
+}
+
+
+static int red_packet(struct mbuf **mbp, struct red_enc *enc, unsigned i)
+{
+	struct mbuf *mb;
+	int err = 0;
+
+	mb = mbuf_alloc(64);
+	if (!mb)
+		return ENOMEM;
+
+	for (unsigned j = 0; j < 20 + i; j++)
+		err |= mbuf_write_u8(mb, (uint8_t)i);
+
+	mb->pos = 0;
+
+	err |= red_enc_encode(enc, mb, 0, 1000 + i * TS_STEP);
+	if (err)
+		mem_deref(mb);
+	else
+		*mbp = mb;
+
+	return err;
+}
+
+
+int test_red(void)
+{
+	struct red_test rt;
+	struct red_enc *enc = NULL;
+	struct red_dec *dec = NULL;
+	struct mbuf *pktv[4] = {NULL};
+	struct mbuf *mb = NULL;
+	struct rtp_header hdr;
+	int err;
+
+	memset(&rt, 0, sizeof(rt));
+	memset(&hdr, 0, sizeof(hdr));
+
+	ASSERT_EQ(EINVAL, red_enc_alloc(&enc, RED_LEVEL_MAX + 1));
+
+	err  = red_enc_alloc(&enc, 2);
+	err |= red_dec_alloc(&dec);
+	TEST_ERR(err);
+
+	for (unsigned i = 0; i < RE_ARRAY_SIZE(pktv); i++) {
+		err = red_packet(&pktv[i], enc, i);
+		TEST_ERR(err);
+	}
+
+	/* the first packet has only the primary block */
+	ASSERT_EQ(1 + 20, mbuf_get_left(pktv[0]));
+	ASSERT_EQ(0, mbuf_buf(pktv[0])[0]);
+
+	/* two previous frames */
+	ASSERT_EQ(4 + 4 + 1 + 21 + 22 + 23, mbuf_get_left(pktv[3]));
+
+	hdr.ver  = RTP_VERSION;
+	hdr.pt   = 63;
+	hdr.ssrc = 0x01020304;
+
+	/* packets 1 and 2 are lost */
+	hdr.seq = SEQ_BASE;
+	hdr.ts  = 1000;
+	err = red_dec_decode(dec, &hdr, pktv[0], red_frame_handler, &rt);
+	TEST_ERR(err);
+	TEST_ERR(rt.err);
+	ASSERT_EQ(1, rt.n);
+	ASSERT_TRUE(!rt.recovered[0]);
+
+	hdr.seq = (uint16_t)(SEQ_BASE + 3);
+	hdr.ts  = 1000 + 3 * TS_STEP;
+	err = red_dec_decode(dec, &hdr, pktv[3], red_frame_handler, &rt);
+	TEST_ERR(err);
+	TEST_ERR(rt.err);
+	ASSERT_EQ(4, rt.n);
+
+	for (unsigned i = 1; i < 4; i++) {
+		ASSERT_EQ((uint16_t)(SEQ_BASE + i), rt.hdrv[i].seq);
+		ASSERT_EQ(1000 + i * TS_STEP, rt.hdrv[i].ts);
+		ASSERT_EQ(0, rt.hdrv[i].pt);
+		ASSERT_EQ(i < 3, rt.recovered[i]);
+	}
+
+	/* a duplicate packet, nothing to recover */
+	pktv[3]->pos = 0;
+	err = red_dec_decode(dec, &hdr, pktv[3], red_frame_handler, &rt);
+	TEST_ERR(err);
+	ASSERT_EQ(5, rt.n);
+	ASSERT_TRUE(!rt.recovered[4]);
+
+	/* block header without the primary header */
+	mb = mbuf_alloc(8);
+	if (!mb) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	err = mbuf_write_u32(mb, htonl(1u << 31 | 10));
+	TEST_ERR(err);
+	mb->pos = 0;
+
+	ASSERT_EQ(EBADMSG, red_dec_decode(dec, &hdr, mb, red_frame_handler,
+					  &rt));
+	ASSERT_EQ(5, rt.n);
+	err = 0;
+
+ out:
+	for (unsigned i = 0; i < RE_ARRAY_SIZE(pktv); i++)
+		mem_deref(pktv[i]);
+	mem_deref(mb);
+	mem_deref(dec);
+	mem_deref(enc);
+
+	return err;
+}
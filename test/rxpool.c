@@ -0,0 +1,135 @@
+/**
+ * @file test/rxpool.c  RTP receive worker pool testcode
+ *
+ * Copyright (C) 2026 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <baresip.h>
+#include "test.h"
+#include "../src/core.h"
+
+
+enum {
+	NUM_KEYS = 1024,
+};
+
+
+static uint32_t stream_key(unsigned i)
+{
+	struct sa laddr;
+
+	/* the local RTP address of a stream, as in rtprecv */
+	sa_set_str(&laddr, "127.0.0.1", (uint16_t)(10000 + 2 * i));
+
+	return sa_hash(&laddr, SA_ALL);
+}
+
+
+static int worker_map(uint8_t *idv, unsigned *countv, unsigned workers)
+{
+	memset(countv, 0, workers * sizeof(*countv));
+
+	for (unsigned i = 0; i < NUM_KEYS; i++) {
+		struct rxworker *w = rxpool_worker(stream_key(i));
+
+		if (!w)
+			return ENOENT;
+
+		/* the same key is always mapped to the same worker */
+		if (w != rxpool_worker(stream_key(i)))
+			return EPROTO;
+
+		idv[i] = (uint8_t)rxworker_id(w);
+		if (idv[i] >= workers)
+			return ERANGE;
+
+		++countv[idv[i]];
+	}
+
+	return 0;
+}
+
+
+static void worker_thread_handler(void *arg)
+{
+	thrd_t *thr = arg;
+
+	*thr = thrd_current();
+}
+
+
+int test_rxpool(void)
+{
+	uint8_t idv4[NUM_KEYS], idv[NUM_KEYS];
+	unsigned countv[5];
+	unsigned moved = 0;
+	thrd_t thr;
+	int err;
+
+	ASSERT_TRUE(rxpool_worker(stream_key(0)) == NULL);
+	ASSERT_EQ(EINVAL, rxpool_init(0));
+
+	err = rxpool_init(4);
+	TEST_ERR(err);
+
+	err = worker_map(idv4, countv, 4);
+	TEST_ERR(err);
+
+	/* the virtual nodes spread the streams over all workers */
+	for (unsigned i = 0; i < 4; i++) {
+		ASSERT_TRUE(countv[i] >= NUM_KEYS / 8);
+		ASSERT_TRUE(countv[i] <= NUM_KEYS / 2);
+	}
+
+	/* a handler is called in the thread of the worker */
+	err = rxworker_call(rxpool_worker(stream_key(0)),
+			    worker_thread_handler, &thr);
+	TEST_ERR(err);
+	ASSERT_TRUE(!thrd_equal(thr, thrd_current()));
+
+	rxpool_close();
+	ASSERT_TRUE(rxpool_worker(stream_key(0)) == NULL);
+
+	/* an added worker only takes streams, none move between the others */
+	err = rxpool_init(5);
+	TEST_ERR(err);
+
+	err = worker_map(idv, countv, 5);
+	TEST_ERR(err);
+
+	for (unsigned i = 0; i < NUM_KEYS; i++) {
+
+		if (idv[i] == idv4[i])
+			continue;
+
+		ASSERT_EQ(4, idv[i]);
+		++moved;
+	}
+
+	ASSERT_EQ(countv[4], moved);
+	ASSERT_TRUE(moved >= NUM_KEYS / 10);
+	ASSERT_TRUE(moved <= NUM_KEYS / 3);
+
+	rxpool_close();
+
+	/* only the streams of a removed worker move */
+	err = rxpool_init(3);
+	TEST_ERR(err);
+
+	err = worker_map(idv, countv, 3);
+	TEST_ERR(err);
+
+	for (unsigned i = 0; i < NUM_KEYS; i++) {
+
+		if (idv4[i] == 3)
+			continue;
+
+		ASSERT_EQ(idv4[i], idv[i]);
+	}
+
+ out:
+	rxpool_close();
+
+	return err;
+}
@@ -192,6 +192,13 @@ int mock_vidisp_register(struct vidisp **vidispp,
 int test_account(void);
 int test_account_uri_complete(void);
 int test_aulevel(void);
+int test_aufilt_arena(void);
+int test_aufilt_chain(void);
+int test_aufilt_perf(void);
+int test_aupoly(void);
+int test_aupoly_perf(void);
+int test_austretch(void);
+int test_austretch_perf(void);
 int test_call_answer(void);
 int test_call_answer_hangup_a(void);
 int test_call_answer_hangup_b(void);
@@ -214,14 +221,21 @@ int test_call_transfer(void);
 int test_call_transfer_fail(void);
 int test_call_attended_transfer(void);
 int test_call_video(void);
+int test_call_video_simulcast(void);
 int test_call_change_videodir(void);
 int test_call_webrtc(void);
 int test_call_bundle(void);
+int test_call_bundle_demux(void);
 int test_call_ipv6ll(void);
 int test_call_100rel_audio(void);
 int test_call_100rel_video(void);
 int test_call_hold_resume(void);
+int test_call_moh(void);
 int test_call_srtp_tx_rekey(void);
+int test_call_srtp_rx_context(void);
+int test_call_sndfile(void);
+int test_call_arena(void);
+int test_call_setup_perf(void);
 int test_cmd(void);
 int test_cmd_long(void);
 int test_contact(void);
@@ -229,9 +243,13 @@ int test_event(void);
 int test_jbuf(void);
 int test_jbuf_adaptive(void);
 int test_jbuf_adaptive_video(void);
+int test_jbuf_hist(void);
 int test_message(void);
 int test_network(void);
 int test_play(void);
+int test_play_cache(void);
+int test_red(void);
+int test_rxpool(void);
 int test_stunuri(void);
 int test_ua_alloc(void);
 int test_ua_options(void);
@@ -242,5 +260,9 @@ int test_ua_register_auth_dns(void);
 int test_ua_register_dns(void);
 int test_uag_find_param(void);
 int test_video(void);
+int test_vidpool(void);
+int test_vidconv_mt(void);
+int test_vidcc(void);
+int test_fec(void);
 int test_clean_number(void);
 int test_clean_number_only_numeric(void);
@@ -4,7 +4,9 @@
  * Copyright (C) 2010 - 2017 Alfred E. Heggestad
  */
 
+#include <string.h>
 #include <re.h>
+#include <rem.h>
 #include <baresip.h>
 #include "test.h"
 
@@ -31,3 +33,550 @@ int test_video(void)
  out:
 	return err;
 }
+
+
+int test_vidpool(void)
+{
+	struct vidpool *pool = NULL;
+	struct vidframe *f1 = NULL, *f2 = NULL, *f3 = NULL;
+	struct vidsz big = {320, 240}, small = {160, 120};
+	uint8_t *data;
+	int err;
+
+	err = vidpool_alloc(&pool, 1);
+	TEST_ERR(err);
+
+	err = vidpool_get(pool, &f1, VID_FMT_YUV420P, &big);
+	TEST_ERR(err);
+	ASSERT_EQ(320, f1->size.w);
+	ASSERT_EQ(240, f1->size.h);
+	ASSERT_TRUE(vidframe_isvalid(f1));
+
+	vidframe_fill_color(f1, 255, 0, 0);
+	data = f1->data[0];
+
+	/* a shared frame keeps its buffer */
+	f2 = mem_ref(f1);
+	f1 = mem_deref(f1);
+	ASSERT_TRUE(f2->data[0] == data);
+
+	/* the buffer is returned to the pool on the last reference */
+	f2 = mem_deref(f2);
+
+	err = vidpool_get(pool, &f1, VID_FMT_YUV420P, &small);
+	TEST_ERR(err);
+	ASSERT_TRUE(f1->data[0] == data);
+	ASSERT_EQ(160, f1->size.w);
+
+	/* pool is empty, a new buffer is allocated */
+	err = vidpool_get(pool, &f2, VID_FMT_YUV420P, &big);
+	TEST_ERR(err);
+	ASSERT_TRUE(f2->data[0] != data);
+
+	f1 = mem_deref(f1);
+	f2 = mem_deref(f2);
+
+	/* at most one free buffer is kept, too small buffers are skipped */
+	err = vidpool_get(pool, &f3, VID_FMT_RGB32, &big);
+	TEST_ERR(err);
+	ASSERT_TRUE(f3->data[0] != data);
+
+	/* frames may outlive the pool */
+	pool = mem_deref(pool);
+	vidframe_fill_color(f3, 0, 255, 0);
+
+	ASSERT_EQ(EINVAL, vidpool_get(NULL, &f1, VID_FMT_YUV420P, &big));
+
+ out:
+	mem_deref(f3);
+	mem_deref(f2);
+	mem_deref(f1);
+	mem_deref(pool);
+
+	return err;
+}
+
+
+static uint8_t ref_y(int r, int g, int b)
+{
+	return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+
+static uint8_t ref_u(int r, int g, int b)
+{
+	return (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+
+static uint8_t ref_v(int r, int g, int b)
+{
+	return (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+
+/* Scalar reference conversion to YUV420P */
+static void ref_conv(struct vidframe *dst, const struct vidframe *src)
+{
+	const unsigned w = src->size.w, h = src->size.h;
+
+	for (unsigned y = 0; y < h; y++) {
+		const uint8_t *p = src->data[0] + y * src->linesize[0];
+		uint8_t *d = dst->data[0] + y * dst->linesize[0];
+
+		for (unsigned x = 0; x < w; x++) {
+
+			switch (src->fmt) {
+
+			case VID_FMT_YUYV422: d[x] = p[x * 2]; break;
+			case VID_FMT_NV12:    d[x] = p[x];     break;
+			default:
+				d[x] = ref_y(p[x*4 + 2], p[x*4 + 1], p[x*4]);
+				break;
+			}
+		}
+	}
+
+	for (unsigned y = 0; y < h / 2; y++) {
+		const uint8_t *p0 = src->data[0] + 2 * y * src->linesize[0];
+		const uint8_t *p1 = p0 + src->linesize[0];
+		const uint8_t *c = src->data[1] + y * src->linesize[1];
+		uint8_t *u = dst->data[1] + y * dst->linesize[1];
+		uint8_t *v = dst->data[2] + y * dst->linesize[2];
+
+		for (unsigned x = 0; x < w / 2; x++) {
+			const uint8_t *a = &p0[x * 8], *b = &p1[x * 8];
+			int r, g, bl;
+
+			switch (src->fmt) {
+
+			case VID_FMT_YUYV422:
+				u[x] = (p0[x*4 + 1] + p1[x*4 + 1] + 1) >> 1;
+				v[x] = (p0[x*4 + 3] + p1[x*4 + 3] + 1) >> 1;
+				break;
+
+			case VID_FMT_NV12:
+				u[x] = c[x * 2];
+				v[x] = c[x * 2 + 1];
+				break;
+
+			default:
+				r  = (a[2] + a[6] + b[2] + b[6] + 2) >> 2;
+				g  = (a[1] + a[5] + b[1] + b[5] + 2) >> 2;
+				bl = (a[0] + a[4] + b[0] + b[4] + 2) >> 2;
+				u[x] = ref_u(r, g, bl);
+				v[x] = ref_v(r, g, bl);
+				break;
+			}
+		}
+	}
+}
+
+
+static bool frame_plane_eq(const struct vidframe *a, const struct vidframe *b,
+			   unsigned i, unsigned w, unsigned h)
+{
+	for (unsigned y = 0; y < h; y++) {
+
+		if (memcmp(a->data[i] + y * a->linesize[i],
+			   b->data[i] + y * b->linesize[i], w))
+			return false;
+	}
+
+	return true;
+}
+
+
+int test_vidconv_mt(void)
+{
+	static const enum vidfmt fmtv[] = {
+		VID_FMT_YUYV422, VID_FMT_NV12, VID_FMT_RGB32
+	};
+	static const struct vidsz szv[] = {
+		{640, 480}, {176, 144}, {38, 22}
+	};
+	struct vidframe *src = NULL, *dst = NULL, *ref = NULL;
+	int err = 0;
+
+	ASSERT_TRUE(vidconv_mt_supported(VID_FMT_NV12, VID_FMT_YUV420P));
+	ASSERT_TRUE(!vidconv_mt_supported(VID_FMT_NV12, VID_FMT_RGB32));
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(fmtv); i++) {
+		for (size_t j = 0; j < RE_ARRAY_SIZE(szv); j++) {
+
+			const struct vidsz *sz = &szv[j];
+
+			err  = vidframe_alloc(&src, fmtv[i], sz);
+			err |= vidframe_alloc(&dst, VID_FMT_YUV420P, sz);
+			err |= vidframe_alloc(&ref, VID_FMT_YUV420P, sz);
+			TEST_ERR(err);
+
+			rand_bytes(src->data[0],
+				   (uint32_t)vidframe_size(fmtv[i], sz));
+
+			ref_conv(ref, src);
+
+			err = vidconv_mt(dst, src);
+			TEST_ERR(err);
+
+			ASSERT_TRUE(frame_plane_eq(dst, ref, 0, sz->w, sz->h));
+			ASSERT_TRUE(frame_plane_eq(dst, ref, 1,
+						   sz->w / 2, sz->h / 2));
+			ASSERT_TRUE(frame_plane_eq(dst, ref, 2,
+						   sz->w / 2, sz->h / 2));
+
+			src = mem_deref(src);
+			dst = mem_deref(dst);
+			ref = mem_deref(ref);
+		}
+	}
+
+	ASSERT_EQ(EINVAL, vidconv_mt(NULL, NULL));
+
+ out:
+	mem_deref(ref);
+	mem_deref(dst);
+	mem_deref(src);
+
+	return err;
+}
+
+
+/*
+ * Send at the estimated rate through a bottleneck link, with transport-wide
+ * feedback every 50 ms. Returns the number of backoffs.
+ */
+static unsigned cc_link_sim(struct vidcc *cc, int64_t *arrv, size_t arrc,
+			    double capacity, uint64_t duration)
+{
+	const size_t pkt_size = 1000;
+	uint64_t now, t_fb = 0;
+	double credit = 0, link_free = 0;
+	uint16_t seq = 0, fb_seq = 0;
+	enum vidcc_state state = VIDCC_INCREASE;
+	unsigned backoffc = 0;
+
+	for (now = 1000000; now < 1000000 + duration; now += 1000) {
+
+		credit += vidcc_bitrate(cc) / 1000.0;
+
+		while (credit >= pkt_size * 8) {
+			double start = max(link_free, (double)now);
+
+			credit   -= pkt_size * 8;
+			link_free = start + pkt_size * 8 * 1e6 / capacity;
+
+			vidcc_sent(cc, seq, pkt_size, now);
+			arrv[seq % arrc] = (int64_t)link_free + 20000;
+			++seq;
+		}
+
+		if (now - t_fb >= 50000) {
+			while (fb_seq != seq &&
+			       arrv[fb_seq % arrc] <= (int64_t)now) {
+				vidcc_arrival(cc, fb_seq, arrv[fb_seq % arrc]);
+				++fb_seq;
+			}
+
+			vidcc_feedback(cc, now);
+			t_fb = now;
+		}
+
+		if (vidcc_state(cc) != state) {
+			state = vidcc_state(cc);
+			backoffc += state == VIDCC_DECREASE;
+		}
+	}
+
+	return backoffc;
+}
+
+
+int test_vidcc(void)
+{
+	struct vidcc *cc = NULL;
+	struct twcc twcc;
+	int64_t *arrv = NULL;
+	uint64_t now = 1000000;
+	const size_t arrc = 8192;
+	uint32_t bitrate;
+	int err = 0;
+
+	memset(&twcc, 0, sizeof(twcc));
+
+	/* loss-based, receiver reports only */
+	err = vidcc_alloc(&cc, 1000000);
+	TEST_ERR(err);
+
+	ASSERT_EQ(1000000, vidcc_bitrate(cc));
+	ASSERT_TRUE(!vidcc_changed(cc));
+
+	vidcc_loss(cc, 64, 50000, now);
+	ASSERT_EQ(875000, vidcc_bitrate(cc));
+	ASSERT_EQ(VIDCC_DECREASE, vidcc_state(cc));
+	ASSERT_TRUE(vidcc_changed(cc));
+	ASSERT_TRUE(!vidcc_changed(cc));
+
+	now += 1000000;
+	vidcc_loss(cc, 0, 50000, now);
+	ASSERT_EQ(VIDCC_INCREASE, vidcc_state(cc));
+	ASSERT_TRUE(vidcc_bitrate(cc) > 875000);
+
+	for (int i = 0; i < 4; i++) {
+		now += 1000000;
+		vidcc_loss(cc, 0, 50000, now);
+	}
+
+	ASSERT_EQ(VIDCC_PROBE, vidcc_state(cc));
+	ASSERT_EQ(1000000, vidcc_bitrate(cc));
+
+	cc = mem_deref(cc);
+
+	/* delay-based, 500 kbit/s bottleneck */
+	arrv = mem_zalloc(arrc * sizeof(*arrv), NULL);
+	if (!arrv) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	err = vidcc_alloc(&cc, 2000000);
+	TEST_ERR(err);
+
+	ASSERT_TRUE(cc_link_sim(cc, arrv, arrc, 500000, 30000000) > 0);
+
+	bitrate = vidcc_bitrate(cc);
+	ASSERT_TRUE(bitrate > 250000);
+	ASSERT_TRUE(bitrate < 600000);
+
+	cc = mem_deref(cc);
+
+	/* transport-wide feedback, 3 packets received 1 ms apart */
+	err = vidcc_alloc(&cc, 1000000);
+	TEST_ERR(err);
+
+	for (uint16_t seq = 100; seq < 103; seq++)
+		vidcc_sent(cc, seq, 1000, now + seq * 1000);
+
+	twcc.seq     = 100;
+	twcc.count   = 3;
+	twcc.reftime = 1;
+	twcc.chunks  = mbuf_alloc(2);
+	twcc.deltas  = mbuf_alloc(3);
+	if (!twcc.chunks || !twcc.deltas) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	/* run-length chunk, 3 x small delta */
+	err  = mbuf_write_u16(twcc.chunks, htons(0x2003));
+	err |= mbuf_write_u8(twcc.deltas, 4);
+	err |= mbuf_write_u8(twcc.deltas, 4);
+	err |= mbuf_write_u8(twcc.deltas, 4);
+	TEST_ERR(err);
+
+	err = vidcc_twcc(cc, &twcc, now);
+	TEST_ERR(err);
+
+	/* deltas are missing */
+	twcc.deltas->end = 1;
+	ASSERT_EQ(EBADMSG, vidcc_twcc(cc, &twcc, now));
+	err = 0;
+
+	ASSERT_EQ(EINVAL, vidcc_twcc(cc, NULL, now));
+
+ out:
+	mem_deref(twcc.chunks);
+	mem_deref(twcc.deltas);
+	mem_deref(arrv);
+	mem_deref(cc);
+
+	return err;
+}
+
+
+struct fec_test {
+	struct mbuf *pktv[4];    /* Packets after the SSRC */
+	struct rtp_header hdrv[4];
+	unsigned recovered;
+	int err;
+};
+
+
+/* A received RTP packet, the position is at the payload */
+static int fec_rtp_packet(struct mbuf **mbp, struct rtp_header *hdr,
+			  const struct rtp_header *tx, uint32_t csrc,
+			  const uint8_t *p, size_t len)
+{
+	struct mbuf *mb;
+	int err = 0;
+
+	mb = mbuf_alloc(RTP_HEADER_SIZE + 4 + len);
+	if (!mb)
+		return ENOMEM;
+
+	err |= mbuf_write_u8(mb, RTP_VERSION << 6 | tx->ext << 4 | tx->cc);
+	err |= mbuf_write_u8(mb, tx->m << 7 | tx->pt);
+	err |= mbuf_write_u16(mb, htons(tx->seq));
+	err |= mbuf_write_u32(mb, htonl(tx->ts));
+	err |= mbuf_write_u32(mb, htonl(tx->ssrc));
+	if (tx->cc)
+		err |= mbuf_write_u32(mb, htonl(csrc));
+	err |= mbuf_write_mem(mb, p, len);
+	if (err)
+		goto out;
+
+	mb->pos = 0;
+	err = rtp_hdr_decode(hdr, mb);
+
+ out:
+	if (err)
+		mem_deref(mb);
+	else
+		*mbp = mb;
+
+	return err;
+}
+
+
+static void fec_recover_handler(const struct rtp_header *hdr,
+				struct mbuf *mb, void *arg)
+{
+	struct fec_test *ft = arg;
+	const struct rtp_header *tx = &ft->hdrv[2];
+	const struct mbuf *pkt = ft->pktv[2];
+	int err = 0;
+
+	ASSERT_EQ(tx->seq, hdr->seq);
+	ASSERT_EQ(tx->ts, hdr->ts);
+	ASSERT_EQ(tx->m, hdr->m);
+	ASSERT_EQ(tx->pt, hdr->pt);
+	ASSERT_EQ(tx->ext, hdr->ext);
+	ASSERT_EQ(0x11223344, hdr->ssrc);
+
+	/* the extension is before the payload */
+	mb->pos -= RTPEXT_HDR_SIZE + hdr->x.len * 4;
+	TEST_MEMCMP(pkt->buf, pkt->end, mbuf_buf(mb), mbuf_get_left(mb));
+
+	++ft->recovered;
+
+ out:
+	if (err)
+		ft->err = err;
+}
+
+
+int test_fec(void)
+{
+	struct fec_test ft;
+	struct fec_enc *enc = NULL;
+	struct fec_dec *dec = NULL;
+	struct mbuf *repair = NULL, *mb = NULL;
+	struct rtp_header fhdr, hdr;
+	int err;
+
+	memset(&ft, 0, sizeof(ft));
+
+	ASSERT_EQ(FEC_GROUP_MAX, fec_group_size(0.0));
+	ASSERT_EQ(10, fec_group_size(0.02));
+	ASSERT_EQ(FEC_GROUP_MIN, fec_group_size(0.5));
+
+	err  = fec_enc_alloc(&enc);
+	err |= fec_dec_alloc(&dec);
+	TEST_ERR(err);
+
+	/* disabled */
+	ASSERT_EQ(0, fec_enc_group(enc));
+
+	fec_enc_set_group(enc, 4);
+	ASSERT_EQ(4, fec_enc_group(enc));
+
+	/* 4 packets of different length, one with a header extension */
+	for (unsigned i = 0; i < 4; i++) {
+		struct rtp_header *tx = &ft.hdrv[i];
+		size_t len = 100 + 37 * i;
+
+		tx->ver  = RTP_VERSION;
+		tx->ext  = i == 2;
+		tx->m    = i == 3;
+		tx->pt   = 96;
+		tx->seq  = 65534 + i;
+		tx->ts   = 90000 + (i / 2) * 3000;
+		tx->ssrc = 0x11223344;
+
+		ft.pktv[i] = mbuf_alloc(len + 8);
+		if (!ft.pktv[i]) {
+			err = ENOMEM;
+			goto out;
+		}
+
+		if (tx->ext) {
+			err  = mbuf_write_u16(ft.pktv[i], htons(0xbede));
+			err |= mbuf_write_u16(ft.pktv[i], htons(1));
+			err |= mbuf_write_u32(ft.pktv[i], htonl(0x10ab0000));
+			TEST_ERR(err);
+		}
+
+		for (size_t j = 0; j < len; j++)
+			err |= mbuf_write_u8(ft.pktv[i], (uint8_t)(i + j * 7));
+		TEST_ERR(err);
+
+		err = fec_enc_packet(enc, &repair, tx, ft.pktv[i]->buf,
+				     ft.pktv[i]->end);
+		TEST_ERR(err);
+
+		ASSERT_TRUE((repair != NULL) == (i == 3));
+	}
+
+	/* packet 2 is lost */
+	for (unsigned i = 0; i < 4; i++) {
+
+		if (i == 2)
+			continue;
+
+		err = fec_rtp_packet(&mb, &hdr, &ft.hdrv[i], 0,
+				     ft.pktv[i]->buf, ft.pktv[i]->end);
+		TEST_ERR(err);
+
+		fec_dec_media(dec, &hdr, mb);
+		mb = mem_deref(mb);
+	}
+
+	memset(&fhdr, 0, sizeof(fhdr));
+	fhdr.cc   = 1;
+	fhdr.pt   = 100;
+	fhdr.ssrc = 0x55667788;
+
+	err = fec_rtp_packet(&mb, &hdr, &fhdr, 0x11223344,
+			     mbuf_buf(repair), mbuf_get_left(repair));
+	TEST_ERR(err);
+
+	err = fec_dec_repair(dec, &hdr, mb, fec_recover_handler, &ft);
+	TEST_ERR(err);
+	TEST_ERR(ft.err);
+	ASSERT_EQ(1, ft.recovered);
+
+	/* nothing is missing now */
+	err = fec_dec_repair(dec, &hdr, mb, fec_recover_handler, &ft);
+	TEST_ERR(err);
+	ASSERT_EQ(1, ft.recovered);
+
+	/* two packets of the group are lost */
+	mem_deref(dec);
+	err = fec_dec_alloc(&dec);
+	TEST_ERR(err);
+
+	ASSERT_EQ(ENOENT, fec_dec_repair(dec, &hdr, mb, fec_recover_handler,
+					 &ft));
+	ASSERT_EQ(1, ft.recovered);
+	err = 0;
+
+ out:
+	for (unsigned i = 0; i < 4; i++)
+		mem_deref(ft.pktv[i]);
+	mem_deref(repair);
+	mem_deref(mb);
+	mem_deref(dec);
+	mem_deref(enc);
+
+	return err;
+}